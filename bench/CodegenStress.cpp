@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "backend/CodeGen.h"
+#include "DebugUtils.h"
+#include "Tree.h"
+
+// Stress benchmark for the backend: builds machine-generated functions with very
+// long statement blocks directly in memory (flat NODE_BLOCK bodies, as the parser
+// builds them) and measures GenerateCode throughput.
+//
+// Usage: codegen-stress [statements_per_function] [functions] [output.asm]
+
+const size_t DEFAULT_STATEMENTS = 1000000;
+const size_t DEFAULT_FUNCTIONS  = 1;
+
+static Node_t *MakeLeafNumber( int number ) {
+    TreeData_t value = {};
+    value.type = NODE_NUMBER;
+    value.data.number = number;
+
+    return NodeCreate( value, NULL );
+}
+
+static Node_t *MakeLeafVariable( const char *name ) {
+    TreeData_t value = {};
+    value.type = NODE_VARIABLE;
+    value.data.variable = strdup( name );
+
+    return NodeCreate( value, NULL );
+}
+
+static Node_t *MakeOp( OperationType op, Node_t *left, Node_t *right ) {
+    TreeData_t value = {};
+    value.type = NODE_OPERATION;
+    value.data.operation = op;
+
+    Node_t *node = NodeCreate( value, NULL );
+
+    node->left = left;
+    node->right = right;
+    if ( left )
+        left->parent = node;
+    if ( right )
+        right->parent = node;
+
+    return node;
+}
+
+// Cycles through assignments, arithmetic with powers, print, if/else and while
+static Node_t *MakeStatement( size_t i ) {
+    const char *vars[] = { "a", "b", "c", "d", "e" };
+    const char *var = vars[i % 5];
+    const char *other = vars[( i + 1 ) % 5];
+
+    switch ( i % 5 ) {
+        case 0:
+            return MakeOp( OP_ADVERT, MakeLeafVariable( var ), MakeLeafNumber( (int)( i % 100 ) ) );
+        case 1:
+            return MakeOp( OP_ASSIGN, MakeLeafVariable( var ),
+                           MakeOp( OP_ADD, MakeOp( OP_MUL, MakeLeafVariable( other ), MakeLeafNumber( 2 ) ),
+                                   MakeOp( OP_POW, MakeLeafVariable( var ), MakeLeafNumber( 3 ) ) ) );
+        case 2:
+            return MakeOp( OP_OUT, MakeOp( OP_SUB, MakeLeafVariable( var ), MakeLeafVariable( other ) ), NULL );
+        case 3:
+            return MakeOp( OP_IF, MakeLeafVariable( var ),
+                           MakeOp( OP_ELSE, MakeOp( OP_OUT, MakeLeafVariable( var ), NULL ),
+                                   MakeOp( OP_OUT, MakeLeafVariable( other ), NULL ) ) );
+        default:
+            return MakeOp( OP_WHILE, MakeLeafVariable( var ),
+                           MakeOp( OP_ASSIGN, MakeLeafVariable( var ),
+                                   MakeOp( OP_SUB, MakeLeafVariable( var ), MakeLeafNumber( 1 ) ) ) );
+    }
+}
+
+static Node_t *MakeFunction( const char *name, size_t statements ) {
+    Node_t *body = BlockCreate( NULL );
+    for ( size_t i = 0; i < statements; i++ )
+        BlockAppend( body, MakeStatement( i ) );
+
+    Node_t *info = MakeOp( OP_COMMA, MakeLeafVariable( name ), MakeLeafVariable( "a" ) );
+    return MakeOp( OP_FUNC, info, body );
+}
+
+static double Seconds( const struct timespec *start, const struct timespec *end ) {
+    return (double)( end->tv_sec - start->tv_sec ) + (double)( end->tv_nsec - start->tv_nsec ) * 1e-9;
+}
+
+int main( int argc, char **argv ) {
+    size_t statements = argc > 1 ? strtoull( argv[1], NULL, 10 ) : DEFAULT_STATEMENTS;
+    size_t functions = argc > 2 ? strtoull( argv[2], NULL, 10 ) : DEFAULT_FUNCTIONS;
+    const char *output = argc > 3 ? argv[3] : "/dev/null";
+
+    if ( statements == 0 || functions == 0 ) {
+        PRINT_ERROR( "Usage: %s [statements_per_function] [functions] [output.asm]", argv[0] );
+        return 1;
+    }
+
+    struct timespec build_start = {}, gen_start = {}, gen_end = {}, free_end = {};
+    clock_gettime( CLOCK_MONOTONIC, &build_start );
+
+    Tree_t *tree = TreeCtor();
+    tree->root = BlockCreate( NULL );
+    for ( size_t f = 0; f < functions; f++ ) {
+        char name[32] = {};
+        snprintf( name, sizeof( name ), "f%zu", f );
+
+        BlockAppend( tree->root, MakeFunction( name, statements ) );
+    }
+
+    CodeGen_t *codegen = CodeGenCtor( "<generated>", output );
+    if ( !codegen ) {
+        TreeDtor( &tree, NULL );
+        return 1;
+    }
+    codegen->tree = tree;
+
+    clock_gettime( CLOCK_MONOTONIC, &gen_start );
+    GenerateCode( codegen );
+    clock_gettime( CLOCK_MONOTONIC, &gen_end );
+
+    CodeGenDtor( &codegen );
+    clock_gettime( CLOCK_MONOTONIC, &free_end );
+
+    size_t total = statements * functions;
+    double gen_time = Seconds( &gen_start, &gen_end );
+
+    printf( "statements:   %zu (%zu x %zu)\n", total, functions, statements );
+    printf( "build AST:    %.3f s\n", Seconds( &build_start, &gen_start ) );
+    printf( "codegen:      %.3f s (%.0f statements/s)\n", gen_time, gen_time > 0 ? (double)total / gen_time : 0.0 );
+    printf( "free AST:     %.3f s\n", Seconds( &gen_end, &free_end ) );
+
+    return 0;
+}
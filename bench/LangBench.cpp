@@ -0,0 +1,751 @@
+#include <getopt.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "backend/CodeGen.h"
+#include "DebugUtils.h"
+#include "Tree.h"
+#include "frontend/Parser.h"
+
+// Phase benchmark of the whole compiler on synthetic programs. A seeded generator writes
+// `.lang` sources of a controlled shape and size, then every repetition runs the pipeline
+// in process: lex, parse, save the AST, load it back and generate code. The warm-up runs
+// are not recorded; for the recorded ones min/median/mean/stddev/max and the throughput
+// over the source size are printed as a table, CSV or JSON. With the same seed and knobs
+// the programs are byte-identical, so runs of different commits compare directly.
+//
+// Usage: lang-bench [options], see --help
+//        lang-bench --generate FILE [options]   only write the program of the first size
+
+const size_t SOURCE_DEFAULT_CAPACITY = 1 << 16;
+const size_t SIZES_MAX               = 32;
+
+const char   DEFAULT_SIZES[]         = "1K,64K,1M,16M";
+const size_t DEFAULT_STATEMENTS      = 24;
+const size_t DEFAULT_DEPTH           = 3;
+const size_t DEFAULT_IDENTIFIERS     = 8;
+const size_t DEFAULT_COMMENTS        = 10;  // percent of statements preceded by a comment line
+const size_t DEFAULT_REPEAT          = 5;
+const size_t DEFAULT_WARMUP          = 1;
+const uint64_t DEFAULT_SEED          = 1;
+
+const size_t ERROR_BUFFER_SIZE       = 256;
+
+enum BenchPhase_t {
+    BENCH_LEX,
+    BENCH_PARSE,
+    BENCH_SAVE,
+    BENCH_LOAD,
+    BENCH_CODEGEN,
+
+    BENCH_PHASES_COUNT
+};
+
+static const char *const BENCH_PHASE_NAMES[BENCH_PHASES_COUNT] = { "lex", "parse", "save", "load", "codegen" };
+
+enum BenchFormat_t {
+    BENCH_TABLE,
+    BENCH_CSV,
+    BENCH_JSON
+};
+
+enum BenchLongOption {
+    OPTION_SIZES = 256,
+    OPTION_FUNCTIONS,
+    OPTION_STATEMENTS,
+    OPTION_DEPTH,
+    OPTION_IDENTIFIERS,
+    OPTION_COMMENTS,
+    OPTION_SEED,
+    OPTION_REPEAT,
+    OPTION_WARMUP,
+    OPTION_FORMAT,
+    OPTION_LABEL,
+    OPTION_WORK_DIR,
+    OPTION_GENERATE
+};
+
+struct BenchOptions_t {
+    size_t sizes[SIZES_MAX]; // target source sizes in bytes
+    size_t sizes_count;
+    size_t functions;        // a fixed number of functions instead of the sizes, 0 - fill the sizes
+
+    size_t statements;       // per function, besides the declarations and the return
+    size_t depth;            // of expression trees
+    size_t identifiers;      // locals declared in every function
+    size_t comments;         // percent
+    uint64_t seed;
+
+    size_t repeat;
+    size_t warmup;
+    size_t threads;          // for lexing and parsing, 0 - one per hardware thread
+
+    BenchFormat_t format;
+    const char *label;       // e.g. the commit, copied into every result
+    const char *work_dir;    // for the AST and assembly files
+    const char *generate_filename;
+};
+
+struct Source_t {
+    char *text;
+    size_t length;
+    size_t capacity;
+
+    size_t functions;
+};
+
+struct PhaseStats_t {
+    double min;
+    double median;
+    double mean;
+    double stddev;
+    double max;
+};
+
+struct BenchResult_t {
+    size_t bytes;
+    size_t functions;
+    size_t tokens;
+
+    PhaseStats_t phases[BENCH_PHASES_COUNT]; // seconds
+};
+
+// xorshift64*, the same sequence on every platform
+static uint64_t random_state = DEFAULT_SEED;
+
+static size_t Random( size_t bound ) {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+
+    return (size_t)( ( random_state * 2685821657736338717ull ) >> 33 ) % bound;
+}
+
+static bool Chance( size_t percent ) {
+    return Random( 100 ) < percent;
+}
+
+static double NowSeconds() {
+    struct timespec now = {};
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+//———————————————————————————————————————————————————————————————————————————————————————
+// Generator
+//———————————————————————————————————————————————————————————————————————————————————————
+
+static bool SourceReserve( Source_t *source, size_t extra ) {
+    if ( source->length + extra < source->capacity )
+        return true;
+
+    size_t capacity = source->capacity ? source->capacity : SOURCE_DEFAULT_CAPACITY;
+    while ( source->length + extra >= capacity )
+        capacity *= 2;
+
+    char *text = (char *)realloc( source->text, capacity );
+    if ( !text ) {
+        PRINT_ERROR( "Memory allocation error" );
+        return false;
+    }
+
+    source->text = text;
+    source->capacity = capacity;
+    return true;
+}
+
+// Appends are small, a failed one only stops the growth: the caller checks SourceReserve
+static void SourceAppend( Source_t *source, const char *format, ... ) {
+    va_list args;
+    va_start( args, format );
+    va_list args_copy;
+    va_copy( args_copy, args );
+
+    int length = vsnprintf( NULL, 0, format, args );
+    if ( length > 0 && SourceReserve( source, (size_t)length + 1 ) ) {
+        vsnprintf( source->text + source->length, (size_t)length + 1, format, args_copy );
+        source->length += (size_t)length;
+    }
+
+    va_end( args_copy );
+    va_end( args );
+}
+
+static void SourceIndent( Source_t *source, size_t level ) {
+    SourceAppend( source, "%*s", (int)( level * 4 ), "" );
+}
+
+// Parameters a, b, c and the locals v0..v<identifiers - 1>
+static void AppendIdentifier( Source_t *source, const BenchOptions_t *options ) {
+    size_t index = Random( options->identifiers + 3 );
+    if ( index < 3 )
+        SourceAppend( source, "%c", 'a' + (int)index );
+    else
+        SourceAppend( source, "v%zu", index - 3 );
+}
+
+static void AppendExpression( Source_t *source, const BenchOptions_t *options, size_t depth ) {
+    if ( depth == 0 || Chance( 20 ) ) {
+        if ( Chance( 40 ) )
+            SourceAppend( source, "%zu", Random( 10 ) );
+        else
+            AppendIdentifier( source, options );
+        return;
+    }
+
+    if ( Chance( 5 ) ) {
+        SourceAppend( source, "sqrt(" );
+        AppendExpression( source, options, depth - 1 );
+        SourceAppend( source, ")" );
+        return;
+    }
+
+    static const char *const OPERATORS[] = { "+", "-", "*", "/", "^" };
+    bool parentheses = Chance( 30 );
+
+    if ( parentheses )
+        SourceAppend( source, "(" );
+    AppendExpression( source, options, depth - 1 );
+    SourceAppend( source, " %s ", OPERATORS[Random( sizeof( OPERATORS ) / sizeof( *OPERATORS ) )] );
+    AppendExpression( source, options, depth - 1 );
+    if ( parentheses )
+        SourceAppend( source, ")" );
+}
+
+static void AppendAssignment( Source_t *source, const BenchOptions_t *options, size_t level ) {
+    SourceIndent( source, level );
+    AppendIdentifier( source, options );
+    SourceAppend( source, " = " );
+    AppendExpression( source, options, options->depth );
+    SourceAppend( source, ";\n" );
+}
+
+// Mostly assignments, as in real code, with prints, branches, loops and calls of earlier functions
+static void AppendStatement( Source_t *source, const BenchOptions_t *options, size_t function ) {
+    if ( Chance( options->comments ) )
+        SourceAppend( source, "    // statement %zu of f%zu: x = (y + 1) { }\n", source->length % 1000, function );
+
+    size_t kind = Random( 10 );
+    switch ( kind ) {
+        case 0:
+            SourceAppend( source, "    print(" );
+            AppendExpression( source, options, options->depth );
+            SourceAppend( source, ");\n" );
+            break;
+        case 1:
+            SourceAppend( source, "    if (" );
+            AppendExpression( source, options, options->depth );
+            SourceAppend( source, ") {\n" );
+            AppendAssignment( source, options, 2 );
+            SourceAppend( source, "    } else {\n" );
+            AppendAssignment( source, options, 2 );
+            SourceAppend( source, "    }\n" );
+            break;
+        case 2:
+            SourceAppend( source, "    while (" );
+            AppendIdentifier( source, options );
+            SourceAppend( source, ") {\n" );
+            AppendAssignment( source, options, 2 );
+            SourceAppend( source, "    }\n" );
+            break;
+        case 3:
+            if ( function ) {
+                SourceAppend( source, "    " );
+                AppendIdentifier( source, options );
+                SourceAppend( source, " = call f%zu(", Random( function ) );
+                for ( size_t i = 0; i < 3; i++ ) {
+                    SourceAppend( source, i ? ", " : "" );
+                    AppendExpression( source, options, options->depth / 2 );
+                }
+                SourceAppend( source, ");\n" );
+                break;
+            }
+            AppendAssignment( source, options, 1 );
+            break;
+        default:
+            AppendAssignment( source, options, 1 );
+            break;
+    }
+}
+
+static void AppendFunction( Source_t *source, const BenchOptions_t *options ) {
+    size_t function = source->functions++;
+
+    SourceAppend( source, "func f%zu(a, b, c) {\n", function );
+    for ( size_t i = 0; i < options->identifiers; i++ )
+        SourceAppend( source, "    v%zu := %zu;\n", i, Random( 100 ) );
+
+    for ( size_t i = 0; i < options->statements; i++ )
+        AppendStatement( source, options, function );
+
+    SourceAppend( source, "    return " );
+    AppendExpression( source, options, options->depth );
+    SourceAppend( source, ";\n}\n" );
+}
+
+// Functions are added until the source reaches `bytes`, or `options->functions` of them
+static bool GenerateSource( Source_t *source, const BenchOptions_t *options, size_t bytes ) {
+    random_state = options->seed ? options->seed : DEFAULT_SEED;
+    source->length = 0;
+    source->functions = 0;
+
+    SourceAppend( source, "// lang-bench seed %llu\n", (unsigned long long)options->seed );
+    while ( options->functions ? source->functions < options->functions : source->length < bytes ) {
+        if ( !SourceReserve( source, SOURCE_DEFAULT_CAPACITY ) )
+            return false;
+        AppendFunction( source, options );
+    }
+
+    SourceAppend( source, "main() { x := call f%zu(1, 2, 3); print(x); }\n", source->functions - 1 );
+    return SourceReserve( source, 1 );
+}
+
+//———————————————————————————————————————————————————————————————————————————————————————
+// Measurement
+//———————————————————————————————————————————————————————————————————————————————————————
+
+// Top-level subtrees go back into one block, the tree GenerateCode expects
+static bool AppendSubtree( Node_t *subtree, void *context ) {
+    BlockAppend( (Node_t *)context, subtree );
+    return true;
+}
+
+struct BenchRun_t {
+    double seconds[BENCH_PHASES_COUNT];
+    size_t tokens;
+};
+
+// One pass of the pipeline; every phase gets the output of the previous one
+static bool RunPipeline( const Source_t *source, char *work, const BenchOptions_t *options, const char *ast_filename,
+                         const char *asm_filename, BenchRun_t *run ) {
+    memcpy( work, source->text, source->length + 1 );
+
+    Parser_t *parser = ParserCtorWithFiles( "<lang-bench>", NULL );
+    if ( !parser )
+        return false;
+    parser->threads = options->threads;
+
+    double start = NowSeconds();
+    Node_t **tokens = LexicalAnalyzeBuffer( parser, work );
+    double lexed = NowSeconds();
+    Node_t *root = tokens ? SyntaxAnalyze( parser ) : NULL;
+    double parsed = NowSeconds();
+
+    run->seconds[BENCH_LEX] = lexed - start;
+    run->seconds[BENCH_PARSE] = parsed - lexed;
+    run->tokens = TokenArraySize( &( parser->tokens ) );
+
+    if ( !root ) {
+        PRINT_ERROR( "The generated program does not compile, see --generate" );
+        ParserDtor( &parser );
+        return false;
+    }
+
+    parser->tree = TreeCtor();
+    parser->tree->root = root;
+    Tree_t *tree = ParserReleaseTree( parser );
+    ParserDtor( &parser );
+
+    start = NowSeconds();
+    TreeSaveToFile( tree, ast_filename );
+    run->seconds[BENCH_SAVE] = NowSeconds() - start;
+    TreeDtor( &tree, NULL );
+
+    // The way lang-back reads it: streamed, one top-level subtree at a time
+    char error[ERROR_BUFFER_SIZE] = "";
+    tree = TreeCtor();
+    tree->root = BlockCreate( NULL );
+    start = NowSeconds();
+    bool loaded = TreeLoadStreaming( ast_filename, AppendSubtree, tree->root, error, sizeof( error ) );
+    run->seconds[BENCH_LOAD] = NowSeconds() - start;
+    if ( !loaded ) {
+        PRINT_ERROR( "Fail to load the saved AST: %s", error );
+        TreeDtor( &tree, NULL );
+        return false;
+    }
+
+    CodeGen_t *codegen = CodeGenCtor( "<lang-bench>", asm_filename );
+    if ( !codegen ) {
+        TreeDtor( &tree, NULL );
+        return false;
+    }
+    codegen->tree = tree;
+
+    start = NowSeconds();
+    GenerateCode( codegen );
+    run->seconds[BENCH_CODEGEN] = NowSeconds() - start;
+    CodeGenDtor( &codegen );
+
+    return true;
+}
+
+static int CompareDoubles( const void *first, const void *second ) {
+    double a = *(const double *)first;
+    double b = *(const double *)second;
+
+    return ( a > b ) - ( a < b );
+}
+
+// Sorts `samples`
+static PhaseStats_t ComputeStats( double *samples, size_t count ) {
+    qsort( samples, count, sizeof( *samples ), CompareDoubles );
+
+    PhaseStats_t stats = {};
+    stats.min = samples[0];
+    stats.max = samples[count - 1];
+    stats.median = count % 2 ? samples[count / 2] : ( samples[count / 2 - 1] + samples[count / 2] ) / 2;
+
+    double sum = 0;
+    for ( size_t i = 0; i < count; i++ )
+        sum += samples[i];
+    stats.mean = sum / (double)count;
+
+    double squares = 0;
+    for ( size_t i = 0; i < count; i++ )
+        squares += ( samples[i] - stats.mean ) * ( samples[i] - stats.mean );
+    stats.stddev = count > 1 ? sqrt( squares / (double)( count - 1 ) ) : 0;
+
+    return stats;
+}
+
+static bool BenchSize( const Source_t *source, const BenchOptions_t *options, BenchResult_t *result ) {
+    char *work = (char *)calloc( source->length + 1, sizeof( *work ) );
+    double *samples = (double *)calloc( BENCH_PHASES_COUNT * options->repeat, sizeof( *samples ) );
+    if ( !work || !samples ) {
+        PRINT_ERROR( "Memory allocation error" );
+        free( work );
+        free( samples );
+        return false;
+    }
+
+    char ast_filename[PATH_MAX] = "";
+    char asm_filename[PATH_MAX] = "";
+    snprintf( ast_filename, sizeof( ast_filename ), "%s/lang-bench-%d.ast", options->work_dir, (int)getpid() );
+    snprintf( asm_filename, sizeof( asm_filename ), "%s/lang-bench-%d.asm", options->work_dir, (int)getpid() );
+
+    bool ok = true;
+    for ( size_t i = 0; ok && i < options->warmup + options->repeat; i++ ) {
+        BenchRun_t run = {};
+        ok = RunPipeline( source, work, options, ast_filename, asm_filename, &run );
+        result->tokens = run.tokens;
+
+        if ( i < options->warmup )
+            continue;
+
+        for ( size_t phase = 0; phase < BENCH_PHASES_COUNT; phase++ )
+            samples[phase * options->repeat + i - options->warmup] = run.seconds[phase];
+    }
+
+    if ( ok ) {
+        result->bytes = source->length;
+        result->functions = source->functions;
+        for ( size_t phase = 0; phase < BENCH_PHASES_COUNT; phase++ )
+            result->phases[phase] = ComputeStats( samples + phase * options->repeat, options->repeat );
+    }
+
+    unlink( ast_filename );
+    unlink( asm_filename );
+    free( work );
+    free( samples );
+    return ok;
+}
+
+//———————————————————————————————————————————————————————————————————————————————————————
+// Output
+//———————————————————————————————————————————————————————————————————————————————————————
+
+static double MegabytesPerSecond( size_t bytes, double seconds ) {
+    return seconds > 0 ? (double)bytes / seconds / 1e6 : 0;
+}
+
+static void PrintJsonString( const char *string ) {
+    putchar( '"' );
+    for ( const char *pos = string; *pos; pos++ ) {
+        if ( *pos == '"' || *pos == '\\' )
+            putchar( '\\' );
+        if ( (unsigned char)*pos >= ' ' )
+            putchar( *pos );
+    }
+    putchar( '"' );
+}
+
+static void PrintHeader( const BenchOptions_t *options ) {
+    switch ( options->format ) {
+        case BENCH_CSV:
+            printf( "label,seed,statements,depth,identifiers,comments,threads,bytes,functions,tokens,phase,repeat,"
+                    "min_ms,median_ms,mean_ms,stddev_ms,max_ms,median_mb_per_sec\n" );
+            break;
+        case BENCH_JSON:
+            printf( "{\"label\": " );
+            PrintJsonString( options->label );
+            printf( ", \"seed\": %llu, \"statements\": %zu, \"depth\": %zu, \"identifiers\": %zu, "
+                    "\"comments\": %zu, \"threads\": %zu, \"warmup\": %zu, \"repeat\": %zu, \"results\": [",
+                    (unsigned long long)options->seed, options->statements, options->depth, options->identifiers,
+                    options->comments, options->threads, options->warmup, options->repeat );
+            break;
+        case BENCH_TABLE:
+        default:
+            printf( "lang-bench %s: seed %llu, %zu statements, depth %zu, %zu identifiers, %zu%% comments, "
+                    "%zu warm-up + %zu runs\n",
+                    options->label, (unsigned long long)options->seed, options->statements, options->depth,
+                    options->identifiers, options->comments, options->warmup, options->repeat );
+            break;
+    }
+}
+
+static void PrintResult( const BenchOptions_t *options, const BenchResult_t *result, bool first ) {
+    switch ( options->format ) {
+        case BENCH_CSV:
+            for ( size_t phase = 0; phase < BENCH_PHASES_COUNT; phase++ ) {
+                const PhaseStats_t *stats = &result->phases[phase];
+                printf( "%s,%llu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%s,%zu,%.4f,%.4f,%.4f,%.4f,%.4f,%.2f\n",
+                        options->label, (unsigned long long)options->seed, options->statements, options->depth,
+                        options->identifiers, options->comments, options->threads, result->bytes,
+                        result->functions, result->tokens, BENCH_PHASE_NAMES[phase], options->repeat,
+                        stats->min * 1e3, stats->median * 1e3, stats->mean * 1e3, stats->stddev * 1e3,
+                        stats->max * 1e3, MegabytesPerSecond( result->bytes, stats->median ) );
+            }
+            break;
+        case BENCH_JSON:
+            printf( "%s\n  {\"bytes\": %zu, \"functions\": %zu, \"tokens\": %zu, \"phases\": {", first ? "" : ",",
+                    result->bytes, result->functions, result->tokens );
+            for ( size_t phase = 0; phase < BENCH_PHASES_COUNT; phase++ ) {
+                const PhaseStats_t *stats = &result->phases[phase];
+                printf( "%s\"%s\": {\"min_ms\": %.4f, \"median_ms\": %.4f, \"mean_ms\": %.4f, \"stddev_ms\": %.4f, "
+                        "\"max_ms\": %.4f, \"median_mb_per_sec\": %.2f}",
+                        phase ? ", " : "", BENCH_PHASE_NAMES[phase], stats->min * 1e3, stats->median * 1e3,
+                        stats->mean * 1e3, stats->stddev * 1e3, stats->max * 1e3,
+                        MegabytesPerSecond( result->bytes, stats->median ) );
+            }
+            printf( "}}" );
+            break;
+        case BENCH_TABLE:
+        default:
+            printf( "\n%zu bytes, %zu functions, %zu tokens\n", result->bytes, result->functions, result->tokens );
+            printf( "%-8s %12s %12s %12s %12s %12s %12s\n", "phase", "min ms", "median ms", "mean ms", "stddev ms",
+                    "max ms", "MB/s" );
+            for ( size_t phase = 0; phase < BENCH_PHASES_COUNT; phase++ ) {
+                const PhaseStats_t *stats = &result->phases[phase];
+                printf( "%-8s %12.3f %12.3f %12.3f %12.3f %12.3f %12.2f\n", BENCH_PHASE_NAMES[phase],
+                        stats->min * 1e3, stats->median * 1e3, stats->mean * 1e3, stats->stddev * 1e3,
+                        stats->max * 1e3, MegabytesPerSecond( result->bytes, stats->median ) );
+            }
+            break;
+    }
+
+    fflush( stdout );
+}
+
+static void PrintFooter( const BenchOptions_t *options ) {
+    if ( options->format == BENCH_JSON )
+        printf( "\n]}\n" );
+}
+
+//———————————————————————————————————————————————————————————————————————————————————————
+// Command line
+//———————————————————————————————————————————————————————————————————————————————————————
+
+static void HelpPrint( const char *program_name ) {
+    printf( "Usage: %s [options]\n", program_name );
+    printf( "       %s --generate FILE [options]\n", program_name );
+    printf( "Program shape:\n" );
+    printf( "  --sizes LIST       source sizes to fill, K/M/G suffixes, up to %zu (default: %s)\n", SIZES_MAX,
+            DEFAULT_SIZES );
+    printf( "  --functions N      exactly N functions instead of the sizes\n" );
+    printf( "  --statements N     statements per function (default: %zu)\n", DEFAULT_STATEMENTS );
+    printf( "  --depth N          expression depth (default: %zu)\n", DEFAULT_DEPTH );
+    printf( "  --identifiers N    locals per function besides a, b, c (default: %zu)\n", DEFAULT_IDENTIFIERS );
+    printf( "  --comments PERCENT statements preceded by a comment line (default: %zu)\n", DEFAULT_COMMENTS );
+    printf( "  --seed N           generator seed (default: %llu)\n", (unsigned long long)DEFAULT_SEED );
+    printf( "Measurement:\n" );
+    printf( "  --repeat N         recorded runs per size (default: %zu)\n", DEFAULT_REPEAT );
+    printf( "  --warmup N         runs before them that are not recorded (default: %zu)\n", DEFAULT_WARMUP );
+    printf( "  -j N               lex and parse on N threads (default: one per CPU)\n" );
+    printf( "  --format FORMAT    table, csv or json (default: table)\n" );
+    printf( "  --label TEXT       copied into the results, e.g. the commit\n" );
+    printf( "  --work-dir DIR     where the AST and assembly are written (default: /tmp)\n" );
+    printf( "  --generate FILE    write the program of the first size to FILE and exit\n" );
+    printf( "  -h                 show this help\n" );
+}
+
+static bool ParseCount( const char *argument, size_t *count, size_t min ) {
+    char *end = NULL;
+    unsigned long long value = strtoull( argument, &end, 10 );
+    if ( !end || end == argument || *end != '\0' || value < min || argument[0] == '-' )
+        return false;
+
+    *count = (size_t)value;
+    return true;
+}
+
+// `1K,64K,1M,1G`, powers of 1024
+static bool ParseSizes( char *argument, BenchOptions_t *options ) {
+    options->sizes_count = 0;
+
+    for ( char *item = strtok( argument, "," ); item; item = strtok( NULL, "," ) ) {
+        char *end = NULL;
+        unsigned long long size = strtoull( item, &end, 10 );
+        if ( end == item || item[0] == '-' || options->sizes_count == SIZES_MAX )
+            return false;
+
+        switch ( *end ) {
+            case 'g': case 'G': size <<= 10; [[fallthrough]];
+            case 'm': case 'M': size <<= 10; [[fallthrough]];
+            case 'k': case 'K': size <<= 10; end++; break;
+            default: break;
+        }
+        if ( *end != '\0' || !size )
+            return false;
+
+        options->sizes[options->sizes_count++] = (size_t)size;
+    }
+
+    return options->sizes_count > 0;
+}
+
+static bool ParseBenchArgs( BenchOptions_t *options, int argc, char **argv ) {
+    static const struct option long_options[] = {
+        { "sizes",       required_argument, NULL, OPTION_SIZES },
+        { "functions",   required_argument, NULL, OPTION_FUNCTIONS },
+        { "statements",  required_argument, NULL, OPTION_STATEMENTS },
+        { "depth",       required_argument, NULL, OPTION_DEPTH },
+        { "identifiers", required_argument, NULL, OPTION_IDENTIFIERS },
+        { "comments",    required_argument, NULL, OPTION_COMMENTS },
+        { "seed",        required_argument, NULL, OPTION_SEED },
+        { "repeat",      required_argument, NULL, OPTION_REPEAT },
+        { "warmup",      required_argument, NULL, OPTION_WARMUP },
+        { "format",      required_argument, NULL, OPTION_FORMAT },
+        { "label",       required_argument, NULL, OPTION_LABEL },
+        { "work-dir",    required_argument, NULL, OPTION_WORK_DIR },
+        { "generate",    required_argument, NULL, OPTION_GENERATE },
+        { "help",        no_argument,       NULL, 'h' },
+        { NULL,          0,                 NULL, 0 }
+    };
+
+    char default_sizes[sizeof( DEFAULT_SIZES )] = "";
+    memcpy( default_sizes, DEFAULT_SIZES, sizeof( DEFAULT_SIZES ) );
+    ParseSizes( default_sizes, options );
+
+    int opt;
+    int index = -1;
+    while ( ( opt = getopt_long( argc, argv, "j:h", long_options, &index ) ) != -1 ) {
+        bool ok = true;
+        size_t seed = 0;
+
+        switch ( opt ) {
+            case OPTION_SIZES:       ok = ParseSizes( optarg, options ); break;
+            case OPTION_FUNCTIONS:   ok = ParseCount( optarg, &options->functions, 1 ); break;
+            case OPTION_STATEMENTS:  ok = ParseCount( optarg, &options->statements, 0 ); break;
+            case OPTION_DEPTH:       ok = ParseCount( optarg, &options->depth, 0 ); break;
+            case OPTION_IDENTIFIERS: ok = ParseCount( optarg, &options->identifiers, 0 ); break;
+            case OPTION_COMMENTS:
+                ok = ParseCount( optarg, &options->comments, 0 ) && options->comments <= 100;
+                break;
+            case OPTION_SEED:
+                ok = ParseCount( optarg, &seed, 0 );
+                options->seed = seed;
+                break;
+            case OPTION_REPEAT:      ok = ParseCount( optarg, &options->repeat, 1 ); break;
+            case OPTION_WARMUP:      ok = ParseCount( optarg, &options->warmup, 0 ); break;
+            case 'j':                ok = ParseCount( optarg, &options->threads, 1 ); break;
+            case OPTION_FORMAT:
+                if ( !strcmp( optarg, "table" ) )
+                    options->format = BENCH_TABLE;
+                else if ( !strcmp( optarg, "csv" ) )
+                    options->format = BENCH_CSV;
+                else if ( !strcmp( optarg, "json" ) )
+                    options->format = BENCH_JSON;
+                else
+                    ok = false;
+                break;
+            case OPTION_LABEL:    options->label = optarg; break;
+            case OPTION_WORK_DIR: options->work_dir = optarg; break;
+            case OPTION_GENERATE: options->generate_filename = optarg; break;
+            case 'h':
+                HelpPrint( argv[0] );
+                return false;
+            case '?':
+            default:
+                return false;
+        }
+
+        if ( !ok ) {
+            PRINT_ERROR( "Bad value `%s` of option `%s`", optarg, opt == 'j' ? "-j" : long_options[index].name );
+            return false;
+        }
+        index = -1;
+    }
+
+    if ( optind != argc ) {
+        PRINT_ERROR( "Unexpected argument `%s`", argv[optind] );
+        return false;
+    }
+
+    // One program of a fixed shape has a single size
+    if ( options->functions )
+        options->sizes_count = 1;
+
+    return true;
+}
+
+static bool WriteSource( const Source_t *source, const char *filename ) {
+    FILE *file = fopen( filename, "w" );
+    if ( !file ) {
+        PRINT_ERROR( "Fail to open file `%s`", filename );
+        return false;
+    }
+
+    bool written = fwrite( source->text, 1, source->length, file ) == source->length;
+    written = !fclose( file ) && written;
+    if ( !written )
+        PRINT_ERROR( "Fail to write file `%s`", filename );
+
+    return written;
+}
+
+int main( int argc, char **argv ) {
+    BenchOptions_t options = {};
+    options.statements = DEFAULT_STATEMENTS;
+    options.depth = DEFAULT_DEPTH;
+    options.identifiers = DEFAULT_IDENTIFIERS;
+    options.comments = DEFAULT_COMMENTS;
+    options.seed = DEFAULT_SEED;
+    options.repeat = DEFAULT_REPEAT;
+    options.warmup = DEFAULT_WARMUP;
+    options.format = BENCH_TABLE;
+    options.label = "";
+    options.work_dir = "/tmp";
+
+    if ( !ParseBenchArgs( &options, argc, argv ) )
+        return 1;
+
+    Source_t source = {};
+    if ( options.generate_filename ) {
+        bool written = GenerateSource( &source, &options, options.sizes[0] ) &&
+                       WriteSource( &source, options.generate_filename );
+        free( source.text );
+        return written ? 0 : 1;
+    }
+
+    PrintHeader( &options );
+
+    bool ok = true;
+    for ( size_t i = 0; ok && i < options.sizes_count; i++ ) {
+        BenchResult_t result = {};
+        ok = GenerateSource( &source, &options, options.sizes[i] ) && BenchSize( &source, &options, &result );
+        if ( ok )
+            PrintResult( &options, &result, i == 0 );
+    }
+
+    PrintFooter( &options );
+    free( source.text );
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+#ifndef BUILD_CACHE_H
+#define BUILD_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Content-addressed cache of whole compiler outputs, shared by lang-front, lang-back and
+// lang. An output is stored under the SHA-256 of the compiler binary identity, the kind of
+// the step, its output-affecting options and the input bytes, so an identical rebuild
+// copies the stored file instead of running the step.
+//
+// Location: $LANG_CACHE_DIR, else $XDG_CACHE_HOME/lang, else ~/.cache/lang.
+// $LANG_CACHE=off disables it, $LANG_CACHE_SIZE sets the size limit in MiB.
+
+#define LANG_VERSION "1.0"
+
+const size_t   BUILD_CACHE_KEY_LENGTH     = 64; // hex SHA-256
+const uint64_t BUILD_CACHE_DEFAULT_LIMIT  = 256ull << 20;
+
+struct BuildCache_t {
+    char* directory;
+    char* compiler; // version and binary identity, part of every key
+    uint64_t size_limit;
+};
+
+struct BuildCacheStats_t {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+    uint64_t bytes; // total size of the stored outputs
+};
+
+// false when the cache is disabled or its directory is unusable, the caller then compiles
+bool BuildCacheOpen( BuildCache_t* cache );
+void BuildCacheClose( BuildCache_t* cache );
+
+// LANG_VERSION and the identity of the running binary, for caches that must not
+// outlive a rebuild of the compiler; the caller frees it
+char* BuildCacheCompilerIdentity();
+
+bool BuildCacheKey( const BuildCache_t* cache, const char* kind, const char* options, const char* input_filename,
+                    char key[BUILD_CACHE_KEY_LENGTH + 1] );
+
+// On a hit writes the stored output to `output_filename` and returns true; counts the lookup
+bool BuildCacheFetch( const BuildCache_t* cache, const char* key, const char* output_filename );
+// Stores a successfully written output, evicting least recently used entries over the limit
+void BuildCacheStore( const BuildCache_t* cache, const char* key, const char* output_filename );
+
+bool BuildCacheReadStats( const BuildCache_t* cache, BuildCacheStats_t* stats );
+void BuildCachePrintStats( const BuildCache_t* cache, FILE* stream );
+
+#endif // BUILD_CACHE_H
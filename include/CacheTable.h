@@ -0,0 +1,55 @@
+#ifndef CACHE_TABLE_H
+#define CACHE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Sha256.h"
+
+// Hash table shared by the AST cache of the frontend and the function cache of the
+// backend. Both keep entries across compiles, look them up by the content they were built
+// from and drop the ones a compile did not touch.
+
+// Identity of the content an entry was built from: the FNV-1a hash picks the slot, a hit
+// also needs the same size and SHA-256, so two different contents never share an entry
+struct CacheKey_t {
+    uint64_t hash;
+    size_t size;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+};
+
+// First member of every entry kept in a CacheTable_t
+struct CacheEntry_t {
+    CacheKey_t key;
+    bool used; // looked up or inserted since the last CacheTableSweep
+};
+
+typedef void ( *CacheEntryDelete_t )( CacheEntry_t* entry );
+
+// Open addressing over stable entry pointers, capacity is a power of two
+struct CacheTable_t {
+    CacheEntry_t** slots;
+    size_t count;
+    size_t capacity;
+};
+
+CacheKey_t CacheKeyOf( const void* data, size_t size );
+bool CacheKeysEqual( const CacheKey_t* first, const CacheKey_t* second );
+
+void CacheTableDtor( CacheTable_t* table, CacheEntryDelete_t entry_delete );
+
+CacheEntry_t* CacheTableFind( CacheTable_t* table, const CacheKey_t* key );
+// Marks `entry` used and puts it under its key, an entry with the same key is deleted
+bool CacheTableInsert( CacheTable_t* table, CacheEntry_t* entry, CacheEntryDelete_t entry_delete );
+
+// Deletes entries not used since the previous sweep and clears the marks, returns the
+// number of deleted entries
+size_t CacheTableSweep( CacheTable_t* table, CacheEntryDelete_t entry_delete );
+
+// On-disk form of a key: `<hash hex> <sha-256 hex> <size>`
+void CacheKeyWrite( FILE* file, const CacheKey_t* key );
+bool CacheKeyRead( const char** pos, const char* end, CacheKey_t* key );
+bool CacheReadNumber( const char** pos, const char* end, int base, unsigned long long* number );
+
+#endif // CACHE_TABLE_H
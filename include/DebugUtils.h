@@ -1,47 +1,59 @@
-#ifndef DEBUG_UTILS_H
-#define DEBUG_UTILS_H
-
-#include "Colors.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <time.h>
-
-
-#ifdef _DEBUG
-
-#define my_assert( arg, message )                                                                            \
-    do {                                                                                                     \
-        if ( !( arg ) ) {                                                                                    \
-            fprintf( stderr, COLOR_BRIGHT_RED "Error in function `%s` %s:%d: %s \n" COLOR_RESET, __func__,   \
-                     __FILE__, __LINE__, message );                                                          \
-            abort();                                                                                         \
-        }                                                                                                    \
-    } while ( 0 )
-
-#define PRINT( str, ... )                                                                                    \
-    do {                                                                                                     \
-        time_t rawtime;                                                                                      \
-        struct tm *timeinfo;                                                                                 \
-        time( &rawtime );                                                                                    \
-        timeinfo = localtime( &rawtime );                                                                    \
-        char time_buffer[20];                                                                                     \
-        strftime( time_buffer, sizeof( time_buffer ), "%H:%M:%S", timeinfo );                                          \
-        fprintf( stderr, "[%s] [%s:%d] [%s] " COLOR_CYAN "[DEBUG]" COLOR_RESET " " str "\n" COLOR_RESET,     \
-                 time_buffer, __FILE__, __LINE__, __func__, ##__VA_ARGS__ );                                      \
-    } while ( 0 )
-
-#define ON_DEBUG( ... ) __VA_ARGS__
-
-#else // !_DEBUG
-
-#define my_assert( arg, message ) ( (void)( arg ) )
-
-#define PRINT( str, ... )
-
-#define ON_DEBUG( ... )
-
-#endif // _DEBUG
-
-#define PRINT_ERROR( format, ... ) fprintf( stderr, COLOR_BRIGHT_RED format COLOR_RESET "\n", ##__VA_ARGS__ )
-
+#ifndef DEBUG_UTILS_H
+#define DEBUG_UTILS_H
+
+#include "Colors.h"
+#include "Log.h"
+#include "Trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#ifdef _DEBUG
+
+#define my_assert( arg, message )                                                                            \
+    do {                                                                                                     \
+        if ( !( arg ) ) {                                                                                    \
+            LogFlush();                                                                                      \
+            fprintf( stderr, COLOR_BRIGHT_RED "Error in function `%s` %s:%d: %s \n" COLOR_RESET, __func__,   \
+                     __FILE__, __LINE__, message );                                                          \
+            abort();                                                                                         \
+        }                                                                                                    \
+    } while ( 0 )
+
+#define ON_DEBUG( ... ) __VA_ARGS__
+
+#else // !_DEBUG
+
+#define my_assert( arg, message ) ( (void)( arg ) )
+
+#define ON_DEBUG( ... )
+
+#endif // _DEBUG
+
+// Pending log lines go first, so the error follows the messages that led to it
+#define PRINT_ERROR( format, ... ) \
+    ( LogFlush(), fprintf( stderr, COLOR_BRIGHT_RED format COLOR_RESET "\n", ##__VA_ARGS__ ) )
+
+// Log messages, see Log.h: the arguments are evaluated only when the message is written
+#define LOG( level, category, format, ... )                                                                  \
+    do {                                                                                                     \
+        if ( ( level ) <= LOG_COMPILED_LEVEL && ( level ) <= log_levels[category] )                          \
+            LogWrite( level, category, __FILE__, __LINE__, __func__, format, ##__VA_ARGS__ );                \
+    } while ( 0 )
+
+#define LOG_WARN( category, format, ... ) LOG( LOG_LEVEL_WARN, category, format, ##__VA_ARGS__ )
+#define LOG_INFO( category, format, ... ) LOG( LOG_LEVEL_INFO, category, format, ##__VA_ARGS__ )
+#define LOG_DEBUG( category, format, ... ) LOG( LOG_LEVEL_DEBUG, category, format, ##__VA_ARGS__ )
+#define LOG_TRACE( category, format, ... ) LOG( LOG_LEVEL_TRACE, category, format, ##__VA_ARGS__ )
+
+// Trace zones, see Trace.h: a zone lasts until the end of the enclosing scope.
+// TRACE_NESTED_ZONE is for recursive code, only the outer `--trace-depth` levels are recorded
+#define TRACE_CONCAT_( a, b ) a##b
+#define TRACE_CONCAT( a, b ) TRACE_CONCAT_( a, b )
+
+#define TRACE_ZONE( name ) TraceZone_t TRACE_CONCAT( trace_zone_, __LINE__ )( name, NULL, false )
+#define TRACE_ZONE_DETAIL( name, detail ) TraceZone_t TRACE_CONCAT( trace_zone_, __LINE__ )( name, detail, false )
+#define TRACE_NESTED_ZONE( name ) TraceZone_t TRACE_CONCAT( trace_zone_, __LINE__ )( name, NULL, true )
+#define TRACE_FUNCTION() TRACE_ZONE( __func__ )
+
 #endif // DEBUG_UTILS_H
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef GRAPH_DUMP_H
+#define GRAPH_DUMP_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#include "Tree.h"
+
+// Graphic snapshots of trees for debug builds: every snapshot is written at once as a
+// DOT file and an entry of <GRAPH_DUMP_DIRECTORY>/index.html, the SVG is rendered later
+// by `dot` off the compiling thread. Async mode renders on a background worker; once
+// GRAPH_DUMP_QUEUE_LIMIT snapshots wait for it, the next ones are rendered at exit in
+// one batched `dot` call, as all of them are in batch mode. Trees larger than the node
+// limit show its first nodes in breadth-first order, deeper subtrees are collapsed into
+// a box with their size.
+
+enum GraphDumpMode_t {
+    GRAPH_DUMP_OFF,   // no files at all
+    GRAPH_DUMP_DOT,   // DOT files and index.html, nothing is rendered
+    GRAPH_DUMP_ASYNC,
+    GRAPH_DUMP_BATCH
+};
+
+const char GRAPH_DUMP_DIRECTORY[]          = "dump_front";
+const size_t GRAPH_DUMP_DEFAULT_NODE_LIMIT = 500;
+const size_t GRAPH_DUMP_QUEUE_LIMIT        = 8;
+
+// `off`, `dot`, `async` or `batch`
+bool GraphDumpParseMode( const char* argument, GraphDumpMode_t* mode );
+// `node_limit` 0 means whole trees
+void GraphDumpConfigure( GraphDumpMode_t mode, size_t node_limit );
+bool GraphDumpEnabled();
+
+// Adds a snapshot of `node` with a caption; NULL `node` adds the caption only
+void GraphDumpTree( const Node_t* node, const char* format, va_list args );
+
+// Waits for the worker and renders the deferred snapshots; also runs at exit
+void GraphDumpFinish();
+
+#endif // GRAPH_DUMP_H
@@ -13,29 +13,47 @@ enum NumberOfParams {
     TWO_ARGS = 2
 };
 
+enum IsPureOp {
+    ImpureOp = 0,
+    PureOp   = 1
+};
+
+// Columns:
+//   token       - source spelling, also used in the text AST format
+//   enum        - OperationType
+//   is_custom   - IsCustomOp
+//   nargs       - legacy parameter marker
+//   string      - name shown in dumps
+//   arity       - number of children an expression of this operation consumes
+//   instruction - VM mnemonic emitted for it, NULL if codegen handles it by hand
+//   is_pure     - has no side effects and may be reordered, duplicated or dropped
+//   cost        - relative VM execution cost, used by the optimizer
+//   lbp, rbp    - left/right binding power of an infix operator for the Pratt parser,
+//                 0 if not infix; lbp < rbp is left-associative, lbp > rbp right-associative
+
 #define INIT_OPERATIONS( macros ) \
-    macros( ":=",      OP_ADVERT,       NonCustomOp, 0, ":="     ) \
-    macros( "=",       OP_ASSIGN,       NonCustomOp, 0, "="      ) \
-    macros( "+",       OP_ADD,          NonCustomOp, 0, "+"      ) \
-    macros( "-",       OP_SUB,          NonCustomOp, 0, "-"      ) \
-    macros( "*",       OP_MUL,          NonCustomOp, 0, "*"      ) \
-    macros( "/",       OP_DIV,          NonCustomOp, 0, "/"      ) \
-    macros( "^",       OP_POW,          NonCustomOp, 0, "^"      ) \
-    macros( "sqrt",    OP_SQRT,         NonCustomOp, 0, "sqrt"   ) \
-    macros( "input",   OP_IN,           NonCustomOp, 0, "input"  ) \
-    macros( "print",   OP_OUT,          CustomOp,    1, "print"  ) \
-    macros( "if",      OP_IF,           CustomOp,    1, "if"     ) \
-    macros( "else",    OP_ELSE,         NonCustomOp, 0, "else"   ) \
-    macros( "while",   OP_WHILE,        CustomOp,    1, "while"  ) \
-    macros( "func",    OP_FUNC,         NonCustomOp, 0, "func"   ) \
-    macros( "call",    OP_CALL,         NonCustomOp, 0, "call"   ) \
-    macros( "return",  OP_RETURN,       NonCustomOp, 0, "return" ) \
-    macros( "main",    OP_MAIN,         NonCustomOp, 0, "main"   ) \
-    macros( ",",       OP_COMMA,        PseudoOp,    0, ","      ) \
-    macros( ";",       OP_SEMICOLON,    PseudoOp,    0, ";"      ) \
-    macros( "(",       OP_OPEN_PARENT,  PseudoOp,    0, "("      ) \
-    macros( ")",       OP_CLOSE_PARENT, PseudoOp,    0, ")"      ) \
-    macros( "{",       OP_OPEN_BRACE,   PseudoOp,    0, "{"      ) \
-    macros( "}",       OP_CLOSE_BRACE,  PseudoOp,    0, "}"      )
+    macros( ":=",      OP_ADVERT,       NonCustomOp, 0, ":=",     TWO_ARGS, NULL,   ImpureOp, 1,  0, 0 ) \
+    macros( "=",       OP_ASSIGN,       NonCustomOp, 0, "=",      TWO_ARGS, NULL,   ImpureOp, 1,  0, 0 ) \
+    macros( "+",       OP_ADD,          NonCustomOp, 0, "+",      TWO_ARGS, "ADD",  PureOp,   1,  1, 2 ) \
+    macros( "-",       OP_SUB,          NonCustomOp, 0, "-",      TWO_ARGS, "SUB",  PureOp,   1,  1, 2 ) \
+    macros( "*",       OP_MUL,          NonCustomOp, 0, "*",      TWO_ARGS, "MUL",  PureOp,   2,  3, 4 ) \
+    macros( "/",       OP_DIV,          NonCustomOp, 0, "/",      TWO_ARGS, "DIV",  PureOp,   4,  3, 4 ) \
+    macros( "^",       OP_POW,          NonCustomOp, 0, "^",      TWO_ARGS, "POW",  PureOp,   24, 6, 5 ) \
+    macros( "sqrt",    OP_SQRT,         NonCustomOp, 0, "sqrt",   ONE_ARG,  "SQRT", PureOp,   8,  0, 0 ) \
+    macros( "input",   OP_IN,           NonCustomOp, 0, "input",  ZERO_ARG, "IN",   ImpureOp, 16, 0, 0 ) \
+    macros( "print",   OP_OUT,          CustomOp,    1, "print",  ONE_ARG,  "OUT",  ImpureOp, 16, 0, 0 ) \
+    macros( "if",      OP_IF,           CustomOp,    1, "if",     TWO_ARGS, NULL,   ImpureOp, 2,  0, 0 ) \
+    macros( "else",    OP_ELSE,         NonCustomOp, 0, "else",   TWO_ARGS, NULL,   ImpureOp, 1,  0, 0 ) \
+    macros( "while",   OP_WHILE,        CustomOp,    1, "while",  TWO_ARGS, NULL,   ImpureOp, 2,  0, 0 ) \
+    macros( "func",    OP_FUNC,         NonCustomOp, 0, "func",   TWO_ARGS, NULL,   ImpureOp, 0,  0, 0 ) \
+    macros( "call",    OP_CALL,         NonCustomOp, 0, "call",   TWO_ARGS, NULL,   ImpureOp, 8,  0, 0 ) \
+    macros( "return",  OP_RETURN,       NonCustomOp, 0, "return", ONE_ARG,  NULL,   ImpureOp, 2,  0, 0 ) \
+    macros( "main",    OP_MAIN,         NonCustomOp, 0, "main",   TWO_ARGS, NULL,   ImpureOp, 0,  0, 0 ) \
+    macros( ",",       OP_COMMA,        PseudoOp,    0, ",",      TWO_ARGS, NULL,   ImpureOp, 0,  0, 0 ) \
+    macros( ";",       OP_SEMICOLON,    PseudoOp,    0, ";",      TWO_ARGS, NULL,   ImpureOp, 0,  0, 0 ) \
+    macros( "(",       OP_OPEN_PARENT,  PseudoOp,    0, "(",      ZERO_ARG, NULL,   ImpureOp, 0,  0, 0 ) \
+    macros( ")",       OP_CLOSE_PARENT, PseudoOp,    0, ")",      ZERO_ARG, NULL,   ImpureOp, 0,  0, 0 ) \
+    macros( "{",       OP_OPEN_BRACE,   PseudoOp,    0, "{",      ZERO_ARG, NULL,   ImpureOp, 0,  0, 0 ) \
+    macros( "}",       OP_CLOSE_BRACE,  PseudoOp,    0, "}",      ZERO_ARG, NULL,   ImpureOp, 0,  0, 0 )
 
 #endif
@@ -0,0 +1,56 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stddef.h>
+
+// Diagnostic log of the compiler with a level per category, set by `--log SPEC` or the
+// LANG_LOG environment variable: `info`, `lexer=trace`, `warn,codegen=debug`, `off`.
+// Lines are formatted by the calling thread and handed to a writer thread that appends
+// them to stderr in large blocks, so logging never waits for the terminal. The log is
+// flushed by errors, at exit and by LogFlush.
+// A disabled message costs one branch and formats nothing; messages above
+// LOG_COMPILED_LEVEL are not compiled at all. The macros are in DebugUtils.h.
+
+enum LogLevel_t {
+    LOG_LEVEL_OFF,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,  // phases of a compile
+    LOG_LEVEL_DEBUG, // decisions per file and per function
+    LOG_LEVEL_TRACE, // every token, every variable
+
+    LOG_LEVELS_COUNT
+};
+
+enum LogCategory_t {
+    LOG_LEXER,
+    LOG_PARSER,
+    LOG_TREE,
+    LOG_CODEGEN,
+    LOG_CACHE,
+    LOG_IO,
+
+    LOG_CATEGORIES_COUNT
+};
+
+// Release builds keep the phase messages only, the per-token ones cost nothing there
+#ifdef _DEBUG
+const LogLevel_t LOG_COMPILED_LEVEL = LOG_LEVEL_TRACE;
+const LogLevel_t LOG_DEFAULT_LEVEL  = LOG_LEVEL_INFO;
+#else
+const LogLevel_t LOG_COMPILED_LEVEL = LOG_LEVEL_INFO;
+const LogLevel_t LOG_DEFAULT_LEVEL  = LOG_LEVEL_WARN;
+#endif
+
+extern LogLevel_t log_levels[LOG_CATEGORIES_COUNT];
+
+// NULL restores LANG_LOG or the default; false on a bad spec, the levels are kept then
+bool LogConfigure( const char* spec );
+
+void LogWrite( LogLevel_t level, LogCategory_t category, const char* file, int line, const char* function,
+               const char* format, ... ) __attribute__( ( format( printf, 6, 7 ) ) );
+
+// Waits until everything logged so far is written, e.g. before stderr is redirected
+void LogFlush();
+
+#endif // LOG_H
@@ -0,0 +1,59 @@
+#ifndef MEM_REPORT_H
+#define MEM_REPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "TimeReport.h"
+
+// Memory accounting printed by `--mem-report`: allocations and bytes requested for the
+// big consumers, and the peak RSS sampled at the phase boundaries of TimeReport.h, so the
+// report shows which phase raised the peak. `--mem-budget` fails the compile whose peak
+// RSS rose above its start by more than the budget. MemReportEnable resets the peak, so
+// on a server every request is checked on its own; where the peak cannot be reset (not
+// Linux) the start is 0 and the peak is that of the process. The phase peaks are those
+// of the process. Allocations are counted when made, frees are not tracked;
+// a grown array counts its whole new size. While the report is off a count costs one branch.
+
+enum MemCategory_t {
+    MEM_NODES,      // NodeCreate and block item arrays
+    MEM_TOKENS,     // token arrays
+    MEM_STRINGS,    // identifier names
+    MEM_IO_BUFFERS, // whole files, read blocks and generated code buffers
+
+    MEM_CATEGORIES_COUNT
+};
+
+enum MemReportFormat_t {
+    MEM_REPORT_OFF,
+    MEM_REPORT_TABLE,
+    MEM_REPORT_JSON
+};
+
+extern bool mem_report_enabled;
+
+// `--mem-report` gives NULL, `--mem-report=json` gives "json"
+bool MemReportParseFormat( const char* argument, MemReportFormat_t* format );
+// Budget in MiB as given to `--mem-budget`
+bool MemReportParseBudget( const char* argument, uint64_t* budget_bytes );
+
+// Clears the counters and starts the run; the budget is checked even when the format is
+// off, 0 means no budget
+void MemReportEnable( MemReportFormat_t format, uint64_t budget_bytes );
+// Prints the report if it is on and clears the counters; false when the peak RSS is over
+// the budget, the error is printed then
+bool MemReportPrint( FILE* stream );
+
+void MemCountSlow( MemCategory_t category, size_t bytes );
+
+inline void MemCount( MemCategory_t category, size_t bytes ) {
+    if ( mem_report_enabled )
+        MemCountSlow( category, bytes );
+}
+
+// Peak RSS of the process so far, used by the phase scopes of TimeReport.h
+uint64_t MemPeakBytes();
+void MemPhaseEnd( TimePhase_t phase, uint64_t peak_before );
+
+#endif // MEM_REPORT_H
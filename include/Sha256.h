@@ -0,0 +1,21 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+const size_t SHA256_BLOCK_SIZE  = 64;
+const size_t SHA256_DIGEST_SIZE = 32;
+
+struct Sha256_t {
+    uint32_t state[8];
+    uint64_t length; // bytes hashed so far
+    uint8_t block[SHA256_BLOCK_SIZE];
+    size_t block_size;
+};
+
+void Sha256Init( Sha256_t* sha );
+void Sha256Update( Sha256_t* sha, const void* data, size_t size );
+void Sha256Final( Sha256_t* sha, uint8_t digest[SHA256_DIGEST_SIZE] );
+
+#endif // SHA256_H
@@ -0,0 +1,16 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+typedef void ( *ParallelJob_t )( size_t job_index, void *context );
+
+// Number of hardware threads, at least 1
+size_t DefaultThreadsCount();
+
+// Runs job( 0 .. jobs_count - 1, context ) on up to `threads` workers which take
+// jobs from a shared counter; returns when every job has finished.
+// threads == 0 means DefaultThreadsCount(), threads == 1 runs inline.
+void ParallelFor( size_t jobs_count, size_t threads, ParallelJob_t job, void *context );
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,61 @@
+#ifndef TIME_REPORT_H
+#define TIME_REPORT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Per-phase timings and throughput printed by `--time-report`, the equivalent of
+// -ftime-report. Phases are timed with CLOCK_MONOTONIC around whole calls, and a phase
+// running inside another one is subtracted from it, so the times add up to the work done.
+// Times of phases that run on several threads at once are summed over the threads.
+// While the report is off a phase costs one branch. The phases also serve as the sampling
+// points of the memory report, see MemReport.h.
+
+enum TimePhase_t {
+    PHASE_READ,
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_AST_SAVE,
+    PHASE_AST_LOAD,
+    PHASE_STRENGTH_REDUCE,
+    PHASE_REG_ALLOC,
+    PHASE_EMIT,
+
+    PHASES_COUNT
+};
+
+enum TimeReportFormat_t {
+    TIME_REPORT_OFF,
+    TIME_REPORT_TABLE,
+    TIME_REPORT_JSON
+};
+
+// What a phase went through, zero where it does not apply
+struct TimeAmount_t {
+    uint64_t bytes;
+    uint64_t tokens;
+    uint64_t nodes;
+};
+
+struct TimeScope_t {
+    uint64_t start;        // 0 while the report is off
+    uint64_t outer_nested; // nested time of the enclosing phase so far
+    uint64_t peak_before;  // peak RSS at the start, for MemReport.h
+};
+
+// `--time-report` gives NULL, `--time-report=json` gives "json"
+bool TimeReportParseFormat( const char* argument, TimeReportFormat_t* format );
+
+// Clears the counters and starts the wall clock of the report
+void TimeReportEnable( TimeReportFormat_t format );
+bool TimeReportEnabled();
+// "strength reduce" for the table, "strength_reduce" for JSON keys
+const char* TimePhaseName( TimePhase_t phase );
+const char* TimePhaseKey( TimePhase_t phase );
+// Prints the report if it is on, then clears the counters
+void TimeReportPrint( FILE* stream );
+
+TimeScope_t TimePhaseBegin();
+void TimePhaseEnd( TimeScope_t* scope, TimePhase_t phase, TimeAmount_t amount );
+
+#endif // TIME_REPORT_H
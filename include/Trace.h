@@ -0,0 +1,62 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Begin/end events of compiler zones written as a Chrome trace-event file, loadable in
+// Perfetto or chrome://tracing. Every thread records into its own ring buffer without
+// locks; when a ring is full the oldest events are overwritten. Threads of a finished
+// ParallelFor hand their rings to the next ones, so a row of the trace is a worker slot
+// and the gaps in it are the time the slot was idle or waiting.
+// While tracing is off a zone costs one branch. The zone macros are in DebugUtils.h.
+
+const char TRACE_DEFAULT_FILENAME[] = "trace.json";
+// Grammar functions nest deeply, only this many levels of them are recorded by default
+const size_t TRACE_DEFAULT_DEPTH = 3;
+
+extern bool trace_enabled;
+
+// Starts a new trace: `depth` limits the nested zones, see TRACE_NESTED_ZONE
+void TraceEnable( const char* filename, size_t depth );
+void TraceDisable();
+// Writes the events recorded since TraceEnable and clears the rings. No zone may be
+// open on another thread: call it between the parallel parts
+bool TraceWrite();
+
+// `detail` is copied, e.g. the name of the function being compiled; NULL for none
+void TraceBegin( const char* name, const char* detail );
+void TraceEnd();
+void TraceNestedBegin( const char* name );
+void TraceNestedEnd();
+
+struct TraceZone_t {
+    bool recorded;
+    bool nested;
+
+    TraceZone_t( const char* name, const char* detail, bool nested_zone )
+        : recorded( trace_enabled ), nested( nested_zone ) {
+        if ( !recorded )
+            return;
+
+        if ( nested )
+            TraceNestedBegin( name );
+        else
+            TraceBegin( name, detail );
+    }
+
+    ~TraceZone_t() {
+        if ( !recorded )
+            return;
+
+        if ( nested )
+            TraceNestedEnd();
+        else
+            TraceEnd();
+    }
+
+    TraceZone_t( const TraceZone_t& ) = delete;
+    TraceZone_t& operator=( const TraceZone_t& ) = delete;
+};
+
+#endif // TRACE_H
@@ -1,9 +1,11 @@
 #ifndef TREE_H
 #define TREE_H
 
+#include <stdint.h>
 #include <stdio.h>
 
 #include "Language.h"
+#include "Sha256.h"
 
 #ifdef _LINUX
 #include <linux/limits.h>
@@ -17,7 +19,8 @@ enum NodeType {
 
     NODE_NUMBER = 0,
     NODE_VARIABLE = 1,
-    NODE_OPERATION = 2
+    NODE_OPERATION = 2,
+    NODE_BLOCK = 3
 };
 
 #define OPERATIONS_ENUM( str, name, ... ) \
@@ -31,6 +34,35 @@ enum OperationType {
 
 #undef INIT_OP_ENUM
 
+#define OPERATIONS_COUNTER( ... ) +1
+
+const size_t OPERATIONS_COUNT = 0 INIT_OPERATIONS( OPERATIONS_COUNTER );
+
+#undef OPERATIONS_COUNTER
+
+struct OperationInfo_t {
+    const char* token;
+    OperationType op;
+    IsCustomOp is_custom;
+    const char* name;
+
+    NumberOfParams arity;
+    const char* instruction;
+    IsPureOp is_pure;
+    int cost;
+    int lbp;
+    int rbp;
+};
+
+struct Node_t;
+
+// Statement list of a `{ }` block or of the whole program: children live in one
+// contiguous array, capacity is implicit (next power of two of `count`)
+struct NodeBlock {
+    Node_t** items;
+    size_t   count;
+};
+
 struct NodeValue {
     enum NodeType type;
 
@@ -38,6 +70,7 @@ struct NodeValue {
         int   number; 
         char* variable; 
         int   operation; 
+        NodeBlock block;
     } data;
 };
 
@@ -66,10 +99,30 @@ Node_t* NodeLeftCreate ( const TreeData_t field, Node_t* parent );
 Node_t* NodeRightCreate( const TreeData_t field, Node_t* parent );
 
 Node_t* NodeCopy( Node_t* node );
+// Hash of the shape and contents of a subtree, `nodes_count` may be NULL. A non-NULL
+// `digest` gets the SHA-256 of the same walk, to confirm a match of the hashes
+uint64_t NodeHash( const Node_t* node, uint64_t seed, size_t* nodes_count, uint8_t digest[SHA256_DIGEST_SIZE] );
+
+Node_t* BlockCreate( Node_t* parent );
+void    BlockAppend( Node_t* block, Node_t* child );
+
+// Writes a DOT file only; `node_limit` 0 draws every node, otherwise deeper subtrees are collapsed
+void NodeGraphicDump( const Node_t* node, size_t node_limit, const char* dot_path_name, ... );
 
-void NodeGraphicDump( const Node_t* node, const char* image_path_name, ... );
+const OperationInfo_t* GetOperationInfo( OperationType op );
+OperationType MatchOperationPrefix( const char* str, size_t* length );
+OperationType FindOperation( const char* str, size_t length );
 
+void NodeSaveToStream( const Node_t *node, FILE *stream );
 void TreeSaveToFile( const Tree_t *tree, const char *filename );
 Tree_t* TreeLoadFromFile( const char *filename, char *error_buffer, size_t error_size );
+Node_t* NodeLoadFromString( const char *text, char *error_buffer, size_t error_size );
+
+// Takes ownership of `subtree`, false stops loading
+typedef bool ( *TreeSubtreeHandler_t )( Node_t* subtree, void* context );
+// Hands every child of the top-level block to `handler` as soon as it is read,
+// a file of another shape is loaded whole and handed over as one subtree
+bool TreeLoadStreaming( const char *filename, TreeSubtreeHandler_t handler, void *context,
+                        char *error_buffer, size_t error_size );
 
 #endif//TREE_H
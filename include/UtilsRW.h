@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <sys/stat.h>
 
 #ifndef UTILSRW_H
@@ -5,6 +6,14 @@
 
 int MakeDirectory( const char* path );
 
+// File name that stands for stdin or stdout
+#define STD_STREAM_NAME "-"
+
+bool  IsStdStream( const char* filename );
+// `-` gives stdin for a reading `mode` and stdout otherwise, CloseFile leaves them open
+FILE* OpenFile( const char* filename, const char* mode );
+int   CloseFile( FILE* file );
+
 char* ReadToBuffer( const char* filename );
 off_t DetermineTheFileSize( const char* file_name );
 
@@ -2,6 +2,8 @@
 #define CODEGEN_H
 
 #include "Tree.h"
+#include "backend/FuncCache.h"
+#include "backend/RegAlloc.h"
 #include <stdio.h>
 
 struct CodeGen_t {
@@ -10,9 +12,20 @@ struct CodeGen_t {
     
     char* input_filename;
     char* output_filename;
+    // Обычный файл пишется в `<output>.tmp` и переименовывается в CodeGenDtor, только если
+    // GenerateCodeEnd дописал программу; NULL, если вывод пишется прямо в output_filename
+    char* tmp_filename;
+    bool finished;
     
     int label_counter;
     int temp_var_counter;
+    int memory_counter;
+
+    RegAlloc_t regs;
+
+    bool incremental;       // брать код неизменившихся функций из func_cache
+    FuncCache_t func_cache; // читается из `<output>.cache` в GenerateCodeBegin, пишется в GenerateCodeEnd
+    bool func_cache_in_memory; // func_cache одолжен вызывающим (lang --watch) и с диском не связан
 };
 
 CodeGen_t* CodeGenCtor( const char* input_file, const char* output_file );
@@ -20,4 +33,15 @@ void CodeGenDtor( CodeGen_t** codegen );
 
 void GenerateCode( CodeGen_t* codegen );
 
+// Потоковая генерация: заголовок, GenerateFunction на каждую функцию верхнего уровня, HLT
+void GenerateCodeBegin( CodeGen_t* codegen );
+bool GenerateFunction( Node_t* function, void* context );
+void GenerateCodeEnd( CodeGen_t* codegen );
+
+// Потоковая генерация с ключом функции от вызывающего (lang --watch ключует код ключом
+// исходного текста функции, с SHA-256). Код без ключа в func_cache генерируется из
+// `function`, при NULL вместо функции он должен уже быть в кэше. Забирает `function`
+bool HasFunctionCode( CodeGen_t* codegen, const CacheKey_t* key );
+bool GenerateFunctionByKey( CodeGen_t* codegen, const CacheKey_t* key, Node_t* function );
+
 #endif // CODEGEN_H
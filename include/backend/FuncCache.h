@@ -0,0 +1,48 @@
+#ifndef FUNC_CACHE_H
+#define FUNC_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CacheTable.h"
+
+// Код одной функции верхнего уровня. Ключ - хэши NodeHash её поддерева до упрощений и
+// число узлов, а в lang --watch - ключ её исходного текста, как в кэше AST.
+// Метки и ячейки памяти в тексте пронумерованы с нуля внутри функции, при выводе
+// к ним прибавляются счётчики предыдущих функций
+struct FuncCacheEntry_t {
+    CacheEntry_t base; // размер ключа - число узлов или длина текста
+
+    size_t labels_count;
+    size_t memory_count;
+
+    char* text;
+    size_t text_length;
+    // Номера, с которых начинаются метки и ячейки в text: 0, пока кэш в памяти
+    // (lang --watch) не перенумеровал текст на месте под последний вывод
+    int label_base;
+    int memory_base;
+};
+
+struct FuncCache_t {
+    CacheTable_t table;
+
+    bool modified; // отличается от загруженного файла, FuncCacheSave его перепишет
+};
+
+void FuncCacheDtor( FuncCache_t* cache );
+
+FuncCacheEntry_t* FuncCacheFind( FuncCache_t* cache, const CacheKey_t* key );
+// Забирает владение `text`
+FuncCacheEntry_t* FuncCacheInsert( FuncCache_t* cache, const CacheKey_t* key, size_t labels_count,
+                                   size_t memory_count, char* text, size_t text_length );
+
+// Удаляет записи, не использованные с прошлой очистки, и сбрасывает отметки
+void FuncCacheSweep( FuncCache_t* cache );
+
+// Отсутствующий, повреждённый или записанный другим компилятором файл даёт пустой кэш
+bool FuncCacheLoad( FuncCache_t* cache, const char* path );
+// Пропускает запись, если кэш не менялся после загрузки
+bool FuncCacheSave( FuncCache_t* cache, const char* path );
+
+#endif // FUNC_CACHE_H
@@ -0,0 +1,15 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "Tree.h"
+
+// Стоимость PUSH/POP в тех же единицах, что и cost в INIT_OPERATIONS
+const int STACK_OP_COST = 1;
+
+void StrengthReduce( Tree_t* tree );
+
+bool IsPureExpression( const Node_t* node );
+bool IsLeaf( const Node_t* node );
+bool IsUnrolledPow( const Node_t* node );
+
+#endif // OPTIMIZER_H
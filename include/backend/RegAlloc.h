@@ -0,0 +1,68 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include <stddef.h>
+
+#include "Tree.h"
+
+enum RegisterName {
+    REG_NONE = -1,
+
+    REG_RAX = 0,
+    REG_RBX = 1,
+    REG_RCX = 2,
+    REG_RDX = 3
+};
+
+const size_t REGISTERS_COUNT = 4;
+
+// RBX всегда занят под возвращаемое значение
+const RegisterName RETURN_REGISTER = REG_RBX;
+
+enum VarHomeType {
+    HOME_REGISTER = 0,
+    HOME_MEMORY   = 1
+};
+
+struct VarHome_t {
+    const char* name;
+    size_t weight;
+
+    VarHomeType type;
+    int index;  // RegisterName или адрес в оперативной памяти
+};
+
+// Число Сети-Ульмана и чистота узла-операции
+struct ExprInfo_t {
+    const Node_t* node;
+    int need;
+    bool pure;
+};
+
+struct RegAlloc_t {
+    VarHome_t* vars;
+    size_t size;
+    size_t capacity;
+
+    // Таблица с открытой адресацией по адресу узла: все операции тела функции,
+    // заполняется одним обходом в RegAllocFunction
+    ExprInfo_t* exprs;
+    size_t exprs_capacity;
+
+    // Временные регистры для развёрнутого возведения в степень
+    RegisterName pow_base;
+    RegisterName pow_dup;
+};
+
+const char* RegisterToString( RegisterName reg );
+
+void RegAllocFunction( RegAlloc_t* alloc, Node_t* function, int* memory_counter );
+void RegAllocDtor( RegAlloc_t* alloc );
+
+const VarHome_t* RegAllocLookup( const RegAlloc_t* alloc, const char* name );
+
+// Значения, посчитанные в RegAllocFunction для узлов текущей функции
+int  StackNeed( const RegAlloc_t* alloc, const Node_t* node );
+bool IsPureCached( const RegAlloc_t* alloc, const Node_t* node );
+
+#endif // REGALLOC_H
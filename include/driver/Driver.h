@@ -0,0 +1,37 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include "BuildCache.h"
+#include "backend/FuncCache.h"
+#include "frontend/AstCache.h"
+#include "frontend/Parser.h"
+
+const char SOURCE_EXTENSION[] = ".lang";
+const char OUTPUT_EXTENSION[] = ".asm";
+
+// Runs one `lang` command line. With `cache` single-file compiles reuse and fill it
+// (the server passes its own), without it every compile starts cold
+int DriverRun( int argc, char** argv, AstCache_t* cache );
+
+// Source to assembly in one process. `cache` is borrowed for the compile and handed back
+// filled, it and `build_cache` may be NULL
+bool CompileFile( const char* input_filename, const char* output_filename, const char* ast_filename, size_t threads,
+                  bool incremental, AstCache_t* cache, const BuildCache_t* build_cache );
+
+// Same with code keyed by the source text of every function, both caches stay warm
+// between calls for the same file (see Watch.cpp). On failure the output is incomplete
+FunctionsResult_t CompileFunctions( const char* input_filename, const char* output_filename, AstCache_t* cache,
+                                    FuncCache_t* func_cache );
+
+// `dir/prog.lang` -> `<output_directory>/prog.asm`, the caller frees it
+char* BatchOutputName( const char* output_directory, const char* input_filename );
+
+double NowMilliseconds();
+
+// Serves compile requests on a Unix socket until a client sends SERVER_STOP_ARGUMENT
+int ServerRun( const char* socket_path );
+
+// Compiles every source of `directory`, then recompiles the changed ones until SIGINT
+int WatchRun( const char* directory, const char* output_directory, size_t threads );
+
+#endif // DRIVER_H
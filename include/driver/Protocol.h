@@ -0,0 +1,26 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+
+// Compile server protocol over a Unix stream socket, one request per connection.
+// Request:  fields terminated by '\0' - the client's working directory, then its argv
+//           (argv[0] included); the client shuts down writing when done.
+// Response: "<exit status> <stdout length> <stderr length>\n", then both outputs;
+//           the server closes the connection when done.
+
+const size_t MAX_REQUEST_SIZE = 1 << 20;
+const size_t SOCKET_PATH_LENGTH = 108; // sun_path of sockaddr_un
+
+// Asks the server to exit instead of compiling
+#define SERVER_STOP_ARGUMENT "--stop"
+
+// $LANG_SERVER_SOCKET, otherwise /tmp/lang-<uid>.sock
+void DefaultSocketPath( char* buffer, size_t size );
+bool SocketAddress( const char* path, void* address, size_t* address_length );
+
+bool SendAll( int fd, const char* data, size_t size );
+// Reads until EOF or `limit` bytes; the result is '\0'-terminated
+char* ReceiveAll( int fd, size_t limit, size_t* size );
+
+#endif // PROTOCOL_H
@@ -0,0 +1,41 @@
+#ifndef AST_CACHE_H
+#define AST_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CacheTable.h"
+#include "Tree.h"
+
+// AST of one top-level function, keyed by its source text. It is kept as text for the
+// disk cache and the text output, and as a tree for in-memory compiles; either form
+// may be missing and is built from the other on first use
+struct AstCacheEntry_t {
+    CacheEntry_t base;
+    size_t tokens_count;
+
+    char* text;
+    size_t text_length;
+
+    Node_t* subtree;
+};
+
+struct AstCache_t {
+    CacheTable_t table;
+};
+
+void AstCacheDtor( AstCache_t* cache );
+
+AstCacheEntry_t* AstCacheFind( AstCache_t* cache, const CacheKey_t* key );
+// Takes ownership of `text`, which may be NULL if the caller sets `subtree` instead
+AstCacheEntry_t* AstCacheInsert( AstCache_t* cache, const CacheKey_t* key, size_t tokens_count, char* text,
+                                 size_t text_length );
+
+// Drops entries not used since the previous sweep and clears the marks
+void AstCacheSweep( AstCache_t* cache );
+
+// A missing or damaged file gives an empty cache
+bool AstCacheLoad( AstCache_t* cache, const char* path );
+bool AstCacheSave( const AstCache_t* cache, const char* path );
+
+#endif // AST_CACHE_H
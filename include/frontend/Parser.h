@@ -2,41 +2,90 @@
 #define FRONTEND_H
 
 #include "Tree.h"
+#include "frontend/AstCache.h"
 #include "frontend/TokenArray.h"
 
-#ifdef _DEBUG
-struct Log_t {
-    FILE *log_file;
-    char *log_path;
-    char *img_log_path;
-    size_t image_number;
+const size_t MAX_SYNTAX_ERRORS  = 64;
+const size_t ERROR_FOUND_LENGTH = 32;
+
+struct SyntaxError_t {
+    size_t token_index;
+    const char* expected;
+    char found[ERROR_FOUND_LENGTH];
+};
+
+// Syntax errors of one pass; past MAX_SYNTAX_ERRORS they are only counted in `dropped`
+struct ErrorList_t {
+    SyntaxError_t* errors;
+    size_t count;
+    size_t capacity;
+    size_t dropped;
 };
-#endif
 
-// TODO: add ErrorList in Parser_t
 struct Parser_t {
     TokenArray_t tokens;
+    TokenArray_t own_nodes; // nodes made by the syntax analyzer itself: blocks, function headers
+
+    ErrorList_t errors;
 
     Tree_t* tree;
 
     char* input_filename;
     char* output_filename;  
 
-#ifdef _DEBUG
-    struct Log_t logging;
-#endif
+    size_t threads; // workers for lexing and parsing, 0 - one per hardware thread
+
+    bool incremental;     // reuse subtrees of unchanged functions, see ParseIncremental
+    bool streaming;       // write and free every function once parsed, see ParseStreaming
+    AstCache_t ast_cache; // kept across passes, loaded from and saved to `<output>.cache`
 };
 
 Parser_t *ParserCtor( int argc, char** argv );
+// No command line: default options, `output_filename` may be NULL when nothing is written
+Parser_t *ParserCtorWithFiles( const char* input_filename, const char* output_filename );
 void ParserDtor( Parser_t** parser );
+// Frees tokens, tree and errors of the last pass, keeps options and file names
+void ParserReset( Parser_t* parser );
+// Hands the tree of the last pass to the caller, tokens linked into it go along
+Tree_t *ParserReleaseTree( Parser_t* parser );
 
 void Parse( Parser_t* parser );
+// Parses and writes the output, reparsing only functions missing from the AST cache
+void ParseIncremental( Parser_t* parser );
+// Like Parse, but builds the tree from copies of cached function subtrees where it can
+void ParseCached( Parser_t* parser );
+// Parses and writes the output one function at a time, memory is bounded by the largest one
+void ParseStreaming( Parser_t* parser );
+
+// For a consumer that keeps its own result per function text, see Watch.cpp. Every
+// top-level function goes to `sink` in order: as NULL when `known` says the consumer has
+// something for this text, as a fresh subtree the sink takes otherwise. Nothing goes to
+// the sink after the first error; a `false` from the sink stops the pass
+// The key is that of the function's source text, see CacheKeyOf
+typedef bool ( *FunctionKnown_t )( const CacheKey_t* key, void* context );
+typedef bool ( *FunctionSink_t )( const CacheKey_t* key, Node_t* function, void* context );
+
+enum FunctionsResult_t {
+    FUNCTIONS_DONE,
+    FUNCTIONS_FAILED,   // errors are reported
+    FUNCTIONS_NOT_SPLIT // not a sequence of functions or the sink gave up, the caller compiles it whole
+};
+
+FunctionsResult_t ParseFunctions( Parser_t* parser, FunctionKnown_t known, FunctionSink_t sink, void* context );
 
 // Lexical analyzer
 Node_t **LexicalAnalyze( Parser_t* parser );
+// Lexes a caller-owned buffer; '\n' at chunk boundaries may be overwritten with '\0'
+Node_t **LexicalAnalyzeBuffer( Parser_t* parser, char* buffer );
 
 // Syntax analyzer
 Node_t *SyntaxAnalyze( Parser_t* parser );
+// Same without printing: on failure returns NULL and leaves the errors in parser->errors
+Node_t *SyntaxAnalyzeSilent( Parser_t* parser );
+void    ReportSyntaxErrors( const Parser_t* parser );
+
+// Moves errors of `src` to `dst`, shifting their token indices by `token_offset`
+void ErrorListAppend( ErrorList_t* dst, ErrorList_t* src, size_t token_offset );
 
 #ifdef _DEBUG
 void ParserDump( Parser_t *parser, const char *format_string, ... );
@@ -44,6 +93,10 @@ void ParserDump( Parser_t *parser, const char *format_string, ... );
 
 Node_t *MakeNode( OperationType op, Node_t *L, Node_t *R );
 
+TreeData_t MakeNumber( int number );
+TreeData_t MakeOperation( OperationType operation );
+TreeData_t MakeVariable( char* variable );
+
 int CompareDoubleToDouble( double a, double b, double eps );
 
 #endif
\ No newline at end of file
@@ -13,6 +13,7 @@ TokenArray_t TokenArrayCreate();
 void TokenArrayDestroy( TokenArray_t *arr );
 
 bool TokenArrayPushBack( TokenArray_t *arr, Node_t *token );
+bool TokenArrayAppend( TokenArray_t *dst, TokenArray_t *src );
 
 size_t TokenArraySize( const TokenArray_t *arr );
 
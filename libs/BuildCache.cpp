@@ -0,0 +1,492 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "BuildCache.h"
+#include "DebugUtils.h"
+#include "Sha256.h"
+
+// Layout of the cache directory:
+//   objects/ab/cdef...  stored outputs, named by their key split after two hex digits
+//   objects/tmp.XXXXXX  an output being stored, renamed into place when complete
+//   stats               counters, read and rewritten under flock
+// Readers never see a partial object: both storing and fetching copy into a temporary
+// file and rename it. The modification time of an object is its last use, fetching
+// touches it and eviction removes the oldest ones first.
+
+const size_t COPY_CHUNK_SIZE    = 1 << 16;
+const size_t STATS_TEXT_LENGTH  = 256;
+const size_t EVICT_DEFAULT_CAPACITY = 256;
+// Temporary files older than this were left by a killed process
+const time_t STALE_TMP_SECONDS  = 60 * 60;
+
+static const char STATS_HEADER[] = "lang-build-cache 1\n";
+static const char TMP_PREFIX[]   = "tmp.";
+
+struct CacheObject_t {
+    char *path;
+    uint64_t size;
+    struct timespec used;
+};
+
+struct CacheObjects_t {
+    CacheObject_t *objects;
+    size_t count;
+    size_t capacity;
+};
+
+static char *PathPrintf( const char *format, ... ) __attribute__( ( format( printf, 1, 2 ) ) );
+
+static char *PathPrintf( const char *format, ... ) {
+    va_list args;
+    va_start( args, format );
+    int length = vsnprintf( NULL, 0, format, args );
+    va_end( args );
+
+    if ( length < 0 )
+        return NULL;
+
+    char *path = (char *)calloc( (size_t)length + 1, sizeof( *path ) );
+    if ( !path )
+        return NULL;
+
+    va_start( args, format );
+    vsnprintf( path, (size_t)length + 1, format, args );
+    va_end( args );
+
+    return path;
+}
+
+// mkdir -p
+static bool MakePath( char *path ) {
+    for ( char *slash = strchr( path + 1, '/' ); ; slash = strchr( slash + 1, '/' ) ) {
+        if ( slash )
+            *slash = '\0';
+
+        bool made = !mkdir( path, 0700 ) || errno == EEXIST;
+
+        if ( slash )
+            *slash = '/';
+        if ( !made )
+            return false;
+        if ( !slash )
+            return true;
+    }
+}
+
+static char *CacheDirectory() {
+    const char *directory = getenv( "LANG_CACHE_DIR" );
+    if ( directory && *directory )
+        return PathPrintf( "%s", directory );
+
+    const char *xdg_cache = getenv( "XDG_CACHE_HOME" );
+    if ( xdg_cache && *xdg_cache )
+        return PathPrintf( "%s/lang", xdg_cache );
+
+    const char *home = getenv( "HOME" );
+    if ( home && *home )
+        return PathPrintf( "%s/.cache/lang", home );
+
+    return NULL;
+}
+
+// A rebuilt compiler may generate different code, so its binary is part of the key;
+// size and mtime identify it without hashing the executable on every run
+char *BuildCacheCompilerIdentity() {
+    struct stat exe_stat = {};
+    if ( stat( "/proc/self/exe", &exe_stat ) )
+        return PathPrintf( "%s", LANG_VERSION );
+
+    return PathPrintf( "%s %lld %lld.%09ld", LANG_VERSION, (long long)exe_stat.st_size,
+                       (long long)exe_stat.st_mtim.tv_sec, exe_stat.st_mtim.tv_nsec );
+}
+
+bool BuildCacheOpen( BuildCache_t *cache ) {
+    my_assert( cache, "Null pointer on `cache`" );
+
+    *cache = {};
+
+    const char *enabled = getenv( "LANG_CACHE" );
+    if ( enabled && ( !strcmp( enabled, "off" ) || !strcmp( enabled, "0" ) ) )
+        return false;
+
+    cache->size_limit = BUILD_CACHE_DEFAULT_LIMIT;
+    const char *limit = getenv( "LANG_CACHE_SIZE" );
+    if ( limit && *limit ) {
+        char *end = NULL;
+        unsigned long long megabytes = strtoull( limit, &end, 10 );
+        if ( *end == '\0' && megabytes > 0 )
+            cache->size_limit = (uint64_t)megabytes << 20;
+        else
+            PRINT_ERROR( "Bad LANG_CACHE_SIZE `%s`, using %" PRIu64 " MiB", limit, BUILD_CACHE_DEFAULT_LIMIT >> 20 );
+    }
+
+    cache->directory = CacheDirectory();
+    cache->compiler = BuildCacheCompilerIdentity();
+    char *objects = cache->directory ? PathPrintf( "%s/objects", cache->directory ) : NULL;
+
+    bool opened = cache->compiler && objects && MakePath( objects );
+    free( objects );
+
+    if ( !opened ) {
+        LOG_WARN( LOG_CACHE, "Build cache is unavailable" );
+        BuildCacheClose( cache );
+    }
+
+    return opened;
+}
+
+void BuildCacheClose( BuildCache_t *cache ) {
+    my_assert( cache, "Null pointer on `cache`" );
+
+    free( cache->directory );
+    free( cache->compiler );
+    *cache = {};
+}
+
+bool BuildCacheKey( const BuildCache_t *cache, const char *kind, const char *options, const char *input_filename,
+                    char key[BUILD_CACHE_KEY_LENGTH + 1] ) {
+    my_assert( cache && cache->compiler, "The cache is not open" );
+    my_assert( kind && options && input_filename, "Null pointer on the key parts" );
+
+    int fd = open( input_filename, O_RDONLY );
+    if ( fd < 0 )
+        return false;
+
+    char *chunk = (char *)calloc( COPY_CHUNK_SIZE, sizeof( *chunk ) );
+    if ( !chunk ) {
+        close( fd );
+        return false;
+    }
+
+    // Every part but the last ends with '\0', so no two different keys share a text
+    Sha256_t sha = {};
+    Sha256Init( &sha );
+    Sha256Update( &sha, cache->compiler, strlen( cache->compiler ) + 1 );
+    Sha256Update( &sha, kind, strlen( kind ) + 1 );
+    Sha256Update( &sha, options, strlen( options ) + 1 );
+
+    ssize_t read_size = 0;
+    while ( ( read_size = read( fd, chunk, COPY_CHUNK_SIZE ) ) > 0 )
+        Sha256Update( &sha, chunk, (size_t)read_size );
+
+    free( chunk );
+    close( fd );
+    if ( read_size < 0 )
+        return false;
+
+    uint8_t digest[SHA256_DIGEST_SIZE] = {};
+    Sha256Final( &sha, digest );
+    for ( size_t i = 0; i < SHA256_DIGEST_SIZE; i++ )
+        snprintf( key + 2 * i, 3, "%02x", digest[i] );
+
+    return true;
+}
+
+static char *ObjectPath( const BuildCache_t *cache, const char *key ) {
+    return PathPrintf( "%s/objects/%.2s/%s", cache->directory, key, key + 2 );
+}
+
+static bool CopyFd( int from, int to, uint64_t *copied ) {
+    char *chunk = (char *)calloc( COPY_CHUNK_SIZE, sizeof( *chunk ) );
+    if ( !chunk )
+        return false;
+
+    *copied = 0;
+    bool done = true;
+
+    ssize_t read_size = 0;
+    while ( done && ( read_size = read( from, chunk, COPY_CHUNK_SIZE ) ) > 0 ) {
+        for ( ssize_t written = 0, offset = 0; done && offset < read_size; offset += written ) {
+            written = write( to, chunk + offset, (size_t)( read_size - offset ) );
+            done = written > 0;
+        }
+        *copied += (uint64_t)read_size;
+    }
+
+    free( chunk );
+    return done && read_size == 0;
+}
+
+// Copies `from` to `<path_prefix>XXXXXX` and renames the copy to `to`
+static bool CopyAtomically( int from, const char *path_prefix, const char *to, uint64_t *copied ) {
+    char *tmp_path = PathPrintf( "%sXXXXXX", path_prefix );
+    if ( !tmp_path )
+        return false;
+
+    int tmp = mkstemp( tmp_path );
+    if ( tmp < 0 ) {
+        free( tmp_path );
+        return false;
+    }
+
+    bool copied_all = CopyFd( from, tmp, copied ) && !fchmod( tmp, 0644 );
+    copied_all = !close( tmp ) && copied_all;
+    copied_all = copied_all && !rename( tmp_path, to );
+
+    if ( !copied_all )
+        unlink( tmp_path );
+
+    free( tmp_path );
+    return copied_all;
+}
+
+static void StatsParse( const char *text, BuildCacheStats_t *stats ) {
+    *stats = {};
+    if ( strncmp( text, STATS_HEADER, sizeof( STATS_HEADER ) - 1 ) )
+        return;
+
+    if ( sscanf( text + sizeof( STATS_HEADER ) - 1,
+                 "hits %" SCNu64 " misses %" SCNu64 " stores %" SCNu64 " evictions %" SCNu64 " bytes %" SCNu64,
+                 &stats->hits, &stats->misses, &stats->stores, &stats->evictions, &stats->bytes ) != 5 )
+        *stats = {};
+}
+
+static int CompareObjectsByUse( const void *first, const void *second ) {
+    const struct timespec *first_used = &( (const CacheObject_t *)first )->used;
+    const struct timespec *second_used = &( (const CacheObject_t *)second )->used;
+
+    if ( first_used->tv_sec != second_used->tv_sec )
+        return first_used->tv_sec < second_used->tv_sec ? -1 : 1;
+    if ( first_used->tv_nsec != second_used->tv_nsec )
+        return first_used->tv_nsec < second_used->tv_nsec ? -1 : 1;
+    return 0;
+}
+
+static bool ObjectsPush( CacheObjects_t *objects, char *path, const struct stat *object_stat ) {
+    if ( objects->count == objects->capacity ) {
+        size_t new_capacity = objects->capacity ? objects->capacity * 2 : EVICT_DEFAULT_CAPACITY;
+        CacheObject_t *new_objects =
+            (CacheObject_t *)realloc( objects->objects, new_capacity * sizeof( *new_objects ) );
+        if ( !new_objects )
+            return false;
+
+        objects->objects = new_objects;
+        objects->capacity = new_capacity;
+    }
+
+    CacheObject_t *object = &objects->objects[objects->count++];
+    object->path = path;
+    object->size = (uint64_t)object_stat->st_size;
+    object->used = object_stat->st_mtim;
+    return true;
+}
+
+// Collects objects/??/*, removing temporary files abandoned by killed processes
+static void ObjectsCollect( const char *objects_directory, CacheObjects_t *objects ) {
+    DIR *directory = opendir( objects_directory );
+    if ( !directory )
+        return;
+
+    time_t now = time( NULL );
+
+    for ( struct dirent *entry = readdir( directory ); entry; entry = readdir( directory ) ) {
+        if ( entry->d_name[0] == '.' )
+            continue;
+
+        char *path = PathPrintf( "%s/%s", objects_directory, entry->d_name );
+        struct stat entry_stat = {};
+        if ( !path || stat( path, &entry_stat ) ) {
+            free( path );
+            continue;
+        }
+
+        if ( S_ISDIR( entry_stat.st_mode ) ) {
+            ObjectsCollect( path, objects );
+            free( path );
+        } else if ( !strncmp( entry->d_name, TMP_PREFIX, sizeof( TMP_PREFIX ) - 1 ) ) {
+            if ( now - entry_stat.st_mtim.tv_sec > STALE_TMP_SECONDS )
+                unlink( path );
+            free( path );
+        } else if ( !ObjectsPush( objects, path, &entry_stat ) ) {
+            free( path );
+        }
+    }
+
+    closedir( directory );
+}
+
+// Removes least recently used objects until the cache fits into 3/4 of the limit,
+// so the next evictions are not one store away. Runs under the stats lock
+static void Evict( const BuildCache_t *cache, BuildCacheStats_t *stats ) {
+    char *objects_directory = PathPrintf( "%s/objects", cache->directory );
+    if ( !objects_directory )
+        return;
+
+    CacheObjects_t objects = {};
+    ObjectsCollect( objects_directory, &objects );
+    free( objects_directory );
+
+    qsort( objects.objects, objects.count, sizeof( *objects.objects ), CompareObjectsByUse );
+
+    uint64_t total = 0;
+    for ( size_t i = 0; i < objects.count; i++ )
+        total += objects.objects[i].size;
+
+    uint64_t target = cache->size_limit / 4 * 3;
+    for ( size_t i = 0; i < objects.count && total > target; i++ ) {
+        if ( unlink( objects.objects[i].path ) )
+            continue;
+
+        total -= objects.objects[i].size;
+        stats->evictions++;
+    }
+
+    for ( size_t i = 0; i < objects.count; i++ )
+        free( objects.objects[i].path );
+    free( objects.objects );
+
+    stats->bytes = total;
+}
+
+// Adds `delta` to the shared counters; processes and batch threads serialize on flock
+static void StatsAdd( const BuildCache_t *cache, const BuildCacheStats_t *delta ) {
+    char *stats_path = PathPrintf( "%s/stats", cache->directory );
+    int fd = stats_path ? open( stats_path, O_RDWR | O_CREAT, 0644 ) : -1;
+    free( stats_path );
+    if ( fd < 0 )
+        return;
+
+    if ( flock( fd, LOCK_EX ) ) {
+        close( fd );
+        return;
+    }
+
+    char text[STATS_TEXT_LENGTH] = "";
+    ssize_t read_size = pread( fd, text, sizeof( text ) - 1, 0 );
+    text[read_size > 0 ? read_size : 0] = '\0';
+
+    BuildCacheStats_t stats = {};
+    StatsParse( text, &stats );
+    stats.hits      += delta->hits;
+    stats.misses    += delta->misses;
+    stats.stores    += delta->stores;
+    stats.evictions += delta->evictions;
+    stats.bytes     += delta->bytes;
+
+    if ( stats.bytes > cache->size_limit )
+        Evict( cache, &stats );
+
+    int length = snprintf( text, sizeof( text ),
+                           "%shits %" PRIu64 "\nmisses %" PRIu64 "\nstores %" PRIu64 "\nevictions %" PRIu64
+                           "\nbytes %" PRIu64 "\n",
+                           STATS_HEADER, stats.hits, stats.misses, stats.stores, stats.evictions, stats.bytes );
+    if ( length <= 0 || pwrite( fd, text, (size_t)length, 0 ) != length || ftruncate( fd, length ) )
+        PRINT_ERROR( "Failed to update the build cache statistics" );
+
+    close( fd ); // releases the lock
+}
+
+bool BuildCacheFetch( const BuildCache_t *cache, const char *key, const char *output_filename ) {
+    my_assert( cache && cache->directory, "The cache is not open" );
+    my_assert( key && output_filename, "Null pointer on `key` or `output_filename`" );
+
+    char *object_path = ObjectPath( cache, key );
+    int object = object_path ? open( object_path, O_RDONLY ) : -1;
+
+    bool hit = false;
+    if ( object >= 0 ) {
+        char *tmp_prefix = PathPrintf( "%s.", output_filename );
+        uint64_t copied = 0;
+        hit = tmp_prefix && CopyAtomically( object, tmp_prefix, output_filename, &copied );
+        free( tmp_prefix );
+        close( object );
+
+        // Marks the object as recently used for the eviction
+        if ( hit )
+            utimensat( AT_FDCWD, object_path, NULL, 0 );
+    }
+    free( object_path );
+
+    BuildCacheStats_t delta = {};
+    delta.hits = hit;
+    delta.misses = !hit;
+    StatsAdd( cache, &delta );
+
+    LOG_DEBUG( LOG_CACHE, "Build cache %s for `%s`", hit ? "hit" : "miss", output_filename );
+    return hit;
+}
+
+void BuildCacheStore( const BuildCache_t *cache, const char *key, const char *output_filename ) {
+    my_assert( cache && cache->directory, "The cache is not open" );
+    my_assert( key && output_filename, "Null pointer on `key` or `output_filename`" );
+
+    int output = open( output_filename, O_RDONLY );
+    if ( output < 0 )
+        return;
+
+    char *object_path = ObjectPath( cache, key );
+    char *bucket_path = PathPrintf( "%s/objects/%.2s", cache->directory, key );
+    char *tmp_prefix = PathPrintf( "%s/objects/%s", cache->directory, TMP_PREFIX );
+
+    uint64_t copied = 0;
+    bool stored = object_path && bucket_path && tmp_prefix && ( !mkdir( bucket_path, 0700 ) || errno == EEXIST ) &&
+                  CopyAtomically( output, tmp_prefix, object_path, &copied );
+
+    close( output );
+    free( object_path );
+    free( bucket_path );
+    free( tmp_prefix );
+
+    if ( !stored ) {
+        LOG_WARN( LOG_CACHE, "Failed to store `%s` in the build cache", output_filename );
+        return;
+    }
+
+    BuildCacheStats_t delta = {};
+    delta.stores = 1;
+    delta.bytes = copied;
+    StatsAdd( cache, &delta );
+}
+
+bool BuildCacheReadStats( const BuildCache_t *cache, BuildCacheStats_t *stats ) {
+    my_assert( cache && cache->directory, "The cache is not open" );
+    my_assert( stats, "Null pointer on `stats`" );
+
+    char *stats_path = PathPrintf( "%s/stats", cache->directory );
+    int fd = stats_path ? open( stats_path, O_RDONLY ) : -1;
+    free( stats_path );
+
+    *stats = {};
+    if ( fd < 0 )
+        return false;
+
+    char text[STATS_TEXT_LENGTH] = "";
+    bool locked = !flock( fd, LOCK_SH );
+    ssize_t read_size = locked ? pread( fd, text, sizeof( text ) - 1, 0 ) : -1;
+    close( fd );
+
+    if ( read_size <= 0 )
+        return false;
+
+    text[read_size] = '\0';
+    StatsParse( text, stats );
+    return true;
+}
+
+void BuildCachePrintStats( const BuildCache_t *cache, FILE *stream ) {
+    my_assert( cache && cache->directory, "The cache is not open" );
+    my_assert( stream, "Null pointer on `stream`" );
+
+    BuildCacheStats_t stats = {};
+    BuildCacheReadStats( cache, &stats );
+
+    uint64_t lookups = stats.hits + stats.misses;
+    double hit_rate = lookups ? 100.0 * (double)stats.hits / (double)lookups : 0.0;
+
+    fprintf( stream, "Build cache:  %s\n", cache->directory );
+    fprintf( stream, "  hits        %" PRIu64 " (%.1f%%)\n", stats.hits, hit_rate );
+    fprintf( stream, "  misses      %" PRIu64 "\n", stats.misses );
+    fprintf( stream, "  stores      %" PRIu64 "\n", stats.stores );
+    fprintf( stream, "  evictions   %" PRIu64 "\n", stats.evictions );
+    fprintf( stream, "  size        %.1f of %.1f MiB\n", (double)stats.bytes / ( 1 << 20 ),
+             (double)cache->size_limit / ( 1 << 20 ) );
+}
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CacheTable.h"
+#include "DebugUtils.h"
+
+const size_t CACHE_TABLE_DEFAULT_CAPACITY = 64;
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME        = 1099511628211ULL;
+
+CacheKey_t CacheKeyOf( const void *data, size_t size ) {
+    my_assert( data || !size, "Null pointer on `data`" );
+
+    CacheKey_t key = {};
+    key.hash = FNV_OFFSET_BASIS;
+    key.size = size;
+
+    const unsigned char *bytes = (const unsigned char *)data;
+    for ( size_t i = 0; i < size; i++ ) {
+        key.hash ^= bytes[i];
+        key.hash *= FNV_PRIME;
+    }
+
+    Sha256_t sha = {};
+    Sha256Init( &sha );
+    Sha256Update( &sha, data, size );
+    Sha256Final( &sha, key.digest );
+
+    return key;
+}
+
+bool CacheKeysEqual( const CacheKey_t *first, const CacheKey_t *second ) {
+    my_assert( first && second, "Null pointer on a key" );
+
+    return first->hash == second->hash && first->size == second->size &&
+           !memcmp( first->digest, second->digest, sizeof( first->digest ) );
+}
+
+void CacheTableDtor( CacheTable_t *table, CacheEntryDelete_t entry_delete ) {
+    my_assert( table, "Null pointer on `table`" );
+    my_assert( entry_delete, "Null pointer on `entry_delete`" );
+
+    for ( size_t i = 0; i < table->capacity; i++ ) {
+        if ( table->slots[i] )
+            entry_delete( table->slots[i] );
+    }
+
+    free( table->slots );
+    *table = {};
+}
+
+static size_t ProbeSlot( const CacheTable_t *table, const CacheKey_t *key ) {
+    size_t mask = table->capacity - 1;
+    size_t slot = key->hash & mask;
+
+    while ( table->slots[slot] && !CacheKeysEqual( &( table->slots[slot]->key ), key ) )
+        slot = ( slot + 1 ) & mask;
+
+    return slot;
+}
+
+static bool CacheTableRehash( CacheTable_t *table, size_t new_capacity ) {
+    CacheEntry_t **new_slots = (CacheEntry_t **)calloc( new_capacity, sizeof( *new_slots ) );
+    if ( !new_slots )
+        return false;
+
+    CacheTable_t grown = { new_slots, 0, new_capacity };
+    for ( size_t i = 0; i < table->capacity; i++ ) {
+        CacheEntry_t *entry = table->slots[i];
+        if ( !entry )
+            continue;
+
+        grown.slots[ProbeSlot( &grown, &( entry->key ) )] = entry;
+        grown.count++;
+    }
+
+    free( table->slots );
+    *table = grown;
+
+    return true;
+}
+
+CacheEntry_t *CacheTableFind( CacheTable_t *table, const CacheKey_t *key ) {
+    my_assert( table, "Null pointer on `table`" );
+    my_assert( key, "Null pointer on `key`" );
+
+    if ( !table->capacity )
+        return NULL;
+
+    CacheEntry_t *entry = table->slots[ProbeSlot( table, key )];
+    if ( entry )
+        entry->used = true;
+
+    return entry;
+}
+
+bool CacheTableInsert( CacheTable_t *table, CacheEntry_t *entry, CacheEntryDelete_t entry_delete ) {
+    my_assert( table, "Null pointer on `table`" );
+    my_assert( entry, "Null pointer on `entry`" );
+    my_assert( entry_delete, "Null pointer on `entry_delete`" );
+
+    // Load factor stays below 1/2
+    if ( ( table->count + 1 ) * 2 > table->capacity ) {
+        size_t new_capacity = table->capacity ? table->capacity * 2 : CACHE_TABLE_DEFAULT_CAPACITY;
+        if ( !CacheTableRehash( table, new_capacity ) )
+            return false;
+    }
+
+    entry->used = true;
+
+    size_t slot = ProbeSlot( table, &( entry->key ) );
+    if ( table->slots[slot] ) {
+        entry_delete( table->slots[slot] );
+        table->count--;
+    }
+
+    table->slots[slot] = entry;
+    table->count++;
+
+    return true;
+}
+
+size_t CacheTableSweep( CacheTable_t *table, CacheEntryDelete_t entry_delete ) {
+    my_assert( table, "Null pointer on `table`" );
+    my_assert( entry_delete, "Null pointer on `entry_delete`" );
+
+    size_t deleted = 0;
+    for ( size_t i = 0; i < table->capacity; i++ ) {
+        CacheEntry_t *entry = table->slots[i];
+        if ( !entry )
+            continue;
+
+        if ( entry->used ) {
+            entry->used = false;
+        } else {
+            entry_delete( entry );
+            table->slots[i] = NULL;
+            table->count--;
+            deleted++;
+        }
+    }
+
+    // Holes break probe chains: reinsert everything into a table of the same size
+    if ( deleted )
+        CacheTableRehash( table, table->capacity );
+
+    return deleted;
+}
+
+void CacheKeyWrite( FILE *file, const CacheKey_t *key ) {
+    my_assert( file, "Null pointer on `file`" );
+    my_assert( key, "Null pointer on `key`" );
+
+    fprintf( file, "%016llx ", (unsigned long long)key->hash );
+    for ( size_t i = 0; i < SHA256_DIGEST_SIZE; i++ )
+        fprintf( file, "%02x", key->digest[i] );
+    fprintf( file, " %zu", key->size );
+}
+
+bool CacheReadNumber( const char **pos, const char *end, int base, unsigned long long *number ) {
+    if ( *pos >= end )
+        return false;
+
+    char *number_end = NULL;
+    *number = strtoull( *pos, &number_end, base );
+    if ( number_end == *pos || number_end > end )
+        return false;
+
+    *pos = number_end;
+    return true;
+}
+
+static int HexValue( char digit ) {
+    if ( '0' <= digit && digit <= '9' )
+        return digit - '0';
+    if ( 'a' <= digit && digit <= 'f' )
+        return digit - 'a' + 10;
+
+    return -1;
+}
+
+static bool ReadDigest( const char **pos, const char *end, uint8_t digest[SHA256_DIGEST_SIZE] ) {
+    if ( end - *pos < (ptrdiff_t)( 2 * SHA256_DIGEST_SIZE + 1 ) || **pos != ' ' )
+        return false;
+
+    const char *digits = *pos + 1;
+    for ( size_t i = 0; i < SHA256_DIGEST_SIZE; i++ ) {
+        int high = HexValue( digits[2 * i] ), low = HexValue( digits[2 * i + 1] );
+        if ( high < 0 || low < 0 )
+            return false;
+
+        digest[i] = (uint8_t)( high * 16 + low );
+    }
+
+    *pos = digits + 2 * SHA256_DIGEST_SIZE;
+    return true;
+}
+
+bool CacheKeyRead( const char **pos, const char *end, CacheKey_t *key ) {
+    my_assert( pos && *pos, "Null pointer on `pos`" );
+    my_assert( key, "Null pointer on `key`" );
+
+    unsigned long long hash = 0, size = 0;
+    if ( !CacheReadNumber( pos, end, 16, &hash ) || !ReadDigest( pos, end, key->digest ) ||
+         !CacheReadNumber( pos, end, 10, &size ) )
+        return false;
+
+    key->hash = hash;
+    key->size = size;
+    return true;
+}
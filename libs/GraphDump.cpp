@@ -0,0 +1,249 @@
+#include <condition_variable>
+#include <errno.h>
+#include <mutex>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <thread>
+
+#include "DebugUtils.h"
+#include "GraphDump.h"
+#include "Tree.h"
+#include "UtilsRW.h"
+
+extern char **environ;
+
+// Files per batched `dot` call, far below the argument limit
+const size_t GRAPH_DUMP_BATCH_FILES = 256;
+const size_t DEFERRED_DEFAULT_CAPACITY = 16;
+
+struct GraphDumpState_t {
+    std::mutex mutex = {}; // guards everything below and index.html
+    std::condition_variable wake = {};
+
+    FILE *index = NULL;
+    size_t images = 0;
+
+    char *queue[GRAPH_DUMP_QUEUE_LIMIT] = {}; // DOT paths for the worker, in order
+    size_t queue_count = 0;
+
+    char **deferred = NULL; // DOT paths rendered by GraphDumpFinish
+    size_t deferred_count = 0;
+    size_t deferred_capacity = 0;
+
+    bool dot_missing = false;
+    bool stop = false;
+    bool at_exit = false;
+    std::thread worker = {};
+};
+
+// Set before any work starts, so the threads only read them
+static GraphDumpMode_t dump_mode = GRAPH_DUMP_ASYNC;
+static size_t dump_node_limit = GRAPH_DUMP_DEFAULT_NODE_LIMIT;
+
+static GraphDumpState_t state;
+
+bool GraphDumpParseMode( const char *argument, GraphDumpMode_t *mode ) {
+    my_assert( argument, "Null pointer on `argument`" );
+    my_assert( mode, "Null pointer on `mode`" );
+
+    static const char *const MODE_NAMES[] = { "off", "dot", "async", "batch" };
+    for ( size_t i = 0; i < sizeof( MODE_NAMES ) / sizeof( *MODE_NAMES ); i++ ) {
+        if ( !strcmp( argument, MODE_NAMES[i] ) ) {
+            *mode = (GraphDumpMode_t)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void GraphDumpConfigure( GraphDumpMode_t mode, size_t node_limit ) {
+    dump_mode = mode;
+    dump_node_limit = node_limit;
+}
+
+bool GraphDumpEnabled() {
+    return dump_mode != GRAPH_DUMP_OFF;
+}
+
+// Runs `dot -Tsvg -O` on the files: every FILE.dot becomes FILE.dot.svg. False when dot is not installed
+static bool RunDot( char *const *paths, size_t count ) {
+    // posix_spawnp takes `char *const []`, so the fixed arguments are writable arrays
+    static char program[] = "dot", format[] = "-Tsvg", output[] = "-O";
+
+    char **argv = (char **)calloc( count + 4, sizeof( *argv ) );
+    if ( !argv ) {
+        PRINT_ERROR( "Memory allocation error" );
+        return true;
+    }
+
+    argv[0] = program;
+    argv[1] = format;
+    argv[2] = output;
+    for ( size_t i = 0; i < count; i++ )
+        argv[i + 3] = paths[i];
+
+    pid_t pid = 0;
+    int error = posix_spawnp( &pid, "dot", NULL, NULL, argv, environ );
+    free( argv );
+
+    if ( error ) {
+        LOG_WARN( LOG_IO, "Cannot run `dot`: %s, graph dumps stay DOT files", strerror( error ) );
+        return error != ENOENT;
+    }
+
+    int status = 0;
+    while ( waitpid( pid, &status, 0 ) < 0 && errno == EINTR )
+        ;
+    if ( !WIFEXITED( status ) || WEXITSTATUS( status ) )
+        LOG_WARN( LOG_IO, "`dot` failed on %zu graph dumps", count );
+
+    return true;
+}
+
+static void RenderWorker() {
+    std::unique_lock<std::mutex> lock( state.mutex );
+
+    while ( true ) {
+        state.wake.wait( lock, [] { return state.stop || state.queue_count; } );
+        if ( !state.queue_count )
+            break;
+
+        char *path = state.queue[0];
+        bool render = !state.dot_missing;
+
+        lock.unlock();
+        bool found = !render || RunDot( &path, 1 );
+        lock.lock();
+
+        state.dot_missing = state.dot_missing || !found;
+        free( path );
+        state.queue_count--;
+        memmove( state.queue, state.queue + 1, state.queue_count * sizeof( *state.queue ) );
+    }
+}
+
+static void Defer( char *path ) {
+    if ( state.deferred_count == state.deferred_capacity ) {
+        size_t capacity = state.deferred_capacity ? state.deferred_capacity * 2 : DEFERRED_DEFAULT_CAPACITY;
+        char **deferred = (char **)realloc( state.deferred, capacity * sizeof( *deferred ) );
+        if ( !deferred ) {
+            PRINT_ERROR( "Memory allocation error" );
+            free( path );
+            return;
+        }
+
+        state.deferred = deferred;
+        state.deferred_capacity = capacity;
+    }
+
+    state.deferred[state.deferred_count++] = path;
+}
+
+// The worker starts with the first snapshot, a process that never dumps never starts it
+static void Enqueue( char *path ) {
+    if ( dump_mode == GRAPH_DUMP_DOT || state.dot_missing ) {
+        free( path );
+        return;
+    }
+
+    if ( dump_mode == GRAPH_DUMP_BATCH || state.queue_count == GRAPH_DUMP_QUEUE_LIMIT ) {
+        Defer( path );
+        return;
+    }
+
+    state.queue[state.queue_count++] = path;
+    if ( !state.worker.joinable() ) {
+        state.stop = false;
+        state.worker = std::thread( RenderWorker );
+    }
+    state.wake.notify_one();
+}
+
+static bool OpenIndex() {
+    char path[MAX_LEN_PATH] = {};
+    snprintf( path, sizeof( path ), "%s/images", GRAPH_DUMP_DIRECTORY );
+
+    if ( MakeDirectory( GRAPH_DUMP_DIRECTORY ) || MakeDirectory( path ) )
+        return false;
+
+    snprintf( path, sizeof( path ), "%s/index.html", GRAPH_DUMP_DIRECTORY );
+    // A second pass of the same process (GraphDumpFinish ran) adds to the same page
+    state.index = fopen( path, state.at_exit ? "a" : "w" );
+    if ( !state.index ) {
+        PRINT_ERROR( "Fail to open file `%s`", path );
+        return false;
+    }
+
+    if ( !state.at_exit ) {
+        state.at_exit = true;
+        atexit( GraphDumpFinish );
+    }
+
+    return true;
+}
+
+void GraphDumpTree( const Node_t *node, const char *format, va_list args ) {
+    my_assert( format, "Null pointer on `format`" );
+
+    if ( dump_mode == GRAPH_DUMP_OFF )
+        return;
+
+    std::lock_guard<std::mutex> lock( state.mutex );
+    if ( !state.index && !OpenIndex() )
+        return;
+
+    fprintf( state.index, "<h3>DUMP</h3>\n<pre>" );
+    vfprintf( state.index, format, args );
+    fprintf( state.index, "</pre>\n" );
+
+    if ( node ) {
+        size_t number = state.images++;
+        char path[MAX_LEN_PATH] = {};
+        snprintf( path, sizeof( path ), "%s/images/image%zu.dot", GRAPH_DUMP_DIRECTORY, number );
+
+        NodeGraphicDump( node, dump_node_limit, "%s", path );
+        fprintf( state.index, "<img src=\"images/image%zu.dot.svg\" style=\"width:auto; height:400;\">\n", number );
+
+        char *queued = strdup( path );
+        if ( queued )
+            Enqueue( queued );
+    }
+
+    fflush( state.index );
+}
+
+void GraphDumpFinish() {
+    std::unique_lock<std::mutex> lock( state.mutex );
+
+    if ( state.worker.joinable() ) {
+        state.stop = true;
+        state.wake.notify_one();
+
+        lock.unlock();
+        state.worker.join();
+        lock.lock();
+    }
+
+    for ( size_t i = 0; i < state.deferred_count; i += GRAPH_DUMP_BATCH_FILES ) {
+        if ( state.dot_missing )
+            break;
+
+        size_t count = state.deferred_count - i;
+        state.dot_missing = !RunDot( state.deferred + i, count < GRAPH_DUMP_BATCH_FILES ? count : GRAPH_DUMP_BATCH_FILES );
+    }
+
+    for ( size_t i = 0; i < state.deferred_count; i++ )
+        free( state.deferred[i] );
+    free( state.deferred );
+    state.deferred = NULL;
+    state.deferred_count = state.deferred_capacity = 0;
+
+    if ( state.index ) {
+        fclose( state.index );
+        state.index = NULL;
+    }
+}
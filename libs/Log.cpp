@@ -0,0 +1,258 @@
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+#include "DebugUtils.h"
+#include "Log.h"
+
+// Two blocks: the threads fill one while the writer writes the other
+const size_t LOG_BUFFER_SIZE = 1 << 20;
+const size_t LOG_LINE_SIZE   = 512;
+const int LOG_FLUSH_INTERVAL_MS = 100;
+
+struct LogSink_t {
+    std::mutex mutex = {};
+    std::condition_variable wake = {};    // the writer waits for lines or a flush
+    std::condition_variable drained = {}; // the threads wait for space or for a flush to end
+
+    char *buffers[2] = {};
+    size_t size = 0;   // filled part of buffers[active]
+    size_t active = 0;
+
+    bool writing = false; // the writer holds the other block
+    bool flush = false;
+    bool stop = false;
+
+    std::thread writer = {};
+};
+
+static const char *const LEVEL_NAMES[LOG_LEVELS_COUNT] = { "off", "error", "warn", "info", "debug", "trace" };
+static const char *const LEVEL_COLORS[LOG_LEVELS_COUNT] = {
+    "", COLOR_BRIGHT_RED, COLOR_YELLOW, COLOR_GREEN, COLOR_CYAN, COLOR_BLUE
+};
+static const char *const CATEGORY_NAMES[LOG_CATEGORIES_COUNT] = { "lexer", "parser", "tree", "codegen", "cache", "io" };
+
+LogLevel_t log_levels[LOG_CATEGORIES_COUNT] = {
+    LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL
+};
+
+static LogSink_t sink;
+static std::once_flag sink_once;
+static std::atomic<bool> sink_running( false );
+static bool colored = false;
+
+// Seconds change rarely, only the milliseconds are formatted on every line
+static thread_local time_t cached_second = 0;
+static thread_local char cached_clock[16] = "";
+
+static bool ParseLevel( const char *name, size_t length, LogLevel_t *level ) {
+    for ( size_t i = 0; i < LOG_LEVELS_COUNT; i++ ) {
+        if ( strlen( LEVEL_NAMES[i] ) == length && !strncmp( LEVEL_NAMES[i], name, length ) ) {
+            *level = (LogLevel_t)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool ParseCategory( const char *name, size_t length, size_t *category ) {
+    for ( size_t i = 0; i < LOG_CATEGORIES_COUNT; i++ ) {
+        if ( strlen( CATEGORY_NAMES[i] ) == length && !strncmp( CATEGORY_NAMES[i], name, length ) ) {
+            *category = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// `level` sets every category, `category=level` one of them; later items win
+static bool ParseSpec( const char *spec, LogLevel_t *levels ) {
+    const char *item = spec;
+
+    while ( *item ) {
+        size_t length = strcspn( item, "," );
+        const char *equals = (const char *)memchr( item, '=', length );
+
+        if ( equals ) {
+            size_t category = 0;
+            if ( !ParseCategory( item, (size_t)( equals - item ), &category ) ||
+                 !ParseLevel( equals + 1, length - (size_t)( equals - item ) - 1, &levels[category] ) )
+                return false;
+        } else {
+            LogLevel_t level = LOG_LEVEL_OFF;
+            if ( !ParseLevel( item, length, &level ) )
+                return false;
+            for ( size_t i = 0; i < LOG_CATEGORIES_COUNT; i++ )
+                levels[i] = level;
+        }
+
+        item += length;
+        if ( *item == ',' )
+            item++;
+    }
+
+    return true;
+}
+
+bool LogConfigure( const char *spec ) {
+    LogLevel_t levels[LOG_CATEGORIES_COUNT] = {};
+    for ( size_t i = 0; i < LOG_CATEGORIES_COUNT; i++ )
+        levels[i] = LOG_DEFAULT_LEVEL;
+
+    const char *environment = getenv( "LANG_LOG" );
+    if ( environment && *environment && !ParseSpec( environment, levels ) )
+        PRINT_ERROR( "Bad LANG_LOG `%s`, expected e.g. `info` or `warn,lexer=trace`", environment );
+
+    if ( spec && !ParseSpec( spec, levels ) ) {
+        PRINT_ERROR( "Bad log spec `%s`, expected e.g. `info` or `warn,lexer=trace`", spec );
+        return false;
+    }
+
+    // Levels above LOG_COMPILED_LEVEL would only cost the branch of the messages left
+    for ( size_t i = 0; i < LOG_CATEGORIES_COUNT; i++ )
+        log_levels[i] = levels[i] < LOG_COMPILED_LEVEL ? levels[i] : LOG_COMPILED_LEVEL;
+
+    return true;
+}
+
+static void WriterLoop() {
+    std::unique_lock<std::mutex> lock( sink.mutex );
+
+    while ( true ) {
+        sink.wake.wait_for( lock, std::chrono::milliseconds( LOG_FLUSH_INTERVAL_MS ),
+                            [] { return sink.stop || sink.flush || sink.size >= LOG_BUFFER_SIZE / 2; } );
+
+        if ( sink.size ) {
+            char *block = sink.buffers[sink.active];
+            size_t size = sink.size;
+            sink.active ^= 1;
+            sink.size = 0;
+            sink.writing = true;
+
+            lock.unlock();
+            fwrite( block, 1, size, stderr );
+            fflush( stderr );
+            lock.lock();
+
+            sink.writing = false;
+            sink.drained.notify_all();
+            continue;
+        }
+
+        if ( sink.flush ) {
+            sink.flush = false;
+            sink.drained.notify_all();
+        }
+        if ( sink.stop )
+            break;
+    }
+}
+
+// Registered after the sink is constructed, so it runs before the sink is destroyed
+static void StopWriter() {
+    {
+        std::lock_guard<std::mutex> lock( sink.mutex );
+        sink.stop = true;
+    }
+    sink.wake.notify_one();
+    sink.writer.join();
+
+    sink_running = false;
+    free( sink.buffers[0] );
+    free( sink.buffers[1] );
+}
+
+static void StartWriter() {
+    sink.buffers[0] = (char *)calloc( LOG_BUFFER_SIZE, sizeof( char ) );
+    sink.buffers[1] = (char *)calloc( LOG_BUFFER_SIZE, sizeof( char ) );
+    if ( !sink.buffers[0] || !sink.buffers[1] ) {
+        free( sink.buffers[0] );
+        free( sink.buffers[1] );
+        return;
+    }
+
+    colored = isatty( STDERR_FILENO );
+    sink.writer = std::thread( WriterLoop );
+    sink_running = true;
+    atexit( StopWriter );
+}
+
+static void Append( const char *line, size_t length ) {
+    std::unique_lock<std::mutex> lock( sink.mutex );
+
+    while ( sink.size + length > LOG_BUFFER_SIZE ) {
+        sink.wake.notify_one();
+        sink.drained.wait( lock );
+    }
+
+    memcpy( sink.buffers[sink.active] + sink.size, line, length );
+    sink.size += length;
+
+    if ( sink.size >= LOG_BUFFER_SIZE / 2 )
+        sink.wake.notify_one();
+}
+
+static const char *Clock( const struct timespec *now ) {
+    if ( now->tv_sec != cached_second || !cached_clock[0] ) {
+        struct tm local = {};
+        localtime_r( &now->tv_sec, &local );
+        strftime( cached_clock, sizeof( cached_clock ), "%H:%M:%S", &local );
+        cached_second = now->tv_sec;
+    }
+
+    return cached_clock;
+}
+
+void LogWrite( LogLevel_t level, LogCategory_t category, const char *file, int line, const char *function,
+               const char *format, ... ) {
+    std::call_once( sink_once, StartWriter );
+
+    char buffer[LOG_LINE_SIZE] = "";
+    struct timespec now = {};
+    clock_gettime( CLOCK_REALTIME_COARSE, &now );
+
+    int prefix = snprintf( buffer, sizeof( buffer ), "[%s.%03ld] %s[%-5s]%s [%s] [%s:%d] [%s] ", Clock( &now ),
+                           now.tv_nsec / 1000000, colored ? LEVEL_COLORS[level] : "", LEVEL_NAMES[level],
+                           colored ? COLOR_RESET : "", CATEGORY_NAMES[category], file, line, function );
+    size_t length = prefix > 0 && (size_t)prefix < sizeof( buffer ) ? (size_t)prefix : sizeof( buffer ) - 1;
+
+    va_list args;
+    va_start( args, format );
+    int message = vsnprintf( buffer + length, sizeof( buffer ) - length, format, args );
+    va_end( args );
+
+    // One record per line: a long message is cut, line breaks inside it become spaces
+    size_t message_start = length;
+    length += message > 0 ? (size_t)message : 0;
+    if ( length > sizeof( buffer ) - 2 )
+        length = sizeof( buffer ) - 2;
+    for ( size_t i = message_start; i < length; i++ ) {
+        if ( buffer[i] == '\n' )
+            buffer[i] = ' ';
+    }
+    buffer[length++] = '\n';
+
+    if ( sink_running )
+        Append( buffer, length );
+    else
+        fwrite( buffer, 1, length, stderr );
+}
+
+void LogFlush() {
+    if ( !sink_running )
+        return;
+
+    std::unique_lock<std::mutex> lock( sink.mutex );
+    sink.flush = true;
+    sink.wake.notify_one();
+    sink.drained.wait( lock, [] { return !sink.flush && !sink.size && !sink.writing; } );
+}
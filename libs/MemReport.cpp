@@ -0,0 +1,221 @@
+#include <atomic>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "DebugUtils.h"
+#include "MemReport.h"
+
+const uint64_t MEBIBYTE = 1ull << 20;
+
+struct MemCounters_t {
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> bytes;
+};
+
+struct MemPhase_t {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> peak_after; // highest peak RSS seen at the end of the phase
+    std::atomic<uint64_t> peak_growth; // how much the peak rose while the phase ran
+};
+
+static const char *const CATEGORY_NAMES[MEM_CATEGORIES_COUNT] = { "nodes", "tokens", "strings", "io buffers" };
+static const char *const CATEGORY_KEYS[MEM_CATEGORIES_COUNT] = { "nodes", "tokens", "strings", "io_buffers" };
+
+bool mem_report_enabled = false;
+
+// Set before any work starts, so the threads only read them
+static MemReportFormat_t report_format = MEM_REPORT_OFF;
+static uint64_t report_budget = 0;
+// The high-water mark of /proc/self/status was reset for this run, which then started
+// at run_start_bytes of RSS; otherwise the peak is that of the process and the start is 0
+static bool peak_reset = false;
+static uint64_t run_start_bytes = 0;
+
+static MemCounters_t categories[MEM_CATEGORIES_COUNT];
+static MemPhase_t phases[PHASES_COUNT];
+
+bool MemReportParseFormat( const char *argument, MemReportFormat_t *format ) {
+    my_assert( format, "Null pointer on `format`" );
+
+    if ( !argument || !strcmp( argument, "table" ) )
+        *format = MEM_REPORT_TABLE;
+    else if ( !strcmp( argument, "json" ) )
+        *format = MEM_REPORT_JSON;
+    else
+        return false;
+
+    return true;
+}
+
+bool MemReportParseBudget( const char *argument, uint64_t *budget_bytes ) {
+    my_assert( argument, "Null pointer on `argument`" );
+    my_assert( budget_bytes, "Null pointer on `budget_bytes`" );
+
+    char *end = NULL;
+    errno = 0;
+    unsigned long long mebibytes = strtoull( argument, &end, 10 );
+    if ( errno || end == argument || *end != '\0' || !mebibytes || mebibytes > UINT64_MAX / MEBIBYTE )
+        return false;
+
+    *budget_bytes = mebibytes * MEBIBYTE;
+    return true;
+}
+
+static void MemReportClear() {
+    for ( size_t i = 0; i < MEM_CATEGORIES_COUNT; i++ ) {
+        categories[i].allocations = 0;
+        categories[i].bytes = 0;
+    }
+
+    for ( size_t i = 0; i < PHASES_COUNT; i++ ) {
+        phases[i].calls = 0;
+        phases[i].peak_after = 0;
+        phases[i].peak_growth = 0;
+    }
+}
+
+// Lowers the high-water mark to the current RSS. ru_maxrss of getrusage is not reset
+static bool ResetPeak() {
+    FILE *clear_refs = fopen( "/proc/self/clear_refs", "w" );
+    if ( !clear_refs )
+        return false;
+
+    bool written = fputs( "5", clear_refs ) >= 0;
+    return !fclose( clear_refs ) && written;
+}
+
+// Peak RSS since the last ResetPeak
+static bool ReadHighWater( uint64_t *bytes ) {
+    FILE *status = fopen( "/proc/self/status", "r" );
+    if ( !status )
+        return false;
+
+    char line[128] = "";
+    unsigned long long kilobytes = 0;
+    bool found = false;
+    while ( !found && fgets( line, sizeof( line ), status ) )
+        found = sscanf( line, "VmHWM: %llu kB", &kilobytes ) == 1;
+    fclose( status );
+
+    *bytes = (uint64_t)kilobytes * 1024;
+    return found;
+}
+
+static uint64_t RunPeakBytes() {
+    uint64_t peak = 0;
+    return peak_reset && ReadHighWater( &peak ) ? peak : MemPeakBytes();
+}
+
+void MemReportEnable( MemReportFormat_t format, uint64_t budget_bytes ) {
+    report_format = format;
+    report_budget = budget_bytes;
+    mem_report_enabled = format != MEM_REPORT_OFF;
+
+    // A server runs many compiles in one process, each is measured from its own start
+    peak_reset = ( mem_report_enabled || budget_bytes ) && ResetPeak() && ReadHighWater( &run_start_bytes );
+    if ( !peak_reset )
+        run_start_bytes = 0;
+
+    MemReportClear();
+}
+
+void MemCountSlow( MemCategory_t category, size_t bytes ) {
+    MemCounters_t *counters = &categories[category];
+    counters->allocations.fetch_add( 1, std::memory_order_relaxed );
+    counters->bytes.fetch_add( bytes, std::memory_order_relaxed );
+}
+
+uint64_t MemPeakBytes() {
+    struct rusage usage = {};
+    if ( getrusage( RUSAGE_SELF, &usage ) )
+        return 0;
+
+    // ru_maxrss is in kilobytes on Linux
+    return (uint64_t)usage.ru_maxrss * 1024;
+}
+
+void MemPhaseEnd( TimePhase_t phase, uint64_t peak_before ) {
+    uint64_t peak = MemPeakBytes();
+    MemPhase_t *counters = &phases[phase];
+
+    counters->calls.fetch_add( 1, std::memory_order_relaxed );
+    counters->peak_growth.fetch_add( peak > peak_before ? peak - peak_before : 0, std::memory_order_relaxed );
+
+    uint64_t seen = counters->peak_after.load( std::memory_order_relaxed );
+    while ( seen < peak && !counters->peak_after.compare_exchange_weak( seen, peak, std::memory_order_relaxed ) )
+        ;
+}
+
+static double Mebibytes( uint64_t bytes ) {
+    return (double)bytes / (double)MEBIBYTE;
+}
+
+static void PrintTable( FILE *stream, uint64_t peak, uint64_t growth ) {
+    fprintf( stream, "Memory report: %.1f MiB peak RSS, %.1f MiB above the start", Mebibytes( peak ),
+             Mebibytes( growth ) );
+    if ( report_budget )
+        fprintf( stream, ", budget %.1f MiB", Mebibytes( report_budget ) );
+    fputc( '\n', stream );
+
+    fprintf( stream, "%-16s %12s %12s\n", "allocated", "count", "MiB" );
+    for ( size_t i = 0; i < MEM_CATEGORIES_COUNT; i++ )
+        fprintf( stream, "%-16s %12llu %12.1f\n", CATEGORY_NAMES[i],
+                 (unsigned long long)categories[i].allocations, Mebibytes( categories[i].bytes ) );
+
+    fprintf( stream, "%-16s %12s %12s %12s\n", "phase", "calls", "peak MiB", "raised MiB" );
+    for ( size_t i = 0; i < PHASES_COUNT; i++ ) {
+        const MemPhase_t *counters = &phases[i];
+        if ( !counters->calls )
+            continue;
+
+        fprintf( stream, "%-16s %12llu %12.1f %12.1f\n", TimePhaseName( (TimePhase_t)i ),
+                 (unsigned long long)counters->calls, Mebibytes( counters->peak_after ),
+                 Mebibytes( counters->peak_growth ) );
+    }
+}
+
+// One line with every category and phase, the keys do not depend on the run
+static void PrintJson( FILE *stream, uint64_t peak, uint64_t growth ) {
+    fprintf( stream,
+             "{\"peak_rss_bytes\": %llu, \"peak_growth_bytes\": %llu, \"budget_bytes\": %llu, \"within_budget\": %s, "
+             "\"allocations\": {",
+             (unsigned long long)peak, (unsigned long long)growth, (unsigned long long)report_budget,
+             !report_budget || growth <= report_budget ? "true" : "false" );
+
+    for ( size_t i = 0; i < MEM_CATEGORIES_COUNT; i++ )
+        fprintf( stream, "%s\"%s\": {\"count\": %llu, \"bytes\": %llu}", i ? ", " : "", CATEGORY_KEYS[i],
+                 (unsigned long long)categories[i].allocations, (unsigned long long)categories[i].bytes );
+
+    fprintf( stream, "}, \"phases\": {" );
+    for ( size_t i = 0; i < PHASES_COUNT; i++ )
+        fprintf( stream, "%s\"%s\": {\"calls\": %llu, \"peak_rss_bytes\": %llu, \"peak_growth_bytes\": %llu}",
+                 i ? ", " : "", TimePhaseKey( (TimePhase_t)i ), (unsigned long long)phases[i].calls,
+                 (unsigned long long)phases[i].peak_after, (unsigned long long)phases[i].peak_growth );
+
+    fprintf( stream, "}}\n" );
+}
+
+bool MemReportPrint( FILE *stream ) {
+    my_assert( stream, "Null pointer on `stream`" );
+
+    uint64_t peak = RunPeakBytes();
+    uint64_t growth = peak > run_start_bytes ? peak - run_start_bytes : 0;
+
+    if ( report_format == MEM_REPORT_JSON )
+        PrintJson( stream, peak, growth );
+    else if ( report_format == MEM_REPORT_TABLE )
+        PrintTable( stream, peak, growth );
+    fflush( stream );
+
+    MemReportClear();
+
+    if ( report_budget && growth > report_budget ) {
+        PRINT_ERROR( "Memory budget exceeded: peak RSS %.1f MiB, %.1f MiB above the start, budget %.1f MiB",
+                     Mebibytes( peak ), Mebibytes( growth ), Mebibytes( report_budget ) );
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,130 @@
+#include <string.h>
+
+#include "DebugUtils.h"
+#include "Sha256.h"
+
+// FIPS 180-4
+
+static const uint32_t SHA256_ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t RotateRight( uint32_t value, unsigned shift ) {
+    return ( value >> shift ) | ( value << ( 32 - shift ) );
+}
+
+static void Sha256Block( Sha256_t *sha, const uint8_t *block ) {
+    uint32_t schedule[64] = {};
+    for ( size_t i = 0; i < 16; i++ )
+        schedule[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 |
+                      (uint32_t)block[4 * i + 2] << 8 | (uint32_t)block[4 * i + 3];
+
+    for ( size_t i = 16; i < 64; i++ ) {
+        uint32_t s0 = RotateRight( schedule[i - 15], 7 ) ^ RotateRight( schedule[i - 15], 18 ) ^ ( schedule[i - 15] >> 3 );
+        uint32_t s1 = RotateRight( schedule[i - 2], 17 ) ^ RotateRight( schedule[i - 2], 19 ) ^ ( schedule[i - 2] >> 10 );
+        schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+    }
+
+    uint32_t a = sha->state[0], b = sha->state[1], c = sha->state[2], d = sha->state[3];
+    uint32_t e = sha->state[4], f = sha->state[5], g = sha->state[6], h = sha->state[7];
+
+    for ( size_t i = 0; i < 64; i++ ) {
+        uint32_t s1 = RotateRight( e, 6 ) ^ RotateRight( e, 11 ) ^ RotateRight( e, 25 );
+        uint32_t choice = ( e & f ) ^ ( ~e & g );
+        uint32_t temp1 = h + s1 + choice + SHA256_ROUND_CONSTANTS[i] + schedule[i];
+        uint32_t s0 = RotateRight( a, 2 ) ^ RotateRight( a, 13 ) ^ RotateRight( a, 22 );
+        uint32_t majority = ( a & b ) ^ ( a & c ) ^ ( b & c );
+        uint32_t temp2 = s0 + majority;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    sha->state[0] += a;
+    sha->state[1] += b;
+    sha->state[2] += c;
+    sha->state[3] += d;
+    sha->state[4] += e;
+    sha->state[5] += f;
+    sha->state[6] += g;
+    sha->state[7] += h;
+}
+
+void Sha256Init( Sha256_t *sha ) {
+    my_assert( sha, "Null pointer on `sha`" );
+
+    static const uint32_t initial_state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    *sha = {};
+    memcpy( sha->state, initial_state, sizeof( initial_state ) );
+}
+
+void Sha256Update( Sha256_t *sha, const void *data, size_t size ) {
+    my_assert( sha, "Null pointer on `sha`" );
+    my_assert( data || !size, "Null pointer on `data`" );
+
+    const uint8_t *bytes = (const uint8_t *)data;
+    sha->length += size;
+
+    if ( sha->block_size ) {
+        size_t taken = SHA256_BLOCK_SIZE - sha->block_size;
+        if ( taken > size )
+            taken = size;
+
+        memcpy( sha->block + sha->block_size, bytes, taken );
+        sha->block_size += taken;
+        bytes += taken;
+        size -= taken;
+
+        if ( sha->block_size < SHA256_BLOCK_SIZE )
+            return;
+
+        Sha256Block( sha, sha->block );
+        sha->block_size = 0;
+    }
+
+    for ( ; size >= SHA256_BLOCK_SIZE; bytes += SHA256_BLOCK_SIZE, size -= SHA256_BLOCK_SIZE )
+        Sha256Block( sha, bytes );
+
+    memcpy( sha->block, bytes, size );
+    sha->block_size = size;
+}
+
+void Sha256Final( Sha256_t *sha, uint8_t digest[SHA256_DIGEST_SIZE] ) {
+    my_assert( sha, "Null pointer on `sha`" );
+    my_assert( digest, "Null pointer on `digest`" );
+
+    uint64_t bit_length = sha->length * 8;
+
+    // 0x80, zeros up to 56 bytes of the last block, then the length in bits
+    static const uint8_t padding[SHA256_BLOCK_SIZE] = { 0x80 };
+    size_t padding_size = sha->block_size < 56 ? 56 - sha->block_size : 120 - sha->block_size;
+    Sha256Update( sha, padding, padding_size );
+
+    uint8_t length[8] = {};
+    for ( size_t i = 0; i < 8; i++ )
+        length[i] = (uint8_t)( bit_length >> ( 56 - 8 * i ) );
+    Sha256Update( sha, length, sizeof( length ) );
+
+    for ( size_t i = 0; i < 8; i++ ) {
+        digest[4 * i]     = (uint8_t)( sha->state[i] >> 24 );
+        digest[4 * i + 1] = (uint8_t)( sha->state[i] >> 16 );
+        digest[4 * i + 2] = (uint8_t)( sha->state[i] >> 8 );
+        digest[4 * i + 3] = (uint8_t)sha->state[i];
+    }
+}
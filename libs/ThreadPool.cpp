@@ -0,0 +1,56 @@
+#include <atomic>
+#include <thread>
+
+#include "DebugUtils.h"
+#include "ThreadPool.h"
+
+const size_t MAX_THREADS_COUNT = 256;
+
+size_t DefaultThreadsCount() {
+    unsigned int hardware = std::thread::hardware_concurrency();
+    return hardware ? hardware : 1;
+}
+
+struct ParallelState_t {
+    std::atomic<size_t> next_job;
+    size_t jobs_count;
+    ParallelJob_t job;
+    void *context;
+};
+
+static void ParallelWorker( ParallelState_t *state ) {
+    size_t job_index = 0;
+    while ( ( job_index = state->next_job.fetch_add( 1, std::memory_order_relaxed ) ) < state->jobs_count )
+        state->job( job_index, state->context );
+}
+
+void ParallelFor( size_t jobs_count, size_t threads, ParallelJob_t job, void *context ) {
+    my_assert( job, "Null pointer on `job`" );
+
+    if ( threads == 0 )
+        threads = DefaultThreadsCount();
+    if ( threads > jobs_count )
+        threads = jobs_count;
+    if ( threads > MAX_THREADS_COUNT )
+        threads = MAX_THREADS_COUNT;
+
+    if ( threads <= 1 ) {
+        for ( size_t i = 0; i < jobs_count; i++ )
+            job( i, context );
+        return;
+    }
+
+    ParallelState_t state = { { 0 }, jobs_count, job, context };
+
+    // The calling thread is one of the workers
+    std::thread *workers = new std::thread[threads - 1];
+    for ( size_t i = 0; i < threads - 1; i++ )
+        workers[i] = std::thread( ParallelWorker, &state );
+
+    ParallelWorker( &state );
+
+    for ( size_t i = 0; i < threads - 1; i++ )
+        workers[i].join();
+
+    delete[] workers;
+}
@@ -0,0 +1,185 @@
+#include <atomic>
+#include <string.h>
+#include <time.h>
+
+#include "DebugUtils.h"
+#include "MemReport.h"
+#include "TimeReport.h"
+
+struct PhaseCounters_t {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> nanoseconds;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> tokens;
+    std::atomic<uint64_t> nodes;
+};
+
+// Names in the table and keys in JSON, in the order of TimePhase_t
+static const char *const PHASE_NAMES[PHASES_COUNT] = {
+    "read", "lex", "parse", "ast save", "ast load", "strength reduce", "reg alloc", "emit"
+};
+static const char *const PHASE_KEYS[PHASES_COUNT] = {
+    "read", "lex", "parse", "ast_save", "ast_load", "strength_reduce", "reg_alloc", "emit"
+};
+
+// Set before any work starts, so the threads only read it
+static TimeReportFormat_t report_format = TIME_REPORT_OFF;
+static uint64_t report_start = 0;
+static PhaseCounters_t phases[PHASES_COUNT];
+
+// Time of the phases finished inside the one running on this thread
+static thread_local uint64_t nested_nanoseconds = 0;
+
+static uint64_t NowNanoseconds() {
+    struct timespec now = {};
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+bool TimeReportParseFormat( const char *argument, TimeReportFormat_t *format ) {
+    my_assert( format, "Null pointer on `format`" );
+
+    if ( !argument || !strcmp( argument, "table" ) )
+        *format = TIME_REPORT_TABLE;
+    else if ( !strcmp( argument, "json" ) )
+        *format = TIME_REPORT_JSON;
+    else
+        return false;
+
+    return true;
+}
+
+static void TimeReportClear() {
+    for ( size_t i = 0; i < PHASES_COUNT; i++ ) {
+        phases[i].calls = 0;
+        phases[i].nanoseconds = 0;
+        phases[i].bytes = 0;
+        phases[i].tokens = 0;
+        phases[i].nodes = 0;
+    }
+
+    report_start = NowNanoseconds();
+}
+
+void TimeReportEnable( TimeReportFormat_t format ) {
+    report_format = format;
+    TimeReportClear();
+}
+
+bool TimeReportEnabled() {
+    return report_format != TIME_REPORT_OFF;
+}
+
+const char *TimePhaseName( TimePhase_t phase ) {
+    return PHASE_NAMES[phase];
+}
+
+const char *TimePhaseKey( TimePhase_t phase ) {
+    return PHASE_KEYS[phase];
+}
+
+// The scopes also mark the phase boundaries of the memory report
+TimeScope_t TimePhaseBegin() {
+    if ( report_format == TIME_REPORT_OFF && !mem_report_enabled )
+        return {};
+
+    TimeScope_t scope = { NowNanoseconds(), nested_nanoseconds, mem_report_enabled ? MemPeakBytes() : 0 };
+    nested_nanoseconds = 0;
+
+    return scope;
+}
+
+void TimePhaseEnd( TimeScope_t *scope, TimePhase_t phase, TimeAmount_t amount ) {
+    my_assert( scope, "Null pointer on `scope`" );
+
+    if ( !scope->start )
+        return;
+
+    uint64_t elapsed = NowNanoseconds() - scope->start;
+    uint64_t own = elapsed > nested_nanoseconds ? elapsed - nested_nanoseconds : 0;
+    nested_nanoseconds = scope->outer_nested + elapsed;
+
+    if ( mem_report_enabled )
+        MemPhaseEnd( phase, scope->peak_before );
+    if ( report_format == TIME_REPORT_OFF )
+        return;
+
+    PhaseCounters_t *counters = &phases[phase];
+    counters->calls.fetch_add( 1, std::memory_order_relaxed );
+    counters->nanoseconds.fetch_add( own, std::memory_order_relaxed );
+    counters->bytes.fetch_add( amount.bytes, std::memory_order_relaxed );
+    counters->tokens.fetch_add( amount.tokens, std::memory_order_relaxed );
+    counters->nodes.fetch_add( amount.nodes, std::memory_order_relaxed );
+}
+
+static double PerSecond( uint64_t amount, uint64_t nanoseconds ) {
+    return nanoseconds ? (double)amount * 1e9 / (double)nanoseconds : 0;
+}
+
+static void PrintRate( FILE *stream, uint64_t amount, uint64_t nanoseconds, double unit ) {
+    if ( amount && nanoseconds )
+        fprintf( stream, " %12.2f", PerSecond( amount, nanoseconds ) / unit );
+    else
+        fprintf( stream, " %12s", "-" );
+}
+
+static void PrintTable( FILE *stream, uint64_t wall ) {
+    uint64_t total = 0;
+    for ( size_t i = 0; i < PHASES_COUNT; i++ )
+        total += phases[i].nanoseconds;
+
+    fprintf( stream, "Time report: %.3f ms wall, %.3f ms in phases\n", (double)wall / 1e6, (double)total / 1e6 );
+    fprintf( stream, "%-16s %8s %12s %6s %12s %12s %12s\n", "phase", "calls", "ms", "%", "MB/s", "Mtokens/s",
+             "Mnodes/s" );
+
+    for ( size_t i = 0; i < PHASES_COUNT; i++ ) {
+        const PhaseCounters_t *counters = &phases[i];
+        if ( !counters->calls )
+            continue;
+
+        uint64_t nanoseconds = counters->nanoseconds;
+        fprintf( stream, "%-16s %8llu %12.3f %6.1f", PHASE_NAMES[i], (unsigned long long)counters->calls,
+                 (double)nanoseconds / 1e6, total ? 100.0 * (double)nanoseconds / (double)total : 0 );
+        PrintRate( stream, counters->bytes, nanoseconds, 1e6 );
+        PrintRate( stream, counters->tokens, nanoseconds, 1e6 );
+        PrintRate( stream, counters->nodes, nanoseconds, 1e6 );
+        fputc( '\n', stream );
+    }
+}
+
+// One line with every phase, so a dashboard sees the same keys in every run
+static void PrintJson( FILE *stream, uint64_t wall ) {
+    fprintf( stream, "{\"wall_ms\": %.3f, \"phases\": {", (double)wall / 1e6 );
+
+    for ( size_t i = 0; i < PHASES_COUNT; i++ ) {
+        const PhaseCounters_t *counters = &phases[i];
+        uint64_t nanoseconds = counters->nanoseconds;
+
+        fprintf( stream,
+                 "%s\"%s\": {\"calls\": %llu, \"ms\": %.3f, \"bytes\": %llu, \"tokens\": %llu, \"nodes\": %llu, "
+                 "\"bytes_per_sec\": %.0f, \"tokens_per_sec\": %.0f, \"nodes_per_sec\": %.0f}",
+                 i ? ", " : "", PHASE_KEYS[i], (unsigned long long)counters->calls, (double)nanoseconds / 1e6,
+                 (unsigned long long)counters->bytes, (unsigned long long)counters->tokens,
+                 (unsigned long long)counters->nodes, PerSecond( counters->bytes, nanoseconds ),
+                 PerSecond( counters->tokens, nanoseconds ), PerSecond( counters->nodes, nanoseconds ) );
+    }
+
+    fprintf( stream, "}}\n" );
+}
+
+void TimeReportPrint( FILE *stream ) {
+    my_assert( stream, "Null pointer on `stream`" );
+
+    if ( report_format == TIME_REPORT_OFF )
+        return;
+
+    uint64_t wall = NowNanoseconds() - report_start;
+    if ( report_format == TIME_REPORT_JSON )
+        PrintJson( stream, wall );
+    else
+        PrintTable( stream, wall );
+
+    fflush( stream );
+    TimeReportClear();
+}
@@ -0,0 +1,260 @@
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+#include "DebugUtils.h"
+#include "Trace.h"
+
+// Events per ring: 40 bytes each, so 2.5 MB for every thread that records anything
+const size_t TRACE_RING_CAPACITY = 1 << 16;
+const size_t TRACE_DETAIL_SIZE = 23;
+
+struct TraceEvent_t {
+    uint64_t timestamp;
+    const char *name; // a literal or __func__, never freed
+    char detail[TRACE_DETAIL_SIZE];
+    char phase;       // 'B' or 'E'
+};
+
+struct TraceBuffer_t {
+    TraceEvent_t *events;
+    std::atomic<uint64_t> head; // events ever written, only the owner thread moves it
+
+    size_t index; // the row of the trace
+    bool main;
+    bool in_use;  // owned by a running thread, guarded by trace_mutex
+
+    TraceBuffer_t *next;
+};
+
+// Gives the ring back when its thread ends, so the next thread of a pool reuses it
+struct TraceThread_t {
+    TraceBuffer_t *buffer = NULL;
+
+    TraceThread_t() = default;
+    ~TraceThread_t();
+
+    TraceThread_t( const TraceThread_t & ) = delete;
+    TraceThread_t &operator=( const TraceThread_t & ) = delete;
+};
+
+bool trace_enabled = false;
+
+static const char *trace_filename = TRACE_DEFAULT_FILENAME;
+static size_t trace_depth = TRACE_DEFAULT_DEPTH;
+static uint64_t trace_start = 0;
+static std::thread::id trace_main_thread;
+
+// Taken once per thread to find a ring, never by the events themselves
+static std::mutex trace_mutex;
+static TraceBuffer_t *trace_buffers = NULL;
+static size_t trace_buffers_count = 0;
+
+static thread_local TraceThread_t trace_thread;
+static thread_local size_t trace_nested = 0;
+
+TraceThread_t::~TraceThread_t() {
+    if ( !buffer )
+        return;
+
+    std::lock_guard<std::mutex> lock( trace_mutex );
+    buffer->in_use = false;
+}
+
+static uint64_t NowNanoseconds() {
+    struct timespec now = {};
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static TraceBuffer_t *AcquireBuffer() {
+    std::lock_guard<std::mutex> lock( trace_mutex );
+
+    bool main = std::this_thread::get_id() == trace_main_thread;
+    for ( TraceBuffer_t *buffer = trace_buffers; buffer; buffer = buffer->next ) {
+        if ( !buffer->in_use && buffer->main == main ) {
+            buffer->in_use = true;
+            return buffer;
+        }
+    }
+
+    TraceBuffer_t *buffer = (TraceBuffer_t *)calloc( 1, sizeof( *buffer ) );
+    TraceEvent_t *events = (TraceEvent_t *)calloc( TRACE_RING_CAPACITY, sizeof( *events ) );
+    if ( !buffer || !events ) {
+        free( buffer );
+        free( events );
+        return NULL;
+    }
+
+    buffer->events = events;
+    buffer->index = trace_buffers_count++;
+    buffer->main = main;
+    buffer->in_use = true;
+
+    // New rings go to the end, so the rows keep the order of the threads
+    TraceBuffer_t **last = &trace_buffers;
+    while ( *last )
+        last = &( *last )->next;
+    *last = buffer;
+
+    return buffer;
+}
+
+static void Record( char phase, const char *name, const char *detail ) {
+    TraceBuffer_t *buffer = trace_thread.buffer;
+    if ( !buffer ) {
+        buffer = trace_thread.buffer = AcquireBuffer();
+        if ( !buffer )
+            return;
+    }
+
+    uint64_t head = buffer->head.load( std::memory_order_relaxed );
+    TraceEvent_t *event = &buffer->events[head % TRACE_RING_CAPACITY];
+
+    event->timestamp = NowNanoseconds();
+    event->name = name;
+    event->phase = phase;
+    event->detail[0] = '\0';
+    if ( detail ) {
+        strncpy( event->detail, detail, TRACE_DETAIL_SIZE - 1 );
+        event->detail[TRACE_DETAIL_SIZE - 1] = '\0';
+    }
+
+    buffer->head.store( head + 1, std::memory_order_release );
+}
+
+void TraceEnable( const char *filename, size_t depth ) {
+    my_assert( filename, "Null pointer on `filename`" );
+
+    trace_filename = filename;
+    trace_depth = depth;
+    trace_main_thread = std::this_thread::get_id();
+    trace_start = NowNanoseconds();
+
+    for ( TraceBuffer_t *buffer = trace_buffers; buffer; buffer = buffer->next )
+        buffer->head.store( 0, std::memory_order_relaxed );
+
+    trace_enabled = true;
+}
+
+void TraceDisable() {
+    trace_enabled = false;
+}
+
+void TraceBegin( const char *name, const char *detail ) {
+    if ( trace_enabled )
+        Record( 'B', name, detail );
+}
+
+void TraceEnd() {
+    if ( trace_enabled )
+        Record( 'E', NULL, NULL );
+}
+
+void TraceNestedBegin( const char *name ) {
+    if ( trace_enabled && ++trace_nested <= trace_depth )
+        Record( 'B', name, NULL );
+}
+
+void TraceNestedEnd() {
+    if ( trace_enabled && trace_nested-- <= trace_depth )
+        Record( 'E', NULL, NULL );
+}
+
+static void WriteString( FILE *stream, const char *string ) {
+    fputc( '"', stream );
+    for ( const char *pos = string; *pos; pos++ ) {
+        if ( *pos == '"' || *pos == '\\' )
+            fputc( '\\', stream );
+        if ( (unsigned char)*pos >= ' ' )
+            fputc( *pos, stream );
+    }
+    fputc( '"', stream );
+}
+
+// An overwritten ring starts in the middle of zones: ends without their beginning are skipped
+static size_t WriteBuffer( FILE *stream, const TraceBuffer_t *buffer, int pid, bool *first ) {
+    uint64_t head = buffer->head.load( std::memory_order_acquire );
+    if ( !head )
+        return 0;
+
+    uint64_t begin = head > TRACE_RING_CAPACITY ? head - TRACE_RING_CAPACITY : 0;
+
+    fprintf( stream, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %zu, \"args\": {\"name\": ",
+             *first ? "" : ",\n", pid, buffer->index );
+    if ( buffer->main )
+        fprintf( stream, "\"main\"}}" );
+    else
+        fprintf( stream, "\"worker %zu\"}}", buffer->index );
+    *first = false;
+
+    size_t open = 0;
+    for ( uint64_t i = begin; i < head; i++ ) {
+        const TraceEvent_t *event = &buffer->events[i % TRACE_RING_CAPACITY];
+        double microseconds = event->timestamp > trace_start ? (double)( event->timestamp - trace_start ) / 1e3 : 0;
+
+        if ( event->phase == 'E' ) {
+            if ( !open )
+                continue;
+            open--;
+            fprintf( stream, ",\n{\"ph\": \"E\", \"ts\": %.3f, \"pid\": %d, \"tid\": %zu}", microseconds, pid,
+                     buffer->index );
+            continue;
+        }
+
+        open++;
+        fprintf( stream, ",\n{\"name\": " );
+        WriteString( stream, event->name );
+        fprintf( stream, ", \"ph\": \"B\", \"ts\": %.3f, \"pid\": %d, \"tid\": %zu", microseconds, pid,
+                 buffer->index );
+        if ( event->detail[0] ) {
+            fprintf( stream, ", \"args\": {\"detail\": " );
+            WriteString( stream, event->detail );
+            fputc( '}', stream );
+        }
+        fputc( '}', stream );
+    }
+
+    return head > TRACE_RING_CAPACITY ? head - TRACE_RING_CAPACITY : 0;
+}
+
+bool TraceWrite() {
+    if ( !trace_enabled )
+        return true;
+
+    FILE *stream = fopen( trace_filename, "w" );
+    if ( !stream ) {
+        PRINT_ERROR( "Fail to open file `%s`", trace_filename );
+        return false;
+    }
+
+    int pid = getpid();
+    bool first = true;
+    size_t dropped = 0;
+
+    fprintf( stream, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n" );
+    {
+        std::lock_guard<std::mutex> lock( trace_mutex );
+        for ( TraceBuffer_t *buffer = trace_buffers; buffer; buffer = buffer->next ) {
+            dropped += WriteBuffer( stream, buffer, pid, &first );
+            buffer->head.store( 0, std::memory_order_relaxed );
+        }
+    }
+    fprintf( stream, "\n]}\n" );
+
+    bool written = !ferror( stream );
+    written = !fclose( stream ) && written;
+    if ( !written )
+        PRINT_ERROR( "Fail to write trace `%s`", trace_filename );
+    if ( dropped )
+        fprintf( stderr, "Trace rings overflowed: the oldest %zu events were dropped\n", dropped );
+
+    trace_start = NowNanoseconds();
+    return written;
+}
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <ctype.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -10,10 +11,15 @@
 
 #include "DebugUtils.h"
 #include "Language.h"
+#include "MemReport.h"
+#include "TimeReport.h"
 #include "Tree.h"
 #include "UtilsRW.h"
 
 const uint32_t fill_color = 0xb6b4b4;
+const size_t NODE_STACK_DEFAULT_CAPACITY = 64;
+const size_t BLOCK_DEFAULT_CAPACITY = 4;
+const size_t TREE_NAME_MAX_LENGTH = 127;
 
 static TreeData_t MakeNumber( int number ) {
     TreeData_t value = {};
@@ -41,6 +47,7 @@ static TreeData_t MakeVariable( const char *variable_src ) {
         size_t len = strlen( variable_src );
         char *copy = (char *)calloc( len + 1, sizeof( char ) );
         assert( copy && "Memory allocation error" );
+        MemCount( MEM_STRINGS, len + 1 );
         memcpy( copy, variable_src, len );
         copy[len] = '\0';
         value.data.variable = copy;
@@ -51,15 +58,110 @@ static TreeData_t MakeVariable( const char *variable_src ) {
     return value;
 }
 
-#define OPERATIONS_STRINGS( token_str, op_enum, is_custom, nargs, string ) string,
+#define OPERATIONS_INFO( token_str, op_enum, is_custom, nargs, string, arity, instruction, is_pure, cost, lbp, rbp ) \
+    { token_str, op_enum, is_custom, string, arity, instruction, is_pure, cost, lbp, rbp },
 
-static const char *operations_txt[] = { INIT_OPERATIONS( OPERATIONS_STRINGS ) };
+// Indexed by OperationType: the enum is generated from the same table in the same order
+static const OperationInfo_t operations_info[] = { INIT_OPERATIONS( OPERATIONS_INFO ) };
 
-#undef OPERATIONS_STRINGS
+#undef OPERATIONS_INFO
+
+static_assert( sizeof( operations_info ) / sizeof( operations_info[0] ) == OPERATIONS_COUNT,
+               "Operation table and OperationType enum diverged" );
+
+const OperationInfo_t *GetOperationInfo( OperationType op ) {
+    if ( op < 0 || (size_t)op >= OPERATIONS_COUNT )
+        return NULL;
+
+    return &operations_info[op];
+}
+
+static const char *OperationName( int op ) {
+    const OperationInfo_t *info = GetOperationInfo( (OperationType)op );
+    return info ? info->name : "NOPE";
+}
+
+// Operations grouped by the first character of their token, longest token first,
+// so that lookup costs one array access plus a couple of compares instead of a
+// strcmp against every operation.
+struct OperationIndex_t {
+    uint8_t start[UINT8_MAX + 1];
+    uint8_t count[UINT8_MAX + 1];
+    OperationType sorted[OPERATIONS_COUNT];
+};
+
+static OperationIndex_t BuildOperationIndex() {
+    OperationIndex_t index = {};
+
+    for ( size_t i = 0; i < OPERATIONS_COUNT; i++ )
+        index.sorted[i] = operations_info[i].op;
+
+    // Insertion sort by (first char, length desc), the table is tiny
+    for ( size_t i = 1; i < OPERATIONS_COUNT; i++ ) {
+        OperationType op = index.sorted[i];
+        const char *token = operations_info[op].token;
+
+        size_t j = i;
+        while ( j > 0 ) {
+            const char *prev = operations_info[index.sorted[j - 1]].token;
+            if ( (unsigned char)prev[0] < (unsigned char)token[0] ||
+                 ( prev[0] == token[0] && strlen( prev ) >= strlen( token ) ) )
+                break;
+
+            index.sorted[j] = index.sorted[j - 1];
+            j--;
+        }
+
+        index.sorted[j] = op;
+    }
+
+    for ( size_t i = OPERATIONS_COUNT; i > 0; i-- ) {
+        unsigned char first = (unsigned char)operations_info[index.sorted[i - 1]].token[0];
+        index.start[first] = (uint8_t)( i - 1 );
+        index.count[first]++;
+    }
+
+    return index;
+}
+
+static const OperationIndex_t &GetOperationIndex() {
+    static const OperationIndex_t index = BuildOperationIndex();
+    return index;
+}
+
+OperationType MatchOperationPrefix( const char *str, size_t *length ) {
+    my_assert( str, "Null pointer on `str`" );
+
+    const OperationIndex_t &index = GetOperationIndex();
+    unsigned char first = (unsigned char)str[0];
+
+    for ( size_t i = index.start[first]; i < (size_t)index.start[first] + index.count[first]; i++ ) {
+        const OperationInfo_t *info = &operations_info[index.sorted[i]];
+
+        size_t token_length = strlen( info->token );
+        if ( !strncmp( str, info->token, token_length ) ) {
+            if ( length )
+                *length = token_length;
+            return info->op;
+        }
+    }
+
+    return OP_NOPE;
+}
+
+OperationType FindOperation( const char *str, size_t length ) {
+    my_assert( str, "Null pointer on `str`" );
+
+    size_t matched = 0;
+    OperationType op = MatchOperationPrefix( str, &matched );
+
+    return matched == length ? op : OP_NOPE;
+}
 
 // Forward declarations for TreeLoadFromFile
-static Node_t *NodeLoadRecursively( const char **pos, char *error_buffer, size_t error_size );
-static void SkipSpaces( const char **pos );
+static Node_t *NodeLoadRecursively( const char **pos, const char *end, size_t *nodes_count, char *error_buffer,
+                                    size_t error_size );
+static void SkipSpaces( const char **pos, const char *end );
 static void SetError( char *error_buffer, size_t error_size, const char *fmt, ... );
 
 static void SetError( char *error_buffer, size_t error_size, const char *fmt, ... ) {
@@ -93,6 +195,7 @@ void TreeDtor( Tree_t **tree, void ( *clean_function )( TreeData_t value, Tree_t
 Node_t *NodeCreate( const TreeData_t field, Node_t *parent ) {
     Node_t *new_node = (Node_t *)calloc( 1, sizeof( *new_node ) );
     assert( new_node && "Memory allocation error" );
+    MemCount( MEM_NODES, sizeof( *new_node ) );
 
     new_node->value = field;
     new_node->parent = parent;
@@ -117,40 +220,208 @@ Node_t *NodeRightCreate( const TreeData_t value, Node_t *parent ) {
     return node;
 }
 
+Node_t *BlockCreate( Node_t *parent ) {
+    TreeData_t value = {};
+    value.type = NODE_BLOCK;
+    value.data.block.items = NULL;
+    value.data.block.count = 0;
+
+    return NodeCreate( value, parent );
+}
+
+static bool IsPowerOfTwo( size_t number ) { return number && !( number & ( number - 1 ) ); }
+
+void BlockAppend( Node_t *block, Node_t *child ) {
+    my_assert( block && block->value.type == NODE_BLOCK, "`block` is not a block node" );
+
+    NodeBlock *data = &block->value.data.block;
+
+    // Capacity is the next power of two: grow exactly when count reaches one
+    if ( data->count == 0 || ( data->count >= BLOCK_DEFAULT_CAPACITY && IsPowerOfTwo( data->count ) ) ) {
+        size_t new_capacity = data->count == 0 ? BLOCK_DEFAULT_CAPACITY : data->count * 2;
+        Node_t **new_items = (Node_t **)realloc( data->items, new_capacity * sizeof( *new_items ) );
+        assert( new_items && "Memory allocation error" );
+        MemCount( MEM_NODES, new_capacity * sizeof( *new_items ) );
+        data->items = new_items;
+    }
+
+    data->items[data->count++] = child;
+    if ( child )
+        child->parent = block;
+}
+
+static void BlockRemove( Node_t *block, Node_t *child ) {
+    NodeBlock *data = &block->value.data.block;
+
+    for ( size_t i = 0; i < data->count; i++ ) {
+        if ( data->items[i] == child ) {
+            memmove( data->items + i, data->items + i + 1, ( data->count - i - 1 ) * sizeof( *data->items ) );
+            data->count--;
+            return;
+        }
+    }
+}
+
+// Iterative on purpose: trees loaded from old `;`-chain files are deep enough to overflow the native stack
 void NodeDelete( Node_t *node, Tree_t *tree, void ( *clean_function )( TreeData_t value, Tree_t *tree ) ) {
     if ( !node ) {
         return;
     }
 
     if ( node->parent ) {
-        if ( node->parent->left == node )
+        if ( node->parent->value.type == NODE_BLOCK )
+            BlockRemove( node->parent, node );
+        else if ( node->parent->left == node )
             node->parent->left = NULL;
         else
             node->parent->right = NULL;
     }
 
-    if ( node->left )
-        NodeDelete( node->left, tree, clean_function );
+    Node_t **stack = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    Node_t *current = node;
+    while ( current ) {
+        size_t children = ( current->value.type == NODE_BLOCK ? current->value.data.block.count : 0 ) + 2;
+        if ( size + children > capacity ) {
+            while ( size + children > capacity )
+                capacity = capacity ? capacity * 2 : NODE_STACK_DEFAULT_CAPACITY;
+            Node_t **new_stack = (Node_t **)realloc( stack, capacity * sizeof( *new_stack ) );
+            assert( new_stack && "Memory allocation error" );
+            stack = new_stack;
+        }
 
-    if ( node->right )
-        NodeDelete( node->right, tree, clean_function );
+        if ( current->left )
+            stack[size++] = current->left;
+        if ( current->right )
+            stack[size++] = current->right;
+
+        if ( current->value.type == NODE_BLOCK ) {
+            for ( size_t i = 0; i < current->value.data.block.count; i++ )
+                stack[size++] = current->value.data.block.items[i];
+            free( current->value.data.block.items );
+        }
+
+        if ( clean_function )
+            clean_function( current->value, tree );
 
-    if ( clean_function )
-        clean_function( node->value, tree );
+        // Free variable strings
+        if ( current->value.type == NODE_VARIABLE && current->value.data.variable ) {
+            free( current->value.data.variable );
+        }
+
+        free( current );
 
-    // Free variable strings
-    if ( node->value.type == NODE_VARIABLE && node->value.data.variable ) {
-        free( node->value.data.variable );
+        current = size > 0 ? stack[--size] : NULL;
     }
 
-    free( node );
+    free( stack );
+}
+
+const uint64_t NODE_HASH_PRIME = 1099511628211ULL;
+const unsigned char NODE_HASH_NIL = 0xff;
+
+struct NodeHasher_t {
+    uint64_t hash;
+    Sha256_t *sha; // NULL without a digest
+};
+
+static void HashBytes( NodeHasher_t *hasher, const void *data, size_t size ) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for ( size_t i = 0; i < size; i++ ) {
+        hasher->hash ^= bytes[i];
+        hasher->hash *= NODE_HASH_PRIME;
+    }
+
+    if ( hasher->sha )
+        Sha256Update( hasher->sha, data, size );
+}
+
+// FNV-1a over a preorder walk that marks missing children. The walk encodes the shape,
+// operations, numbers and identifiers unambiguously, so equal SHA-256 digests of it mean
+// equal subtrees; equal 64-bit hashes alone may be a collision
+uint64_t NodeHash( const Node_t *node, uint64_t seed, size_t *nodes_count, uint8_t digest[SHA256_DIGEST_SIZE] ) {
+    const Node_t **stack = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    Sha256_t sha = {};
+    NodeHasher_t hasher = { seed, digest ? &sha : NULL };
+    if ( digest ) {
+        Sha256Init( &sha );
+        Sha256Update( &sha, &seed, sizeof( seed ) );
+    }
+    size_t count = 0;
+
+    const Node_t *current = node;
+    for ( ;; ) {
+        if ( !current ) {
+            HashBytes( &hasher, &NODE_HASH_NIL, sizeof( NODE_HASH_NIL ) );
+        } else {
+            count++;
+
+            unsigned char type = (unsigned char)current->value.type;
+            HashBytes( &hasher, &type, sizeof( type ) );
+
+            switch ( current->value.type ) {
+                case NODE_NUMBER:
+                    HashBytes( &hasher, &current->value.data.number, sizeof( current->value.data.number ) );
+                    break;
+                case NODE_VARIABLE:
+                    HashBytes( &hasher, current->value.data.variable, strlen( current->value.data.variable ) + 1 );
+                    break;
+                case NODE_OPERATION:
+                    HashBytes( &hasher, &current->value.data.operation, sizeof( current->value.data.operation ) );
+                    break;
+                case NODE_BLOCK:
+                    HashBytes( &hasher, &current->value.data.block.count, sizeof( current->value.data.block.count ) );
+                    break;
+                case NODE_UNKNOWN:
+                default:
+                    break;
+            }
+
+            size_t children = ( current->value.type == NODE_BLOCK ? current->value.data.block.count : 0 ) + 2;
+            if ( size + children > capacity ) {
+                while ( size + children > capacity )
+                    capacity = capacity ? capacity * 2 : NODE_STACK_DEFAULT_CAPACITY;
+                const Node_t **new_stack = (const Node_t **)realloc( stack, capacity * sizeof( *new_stack ) );
+                assert( new_stack && "Memory allocation error" );
+                stack = new_stack;
+            }
+
+            // Reversed, so that the walk visits left, right, then the block items in order
+            if ( current->value.type == NODE_BLOCK ) {
+                for ( size_t i = current->value.data.block.count; i > 0; i-- )
+                    stack[size++] = current->value.data.block.items[i - 1];
+            }
+            stack[size++] = current->right;
+            stack[size++] = current->left;
+        }
+
+        if ( !size )
+            break;
+        current = stack[--size];
+    }
+
+    free( stack );
+
+    if ( digest )
+        Sha256Final( &sha, digest );
+    if ( nodes_count )
+        *nodes_count = count;
+    return hasher.hash;
 }
 
 Node_t *NodeCopy( Node_t *node ) {
     if ( !node )
         return NULL;
 
-    Node_t *new_node = NodeCreate( node->value, NULL );
+    // Variable strings are owned by their node (see NodeDelete), so copy them too
+    Node_t *new_node = NodeCreate( node->value.type == NODE_VARIABLE ? MakeVariable( node->value.data.variable )
+                                                                     : node->value,
+                                   NULL );
     assert( new_node && "Memory allocation error" );
 
     new_node->parent = NULL;
@@ -163,6 +434,14 @@ Node_t *NodeCopy( Node_t *node ) {
     if ( new_node->right )
         new_node->right->parent = new_node;
 
+    if ( node->value.type == NODE_BLOCK ) {
+        new_node->value.data.block.items = NULL;
+        new_node->value.data.block.count = 0;
+
+        for ( size_t i = 0; i < node->value.data.block.count; i++ )
+            BlockAppend( new_node, NodeCopy( node->value.data.block.items[i] ) );
+    }
+
     return new_node;
 }
 
@@ -189,47 +468,128 @@ static uint32_t my_crc32_ptr( const void *ptr ) {
 
 #define DOT_PRINT( format, ... ) fprintf( dot_stream, format, ##__VA_ARGS__ );
 
-static void NodeDumpRecursively( const Node_t *node, FILE *dot_stream );
+// Nodes drawn in a dump, sorted by address; NULL draws the whole tree
+struct DotVisible_t {
+    const Node_t **nodes;
+    size_t count;
+};
+
+static void NodeDumpRecursively( const Node_t *node, const DotVisible_t *visible, FILE *dot_stream );
 static void NodeInitDot( const Node_t *node, FILE *dot_stream );
-static void NodeBondInitDot( const Node_t *node, FILE *dot_stream );
+static void NodeBondInitDot( const Node_t *node, const DotVisible_t *visible, FILE *dot_stream );
+
+static int ComparePointers( const void *first, const void *second ) {
+    uintptr_t a = (uintptr_t)*(const Node_t *const *)first;
+    uintptr_t b = (uintptr_t)*(const Node_t *const *)second;
+
+    return ( a > b ) - ( a < b );
+}
+
+static size_t NodeCount( const Node_t *node ) {
+    if ( !node )
+        return 0;
+
+    size_t count = 1;
+    if ( node->value.type == NODE_BLOCK ) {
+        for ( size_t i = 0; i < node->value.data.block.count; i++ )
+            count += NodeCount( node->value.data.block.items[i] );
+    } else {
+        count += NodeCount( node->left ) + NodeCount( node->right );
+    }
+
+    return count;
+}
+
+// The first `limit` nodes in breadth-first order: the top of the tree stays readable
+static bool SelectVisible( const Node_t *root, size_t limit, DotVisible_t *visible ) {
+    visible->nodes = (const Node_t **)calloc( limit, sizeof( *visible->nodes ) );
+    if ( !visible->nodes ) {
+        PRINT_ERROR( "Memory allocation error" );
+        return false;
+    }
+
+    visible->nodes[0] = root;
+    visible->count = 1;
+
+    for ( size_t head = 0; head < visible->count && visible->count < limit; head++ ) {
+        const Node_t *node = visible->nodes[head];
 
-void NodeGraphicDump( const Node_t *node, const char *image_path_name, ... ) {
-    if ( !node || !image_path_name ) {
+        if ( node->value.type == NODE_BLOCK ) {
+            for ( size_t i = 0; i < node->value.data.block.count && visible->count < limit; i++ ) {
+                if ( node->value.data.block.items[i] )
+                    visible->nodes[visible->count++] = node->value.data.block.items[i];
+            }
+            continue;
+        }
+
+        if ( node->left && visible->count < limit )
+            visible->nodes[visible->count++] = node->left;
+        if ( node->right && visible->count < limit )
+            visible->nodes[visible->count++] = node->right;
+    }
+
+    qsort( visible->nodes, visible->count, sizeof( *visible->nodes ), ComparePointers );
+    return true;
+}
+
+static bool IsVisible( const Node_t *node, const DotVisible_t *visible ) {
+    return bsearch( &node, visible->nodes, visible->count, sizeof( *visible->nodes ), ComparePointers );
+}
+
+static void NodeCollapsedDot( const Node_t *node, size_t hidden, FILE *dot_stream ) {
+    DOT_PRINT( "\tnode_%lX [shape=box, style=\"filled,dashed\", fillcolor=\"#%X\", label=\"+%zu nodes\"]; \n",
+               (uintptr_t)node, fill_color, hidden );
+}
+
+void NodeGraphicDump( const Node_t *node, size_t node_limit, const char *dot_path_name, ... ) {
+    if ( !node || !dot_path_name ) {
         PRINT_ERROR( "Null pointer on `node` %s:%d \n", __FILE__, __LINE__ );
         return;
     }
 
     char dot_path[MAX_LEN_PATH] = {};
-    char svg_path[MAX_LEN_PATH + 5] = {};
 
     va_list args;
-    va_start( args, image_path_name );
-    vsnprintf( dot_path, MAX_LEN_PATH, image_path_name, args );
+    va_start( args, dot_path_name );
+    vsnprintf( dot_path, MAX_LEN_PATH, dot_path_name, args );
     va_end( args );
 
-    snprintf( svg_path, MAX_LEN_PATH + 5, "%s.svg", dot_path );
+    DotVisible_t limited = {};
+    const DotVisible_t *visible = NULL;
+    if ( node_limit && NodeCount( node ) > node_limit ) {
+        if ( !SelectVisible( node, node_limit, &limited ) )
+            return;
+        visible = &limited;
+    }
 
     FILE *dot_stream = fopen( dot_path, "w" );
-    assert( dot_stream && "File opening error" );
+    if ( !dot_stream ) {
+        PRINT_ERROR( "Fail to open file `%s`", dot_path );
+        free( limited.nodes );
+        return;
+    }
 
     fprintf( dot_stream, "digraph {\n\tsplines=line;\n" );
-    NodeDumpRecursively( node, dot_stream );
+    NodeDumpRecursively( node, visible, dot_stream );
     fprintf( dot_stream, "}\n" );
 
     fclose( dot_stream );
-
-    char cmd[MAX_LEN_PATH * 3] = {};
-    snprintf( cmd, sizeof( cmd ), "dot -Tsvg %s -o %s", dot_path, svg_path );
-    system( cmd );
+    free( limited.nodes );
 }
 
-static void NodeDumpRecursively( const Node_t *node, FILE *dot_stream ) {
+static void NodeDumpRecursively( const Node_t *node, const DotVisible_t *visible, FILE *dot_stream ) {
     if ( node == NULL ) {
         return;
     }
 
+    // A cut subtree keeps the id of its root, so the edge to it needs no changes
+    if ( visible && !IsVisible( node, visible ) ) {
+        NodeCollapsedDot( node, NodeCount( node ), dot_stream );
+        return;
+    }
+
     NodeInitDot( node, dot_stream );
-    NodeBondInitDot( node, dot_stream );
+    NodeBondInitDot( node, visible, dot_stream );
 }
 
 static void NodeInitDot( const Node_t *node, FILE *dot_stream ) {
@@ -244,8 +604,10 @@ static void NodeInitDot( const Node_t *node, FILE *dot_stream ) {
             break;
         case NODE_OPERATION:
             DOT_PRINT( "fillcolor=\"#F5B041\", label=\"%s\"]; \n",
-                       node->value.data.operation >= 0 ? operations_txt[node->value.data.operation]
-                                                       : "NOPE" );
+                       OperationName( node->value.data.operation ) );
+            break;
+        case NODE_BLOCK:
+            DOT_PRINT( "fillcolor=\"#BB8FCE\", label=\"{ %zu }\"]; \n", node->value.data.block.count );
             break;
 
         case NODE_UNKNOWN:
@@ -288,10 +650,14 @@ static void NodeInitDot( const Node_t *node, FILE *dot_stream ) {
             DOT_PRINT( "\t\t\t<TD PORT=\"type\">type=OPERATION</TD> \n" );
             DOT_PRINT( "\t\t</TR> \n\t\t<TR> \n" );
             DOT_PRINT( "\t\t\t<TD PORT=\"value\">value=%s</TD> \n",
-                       node->value.data.operation >= 0 ? operations_txt[node->value.data.operation]
-                                                       : "NOPE" );
+                       OperationName( node->value.data.operation ) );
             break;
         }
+        case NODE_BLOCK:
+            DOT_PRINT( "\t\t\t<TD PORT=\"type\">type=BLOCK</TD> \n" );
+            DOT_PRINT( "\t\t</TR> \n\t\t<TR> \n" );
+            DOT_PRINT( "\t\t\t<TD PORT=\"value\">count=%zu</TD> \n", node->value.data.block.count );
+            break;
         case NODE_UNKNOWN:
         default:
             DOT_PRINT( "<TD PORT=\"type\" BGCOLOR=\"#FF0000\">type=UNKOWN</TD> \n" );
@@ -326,37 +692,71 @@ static void NodeInitDot( const Node_t *node, FILE *dot_stream ) {
 #endif
 }
 
-static void NodeBondInitDot( const Node_t *node, FILE *dot_stream ) {
+static void NodeBondInitDot( const Node_t *node, const DotVisible_t *visible, FILE *dot_stream ) {
+    if ( node->value.type == NODE_BLOCK ) {
+        Node_t **items = node->value.data.block.items;
+        size_t count = node->value.data.block.count;
+
+        for ( size_t i = 0; i < count; i++ ) {
+            // Items are selected in order, the cut ones are a tail and share one box
+            if ( visible && items[i] && !IsVisible( items[i], visible ) ) {
+                size_t hidden = 0;
+                for ( size_t j = i; j < count; j++ )
+                    hidden += NodeCount( items[j] );
+
+                DOT_PRINT( "\tnode_%lX -> node_%lX [label=\"%zu..%zu\"];\n", (uintptr_t)node, (uintptr_t)items[i], i,
+                           count - 1 );
+                NodeCollapsedDot( items[i], hidden, dot_stream );
+                return;
+            }
+
+            DOT_PRINT( "\tnode_%lX -> node_%lX [label=\"%zu\"];\n", (uintptr_t)node, (uintptr_t)items[i], i );
+            NodeDumpRecursively( items[i], visible, dot_stream );
+        }
+        return;
+    }
+
 #ifdef _SIMPLIFIED_DUMP
     if ( node->left ) {
         DOT_PRINT( "\tnode_%lX -> node_%lX;\n", (uintptr_t)node, (uintptr_t)node->left );
-        NodeDumpRecursively( node->left, dot_stream );
+        NodeDumpRecursively( node->left, visible, dot_stream );
     }
     if ( node->right ) {
         DOT_PRINT( "\tnode_%lX -> node_%lX;\n", (uintptr_t)node, (uintptr_t)node->right );
-        NodeDumpRecursively( node->right, dot_stream );
+        NodeDumpRecursively( node->right, visible, dot_stream );
     }
 #else
     if ( node->left ) {
         DOT_PRINT( "\tnode_%lX:left:s->node_%lX\n", (uintptr_t)node, (uintptr_t)node->left );
-        NodeDumpRecursively( node->left, dot_stream );
+        NodeDumpRecursively( node->left, visible, dot_stream );
     }
 
     if ( node->right ) {
         DOT_PRINT( "\tnode_%lX:right:s->node_%lX\n", (uintptr_t)node, (uintptr_t)node->right );
-        NodeDumpRecursively( node->right, dot_stream );
+        NodeDumpRecursively( node->right, visible, dot_stream );
     }
 #endif
 }
 
 #undef DOT_PRINT
 
-static void NodeSaveRecursively( const Node_t *node, FILE *file_stream ) {
+static void NodeSaveRecursively( const Node_t *node, FILE *file_stream, size_t *nodes_count ) {
     if ( node == NULL ) {
         fprintf( file_stream, "nil" );
         return;
     }
 
+    ( *nodes_count )++;
+
+    // Blocks are written as `[ child child ... ]`: no operation name and no nil padding
+    if ( node->value.type == NODE_BLOCK ) {
+        fprintf( file_stream, "[ " );
+        for ( size_t i = 0; i < node->value.data.block.count; i++ )
+            NodeSaveRecursively( node->value.data.block.items[i], file_stream, nodes_count );
+        fprintf( file_stream, "] " );
+        return;
+    }
+
     fprintf( file_stream, "( " );
 
     switch ( node->value.type ) {
@@ -367,7 +767,7 @@ static void NodeSaveRecursively( const Node_t *node, FILE *file_stream ) {
             fprintf( file_stream, "\"%s\" ", node->value.data.variable );
             break;
         case NODE_OPERATION:
-            fprintf( file_stream, "%s ", operations_txt[node->value.data.operation] );
+            fprintf( file_stream, "%s ", OperationName( node->value.data.operation ) );
             break;
         case NODE_UNKNOWN:
         default:
@@ -376,118 +776,241 @@ static void NodeSaveRecursively( const Node_t *node, FILE *file_stream ) {
     }
 
     if ( node->left )
-        NodeSaveRecursively( node->left, file_stream );
+        NodeSaveRecursively( node->left, file_stream, nodes_count );
     else
         fprintf( file_stream, "nil " );
 
     if ( node->right )
-        NodeSaveRecursively( node->right, file_stream );
+        NodeSaveRecursively( node->right, file_stream, nodes_count );
     else
         fprintf( file_stream, "nil " );
     fprintf( file_stream, ") " );
 }
 
+// Every save is one call of the `ast save` phase; a pipe has no position and counts no bytes
+static void NodeSaveTimed( const Node_t *node, FILE *stream ) {
+    TimeScope_t scope = TimePhaseBegin();
+    long start = scope.start ? ftell( stream ) : -1;
+    size_t nodes_count = 0;
+
+    NodeSaveRecursively( node, stream, &nodes_count );
+
+    long end = start >= 0 ? ftell( stream ) : -1;
+    TimePhaseEnd( &scope, PHASE_AST_SAVE, { end > start ? (uint64_t)( end - start ) : 0, 0, nodes_count } );
+}
+
+void NodeSaveToStream( const Node_t *node, FILE *stream ) {
+    my_assert( stream, "Null pointer on `stream`" );
+
+    NodeSaveTimed( node, stream );
+}
+
 void TreeSaveToFile( const Tree_t *tree, const char *filename ) {
     if ( !tree || !filename ) {
         PRINT_ERROR( "Null pointer on `tree` or `filename`" );
         return;
     }
 
-    FILE *file_stream = fopen( filename, "w" );
+    TRACE_FUNCTION();
+
+    FILE *file_stream = OpenFile( filename, "w" );
     if ( !file_stream ) {
         PRINT_ERROR( "Fail to open file `%s`", filename );
         return;
     }
 
-    NodeSaveRecursively( tree->root, file_stream );
+    NodeSaveTimed( tree->root, file_stream );
 
-    fclose( file_stream );
+    CloseFile( file_stream );
 }
 
-static void SkipSpaces( const char **pos ) {
-    while ( **pos && isspace( (unsigned char)**pos ) ) {
+static void SkipSpaces( const char **pos, const char *end ) {
+    while ( *pos < end && isspace( (unsigned char)**pos ) ) {
         ( *pos )++;
     }
 }
 
-#define CMP_OP( arg1, enum_name, arg3, arg4, string )                                                        \
-    if ( !strncmp( buffer, string, strlen( string ) ) ) {                                                    \
-        value = MakeOperation( enum_name );                                                                  \
-    }
+// Tokens are read only up to `end`: sscanf on the remaining text measures it on every
+// call, which makes loading a long function quadratic
+static bool ReadName( const char **pos, const char *end, TreeData_t *value ) {
+    const char *name = *pos + 1;
+    const char *name_end = (const char *)memchr( name, '"', (size_t)( end - name ) );
+    if ( !name_end || name_end == name || (size_t)( name_end - name ) > TREE_NAME_MAX_LENGTH )
+        return false;
+
+    char buffer[TREE_NAME_MAX_LENGTH + 1] = {};
+    memcpy( buffer, name, (size_t)( name_end - name ) );
+    *value = MakeVariable( buffer );
+
+    *pos = name_end + 1;
+    return true;
+}
+
+static bool ReadNumber( const char **pos, const char *end, TreeData_t *value ) {
+    char *number_end = NULL;
+    long number = strtol( *pos, &number_end, 10 );
+    if ( number_end == *pos || number_end > end || number < INT_MIN || number > INT_MAX )
+        return false;
 
-static Node_t *NodeLoadRecursively( const char **pos, char *error_buffer, size_t error_size ) {
+    *value = MakeNumber( (int)number );
+
+    *pos = number_end;
+    return true;
+}
+
+// Context for error messages, which must not run past the subtree being loaded
+static int NearLength( const char *pos, const char *end ) {
+    const ptrdiff_t NEAR_LENGTH = 20;
+    return (int)( end - pos < NEAR_LENGTH ? end - pos : NEAR_LENGTH );
+}
+
+static size_t WordLength( const char *pos, const char *end ) {
+    const char *word_end = pos;
+    while ( word_end < end && !isspace( (unsigned char)*word_end ) )
+        word_end++;
+
+    return (size_t)( word_end - pos );
+}
+
+static Node_t *NodeLoadRecursively( const char **pos, const char *end, size_t *nodes_count, char *error_buffer,
+                                    size_t error_size ) {
     my_assert( pos && *pos, "Null pointer on `pos`" );
 
-    SkipSpaces( pos );
+    SkipSpaces( pos, end );
 
-    if ( **pos == '(' ) {
+    if ( *pos < end && **pos == '(' ) {
         ( *pos )++;
-        SkipSpaces( pos );
+        SkipSpaces( pos, end );
 
         TreeData_t value = {};
+        size_t word_length = WordLength( *pos, end );
 
-        char buffer[128] = {};
-        int buffer_number = 0;
-        int read_bytes = 0;
-
-        // Fixed: read string until closing quote instead of until space
-        if ( sscanf( *pos, "\"%127[^\"]\"%n", buffer, &read_bytes ) == 1 ) {
-            value = MakeVariable( buffer );
-        } else if ( sscanf( *pos, "%d%n", &buffer_number, &read_bytes ) == 1 ) {
-            value = MakeNumber( buffer_number );
-        } else if ( sscanf( *pos, "%127s%n", buffer, &read_bytes ) == 1 ) {
-            INIT_OPERATIONS( CMP_OP );
-            if ( value.type != NODE_OPERATION ) {
+        if ( *pos < end && **pos == '"' ) {
+            if ( !ReadName( pos, end, &value ) ) {
                 SetError( error_buffer, error_size,
-                          "Unknown operation '%s' near: '%.20s'", buffer, *pos );
-                PRINT_ERROR( "Unknown operation '%s'", buffer );
+                          "Bad variable name near: '%.*s'", NearLength( *pos, end ), *pos );
+                PRINT_ERROR( "Bad variable name in tree.txt" );
                 return NULL;
             }
-        } else {
+        } else if ( !word_length ) {
             SetError( error_buffer, error_size,
-                      "Unexpected token near: '%.20s'", *pos );
+                      "Unexpected token near: '%.*s'", NearLength( *pos, end ), *pos );
             PRINT_ERROR( "Unexpected token in tree.txt" );
             return NULL;
+        } else if ( !ReadNumber( pos, end, &value ) ) {
+            OperationType op = FindOperation( *pos, word_length );
+            if ( op != OP_NOPE ) {
+                value = MakeOperation( op );
+                ( *pos ) += word_length;
+            } else {
+                SetError( error_buffer, error_size,
+                          "Unknown operation '%.*s' near: '%.*s'", (int)word_length, *pos,
+                          NearLength( *pos, end ), *pos );
+                PRINT_ERROR( "Unknown operation '%.*s'", (int)word_length, *pos );
+                return NULL;
+            }
         }
 
-        ( *pos ) += read_bytes;
-
         Node_t *node = NodeCreate( value, NULL );
+        ( *nodes_count )++;
 
-        node->left = NodeLoadRecursively( pos, error_buffer, error_size );
+        node->left = NodeLoadRecursively( pos, end, nodes_count, error_buffer, error_size );
         if ( node->left )
             node->left->parent = node;
 
-        node->right = NodeLoadRecursively( pos, error_buffer, error_size );
+        node->right = NodeLoadRecursively( pos, end, nodes_count, error_buffer, error_size );
         if ( node->right )
             node->right->parent = node;
 
-        SkipSpaces( pos );
+        SkipSpaces( pos, end );
 
-        if ( **pos == ')' )
+        if ( *pos < end && **pos == ')' )
             ( *pos )++;
         else {
             SetError( error_buffer, error_size,
-                      "Expected ')' near: '%.20s'", *pos );
+                      "Expected ')' near: '%.*s'", NearLength( *pos, end ), *pos );
             PRINT_ERROR( "Expected ')' in tree.txt" );
+            NodeDelete( node, NULL, NULL );
             return NULL;
         }
 
         return node;
     }
 
-    if ( !strncmp( *pos, "nil", 3 ) ) {
+    if ( *pos < end && **pos == '[' ) {
+        ( *pos )++;
+
+        Node_t *block = BlockCreate( NULL );
+        ( *nodes_count )++;
+
+        SkipSpaces( pos, end );
+        while ( *pos < end && **pos != ']' ) {
+            if ( **pos != '(' && **pos != '[' ) {
+                SetError( error_buffer, error_size, "Expected '(' or '[' in block near: '%.*s'",
+                          NearLength( *pos, end ), *pos );
+                PRINT_ERROR( "Expected '(' or '[' in block in tree.txt" );
+                NodeDelete( block, NULL, NULL );
+                return NULL;
+            }
+
+            Node_t *child = NodeLoadRecursively( pos, end, nodes_count, error_buffer, error_size );
+            if ( !child ) {
+                NodeDelete( block, NULL, NULL );
+                return NULL;
+            }
+
+            BlockAppend( block, child );
+            SkipSpaces( pos, end );
+        }
+
+        if ( *pos == end ) {
+            SetError( error_buffer, error_size, "Expected ']' near: '%.*s'", NearLength( *pos, end ),
+                      *pos );
+            PRINT_ERROR( "Expected ']' in tree.txt" );
+            NodeDelete( block, NULL, NULL );
+            return NULL;
+        }
+        ( *pos )++;
+
+        return block;
+    }
+
+    if ( end - *pos >= 3 && !memcmp( *pos, "nil", 3 ) ) {
         ( *pos ) += 3;
         return NULL;
     }
 
     SetError( error_buffer, error_size,
-              "Expected '(' or 'nil' near: '%.20s'", *pos );
+              "Expected '(', '[' or 'nil' near: '%.*s'", NearLength( *pos, end ), *pos );
     PRINT_ERROR( "Error in tree.txt" );
     return NULL;
 }
 
+// Every load from text is one call of the `ast load` phase
+static Node_t *NodeLoadTimed( const char **pos, const char *end, char *error_buffer, size_t error_size ) {
+    TimeScope_t scope = TimePhaseBegin();
+    const char *start = *pos;
+    size_t nodes_count = 0;
+
+    Node_t *node = NodeLoadRecursively( pos, end, &nodes_count, error_buffer, error_size );
+
+    TimePhaseEnd( &scope, PHASE_AST_LOAD, { (uint64_t)( *pos - start ), 0, nodes_count } );
+    return node;
+}
+
+Node_t *NodeLoadFromString( const char *text, char *error_buffer, size_t error_size ) {
+    my_assert( text, "Null pointer on `text`" );
+
+    if ( error_buffer && error_size > 0 )
+        error_buffer[0] = '\0';
+
+    const char *pos = text;
+    return NodeLoadTimed( &pos, text + strlen( text ), error_buffer, error_size );
+}
+
 Tree_t *TreeLoadFromFile( const char *filename, char *error_buffer, size_t error_size ) {
+    TRACE_FUNCTION();
+
     if ( error_buffer && error_size > 0 )
         error_buffer[0] = '\0';
 
@@ -513,7 +1036,7 @@ Tree_t *TreeLoadFromFile( const char *filename, char *error_buffer, size_t error
     }
 
     const char *pos = buffer;
-    tree->root = NodeLoadRecursively( &pos, error_buffer, error_size );
+    tree->root = NodeLoadTimed( &pos, buffer + strlen( buffer ), error_buffer, error_size );
 
     free( buffer );
 
@@ -525,6 +1048,227 @@ Tree_t *TreeLoadFromFile( const char *filename, char *error_buffer, size_t error
         return NULL;
     }
 
-    PRINT( "Successfully loaded tree from file `%s`", filename );
+    LOG_DEBUG( LOG_TREE, "Successfully loaded tree from file `%s`", filename );
     return tree;
 }
+
+// ===== Streaming loading =====
+// The file is read in blocks. Brackets are counted outside quoted names, and every child of
+// the top-level `[ ... ]` is loaded up to its closing bracket as soon as that bracket arrives
+// and handed over, so memory holds one subtree and one read block instead of the whole tree.
+
+const size_t TREE_STREAM_READ_SIZE = 1 << 16;
+const size_t NO_SUBTREE = SIZE_MAX;
+
+struct TreeStream_t {
+    FILE *file;
+    char *buffer;
+    size_t size;
+    size_t capacity;
+    bool eof;
+};
+
+struct TreeScan_t {
+    size_t pos;
+    size_t depth;         // 1 inside the top-level block
+    size_t subtree_begin; // NO_SUBTREE between children
+    bool in_quotes;
+    bool finished;        // the top-level `]` was read
+};
+
+static bool TreeStreamFill( TreeStream_t *stream ) {
+    if ( stream->capacity < stream->size + TREE_STREAM_READ_SIZE + 1 ) {
+        size_t new_capacity = stream->capacity ? stream->capacity : TREE_STREAM_READ_SIZE + 1;
+        while ( new_capacity < stream->size + TREE_STREAM_READ_SIZE + 1 )
+            new_capacity *= 2;
+
+        char *new_buffer = (char *)realloc( stream->buffer, new_capacity );
+        if ( !new_buffer )
+            return false;
+        MemCount( MEM_IO_BUFFERS, new_capacity );
+
+        stream->buffer = new_buffer;
+        stream->capacity = new_capacity;
+    }
+
+    TimeScope_t scope = TimePhaseBegin();
+    size_t read = fread( stream->buffer + stream->size, 1, TREE_STREAM_READ_SIZE, stream->file );
+    TimePhaseEnd( &scope, PHASE_READ, { read, 0, 0 } );
+    stream->size += read;
+    stream->buffer[stream->size] = '\0';
+    stream->eof = read < TREE_STREAM_READ_SIZE;
+
+    return !ferror( stream->file );
+}
+
+static bool TreeStreamSubtree( TreeStream_t *stream, TreeScan_t *scan, TreeSubtreeHandler_t handler,
+                               void *context, char *error_buffer, size_t error_size ) {
+    const char *end = stream->buffer + scan->pos + 1;
+    const char *pos = stream->buffer + scan->subtree_begin;
+    Node_t *subtree = NodeLoadTimed( &pos, end, error_buffer, error_size );
+
+    scan->subtree_begin = NO_SUBTREE;
+
+    if ( !subtree )
+        return false;
+
+    if ( pos != end ) {
+        SetError( error_buffer, error_size, "Unexpected token near: '%.20s'", pos );
+        PRINT_ERROR( "Unexpected token in tree.txt" );
+        NodeDelete( subtree, NULL, NULL );
+        return false;
+    }
+
+    return handler( subtree, context );
+}
+
+static bool TreeStreamScan( TreeStream_t *stream, TreeScan_t *scan, TreeSubtreeHandler_t handler,
+                            void *context, char *error_buffer, size_t error_size ) {
+    for ( ; scan->pos < stream->size && !scan->finished; scan->pos++ ) {
+        char symbol = stream->buffer[scan->pos];
+
+        if ( scan->in_quotes ) {
+            scan->in_quotes = symbol != '"';
+            continue;
+        }
+
+        if ( scan->depth == 1 && symbol != '(' && symbol != '[' && symbol != ']' &&
+             !isspace( (unsigned char)symbol ) ) {
+            SetError( error_buffer, error_size, "Expected '(' or '[' in block near: '%.20s'",
+                      stream->buffer + scan->pos );
+            PRINT_ERROR( "Expected '(' or '[' in block in tree.txt" );
+            return false;
+        }
+
+        switch ( symbol ) {
+            case '"':
+                scan->in_quotes = true;
+                break;
+            case '(':
+            case '[':
+                if ( scan->depth++ == 1 )
+                    scan->subtree_begin = scan->pos;
+                break;
+            case ')':
+            case ']':
+                if ( --scan->depth == 1 ) {
+                    if ( !TreeStreamSubtree( stream, scan, handler, context, error_buffer, error_size ) )
+                        return false;
+                } else if ( scan->depth == 0 ) {
+                    scan->finished = true;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return true;
+}
+
+// Anything but a top-level block, e.g. a `;` chain of the old format, is read to the end
+// and loaded whole: the input may be a pipe that cannot be reopened
+static bool TreeStreamWhole( TreeStream_t *stream, TreeSubtreeHandler_t handler, void *context,
+                             char *error_buffer, size_t error_size ) {
+    while ( !stream->eof ) {
+        if ( !TreeStreamFill( stream ) ) {
+            SetError( error_buffer, error_size, "Failed to read input" );
+            return false;
+        }
+    }
+
+    const char *pos = stream->buffer;
+    Node_t *root = NodeLoadTimed( &pos, stream->buffer + stream->size, error_buffer, error_size );
+    if ( !root ) {
+        PRINT_ERROR( "Failed to parse tree from file" );
+        if ( !error_buffer || error_buffer[0] == '\0' )
+            SetError( error_buffer, error_size, "Failed to parse tree from file" );
+        return false;
+    }
+
+    return handler( root, context );
+}
+
+bool TreeLoadStreaming( const char *filename, TreeSubtreeHandler_t handler, void *context,
+                        char *error_buffer, size_t error_size ) {
+    TRACE_FUNCTION();
+
+    if ( error_buffer && error_size > 0 )
+        error_buffer[0] = '\0';
+
+    if ( !filename || !handler ) {
+        PRINT_ERROR( "Null pointer on `filename` or `handler`" );
+        SetError( error_buffer, error_size, "Null filename" );
+        return false;
+    }
+
+    TreeStream_t stream = {};
+    stream.file = OpenFile( filename, "r" );
+    if ( !stream.file ) {
+        PRINT_ERROR( "Failed to read file `%s`", filename );
+        SetError( error_buffer, error_size, "Failed to read file '%s'", filename );
+        return false;
+    }
+
+    TreeScan_t scan = {};
+    scan.subtree_begin = NO_SUBTREE;
+
+    bool loaded = true;
+    bool whole = false;
+    while ( loaded ) {
+        if ( !TreeStreamFill( &stream ) ) {
+            SetError( error_buffer, error_size, "Failed to read file '%s'", filename );
+            loaded = false;
+            break;
+        }
+
+        if ( scan.depth == 0 && !scan.finished ) {
+            const char *first = stream.buffer + scan.pos;
+            SkipSpaces( &first, stream.buffer + stream.size );
+            scan.pos = (size_t)( first - stream.buffer );
+
+            if ( *first && *first != '[' ) {
+                loaded = TreeStreamWhole( &stream, handler, context, error_buffer, error_size );
+                whole = true;
+                break;
+            }
+            if ( *first ) {
+                scan.depth = 1;
+                scan.pos++;
+            }
+        }
+
+        if ( scan.depth > 0 )
+            loaded = TreeStreamScan( &stream, &scan, handler, context, error_buffer, error_size );
+
+        if ( stream.eof || scan.finished )
+            break;
+
+        // Handed over subtrees are not needed any more
+        size_t keep = scan.subtree_begin != NO_SUBTREE ? scan.subtree_begin : scan.pos;
+        memmove( stream.buffer, stream.buffer + keep, stream.size - keep );
+        stream.size -= keep;
+        scan.pos -= keep;
+        if ( scan.subtree_begin != NO_SUBTREE )
+            scan.subtree_begin = 0;
+    }
+
+    CloseFile( stream.file );
+
+    if ( loaded && !whole && !scan.finished ) {
+        if ( stream.size ) {
+            SetError( error_buffer, error_size, "Expected ']' near end of file" );
+            PRINT_ERROR( "Expected ']' in tree.txt" );
+        } else {
+            SetError( error_buffer, error_size, "The file '%s' is empty", filename );
+        }
+        loaded = false;
+    }
+
+    free( stream.buffer );
+
+    if ( loaded ) {
+        LOG_DEBUG( LOG_TREE, "Successfully streamed tree from file `%s`", filename );
+    }
+    return loaded;
+}
@@ -1,8 +1,11 @@
 #include <errno.h>
+#include <string.h>
 #include <assert.h>
 
 #include "UtilsRW.h"
 #include "DebugUtils.h"
+#include "MemReport.h"
+#include "TimeReport.h"
 
 int MakeDirectory( const char* path ) {    
     if ( mkdir( path, 0700 ) == -1 ) {
@@ -12,7 +15,7 @@ int MakeDirectory( const char* path ) {
         }
     }
 
-    PRINT( "Directory `%s` was created.", path );
+    LOG_DEBUG( LOG_IO, "Directory `%s` was created.", path );
     return 0;
 }
 
@@ -20,29 +23,89 @@ off_t DetermineTheFileSize( const char* filename ) {
     my_assert( filename, "Null pointer on `filename`" );
 
     struct stat file_stat;
-    int check_stat = stat( filename, &file_stat );
-    assert( check_stat == 0 );
+    if ( stat( filename, &file_stat ) != 0 )
+        return -1;
 
     return file_stat.st_size;
 }
 
 
-char* ReadToBuffer( const char* filename ) {
+bool IsStdStream( const char* filename ) {
+    return filename && !strcmp( filename, STD_STREAM_NAME );
+}
+
+FILE* OpenFile( const char* filename, const char* mode ) {
     my_assert( filename, "Null pointer on `filename`" );
+    my_assert( mode, "Null pointer on `mode`" );
+
+    if ( IsStdStream( filename ) )
+        return mode[0] == 'r' ? stdin : stdout;
+
+    return fopen( filename, mode );
+}
+
+int CloseFile( FILE* file ) {
+    if ( file == stdin )
+        return 0;
+    if ( file == stdout )
+        return fflush( file );
+
+    return fclose( file );
+}
+
+const size_t READ_CHUNK_SIZE = 1 << 16;
+
+// A pipe has no size to `stat`: read until EOF, doubling the buffer
+static char* ReadStreamToBuffer( FILE* stream ) {
+    size_t size = 0;
+    size_t capacity = READ_CHUNK_SIZE + 1;
+
+    char* buffer = ( char* ) calloc( capacity, sizeof( *buffer ) );
+    assert( buffer && "Memory allocation error for `buffer`" );
+    MemCount( MEM_IO_BUFFERS, capacity );
+
+    size_t read = 0;
+    while ( ( read = fread( buffer + size, sizeof( char ), capacity - size - 1, stream ) ) > 0 ) {
+        size += read;
+        if ( size + 1 < capacity )
+            continue;
 
+        capacity *= 2;
+        char* new_buffer = ( char* ) realloc( buffer, capacity );
+        assert( new_buffer && "Memory allocation error for `buffer`" );
+        MemCount( MEM_IO_BUFFERS, capacity );
+        buffer = new_buffer;
+    }
+    buffer[size] = '\0';
+
+    if ( !size )
+        PRINT_ERROR( "The input is empty!" );
+
+    return buffer;
+}
+
+static char* ReadFileToBuffer( const char* filename ) {
+    // A missing file is the caller's error to report, not a reason to abort: the batch
+    // driver compiles many files in one process
     off_t file_size = DetermineTheFileSize( filename );
+    if ( file_size < 0 )
+        return NULL;
     if ( file_size == 0 ) {
         PRINT_ERROR( "The file `%s` is empty!", filename );
     }
 
     char* buffer = ( char* ) calloc ( ( size_t ) ( file_size + 1 ), sizeof( *buffer ) );
     assert( buffer && "Memory allocation error for `buffer`" );
+    MemCount( MEM_IO_BUFFERS, ( size_t ) ( file_size + 1 ) );
 
     FILE* file = fopen( filename, "r" );
-    assert( file && "Error opening file" );
+    if ( !file ) {
+        free( buffer );
+        return NULL;
+    }
 
     size_t result_of_read = fread( buffer, sizeof( char ), ( size_t ) file_size, file );
-    assert( result_of_read != 0 && "Fail read to buffer" );
+    assert( ( result_of_read != 0 || file_size == 0 ) && "Fail read to buffer" );
 
     int result_of_fclose = fclose( file );
     if ( result_of_fclose ) {
@@ -52,3 +115,13 @@ char* ReadToBuffer( const char* filename ) {
     return buffer;
 }
 
+char* ReadToBuffer( const char* filename ) {
+    my_assert( filename, "Null pointer on `filename`" );
+
+    TimeScope_t scope = TimePhaseBegin();
+    char* buffer = IsStdStream( filename ) ? ReadStreamToBuffer( stdin ) : ReadFileToBuffer( filename );
+    TimePhaseEnd( &scope, PHASE_READ, { buffer && scope.start ? strlen( buffer ) : 0, 0, 0 } );
+
+    return buffer;
+}
+
@@ -0,0 +1,4 @@
+#!/bin/sh
+
+g++ ./bench/CodegenStress.cpp ./src/backend/CodeGen.cpp ./src/backend/FuncCache.cpp ./src/backend/Optimizer.cpp ./src/backend/RegAlloc.cpp ./libs/Tree.cpp ./libs/TimeReport.cpp ./libs/Trace.cpp ./libs/MemReport.cpp ./libs/Log.cpp ./libs/UtilsRW.cpp ./libs/BuildCache.cpp ./libs/CacheTable.cpp ./libs/Sha256.cpp -o codegen-stress -pthread -I./include -std=c++17 -Wall -Wextra -O2 -g
+g++ ./bench/LangBench.cpp ./src/frontend/Parser.cpp ./src/frontend/LexicalAnalyzer.cpp ./src/frontend/SyntaxAnalyzer.cpp ./src/frontend/UtilsForParser.cpp ./src/frontend/TokenArray.cpp ./src/frontend/Incremental.cpp ./src/frontend/AstCache.cpp ./src/backend/CodeGen.cpp ./src/backend/FuncCache.cpp ./src/backend/Optimizer.cpp ./src/backend/RegAlloc.cpp ./libs/Tree.cpp ./libs/TimeReport.cpp ./libs/Trace.cpp ./libs/MemReport.cpp ./libs/Log.cpp ./libs/GraphDump.cpp ./libs/UtilsRW.cpp ./libs/BuildCache.cpp ./libs/CacheTable.cpp ./libs/Sha256.cpp ./libs/ThreadPool.cpp -o lang-bench -pthread -I./include -std=c++17 -Wall -Wextra -O2 -g
@@ -0,0 +1,4 @@
+#!/bin/sh
+
+g++ ./tests/CodegenTests.cpp ./src/frontend/Parser.cpp ./src/frontend/LexicalAnalyzer.cpp ./src/frontend/SyntaxAnalyzer.cpp ./src/frontend/UtilsForParser.cpp ./src/frontend/TokenArray.cpp ./src/frontend/Incremental.cpp ./src/frontend/AstCache.cpp ./src/backend/CodeGen.cpp ./src/backend/FuncCache.cpp ./src/backend/Optimizer.cpp ./src/backend/RegAlloc.cpp ./libs/Tree.cpp ./libs/TimeReport.cpp ./libs/Trace.cpp ./libs/MemReport.cpp ./libs/Log.cpp ./libs/GraphDump.cpp ./libs/UtilsRW.cpp ./libs/BuildCache.cpp ./libs/CacheTable.cpp ./libs/Sha256.cpp ./libs/ThreadPool.cpp -o codegen-tests -pthread -I./include -std=c++17 -Wall -Wextra -Weffc++ -Waggressive-loop-optimizations -Wc++14-compat -Wmissing-declarations -Wcast-align -Wcast-qual -Wchar-subscripts -Wconditionally-supported -Wconversion -Wctor-dtor-privacy -Wempty-body -Wfloat-equal -Wformat-nonliteral -Wformat-security -Wformat-signedness -Wformat=2 -Winline -Wlogical-op -Wnon-virtual-dtor -Wopenmp-simd -Woverloaded-virtual -Wpacked -Wpointer-arith -Winit-self -Wredundant-decls -Wshadow -Wsign-conversion -Wsign-promo -Wstrict-null-sentinel -Wstrict-overflow=2 -Wsuggest-attribute=noreturn -Wsuggest-final-methods -Wsuggest-final-types -Wsuggest-override -Wswitch-default -Wsync-nand -Wundef -Wunreachable-code -Wunused -Wuseless-cast -Wvariadic-macros -Wno-literal-suffix -Wno-missing-field-initializers -Wno-narrowing -Wno-old-style-cast -Wno-varargs -Wstack-protector -fcheck-new -fsized-deallocation -fstack-protector -fstrict-overflow -flto-odr-type-merging -fno-omit-frame-pointer -Wlarger-than=8192 -Wstack-usage=8192 -pie -fPIE -Werror=vla -ggdb3 -O0 -D_DEBUG -D_SIMPLIFIED_DUMP -fsanitize=address,alignment,bool,bounds,enum,float-cast-overflow,float-divide-by-zero,integer-divide-by-zero,leak,nonnull-attribute,null,object-size,return,returns-nonnull-attribute,shift,signed-integer-overflow,undefined,unreachable,vla-bound,vptr
+g++ ./tests/FrontendTests.cpp ./src/frontend/Parser.cpp ./src/frontend/LexicalAnalyzer.cpp ./src/frontend/SyntaxAnalyzer.cpp ./src/frontend/UtilsForParser.cpp ./src/frontend/TokenArray.cpp ./src/frontend/Incremental.cpp ./src/frontend/AstCache.cpp ./libs/Tree.cpp ./libs/TimeReport.cpp ./libs/Trace.cpp ./libs/MemReport.cpp ./libs/Log.cpp ./libs/GraphDump.cpp ./libs/UtilsRW.cpp ./libs/BuildCache.cpp ./libs/CacheTable.cpp ./libs/Sha256.cpp ./libs/ThreadPool.cpp -o frontend-tests -pthread -I./include -std=c++17 -Wall -Wextra -Weffc++ -Waggressive-loop-optimizations -Wc++14-compat -Wmissing-declarations -Wcast-align -Wcast-qual -Wchar-subscripts -Wconditionally-supported -Wconversion -Wctor-dtor-privacy -Wempty-body -Wfloat-equal -Wformat-nonliteral -Wformat-security -Wformat-signedness -Wformat=2 -Winline -Wlogical-op -Wnon-virtual-dtor -Wopenmp-simd -Woverloaded-virtual -Wpacked -Wpointer-arith -Winit-self -Wredundant-decls -Wshadow -Wsign-conversion -Wsign-promo -Wstrict-null-sentinel -Wstrict-overflow=2 -Wsuggest-attribute=noreturn -Wsuggest-final-methods -Wsuggest-final-types -Wsuggest-override -Wswitch-default -Wsync-nand -Wundef -Wunreachable-code -Wunused -Wuseless-cast -Wvariadic-macros -Wno-literal-suffix -Wno-missing-field-initializers -Wno-narrowing -Wno-old-style-cast -Wno-varargs -Wstack-protector -fcheck-new -fsized-deallocation -fstack-protector -fstrict-overflow -flto-odr-type-merging -fno-omit-frame-pointer -Wlarger-than=8192 -Wstack-usage=8192 -pie -fPIE -Werror=vla -ggdb3 -O0 -D_DEBUG -D_SIMPLIFIED_DUMP -fsanitize=address,alignment,bool,bounds,enum,float-cast-overflow,float-divide-by-zero,integer-divide-by-zero,leak,nonnull-attribute,null,object-size,return,returns-nonnull-attribute,shift,signed-integer-overflow,undefined,unreachable,vla-bound,vptr
@@ -1,18 +1,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <ctype.h>
 #include <math.h>
+#include <sys/stat.h>
 
 #include "backend/CodeGen.h"
+#include "backend/Optimizer.h"
 #include "DebugUtils.h"
+#include "MemReport.h"
+#include "TimeReport.h"
 #include "UtilsRW.h"
 #include "Tree.h"
 
 // ========== АРХИТЕКТУРА My-Compiler-and-Processor ==========
 //
 // Стековая виртуальная машина с командами:
-// PUSH <val>    - положить значение/регистр на стек
-// POP <reg>     - снять значение со стека в регистр
+// PUSH <val>    - положить значение/регистр/ячейку памяти на стек
+// POP <reg>     - снять значение со стека в регистр или ячейку памяти
 // ADD           - сложение верхних элементов стека
 // SUB           - вычитание
 // MUL           - умножение
@@ -33,12 +38,51 @@
 //
 // Метки: :<name> или :<number>
 // Регистры: RAX, RBX, RCX, RDX
+// Оперативная память: [<addr>]
+//
+// RBX хранит возвращаемое значение. Остальные регистры раздаёт RegAlloc.cpp:
+// горячим локальным переменным и временным значениям развёрнутого POW.
+// Переменные функции (и регистры, и ячейки памяти) сохраняет вызывающая сторона
+// вокруг CALL: ячейки у функции постоянные, и рекурсивный вызов писал бы в ячейки вызвавшего.
 
 static void GenNode( CodeGen_t* codegen, Node_t* node );
 static void GenExpression( CodeGen_t* codegen, Node_t* node );
-static void GenFunction( CodeGen_t* codegen, Node_t* node );
-static void GenStatement( CodeGen_t* codegen, Node_t* node );
+static bool GenFunctionBegin( CodeGen_t* codegen, Node_t* node );
+static void GenFunctionEnd( CodeGen_t* codegen, Node_t* node );
+static void GenPow( CodeGen_t* codegen, Node_t* node );
+static void GenBinary( CodeGen_t* codegen, Node_t* node, const char* instruction );
+static void GenTableOperation( CodeGen_t* codegen, Node_t* node );
+static void GenCall( CodeGen_t* codegen, Node_t* node, bool push_result );
+static void GenLoadVariable( CodeGen_t* codegen, const char* name );
+static void GenStoreVariable( CodeGen_t* codegen, const char* name, const char* comment );
+struct WorkStack_t;
+static void GenStatement( CodeGen_t* codegen, Node_t* node, WorkStack_t* work );
 static int GetNewLabel( CodeGen_t* codegen );
+static void GenFunctionIncremental( CodeGen_t* codegen, Node_t** slot );
+static void GenTopLevel( CodeGen_t* codegen, Node_t** slot );
+
+static const char FUNC_CACHE_SUFFIX[] = ".cache";
+static const char OUTPUT_TMP_SUFFIX[] = ".tmp";
+
+// Опций у кодогенератора нет, а его версию проверяет заголовок файла кэша
+const uint64_t FUNC_HASH_SEED = 14695981039346656037ULL;
+
+// Ширина поля инструкции перед комментарием в строках с переменными
+const int INSTRUCTION_WIDTH = 16;
+
+// stdout, /dev/null и прочие не обычные файлы пишутся напрямую: переименовать их нельзя
+static char* OutputTmpPath( const char* output_file ) {
+    struct stat output_stat = {};
+    if ( IsStdStream( output_file ) || ( !stat( output_file, &output_stat ) && !S_ISREG( output_stat.st_mode ) ) )
+        return NULL;
+
+    size_t length = strlen( output_file ) + sizeof( OUTPUT_TMP_SUFFIX );
+    char* path = (char*)calloc( length, sizeof( *path ) );
+    if ( path )
+        snprintf( path, length, "%s%s", output_file, OUTPUT_TMP_SUFFIX );
+
+    return path;
+}
 
 CodeGen_t* CodeGenCtor( const char* input_file, const char* output_file ) {
     CodeGen_t* codegen = (CodeGen_t*)calloc( 1, sizeof(CodeGen_t) );
@@ -49,20 +93,23 @@ CodeGen_t* CodeGenCtor( const char* input_file, const char* output_file ) {
 
     codegen->input_filename = strdup( input_file );
     codegen->output_filename = strdup( output_file );
-    
-    codegen->output = fopen( output_file, "w" );
+    codegen->tmp_filename = OutputTmpPath( output_file );
+
+    codegen->output = OpenFile( codegen->tmp_filename ? codegen->tmp_filename : output_file, "w" );
     if ( !codegen->output ) {
         PRINT_ERROR( "Failed to open output file: %s", output_file );
         free( codegen->input_filename );
         free( codegen->output_filename );
+        free( codegen->tmp_filename );
         free( codegen );
         return NULL;
     }
 
     codegen->label_counter = 0;
     codegen->temp_var_counter = 0;
+    codegen->memory_counter = 0;
 
-    PRINT( "CodeGen created for: %s -> %s", input_file, output_file );
+    LOG_DEBUG( LOG_CODEGEN, "CodeGen created for: %s -> %s", input_file, output_file );
     return codegen;
 }
 
@@ -70,15 +117,31 @@ void CodeGenDtor( CodeGen_t** codegen ) {
     if ( !codegen || !*codegen )
         return;
 
+    bool written = (*codegen)->output && !ferror( (*codegen)->output );
     if ( (*codegen)->output )
-        fclose( (*codegen)->output );
+        written = !CloseFile( (*codegen)->output ) && written;
+
+    // Недописанная программа (ошибка загрузки AST, сбой записи) не заменяет прошлый вывод
+    char* tmp_filename = (*codegen)->tmp_filename;
+    if ( tmp_filename ) {
+        bool finished = (*codegen)->finished;
+        if ( !( written && finished && !rename( tmp_filename, (*codegen)->output_filename ) ) ) {
+            if ( finished )
+                PRINT_ERROR( "Failed to write output file: %s", (*codegen)->output_filename );
+            remove( tmp_filename );
+        }
+    }
 
     free( (*codegen)->input_filename );
     free( (*codegen)->output_filename );
+    free( tmp_filename );
     
     if ( (*codegen)->tree )
         TreeDtor( &(*codegen)->tree, NULL );
 
+    RegAllocDtor( &(*codegen)->regs );
+    FuncCacheDtor( &(*codegen)->func_cache );
+
     free( *codegen );
     *codegen = NULL;
 }
@@ -87,12 +150,50 @@ static int GetNewLabel( CodeGen_t* codegen ) {
     return codegen->label_counter++;
 }
 
-void GenerateCode( CodeGen_t* codegen ) {
+// NULL, если вывод идёт в stdout и кэшу негде лежать
+static char* FuncCachePath( const CodeGen_t* codegen ) {
+    if ( IsStdStream( codegen->output_filename ) )
+        return NULL;
+
+    size_t length = strlen( codegen->output_filename ) + sizeof( FUNC_CACHE_SUFFIX );
+    char* path = (char*)calloc( length, sizeof( *path ) );
+    if ( path )
+        snprintf( path, length, "%s%s", codegen->output_filename, FUNC_CACHE_SUFFIX );
+
+    return path;
+}
+
+// Упрощение дорогих операций с константами - отдельная фаза, поэтому в emit не входит
+static void ReduceFunction( Node_t** slot ) {
+    Tree_t subtree = { *slot };
+    StrengthReduce( &subtree );
+    *slot = subtree.root;
+}
+
+// Фаза emit закрывается ровно один раз на функцию верхнего уровня. Байты считаются по
+// позиции вывода; у канала её нет, и байты остаются нулевыми
+struct EmitScope_t {
+    TimeScope_t time;
+    long start;
+};
+
+static EmitScope_t EmitBegin( const CodeGen_t* codegen ) {
+    EmitScope_t scope = { TimePhaseBegin(), -1 };
+    if ( scope.time.start )
+        scope.start = ftell( codegen->output );
+
+    return scope;
+}
+
+static void EmitEnd( const CodeGen_t* codegen, EmitScope_t* scope ) {
+    long end = scope->start >= 0 ? ftell( codegen->output ) : -1;
+    TimePhaseEnd( &scope->time, PHASE_EMIT, { end > scope->start ? (uint64_t)( end - scope->start ) : 0, 0, 0 } );
+}
+
+void GenerateCodeBegin( CodeGen_t* codegen ) {
     my_assert( codegen, "Null pointer on codegen" );
-    my_assert( codegen->tree, "Null pointer on tree" );
-    my_assert( codegen->tree->root, "Null pointer on tree root" );
 
-    PRINT( "Starting code generation..." );
+    LOG_INFO( LOG_CODEGEN, "Starting code generation..." );
 
     FILE* out = codegen->output;
 
@@ -101,13 +202,293 @@ void GenerateCode( CodeGen_t* codegen ) {
     fprintf( out, "; Target: My-Compiler-and-Processor\n" );
     fprintf( out, "; Source: %s\n\n", codegen->input_filename );
 
-    // Генерация кода для всего AST
-    GenNode( codegen, codegen->tree->root );
+    if ( codegen->incremental && !codegen->func_cache_in_memory ) {
+        char* cache_path = FuncCachePath( codegen );
+        if ( cache_path )
+            FuncCacheLoad( &codegen->func_cache, cache_path );
+        free( cache_path );
+    }
+}
+
+void GenerateCodeEnd( CodeGen_t* codegen ) {
+    my_assert( codegen, "Null pointer on codegen" );
 
     // Завершение программы
-    fprintf( out, "\nHLT\n" );
+    fprintf( codegen->output, "\nHLT\n" );
+    codegen->finished = true;
+
+    // Функции, которых больше нет в программе, из кэша уходят
+    if ( codegen->incremental ) {
+        FuncCacheSweep( &codegen->func_cache );
+
+        char* cache_path = codegen->func_cache_in_memory ? NULL : FuncCachePath( codegen );
+        if ( cache_path )
+            FuncCacheSave( &codegen->func_cache, cache_path );
+        free( cache_path );
+    }
+
+    LOG_INFO( LOG_CODEGEN, "Code generation complete" );
+}
+
+void GenerateCode( CodeGen_t* codegen ) {
+    my_assert( codegen, "Null pointer on codegen" );
+    my_assert( codegen->tree, "Null pointer on tree" );
+    my_assert( codegen->tree->root, "Null pointer on tree root" );
+
+    TRACE_FUNCTION();
+
+    GenerateCodeBegin( codegen );
+
+    // Блок верхнего уровня только складывает свои элементы в стек, поэтому генерация по
+    // одной функции даёт тот же код
+    Node_t* root = codegen->tree->root;
+    if ( root->value.type == NODE_BLOCK ) {
+        for ( size_t i = 0; i < root->value.data.block.count; i++ )
+            GenTopLevel( codegen, &root->value.data.block.items[i] );
+    } else {
+        ReduceFunction( &codegen->tree->root );
+
+        EmitScope_t scope = EmitBegin( codegen );
+        GenNode( codegen, codegen->tree->root );
+        EmitEnd( codegen, &scope );
+    }
+
+    GenerateCodeEnd( codegen );
+}
+
+// Функции связаны только метками CALL :name, поэтому каждую можно упростить и
+// сгенерировать отдельно - результат тот же, что у GenerateCode для всей программы
+bool GenerateFunction( Node_t* function, void* context ) {
+    CodeGen_t* codegen = (CodeGen_t*)context;
+    my_assert( codegen, "Null pointer on codegen" );
+    my_assert( function, "Null pointer on function" );
+
+    GenTopLevel( codegen, &function );
+
+    NodeDelete( function, NULL, NULL );
+    return true;
+}
+
+static void GenTopLevel( CodeGen_t* codegen, Node_t** slot ) {
+    if ( codegen->incremental ) {
+        GenFunctionIncremental( codegen, slot );
+        return;
+    }
+
+    ReduceFunction( slot );
+
+    EmitScope_t scope = EmitBegin( codegen );
+    GenNode( codegen, *slot );
+    EmitEnd( codegen, &scope );
+}
+
+// ===== КЭШ КОДА ФУНКЦИЙ =====
+//
+// Функция генерируется в буфер с собственной нумерацией меток и ячеек памяти от нуля,
+// буфер запоминается в кэше по хэшу её поддерева. При выводе номера сдвигаются на
+// число меток и ячеек всех предыдущих функций, поэтому результат совпадает с
+// генерацией без кэша, а изменение одной функции не трогает код остальных.
+
+// Переносит код функции в вывод, сдвигая метки ':<n>' и ячейки '[<n>]' на заданные величины.
+// Имена функций ':name' и комментарии после ';' копируются как есть, а инструкция
+// со сдвинутым номером заново дополняется пробелами до колонки комментария
+static void EmitRelocated( FILE* out, const char* text, size_t length, int label_shift, int memory_shift ) {
+    const char* end = text + length;
+
+    for ( const char* line = text; line < end; ) {
+        const char* line_end = (const char*)memchr( line, '\n', (size_t)( end - line ) );
+        line_end = line_end ? line_end + 1 : end;
+
+        const char* comment = (const char*)memchr( line, ';', (size_t)( line_end - line ) );
+        const char* code_end = comment ? comment : line_end;
+        if ( comment ) {
+            while ( code_end > line && code_end[-1] == ' ' )
+                code_end--;
+        }
+
+        const char* copied = line;
+        int written = 0;
+        for ( const char* pos = line; pos < code_end; pos++ ) {
+            if ( ( *pos != ':' && *pos != '[' ) || pos + 1 >= code_end || !isdigit( (unsigned char)pos[1] ) )
+                continue;
+
+            written += (int)fwrite( copied, sizeof( *copied ), (size_t)( pos + 1 - copied ), out );
+
+            char* number_end = NULL;
+            long number = strtol( pos + 1, &number_end, 10 );
+            written += fprintf( out, "%ld", number + ( *pos == ':' ? label_shift : memory_shift ) );
+
+            copied = number_end;
+            pos = number_end - 1;
+        }
 
-    PRINT( "Code generation complete" );
+        if ( copied == line ) {
+            fwrite( line, sizeof( *line ), (size_t)( line_end - line ), out );
+        } else {
+            written += (int)fwrite( copied, sizeof( *copied ), (size_t)( code_end - copied ), out );
+            if ( comment ) {
+                fprintf( out, "%*s", written < INSTRUCTION_WIDTH ? INSTRUCTION_WIDTH - written : 0, "" );
+                fwrite( comment, sizeof( *comment ), (size_t)( line_end - comment ), out );
+            }
+        }
+
+        line = line_end;
+    }
+}
+
+// Промах кэша: генерирует код уже упрощённой функции с нумерацией от нуля
+static FuncCacheEntry_t* GenFunctionLocal( CodeGen_t* codegen, Node_t* function, const CacheKey_t* key ) {
+    char* text = NULL;
+    size_t text_length = 0;
+    FILE* buffer = open_memstream( &text, &text_length );
+    assert( buffer && "Memory allocation error" );
+
+    FILE* output = codegen->output;
+    int label_counter = codegen->label_counter;
+    int memory_counter = codegen->memory_counter;
+
+    codegen->output = buffer;
+    codegen->label_counter = 0;
+    codegen->memory_counter = 0;
+
+    GenNode( codegen, function );
+    fclose( buffer );
+    MemCount( MEM_IO_BUFFERS, text_length + 1 );
+
+    size_t labels_count = (size_t)codegen->label_counter;
+    size_t memory_count = (size_t)codegen->memory_counter;
+
+    codegen->output = output;
+    codegen->label_counter = label_counter;
+    codegen->memory_counter = memory_counter;
+
+    FuncCacheEntry_t* entry =
+        FuncCacheInsert( &codegen->func_cache, key, labels_count, memory_count, text, text_length );
+    assert( entry && "Memory allocation error" );
+
+    return entry;
+}
+
+// Кэш в памяти переживает компиляцию, поэтому сдвинутый текст заменяет старый: функция,
+// перед которой ничего не поменялось, в следующий раз копируется без разбора
+static void RebaseEntry( CodeGen_t* codegen, FuncCacheEntry_t* entry, int label_shift, int memory_shift ) {
+    char* text = NULL;
+    size_t text_length = 0;
+    FILE* buffer = open_memstream( &text, &text_length );
+    assert( buffer && "Memory allocation error" );
+
+    EmitRelocated( buffer, entry->text, entry->text_length, label_shift, memory_shift );
+    fclose( buffer );
+
+    free( entry->text );
+    entry->text = text;
+    entry->text_length = text_length;
+    entry->label_base = codegen->label_counter;
+    entry->memory_base = codegen->memory_counter;
+}
+
+static void EmitEntry( CodeGen_t* codegen, FuncCacheEntry_t* entry ) {
+    int label_shift = codegen->label_counter - entry->label_base;
+    int memory_shift = codegen->memory_counter - entry->memory_base;
+
+    if ( ( label_shift || memory_shift ) && codegen->func_cache_in_memory )
+        RebaseEntry( codegen, entry, label_shift, memory_shift );
+
+    if ( codegen->label_counter == entry->label_base && codegen->memory_counter == entry->memory_base )
+        fwrite( entry->text, sizeof( *entry->text ), entry->text_length, codegen->output );
+    else
+        EmitRelocated( codegen->output, entry->text, entry->text_length, label_shift, memory_shift );
+
+    codegen->label_counter += (int)entry->labels_count;
+    codegen->memory_counter += (int)entry->memory_count;
+}
+
+// Ключ считается по дереву до упрощения, поэтому функция упрощается только при промахе.
+// Возвращает NULL, если кода нет ни в кэше, ни в *slot
+static FuncCacheEntry_t* GenFunctionCached( CodeGen_t* codegen, Node_t** slot, const CacheKey_t* key ) {
+    FuncCacheEntry_t* entry = FuncCacheFind( &codegen->func_cache, key );
+    if ( !entry && *slot )
+        ReduceFunction( slot );
+
+    EmitScope_t scope = EmitBegin( codegen );
+    if ( !entry && *slot )
+        entry = GenFunctionLocal( codegen, *slot, key );
+
+    if ( entry )
+        EmitEntry( codegen, entry );
+    EmitEnd( codegen, &scope );
+
+    return entry;
+}
+
+static void GenFunctionIncremental( CodeGen_t* codegen, Node_t** slot ) {
+    TRACE_FUNCTION();
+
+    CacheKey_t key = {};
+    key.hash = NodeHash( *slot, FUNC_HASH_SEED, &key.size, key.digest );
+
+    GenFunctionCached( codegen, slot, &key );
+}
+
+bool HasFunctionCode( CodeGen_t* codegen, const CacheKey_t* key ) {
+    my_assert( codegen, "Null pointer on codegen" );
+
+    return FuncCacheFind( &codegen->func_cache, key ) != NULL;
+}
+
+bool GenerateFunctionByKey( CodeGen_t* codegen, const CacheKey_t* key, Node_t* function ) {
+    my_assert( codegen, "Null pointer on codegen" );
+
+    TRACE_FUNCTION();
+
+    FuncCacheEntry_t* entry = GenFunctionCached( codegen, &function, key );
+
+    NodeDelete( function, NULL, NULL );
+    return entry != NULL;
+}
+
+// ===== ОБХОД ОПЕРАТОРОВ =====
+//
+// Операторы обходятся не рекурсией, а через явный стек работ: GenStatement разбирает
+// один узел и кладёт на стек то, что нужно сгенерировать после него (в обратном порядке).
+// Так глубина обхода не зависит ни от длины блоков, ни от цепочек ';' в старых деревьях.
+// Рекурсия остаётся только внутри выражений, её глубина ограничена вложенностью скобок.
+
+enum WorkKind {
+    WORK_NODE,          // сгенерировать оператор node
+    WORK_JMP,           // JMP :label
+    WORK_LABEL,         // :label
+    WORK_FUNCTION_END   // эпилог функции node
+};
+
+struct WorkItem_t {
+    WorkKind kind;
+    Node_t* node;
+    int label;
+};
+
+struct WorkStack_t {
+    WorkItem_t* data;
+    size_t size;
+    size_t capacity;
+};
+
+const size_t WORK_STACK_DEFAULT_CAPACITY = 64;
+
+static void WorkPush( WorkStack_t* work, WorkKind kind, Node_t* node, int label ) {
+    if ( kind == WORK_NODE && !node )
+        return;
+
+    if ( work->size >= work->capacity ) {
+        size_t new_capacity = work->capacity ? work->capacity * 2 : WORK_STACK_DEFAULT_CAPACITY;
+        WorkItem_t* new_data = (WorkItem_t*)realloc( work->data, new_capacity * sizeof( *new_data ) );
+        assert( new_data && "Memory allocation error" );
+
+        work->data = new_data;
+        work->capacity = new_capacity;
+    }
+
+    work->data[work->size++] = { kind, node, label };
 }
 
 static void GenNode( CodeGen_t* codegen, Node_t* node ) {
@@ -116,14 +497,55 @@ static void GenNode( CodeGen_t* codegen, Node_t* node ) {
 
     FILE* out = codegen->output;
 
+    WorkStack_t work = {};
+    WorkPush( &work, WORK_NODE, node, 0 );
+
+    while ( work.size > 0 ) {
+        WorkItem_t item = work.data[--work.size];
+
+        switch ( item.kind ) {
+            case WORK_NODE:
+                GenStatement( codegen, item.node, &work );
+                break;
+
+            case WORK_JMP:
+                fprintf( out, "JMP :%d\n", item.label );
+                break;
+
+            case WORK_LABEL:
+                fprintf( out, ":%d\n", item.label );
+                break;
+
+            case WORK_FUNCTION_END:
+                GenFunctionEnd( codegen, item.node );
+                break;
+
+            default:
+                PRINT_ERROR( "Unknown work item: %d", item.kind );
+                break;
+        }
+    }
+
+    free( work.data );
+}
+
+static void GenStatement( CodeGen_t* codegen, Node_t* node, WorkStack_t* work ) {
+    FILE* out = codegen->output;
+
     if ( node->value.type == NODE_NUMBER ) {
         fprintf( out, "PUSH %d\n", node->value.data.number );
         return;
     }
 
     if ( node->value.type == NODE_VARIABLE ) {
-        // Загрузка переменной - используем RAX как временный регистр
-        fprintf( out, "PUSH RAX        ; load variable %s\n", node->value.data.variable );
+        GenLoadVariable( codegen, node->value.data.variable );
+        return;
+    }
+
+    // ===== БЛОК: операторы кладутся в обратном порядке =====
+    if ( node->value.type == NODE_BLOCK ) {
+        for ( size_t i = node->value.data.block.count; i > 0; i-- )
+            WorkPush( work, WORK_NODE, node->value.data.block.items[i - 1], 0 );
         return;
     }
 
@@ -134,56 +556,23 @@ static void GenNode( CodeGen_t* codegen, Node_t* node ) {
             // ===== ФУНКЦИИ =====
             case OP_MAIN:
             case OP_FUNC:
-                GenFunction( codegen, node );
+                if ( GenFunctionBegin( codegen, node ) ) {
+                    WorkPush( work, WORK_FUNCTION_END, node, 0 );
+                    WorkPush( work, WORK_NODE, node->right, 0 );
+                }
                 break;
 
-            // ===== ПОСЛЕДОВАТЕЛЬНОСТЬ ОПЕРАТОРОВ =====
+            // ===== ПОСЛЕДОВАТЕЛЬНОСТЬ ОПЕРАТОРОВ (деревья старого формата) =====
             case OP_SEMICOLON:
-                GenNode( codegen, node->left );
-                GenNode( codegen, node->right );
+                WorkPush( work, WORK_NODE, node->right, 0 );
+                WorkPush( work, WORK_NODE, node->left, 0 );
                 break;
 
             // ===== ОБЪЯВЛЕНИЕ/ПРИСВАИВАНИЕ =====
             case OP_ADVERT:
             case OP_ASSIGN:
                 GenExpression( codegen, node->right );
-                fprintf( out, "POP RAX         ; store to %s\n", node->left->value.data.variable );
-                break;
-
-            // ===== АРИФМЕТИКА =====
-            case OP_ADD:
-                GenExpression( codegen, node->left );
-                GenExpression( codegen, node->right );
-                fprintf( out, "ADD\n" );
-                break;
-
-            case OP_SUB:
-                GenExpression( codegen, node->left );
-                GenExpression( codegen, node->right );
-                fprintf( out, "SUB\n" );
-                break;
-
-            case OP_MUL:
-                GenExpression( codegen, node->left );
-                GenExpression( codegen, node->right );
-                fprintf( out, "MUL\n" );
-                break;
-
-            case OP_DIV:
-                GenExpression( codegen, node->left );
-                GenExpression( codegen, node->right );
-                fprintf( out, "DIV\n" );
-                break;
-
-            case OP_POW:
-                GenExpression( codegen, node->left );
-                GenExpression( codegen, node->right );
-                fprintf( out, "POW\n" );
-                break;
-
-            case OP_SQRT:
-                GenExpression( codegen, node->left );
-                fprintf( out, "SQRT\n" );
+                GenStoreVariable( codegen, node->left->value.data.variable, "store to" );
                 break;
 
             // ===== УПРАВЛЯЮЩИЕ КОНСТРУКЦИИ =====
@@ -196,22 +585,20 @@ static void GenNode( CodeGen_t* codegen, Node_t* node ) {
                 fprintf( out, "PUSH 1\n" );
                 fprintf( out, "JBE :%d\n", else_label );  // если условие <= 1 (0 или 1), переход
 
-                // Then-ветка
+                // Стек работ: ветки кладутся в обратном порядке
+                WorkPush( work, WORK_LABEL, NULL, end_label );
                 if ( node->right && node->right->value.type == NODE_OPERATION &&
                      (OperationType)node->right->value.data.operation == OP_ELSE ) {
-                    GenNode( codegen, node->right->left );
-                    fprintf( out, "JMP :%d\n", end_label );
-                    
-                    // Else-ветка
-                    fprintf( out, ":%d\n", else_label );
-                    GenNode( codegen, node->right->right );
+                    // Then-ветка, затем else-ветка
+                    WorkPush( work, WORK_NODE, node->right->right, 0 );
+                    WorkPush( work, WORK_LABEL, NULL, else_label );
+                    WorkPush( work, WORK_JMP, NULL, end_label );
+                    WorkPush( work, WORK_NODE, node->right->left, 0 );
                 } else {
-                    GenNode( codegen, node->right );
-                    fprintf( out, "JMP :%d\n", end_label );
-                    fprintf( out, ":%d\n", else_label );
+                    WorkPush( work, WORK_LABEL, NULL, else_label );
+                    WorkPush( work, WORK_JMP, NULL, end_label );
+                    WorkPush( work, WORK_NODE, node->right, 0 );
                 }
-
-                fprintf( out, ":%d\n", end_label );
                 break;
             }
 
@@ -226,11 +613,10 @@ static void GenNode( CodeGen_t* codegen, Node_t* node ) {
                 fprintf( out, "PUSH 1\n" );
                 fprintf( out, "JBE :%d\n", end_label );  // если условие <= 1, выход
 
-                // Тело цикла
-                GenNode( codegen, node->right );
-                fprintf( out, "JMP :%d\n", start_label );
-
-                fprintf( out, ":%d\n", end_label );
+                // Тело цикла, переход на начало, метка выхода
+                WorkPush( work, WORK_LABEL, NULL, end_label );
+                WorkPush( work, WORK_JMP, NULL, start_label );
+                WorkPush( work, WORK_NODE, node->right, 0 );
                 break;
             }
 
@@ -240,44 +626,20 @@ static void GenNode( CodeGen_t* codegen, Node_t* node ) {
                 fprintf( out, "RET\n" );
                 break;
 
-            // ===== ВВОД/ВЫВОД =====
-            case OP_IN:
-                fprintf( out, "IN\n" );
-                break;
-
-            case OP_OUT:
-                GenExpression( codegen, node->left );
-                fprintf( out, "OUT\n" );
-                break;
-
             // ===== ВЫЗОВ ФУНКЦИИ =====
-            case OP_CALL: {
-                // Получаем имя функции
-                const char* func_name = node->left->value.data.variable;
-                
-                // Генерируем код для аргументов (они на стеке)
-                Node_t* args = node->right;
-                
-                // Подсчитываем и генерируем аргументы
-                Node_t* arg = args;
-                while ( arg ) {
-                    if ( arg->value.type == NODE_OPERATION &&
-                         (OperationType)arg->value.data.operation == OP_COMMA ) {
-                        GenExpression( codegen, arg->left );
-                        arg = arg->right;
-                    } else {
-                        GenExpression( codegen, arg );
-                        break;
-                    }
-                }
-
-                fprintf( out, "CALL :%s\n", func_name );
+            case OP_CALL:
+                GenCall( codegen, node, false );
                 break;
-            }
 
-            default:
-                PRINT_ERROR( "Unknown operation type: %d", op );
+            // ===== ВЫРАЖЕНИЯ (арифметика, ввод/вывод) =====
+            default: {
+                const OperationInfo_t* info = GetOperationInfo( op );
+                if ( info && info->instruction )
+                    GenExpression( codegen, node );
+                else
+                    PRINT_ERROR( "Unknown operation type: %d", op );
                 break;
+            }
         }
     }
 }
@@ -294,8 +656,7 @@ static void GenExpression( CodeGen_t* codegen, Node_t* node ) {
     }
 
     if ( node->value.type == NODE_VARIABLE ) {
-        // Загружаем переменную через регистр
-        fprintf( out, "PUSH RAX        ; load %s\n", node->value.data.variable );
+        GenLoadVariable( codegen, node->value.data.variable );
         return;
     }
 
@@ -303,128 +664,252 @@ static void GenExpression( CodeGen_t* codegen, Node_t* node ) {
         OperationType op = (OperationType)node->value.data.operation;
 
         switch ( op ) {
-            case OP_ADD:
-                GenExpression( codegen, node->left );
-                GenExpression( codegen, node->right );
-                fprintf( out, "ADD\n" );
+            case OP_POW:
+                GenPow( codegen, node );
                 break;
 
-            case OP_SUB:
-                GenExpression( codegen, node->left );
-                GenExpression( codegen, node->right );
-                fprintf( out, "SUB\n" );
+            case OP_CALL:
+                GenCall( codegen, node, true );
                 break;
 
-            case OP_MUL:
-                GenExpression( codegen, node->left );
-                GenExpression( codegen, node->right );
-                fprintf( out, "MUL\n" );
+            default:
+                GenTableOperation( codegen, node );
                 break;
+        }
+    }
+}
 
-            case OP_DIV:
-                GenExpression( codegen, node->left );
-                GenExpression( codegen, node->right );
-                fprintf( out, "DIV\n" );
-                break;
+// Операции, которые целиком описаны таблицей INIT_OPERATIONS: операнды и одна инструкция VM
+static void GenTableOperation( CodeGen_t* codegen, Node_t* node ) {
+    const OperationInfo_t* info = GetOperationInfo( (OperationType)node->value.data.operation );
+    if ( !info || !info->instruction ) {
+        GenNode( codegen, node );
+        return;
+    }
 
-            case OP_POW:
-                GenExpression( codegen, node->left );
-                GenExpression( codegen, node->right );
-                fprintf( out, "POW\n" );
-                break;
+    switch ( info->arity ) {
+        case TWO_ARGS:
+            GenBinary( codegen, node, info->instruction );
+            return;
 
-            case OP_SQRT:
-                GenExpression( codegen, node->left );
-                fprintf( out, "SQRT\n" );
-                break;
+        case ONE_ARG:
+            GenExpression( codegen, node->left );
+            break;
 
-            case OP_IN:
-                fprintf( out, "IN\n" );
-                break;
+        case ZERO_ARG:
+        default:
+            break;
+    }
 
-            case OP_CALL: {
-                const char* func_name = node->left->value.data.variable;
-                Node_t* args = node->right;
-                
-                // Генерируем аргументы
-                Node_t* arg = args;
-                while ( arg ) {
-                    if ( arg->value.type == NODE_OPERATION &&
-                         (OperationType)arg->value.data.operation == OP_COMMA ) {
-                        GenExpression( codegen, arg->left );
-                        arg = arg->right;
-                    } else {
-                        GenExpression( codegen, arg );
-                        break;
-                    }
-                }
+    fprintf( codegen->output, "%s\n", info->instruction );
+}
 
-                fprintf( out, "CALL :%s\n", func_name );
-                break;
-            }
+// Загружает на стек основание степени: лист кладётся напрямую, иначе берётся из временного регистра
+static void GenPowBase( CodeGen_t* codegen, Node_t* base ) {
+    if ( IsLeaf( base ) )
+        GenExpression( codegen, base );
+    else
+        fprintf( codegen->output, "PUSH %s\n", RegisterToString( codegen->regs.pow_base ) );
+}
 
-            default:
-                GenNode( codegen, node );
-                break;
+// x ^ n с константным n раскрывается в цепочку MUL (возведение в квадрат и умножение
+// по битам n от старшего к младшему), т.к. POW на VM гораздо медленнее MUL
+static void GenPow( CodeGen_t* codegen, Node_t* node ) {
+    FILE* out = codegen->output;
+
+    Node_t* base = node->left;
+    Node_t* exponent = node->right;
+
+    if ( !IsUnrolledPow( node ) ) {
+        GenExpression( codegen, base );
+        GenExpression( codegen, exponent );
+        fprintf( out, "POW\n" );
+        return;
+    }
+
+    unsigned n = (unsigned)exponent->value.data.number;
+
+    if ( !IsLeaf( base ) ) {
+        GenExpression( codegen, base );
+        fprintf( out, "POP %s         ; pow base\n", RegisterToString( codegen->regs.pow_base ) );
+    }
+
+    GenPowBase( codegen, base );
+
+    unsigned bit = 1;
+    while ( ( bit << 1 ) <= n )
+        bit <<= 1;
+
+    bool top_is_base = true;
+    for ( bit >>= 1; bit; bit >>= 1 ) {
+        if ( top_is_base ) {
+            GenPowBase( codegen, base );
+        } else {
+            const char* dup = RegisterToString( codegen->regs.pow_dup );
+            fprintf( out, "POP %s\n", dup );
+            fprintf( out, "PUSH %s\n", dup );
+            fprintf( out, "PUSH %s\n", dup );
+        }
+        fprintf( out, "MUL\n" );
+        top_is_base = false;
+
+        if ( n & bit ) {
+            GenPowBase( codegen, base );
+            fprintf( out, "MUL\n" );
         }
     }
 }
 
-static void GenFunction( CodeGen_t* codegen, Node_t* node ) {
-    if ( !node )
+static bool IsComma( const Node_t* node ) {
+    return node && node->value.type == NODE_OPERATION && (OperationType)node->value.data.operation == OP_COMMA;
+}
+
+// Формирует строку "PUSH RAX" / "POP [3]" для домашнего места переменной
+static void FormatHome( char* buffer, size_t size, const char* instruction, const VarHome_t* home ) {
+    if ( home->type == HOME_REGISTER )
+        snprintf( buffer, size, "%s %s", instruction, RegisterToString( (RegisterName)home->index ) );
+    else
+        snprintf( buffer, size, "%s [%d]", instruction, home->index );
+}
+
+static void GenLoadVariable( CodeGen_t* codegen, const char* name ) {
+    const VarHome_t* home = RegAllocLookup( &codegen->regs, name );
+    if ( !home ) {
+        PRINT_ERROR( "Unknown variable `%s`", name );
         return;
+    }
+
+    char instruction[32] = {};
+    FormatHome( instruction, sizeof( instruction ), "PUSH", home );
+    fprintf( codegen->output, "%-*s; load %s\n", INSTRUCTION_WIDTH, instruction, name );
+}
+
+static void GenStoreVariable( CodeGen_t* codegen, const char* name, const char* comment ) {
+    const VarHome_t* home = RegAllocLookup( &codegen->regs, name );
+    if ( !home ) {
+        PRINT_ERROR( "Unknown variable `%s`", name );
+        return;
+    }
+
+    char instruction[32] = {};
+    FormatHome( instruction, sizeof( instruction ), "POP", home );
+    fprintf( codegen->output, "%-*s; %s %s\n", INSTRUCTION_WIDTH, instruction, comment, name );
+}
+
+// Коммутативные операнды без побочных эффектов вычисляются в порядке Сети-Ульмана:
+// сначала более "глубокий", чтобы стек рос меньше
+static void GenBinary( CodeGen_t* codegen, Node_t* node, const char* instruction ) {
+    Node_t* first = node->left;
+    Node_t* second = node->right;
 
-    FILE* out = codegen->output;
     OperationType op = (OperationType)node->value.data.operation;
+    if ( ( op == OP_ADD || op == OP_MUL ) && StackNeed( &codegen->regs, second ) > StackNeed( &codegen->regs, first ) &&
+         IsPureCached( &codegen->regs, node ) ) {
+        first = node->right;
+        second = node->left;
+    }
+
+    GenExpression( codegen, first );
+    GenExpression( codegen, second );
+    fprintf( codegen->output, "%s\n", instruction );
+}
+
+// Аргументы лежат в дереве из запятых с любой вложенностью, обход in-order даёт порядок исходника
+static void GenArguments( CodeGen_t* codegen, Node_t* arg ) {
+    if ( !arg )
+        return;
+
+    if ( IsComma( arg ) ) {
+        GenArguments( codegen, arg->left );
+        GenArguments( codegen, arg->right );
+        return;
+    }
+
+    GenExpression( codegen, arg );
+}
+
+static void GenCall( CodeGen_t* codegen, Node_t* node, bool push_result ) {
+    FILE* out = codegen->output;
+    const RegAlloc_t* regs = &codegen->regs;
+
+    const char* func_name = node->left->value.data.variable;
+
+    // Вызываемая функция пользуется теми же регистрами, а при рекурсии и теми же
+    // ячейками памяти - сохраняем все переменные на стеке
+    char instruction[32] = {};
+    for ( size_t i = 0; i < regs->size; i++ ) {
+        FormatHome( instruction, sizeof( instruction ), "PUSH", &regs->vars[i] );
+        fprintf( out, "%-*s; save %s\n", INSTRUCTION_WIDTH, instruction, regs->vars[i].name );
+    }
+
+    GenArguments( codegen, node->right );
+
+    fprintf( out, "CALL :%s\n", func_name );
+
+    for ( size_t i = regs->size; i > 0; i-- ) {
+        FormatHome( instruction, sizeof( instruction ), "POP", &regs->vars[i - 1] );
+        fprintf( out, "%-*s; restore %s\n", INSTRUCTION_WIDTH, instruction, regs->vars[i - 1].name );
+    }
+
+    if ( push_result )
+        fprintf( out, "PUSH %s        ; return value\n", RegisterToString( RETURN_REGISTER ) );
+}
+
+// Аргументы кладутся на стек слева направо, поэтому параметры снимаются справа налево
+static void GenParameters( CodeGen_t* codegen, Node_t* param ) {
+    if ( !param )
+        return;
+
+    if ( IsComma( param ) ) {
+        GenParameters( codegen, param->right );
+        GenParameters( codegen, param->left );
+        return;
+    }
+
+    if ( param->value.type == NODE_VARIABLE )
+        GenStoreVariable( codegen, param->value.data.variable, "param:" );
+}
+
+// Метка функции и снятие параметров; тело и эпилог генерирует GenNode через стек работ
+static bool GenFunctionBegin( CodeGen_t* codegen, Node_t* node ) {
+    FILE* out = codegen->output;
 
     // node->left содержит (, func_name params)
     // node->right содержит тело функции
 
     Node_t* func_info = node->left;
-    if ( !func_info || func_info->value.type != NODE_OPERATION ||
-         (OperationType)func_info->value.data.operation != OP_COMMA ) {
+    if ( !IsComma( func_info ) ) {
         PRINT_ERROR( "Invalid function structure" );
-        return;
+        return false;
     }
 
     const char* func_name = func_info->left->value.data.variable;
-    Node_t* params = func_info->right;
+
+    // Зона закрывается в GenFunctionEnd, когда тело функции уже сгенерировано
+    TraceBegin( "GenFunction", func_name );
+
+    // Раздаём регистры и ячейки памяти переменным функции
+    RegAllocFunction( &codegen->regs, node, &codegen->memory_counter );
 
     // Генерируем метку функции (формат :<name>)
     fprintf( out, "\n:%s\n", func_name );
 
-    // Обрабатываем параметры - снимаем их со стека
-    // Для простоты пока используем RAX для первого параметра
-    Node_t* param = params;
-    if ( param && param->value.type == NODE_VARIABLE ) {
-        fprintf( out, "POP RAX         ; param: %s\n", param->value.data.variable );
-    } else if ( param && param->value.type == NODE_OPERATION &&
-                (OperationType)param->value.data.operation == OP_COMMA ) {
-        // Несколько параметров
-        while ( param ) {
-            if ( param->value.type == NODE_OPERATION &&
-                 (OperationType)param->value.data.operation == OP_COMMA ) {
-                if ( param->left && param->left->value.type == NODE_VARIABLE ) {
-                    fprintf( out, "POP RAX         ; param: %s\n", param->left->value.data.variable );
-                }
-                param = param->right;
-            } else if ( param->value.type == NODE_VARIABLE ) {
-                fprintf( out, "POP RAX         ; param: %s\n", param->value.data.variable );
-                break;
-            } else {
-                break;
-            }
-        }
-    }
+    // Снимаем параметры со стека в их домашние места
+    GenParameters( codegen, func_info->right );
 
-    // Генерируем тело функции
-    GenNode( codegen, node->right );
+    return true;
+}
+
+static void GenFunctionEnd( CodeGen_t* codegen, Node_t* node ) {
+    FILE* out = codegen->output;
 
     // Если это main и нет явного return
-    if ( op == OP_MAIN ) {
+    if ( (OperationType)node->value.data.operation == OP_MAIN ) {
         fprintf( out, "PUSH 0\n" );
         fprintf( out, "POP RBX         ; return 0\n" );
     }
     
     fprintf( out, "RET\n" );
+
+    TraceEnd();
 }
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BuildCache.h"
+#include "DebugUtils.h"
+#include "backend/FuncCache.h"
+
+// Формат файла: заголовок, строка с версией и идентичностью компилятора, затем записи
+//   <hash hex> <sha-256 hex> <size> <labels_count> <memory_count> <text_length>
+// и text_length байт ассемблера с '\n' в конце. Базы не пишутся: на месте перенумеровывается
+// только кэш в памяти, который не сохраняется.
+// Код зависит от самого кодогенератора, поэтому кэш другой сборки отбрасывается целиком
+static const char FUNC_CACHE_HEADER[] = "lang-func-cache 2\n";
+
+static FuncCacheEntry_t *AsFuncEntry( CacheEntry_t *entry ) {
+    return (FuncCacheEntry_t *)entry;
+}
+
+static void EntryDelete( CacheEntry_t *base ) {
+    FuncCacheEntry_t *entry = AsFuncEntry( base );
+
+    free( entry->text );
+    free( entry );
+}
+
+void FuncCacheDtor( FuncCache_t *cache ) {
+    my_assert( cache, "Null pointer on `cache`" );
+
+    CacheTableDtor( &( cache->table ), EntryDelete );
+    *cache = {};
+}
+
+FuncCacheEntry_t *FuncCacheFind( FuncCache_t *cache, const CacheKey_t *key ) {
+    my_assert( cache, "Null pointer on `cache`" );
+
+    return AsFuncEntry( CacheTableFind( &( cache->table ), key ) );
+}
+
+FuncCacheEntry_t *FuncCacheInsert( FuncCache_t *cache, const CacheKey_t *key, size_t labels_count,
+                                   size_t memory_count, char *text, size_t text_length ) {
+    my_assert( cache, "Null pointer on `cache`" );
+    my_assert( key, "Null pointer on `key`" );
+    my_assert( text, "Null pointer on `text`" );
+
+    FuncCacheEntry_t *entry = (FuncCacheEntry_t *)calloc( 1, sizeof( *entry ) );
+    if ( !entry )
+        return NULL;
+
+    entry->base.key = *key;
+    entry->labels_count = labels_count;
+    entry->memory_count = memory_count;
+    entry->text = text;
+    entry->text_length = text_length;
+
+    if ( !CacheTableInsert( &( cache->table ), &( entry->base ), EntryDelete ) ) {
+        free( entry );
+        return NULL;
+    }
+
+    cache->modified = true;
+    return entry;
+}
+
+void FuncCacheSweep( FuncCache_t *cache ) {
+    my_assert( cache, "Null pointer on `cache`" );
+
+    if ( CacheTableSweep( &( cache->table ), EntryDelete ) )
+        cache->modified = true;
+}
+
+// Вторая строка файла должна совпасть с идентичностью текущего компилятора
+static bool SkipIdentity( const char **pos, const char *end ) {
+    char *identity = BuildCacheCompilerIdentity();
+    if ( !identity )
+        return false;
+
+    size_t length = strlen( identity );
+    bool same = (size_t)( end - *pos ) > length && !memcmp( *pos, identity, length ) && ( *pos )[length] == '\n';
+    if ( same )
+        *pos += length + 1;
+
+    free( identity );
+    return same;
+}
+
+static bool ParseCacheFile( FuncCache_t *cache, const char *data, size_t size ) {
+    size_t header_length = sizeof( FUNC_CACHE_HEADER ) - 1;
+    if ( size < header_length || memcmp( data, FUNC_CACHE_HEADER, header_length ) )
+        return false;
+
+    const char *pos = data + header_length;
+    const char *end = data + size;
+    if ( !SkipIdentity( &pos, end ) )
+        return false;
+
+    while ( pos < end ) {
+        CacheKey_t key = {};
+        unsigned long long labels_count = 0, memory_count = 0, text_length = 0;
+        if ( !CacheKeyRead( &pos, end, &key ) || !CacheReadNumber( &pos, end, 10, &labels_count ) ||
+             !CacheReadNumber( &pos, end, 10, &memory_count ) || !CacheReadNumber( &pos, end, 10, &text_length ) )
+            return false;
+
+        if ( pos >= end || *pos != '\n' || (size_t)( end - pos - 1 ) < text_length + 1 )
+            return false;
+        pos++;
+
+        char *text = (char *)calloc( text_length + 1, sizeof( *text ) );
+        if ( !text )
+            return false;
+        memcpy( text, pos, text_length );
+        pos += text_length + 1;
+
+        FuncCacheEntry_t *entry = FuncCacheInsert( cache, &key, labels_count, memory_count, text, text_length );
+        if ( !entry ) {
+            free( text );
+            return false;
+        }
+        entry->base.used = false;
+    }
+
+    return true;
+}
+
+bool FuncCacheLoad( FuncCache_t *cache, const char *path ) {
+    my_assert( cache, "Null pointer on `cache`" );
+    my_assert( path, "Null pointer on `path`" );
+
+    FILE *file = fopen( path, "rb" );
+    if ( !file ) {
+        LOG_DEBUG( LOG_CACHE, "No function cache at `%s`", path );
+        return false;
+    }
+
+    fseek( file, 0, SEEK_END );
+    long size = ftell( file );
+    fseek( file, 0, SEEK_SET );
+
+    char *data = size > 0 ? (char *)calloc( (size_t)size + 1, sizeof( *data ) ) : NULL;
+    bool loaded = data && fread( data, 1, (size_t)size, file ) == (size_t)size &&
+                  ParseCacheFile( cache, data, (size_t)size );
+
+    free( data );
+    fclose( file );
+
+    if ( !loaded ) {
+        LOG_WARN( LOG_CACHE, "Function cache `%s` is stale or damaged, starting empty", path );
+        FuncCacheDtor( cache );
+    }
+    cache->modified = !loaded;
+
+    return loaded;
+}
+
+// Пишется в `<path>.tmp` и переименовывается, поэтому сбой не оставит обрезанный кэш
+bool FuncCacheSave( FuncCache_t *cache, const char *path ) {
+    my_assert( cache, "Null pointer on `cache`" );
+    my_assert( path, "Null pointer on `path`" );
+
+    if ( !cache->modified )
+        return true;
+
+    char *identity = BuildCacheCompilerIdentity();
+    size_t tmp_length = strlen( path ) + sizeof( ".tmp" );
+    char *tmp_path = (char *)calloc( tmp_length, sizeof( *tmp_path ) );
+    if ( !identity || !tmp_path ) {
+        free( identity );
+        free( tmp_path );
+        return false;
+    }
+    snprintf( tmp_path, tmp_length, "%s.tmp", path );
+
+    FILE *file = fopen( tmp_path, "wb" );
+    if ( !file ) {
+        PRINT_ERROR( "Fail to open file `%s`", tmp_path );
+        free( identity );
+        free( tmp_path );
+        return false;
+    }
+
+    fprintf( file, "%s%s\n", FUNC_CACHE_HEADER, identity );
+    for ( size_t i = 0; i < cache->table.capacity; i++ ) {
+        const FuncCacheEntry_t *entry = (const FuncCacheEntry_t *)cache->table.slots[i];
+        if ( !entry )
+            continue;
+
+        CacheKeyWrite( file, &( entry->base.key ) );
+        fprintf( file, " %zu %zu %zu\n", entry->labels_count, entry->memory_count, entry->text_length );
+        fwrite( entry->text, 1, entry->text_length, file );
+        fputc( '\n', file );
+    }
+
+    bool saved = !ferror( file );
+    saved = !fclose( file ) && saved;
+    saved = saved && !rename( tmp_path, path );
+    if ( !saved ) {
+        PRINT_ERROR( "Fail to write function cache `%s`", path );
+        remove( tmp_path );
+    }
+
+    free( identity );
+    free( tmp_path );
+
+    cache->modified = !saved;
+    return saved;
+}
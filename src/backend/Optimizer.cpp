@@ -0,0 +1,333 @@
+#include <stdlib.h>
+#include <limits.h>
+#include <assert.h>
+
+#include "backend/Optimizer.h"
+#include "DebugUtils.h"
+#include "TimeReport.h"
+#include "Tree.h"
+
+// ========== STRENGTH REDUCTION ==========
+//
+// Упрощения, которые точны для целочисленной VM:
+//   x ^ 0  -> 1          (если x без побочных эффектов и не может делить на ноль)
+//   x ^ 1  -> x
+//   c1 ^ c2 -> c         (если нет переполнения)
+//   x * 1, 1 * x, x / 1 -> x
+//   x * 0, 0 * x -> 0    (если x без побочных эффектов и не может делить на ноль)
+//   x * 2, 2 * x -> x + x (если x - лист)
+//   sqrt( c ) -> isqrt( c ) (если c - точный квадрат)
+//
+// sqrt( x ) ^ 2 в общем случае не сворачивается: SQRT на VM целочисленный
+// и отбрасывает дробную часть, поэтому sqrt( 5 ) ^ 2 == 4, а не 5.
+// Точный квадрат под корнем сворачивается правилом для sqrt( c ).
+//
+// x ^ n с небольшим константным n не переписывается здесь, а раскрывается
+// в цепочку MUL при генерации кода (см. GenPow в CodeGen.cpp), если по стоимостям
+// из INIT_OPERATIONS цепочка дешевле одной POW (IsUnrolledPow).
+
+static bool IsNumber( const Node_t* node, int number ) {
+    return node && node->value.type == NODE_NUMBER && node->value.data.number == number;
+}
+
+bool IsLeaf( const Node_t* node ) {
+    return node && ( node->value.type == NODE_NUMBER || node->value.type == NODE_VARIABLE );
+}
+
+// Выражение можно выбросить целиком. DIV в таблице чистая, но деление на ноль
+// останавливает VM, поэтому выбросить можно только деление на известную ненулевую константу
+bool IsPureExpression( const Node_t* node ) {
+    if ( !node )
+        return true;
+
+    if ( node->value.type != NODE_OPERATION )
+        return true;
+
+    OperationType op = (OperationType)node->value.data.operation;
+    const OperationInfo_t* info = GetOperationInfo( op );
+    if ( !info || info->is_pure != PureOp )
+        return false;
+
+    if ( op == OP_DIV &&
+         !( node->right && node->right->value.type == NODE_NUMBER && node->right->value.data.number != 0 ) )
+        return false;
+
+    return IsPureExpression( node->left ) && IsPureExpression( node->right );
+}
+
+static int OperationCost( OperationType op ) {
+    const OperationInfo_t* info = GetOperationInfo( op );
+    return info ? info->cost : 0;
+}
+
+// Стоимость цепочки из GenPow: на каждый бит показателя кроме старшего - возведение
+// в квадрат (POP/PUSH/PUSH + MUL, первое - PUSH + MUL), на каждую единицу - PUSH + MUL
+static int PowChainCost( unsigned exponent ) {
+    int cost = 0;
+    bool first = true;
+
+    for ( unsigned bit = 1; ( bit << 1 ) <= exponent; bit <<= 1 ) {
+        cost += ( first ? STACK_OP_COST : 3 * STACK_OP_COST ) + OperationCost( OP_MUL );
+        first = false;
+    }
+
+    unsigned ones = exponent;
+    for ( ones &= ones - 1; ones; ones &= ones - 1 )
+        cost += STACK_OP_COST + OperationCost( OP_MUL );
+
+    return cost;
+}
+
+bool IsUnrolledPow( const Node_t* node ) {
+    if ( !node || node->value.type != NODE_OPERATION || (OperationType)node->value.data.operation != OP_POW )
+        return false;
+
+    const Node_t* exponent = node->right;
+    if ( !exponent || exponent->value.type != NODE_NUMBER || exponent->value.data.number < 2 )
+        return false;
+
+    // PUSH показателя + сама POW
+    return PowChainCost( (unsigned)exponent->value.data.number ) < STACK_OP_COST + OperationCost( OP_POW );
+}
+
+static TreeData_t MakeNumberValue( int number ) {
+    TreeData_t value = {};
+    value.type = NODE_NUMBER;
+    value.data.number = number;
+
+    return value;
+}
+
+static TreeData_t MakeOperationValue( OperationType operation ) {
+    TreeData_t value = {};
+    value.type = NODE_OPERATION;
+    value.data.operation = operation;
+
+    return value;
+}
+
+// Заменяет node на keep (поддерево node), остальное удаляет
+static Node_t* ReplaceWithChild( Node_t* node, Node_t* keep ) {
+    if ( node->left == keep )
+        node->left = NULL;
+    else
+        node->right = NULL;
+
+    keep->parent = node->parent;
+
+    node->parent = NULL;
+    NodeDelete( node, NULL, NULL );
+
+    return keep;
+}
+
+static Node_t* ReplaceWithNumber( Node_t* node, int number ) {
+    Node_t* parent = node->parent;
+
+    node->parent = NULL;
+    NodeDelete( node, NULL, NULL );
+
+    return NodeCreate( MakeNumberValue( number ), parent );
+}
+
+// Возведение в квадрат и умножение: O(log exponent) шагов даже для 1 ^ 2000000000.
+// Переполнение квадрата при оставшихся битах означает переполнение и результата
+static bool PowInt( int base, int exponent, int* result ) {
+    if ( exponent < 0 )
+        return false;
+
+    long long value = 1;
+    long long square = base;
+    for ( unsigned n = (unsigned)exponent; n; n >>= 1 ) {
+        if ( n & 1 ) {
+            value *= square;
+            if ( value > INT_MAX || value < INT_MIN )
+                return false;
+        }
+
+        if ( n > 1 ) {
+            square *= square;
+            if ( square > INT_MAX || square < INT_MIN )
+                return false;
+        }
+    }
+
+    *result = (int)value;
+    return true;
+}
+
+// Граница корня: SQRT_BOUND ^ 2 уже больше INT_MAX
+const long long SQRT_BOUND = 46341;
+
+// Бинарный поиск корня: не больше 16 шагов для любого int.
+// Инвариант: low ^ 2 <= number < high ^ 2
+static bool ExactSqrt( int number, int* result ) {
+    if ( number < 0 )
+        return false;
+
+    long long low = 0;
+    long long high = SQRT_BOUND;
+    while ( low + 1 < high ) {
+        long long middle = ( low + high ) / 2;
+        if ( middle * middle <= number )
+            low = middle;
+        else
+            high = middle;
+    }
+
+    if ( low * low != number )
+        return false;
+
+    *result = (int)low;
+    return true;
+}
+
+static Node_t* ReducePow( Node_t* node ) {
+    Node_t* base = node->left;
+    Node_t* exponent = node->right;
+
+    if ( IsNumber( exponent, 1 ) )
+        return ReplaceWithChild( node, base );
+
+    if ( IsNumber( exponent, 0 ) && IsPureExpression( base ) )
+        return ReplaceWithNumber( node, 1 );
+
+    int folded = 0;
+    if ( base && exponent && base->value.type == NODE_NUMBER && exponent->value.type == NODE_NUMBER &&
+         exponent->value.data.number >= 0 &&
+         PowInt( base->value.data.number, exponent->value.data.number, &folded ) )
+        return ReplaceWithNumber( node, folded );
+
+    return node;
+}
+
+static Node_t* ReduceMul( Node_t* node ) {
+    Node_t* left = node->left;
+    Node_t* right = node->right;
+
+    if ( IsNumber( right, 1 ) )
+        return ReplaceWithChild( node, left );
+    if ( IsNumber( left, 1 ) )
+        return ReplaceWithChild( node, right );
+
+    if ( ( IsNumber( right, 0 ) && IsPureExpression( left ) ) ||
+         ( IsNumber( left, 0 ) && IsPureExpression( right ) ) )
+        return ReplaceWithNumber( node, 0 );
+
+    Node_t* doubled = IsNumber( right, 2 ) ? left : IsNumber( left, 2 ) ? right : NULL;
+    if ( IsLeaf( doubled ) ) {
+        Node_t* sum = NodeCreate( MakeOperationValue( OP_ADD ), node->parent );
+
+        sum->left = NodeCopy( doubled );
+        sum->left->parent = sum;
+        sum->right = NodeCopy( doubled );
+        sum->right->parent = sum;
+
+        node->parent = NULL;
+        NodeDelete( node, NULL, NULL );
+
+        return sum;
+    }
+
+    return node;
+}
+
+static Node_t* ReduceDiv( Node_t* node ) {
+    if ( IsNumber( node->right, 1 ) )
+        return ReplaceWithChild( node, node->left );
+
+    return node;
+}
+
+static Node_t* ReduceSqrt( Node_t* node ) {
+    int root = 0;
+    if ( node->left && node->left->value.type == NODE_NUMBER && ExactSqrt( node->left->value.data.number, &root ) )
+        return ReplaceWithNumber( node, root );
+
+    return node;
+}
+
+static Node_t* ReduceNode( Node_t* node ) {
+    if ( node->value.type != NODE_OPERATION )
+        return node;
+
+    switch ( (OperationType)node->value.data.operation ) {
+        case OP_POW:  return ReducePow( node );
+        case OP_MUL:  return ReduceMul( node );
+        case OP_DIV:  return ReduceDiv( node );
+        case OP_SQRT: return ReduceSqrt( node );
+        default:      return node;
+    }
+}
+
+// Обход в обратном порядке через явный стек: блоки и старые цепочки ';' слишком велики для рекурсии.
+// В стеке лежат адреса полей-ссылок, чтобы заменить узел прямо у родителя.
+struct ReduceItem_t {
+    Node_t** slot;
+    bool children_done;
+};
+
+const size_t REDUCE_STACK_DEFAULT_CAPACITY = 64;
+
+static void ReducePush( ReduceItem_t** stack, size_t* size, size_t* capacity, Node_t** slot ) {
+    if ( !*slot )
+        return;
+
+    if ( *size >= *capacity ) {
+        *capacity = *capacity ? *capacity * 2 : REDUCE_STACK_DEFAULT_CAPACITY;
+        ReduceItem_t* new_stack = (ReduceItem_t*)realloc( *stack, *capacity * sizeof( *new_stack ) );
+        assert( new_stack && "Memory allocation error" );
+        *stack = new_stack;
+    }
+
+    ( *stack )[( *size )++] = { slot, false };
+}
+
+void StrengthReduce( Tree_t* tree ) {
+    my_assert( tree, "Null pointer on `tree`" );
+
+    LOG_INFO( LOG_CODEGEN, "Strength reduction..." );
+
+    TRACE_FUNCTION();
+
+    TimeScope_t scope = TimePhaseBegin();
+    size_t nodes_count = 0;
+
+    ReduceItem_t* stack = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    ReducePush( &stack, &size, &capacity, &tree->root );
+
+    while ( size > 0 ) {
+        ReduceItem_t* item = &stack[size - 1];
+        Node_t* node = *item->slot;
+
+        if ( !item->children_done ) {
+            item->children_done = true;
+            ReducePush( &stack, &size, &capacity, &node->right );
+            ReducePush( &stack, &size, &capacity, &node->left );
+
+            // Массив блока не перевыделяется во время обхода, адреса его ячеек стабильны
+            if ( node->value.type == NODE_BLOCK ) {
+                for ( size_t i = 0; i < node->value.data.block.count; i++ )
+                    ReducePush( &stack, &size, &capacity, &node->value.data.block.items[i] );
+            }
+            continue;
+        }
+
+        size--;
+        nodes_count++;
+
+        Node_t* parent = node->parent;
+        Node_t** slot = item->slot;
+
+        *slot = ReduceNode( node );
+        if ( *slot )
+            ( *slot )->parent = parent;
+    }
+
+    free( stack );
+
+    TimePhaseEnd( &scope, PHASE_STRENGTH_REDUCE, { 0, 0, nodes_count } );
+}
@@ -0,0 +1,400 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "backend/RegAlloc.h"
+#include "backend/Optimizer.h"
+#include "DebugUtils.h"
+#include "TimeReport.h"
+#include "Tree.h"
+
+// ========== РАСПРЕДЕЛЕНИЕ РЕГИСТРОВ ==========
+//
+// Арифметика VM работает только со стеком, регистровые операнды есть лишь у PUSH/POP.
+// Поэтому промежуточные значения выражений всегда живут на стеке, а регистры
+// отдаются самым горячим локальным переменным функции:
+//   - вес переменной = число обращений, каждое вложение в while умножает его на LOOP_WEIGHT;
+//   - временные регистры для развёрнутого POW забираются с конца пула, если нужны;
+//   - переменные, которым не хватило регистров, живут в оперативной памяти [<addr>].
+//
+// Порядок вычисления операндов коммутативных операций выбирается по числам
+// Сети-Ульмана (StackNeed), чтобы уменьшить глубину стека. Числа и чистота всех
+// операций функции считаются одним обходом снизу вверх и лежат в таблице
+// alloc->exprs: иначе каждый узел цепочки a + b + ... заново обходил бы всё поддерево.
+
+static const char* const register_names[REGISTERS_COUNT] = { "RAX", "RBX", "RCX", "RDX" };
+
+// Регистры, которые можно отдавать переменным, в порядке выдачи
+static const RegisterName allocatable[] = { REG_RAX, REG_RCX, REG_RDX };
+
+const size_t ALLOCATABLE_COUNT = sizeof( allocatable ) / sizeof( allocatable[0] );
+const size_t LOOP_WEIGHT = 8;
+const size_t VARS_DEFAULT_CAPACITY = 16;
+const size_t EXPRS_DEFAULT_CAPACITY = 64;
+
+const char* RegisterToString( RegisterName reg ) {
+    if ( reg < 0 || (size_t)reg >= REGISTERS_COUNT )
+        return "???";
+
+    return register_names[reg];
+}
+
+static VarHome_t* FindVar( const RegAlloc_t* alloc, const char* name ) {
+    for ( size_t i = 0; i < alloc->size; i++ ) {
+        if ( !strcmp( alloc->vars[i].name, name ) )
+            return &alloc->vars[i];
+    }
+
+    return NULL;
+}
+
+static void AddUse( RegAlloc_t* alloc, const char* name, size_t weight ) {
+    VarHome_t* var = FindVar( alloc, name );
+    if ( var ) {
+        var->weight += weight;
+        return;
+    }
+
+    if ( alloc->size >= alloc->capacity ) {
+        size_t new_capacity = alloc->capacity ? alloc->capacity * 2 : VARS_DEFAULT_CAPACITY;
+        VarHome_t* new_vars = (VarHome_t*)realloc( alloc->vars, new_capacity * sizeof( *new_vars ) );
+        assert( new_vars && "Memory allocation error" );
+
+        alloc->vars = new_vars;
+        alloc->capacity = new_capacity;
+    }
+
+    VarHome_t* new_var = &alloc->vars[alloc->size++];
+    new_var->name = name;
+    new_var->weight = weight;
+    new_var->type = HOME_MEMORY;
+    new_var->index = 0;
+}
+
+struct ScratchNeed_t {
+    bool pow_base;
+    bool pow_dup;
+
+    size_t operations; // узлов-операций, столько записей ляжет в alloc->exprs
+};
+
+struct UseItem_t {
+    Node_t* node;
+    size_t weight;
+};
+
+static void UsePush( UseItem_t** stack, size_t* size, size_t* capacity, Node_t* node, size_t weight ) {
+    if ( !node )
+        return;
+
+    if ( *size >= *capacity ) {
+        *capacity = *capacity ? *capacity * 2 : VARS_DEFAULT_CAPACITY;
+        UseItem_t* new_stack = (UseItem_t*)realloc( *stack, *capacity * sizeof( *new_stack ) );
+        assert( new_stack && "Memory allocation error" );
+        *stack = new_stack;
+    }
+
+    ( *stack )[( *size )++] = { node, weight };
+}
+
+// Обход через явный стек: блоки бывают очень длинными
+static void CountUses( RegAlloc_t* alloc, Node_t* root, size_t root_weight, ScratchNeed_t* scratch ) {
+    UseItem_t* stack = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    UsePush( &stack, &size, &capacity, root, root_weight );
+
+    while ( size > 0 ) {
+        UseItem_t item = stack[--size];
+        Node_t* node = item.node;
+        size_t weight = item.weight;
+
+        if ( node->value.type == NODE_VARIABLE ) {
+            AddUse( alloc, node->value.data.variable, weight );
+            continue;
+        }
+
+        if ( node->value.type == NODE_BLOCK ) {
+            for ( size_t i = node->value.data.block.count; i > 0; i-- )
+                UsePush( &stack, &size, &capacity, node->value.data.block.items[i - 1], weight );
+            continue;
+        }
+
+        if ( node->value.type != NODE_OPERATION )
+            continue;
+
+        scratch->operations++;
+
+        switch ( (OperationType)node->value.data.operation ) {
+            case OP_CALL:
+                // Слева имя функции, а не переменная
+                UsePush( &stack, &size, &capacity, node->right, weight );
+                continue;
+
+            case OP_WHILE:
+                weight *= LOOP_WEIGHT;
+                break;
+
+            case OP_POW:
+                if ( IsUnrolledPow( node ) ) {
+                    scratch->pow_base |= !IsLeaf( node->left );
+                    scratch->pow_dup  |= node->right->value.data.number >= 4;
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        // Правый кладётся первым, чтобы переменные встречались в порядке исходника
+        UsePush( &stack, &size, &capacity, node->right, weight );
+        UsePush( &stack, &size, &capacity, node->left, weight );
+    }
+
+    free( stack );
+}
+
+// Устойчивая сортировка по убыванию веса: при равенстве раньше идёт первая встреченная
+static void SortByWeight( RegAlloc_t* alloc ) {
+    for ( size_t i = 1; i < alloc->size; i++ ) {
+        VarHome_t var = alloc->vars[i];
+
+        size_t j = i;
+        while ( j > 0 && alloc->vars[j - 1].weight < var.weight ) {
+            alloc->vars[j] = alloc->vars[j - 1];
+            j--;
+        }
+
+        alloc->vars[j] = var;
+    }
+}
+
+static size_t ExprSlot( const Node_t* node, size_t capacity ) {
+    return (size_t)( ( (uintptr_t)node * 0x9E3779B97F4A7C15ULL ) >> 32 ) & ( capacity - 1 );
+}
+
+static const ExprInfo_t* FindExpr( const RegAlloc_t* alloc, const Node_t* node ) {
+    if ( !alloc->exprs_capacity )
+        return NULL;
+
+    for ( size_t slot = ExprSlot( node, alloc->exprs_capacity );; slot = ( slot + 1 ) & ( alloc->exprs_capacity - 1 ) ) {
+        const ExprInfo_t* info = &alloc->exprs[slot];
+        if ( info->node == node )
+            return info;
+        if ( !info->node )
+            return NULL;
+    }
+}
+
+static void InsertExpr( RegAlloc_t* alloc, const Node_t* node, int need, bool pure ) {
+    size_t slot = ExprSlot( node, alloc->exprs_capacity );
+    while ( alloc->exprs[slot].node && alloc->exprs[slot].node != node )
+        slot = ( slot + 1 ) & ( alloc->exprs_capacity - 1 );
+
+    alloc->exprs[slot] = { node, need, pure };
+}
+
+// Таблица заполнена не больше чем наполовину; большая таблица от прошлой огромной
+// функции не чистится целиком ради маленькой
+static void ResetExprs( RegAlloc_t* alloc, size_t operations ) {
+    size_t capacity = EXPRS_DEFAULT_CAPACITY;
+    while ( capacity < operations * 2 )
+        capacity *= 2;
+
+    if ( capacity != alloc->exprs_capacity ) {
+        free( alloc->exprs );
+        alloc->exprs = (ExprInfo_t*)calloc( capacity, sizeof( *alloc->exprs ) );
+        assert( alloc->exprs && "Memory allocation error" );
+        alloc->exprs_capacity = capacity;
+        return;
+    }
+
+    memset( alloc->exprs, 0, capacity * sizeof( *alloc->exprs ) );
+}
+
+static bool IsCommutative( OperationType op ) {
+    return op == OP_ADD || op == OP_MUL;
+}
+
+// Число Сети-Ульмана узла по уже посчитанным детям: сколько ячеек стека нужно, чтобы его вычислить
+static void ComputeExpr( RegAlloc_t* alloc, const Node_t* node ) {
+    int left = StackNeed( alloc, node->left );
+    int right = StackNeed( alloc, node->right );
+
+    OperationType op = (OperationType)node->value.data.operation;
+    const OperationInfo_t* info = GetOperationInfo( op );
+    bool pure = info && info->is_pure == PureOp && IsPureCached( alloc, node->left ) &&
+                IsPureCached( alloc, node->right );
+
+    int need = 0;
+    switch ( op ) {
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_POW: {
+            int left_first = left > right + 1 ? left : right + 1;
+            int right_first = right > left + 1 ? right : left + 1;
+
+            need = IsCommutative( op ) && pure && right_first < left_first ? right_first : left_first;
+            break;
+        }
+
+        case OP_SQRT:
+            need = left;
+            break;
+
+        default:
+            need = ( left > right ? left : right ) + 1;
+            break;
+    }
+
+    InsertExpr( alloc, node, need, pure );
+}
+
+struct ExprItem_t {
+    const Node_t* node;
+    bool children_done;
+};
+
+static void ExprPush( ExprItem_t** stack, size_t* size, size_t* capacity, const Node_t* node, bool children_done ) {
+    if ( !node )
+        return;
+
+    if ( *size >= *capacity ) {
+        *capacity = *capacity ? *capacity * 2 : EXPRS_DEFAULT_CAPACITY;
+        ExprItem_t* new_stack = (ExprItem_t*)realloc( *stack, *capacity * sizeof( *new_stack ) );
+        assert( new_stack && "Memory allocation error" );
+        *stack = new_stack;
+    }
+
+    ( *stack )[( *size )++] = { node, children_done };
+}
+
+// Обход снизу вверх через явный стек: узел считается, когда готовы оба ребёнка
+static void ComputeExprs( RegAlloc_t* alloc, const Node_t* root ) {
+    ExprItem_t* stack = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    ExprPush( &stack, &size, &capacity, root, false );
+
+    while ( size > 0 ) {
+        ExprItem_t item = stack[--size];
+        const Node_t* node = item.node;
+
+        if ( node->value.type == NODE_BLOCK ) {
+            for ( size_t i = 0; i < node->value.data.block.count; i++ )
+                ExprPush( &stack, &size, &capacity, node->value.data.block.items[i], false );
+            continue;
+        }
+
+        if ( node->value.type != NODE_OPERATION )
+            continue;
+
+        if ( item.children_done ) {
+            ComputeExpr( alloc, node );
+            continue;
+        }
+
+        ExprPush( &stack, &size, &capacity, node, true );
+        ExprPush( &stack, &size, &capacity, node->right, false );
+        ExprPush( &stack, &size, &capacity, node->left, false );
+    }
+
+    free( stack );
+}
+
+void RegAllocFunction( RegAlloc_t* alloc, Node_t* function, int* memory_counter ) {
+    my_assert( alloc, "Null pointer on `alloc`" );
+    my_assert( function, "Null pointer on `function`" );
+    my_assert( memory_counter, "Null pointer on `memory_counter`" );
+
+    TimeScope_t scope = TimePhaseBegin();
+
+    alloc->size = 0;
+    alloc->pow_base = REG_NONE;
+    alloc->pow_dup = REG_NONE;
+
+    ScratchNeed_t scratch = {};
+
+    // Параметры: (, func_name params)
+    if ( function->left )
+        CountUses( alloc, function->left->right, 1, &scratch );
+
+    CountUses( alloc, function->right, 1, &scratch );
+
+    size_t free_registers = ALLOCATABLE_COUNT;
+    if ( scratch.pow_dup )
+        alloc->pow_dup = allocatable[--free_registers];
+    if ( scratch.pow_base )
+        alloc->pow_base = allocatable[--free_registers];
+
+    ResetExprs( alloc, scratch.operations );
+    ComputeExprs( alloc, function->right );
+
+    SortByWeight( alloc );
+
+    for ( size_t i = 0; i < alloc->size; i++ ) {
+        VarHome_t* var = &alloc->vars[i];
+
+        if ( i < free_registers ) {
+            var->type = HOME_REGISTER;
+            var->index = allocatable[i];
+        } else {
+            var->type = HOME_MEMORY;
+            var->index = ( *memory_counter )++;
+        }
+
+        LOG_DEBUG( LOG_CODEGEN, "Variable `%s` (weight %zu) -> %s %d", var->name, var->weight,
+                   var->type == HOME_REGISTER ? "register" : "memory", var->index );
+    }
+
+    TimePhaseEnd( &scope, PHASE_REG_ALLOC, {} );
+}
+
+void RegAllocDtor( RegAlloc_t* alloc ) {
+    if ( !alloc )
+        return;
+
+    free( alloc->vars );
+    alloc->vars = NULL;
+    alloc->size = 0;
+    alloc->capacity = 0;
+
+    free( alloc->exprs );
+    alloc->exprs = NULL;
+    alloc->exprs_capacity = 0;
+}
+
+const VarHome_t* RegAllocLookup( const RegAlloc_t* alloc, const char* name ) {
+    my_assert( alloc, "Null pointer on `alloc`" );
+    my_assert( name, "Null pointer on `name`" );
+
+    return FindVar( alloc, name );
+}
+
+// Лист и пустое поддерево чисты и занимают не больше одной ячейки. Узла нет в таблице,
+// только если он не из текущей функции - тогда он считается нечистым и перестановок не будет
+int StackNeed( const RegAlloc_t* alloc, const Node_t* node ) {
+    my_assert( alloc, "Null pointer on `alloc`" );
+
+    if ( !node )
+        return 0;
+    if ( node->value.type != NODE_OPERATION )
+        return 1;
+
+    const ExprInfo_t* info = FindExpr( alloc, node );
+    return info ? info->need : 1;
+}
+
+bool IsPureCached( const RegAlloc_t* alloc, const Node_t* node ) {
+    my_assert( alloc, "Null pointer on `alloc`" );
+
+    if ( !node || node->value.type != NODE_OPERATION )
+        return true;
+
+    const ExprInfo_t* info = FindExpr( alloc, node );
+    return info && info->pure;
+}
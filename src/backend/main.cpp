@@ -1,55 +1,173 @@
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "backend/CodeGen.h"
+#include "BuildCache.h"
+#include "MemReport.h"
+#include "TimeReport.h"
 #include "Tree.h"
 #include "DebugUtils.h"
+#include "UtilsRW.h"
 
 static void PrintUsage() {
-    printf( "Usage: backend <input.ast> <output.asm>\n" );
-    printf( "  input.ast  - Input AST file\n" );
-    printf( "  output.asm - Output assembly file\n" );
+    printf( "Usage: backend [-c] [--time-report[=json]] [--trace[=FILE]] [--trace-depth N]\n"
+            "               [--mem-report[=json]] [--mem-budget MIB] [--log SPEC] <input.ast> <output.asm>\n" );
+    printf( "  input.ast  - Input AST file, `-` for stdin\n" );
+    printf( "  output.asm - Output assembly file, `-` for stdout\n" );
+    printf( "  -c         - reuse code of unchanged functions, cached in <output.asm>.cache\n" );
+    printf( "  --time-report[=json] - print time and throughput of every phase to stderr\n" );
+    printf( "  --trace[=FILE]       - write a Chrome trace of the compiler zones (default: %s)\n",
+            TRACE_DEFAULT_FILENAME );
+    printf( "  --trace-depth N      - levels of nested zones in the trace (default: %zu)\n", TRACE_DEFAULT_DEPTH );
+    printf( "  --mem-report[=json]  - print allocations and peak RSS of every phase to stderr\n" );
+    printf( "  --mem-budget MIB     - fail when the compile raises the RSS by more than MIB mebibytes\n" );
+    printf( "  --log SPEC           - log levels, e.g. `info` or `warn,codegen=debug` (default: $LANG_LOG)\n" );
 }
 
 int main( int argc, char** argv ) {
-    if ( argc < 3 ) {
+    bool incremental = false;
+
+    enum { OPTION_TIME_REPORT = 256, OPTION_TRACE, OPTION_TRACE_DEPTH, OPTION_MEM_REPORT, OPTION_MEM_BUDGET, OPTION_LOG };
+    static const struct option long_options[] = {
+        { "time-report", optional_argument, NULL, OPTION_TIME_REPORT },
+        { "trace",       optional_argument, NULL, OPTION_TRACE },
+        { "trace-depth", required_argument, NULL, OPTION_TRACE_DEPTH },
+        { "mem-report",  optional_argument, NULL, OPTION_MEM_REPORT },
+        { "mem-budget",  required_argument, NULL, OPTION_MEM_BUDGET },
+        { "log",         required_argument, NULL, OPTION_LOG },
+        { NULL, 0, NULL, 0 }
+    };
+
+    size_t trace_depth = TRACE_DEFAULT_DEPTH;
+    const char* trace_filename = NULL;
+    MemReportFormat_t mem_format = MEM_REPORT_OFF;
+    uint64_t mem_budget = 0;
+    const char* log_spec = NULL;
+
+    int opt;
+    while ( ( opt = getopt_long( argc, argv, "ch", long_options, NULL ) ) != -1 ) {
+        switch ( opt ) {
+            case 'c':
+                incremental = true;
+                break;
+            case OPTION_TIME_REPORT: {
+                TimeReportFormat_t format = TIME_REPORT_OFF;
+                if ( !TimeReportParseFormat( optarg, &format ) ) {
+                    PRINT_ERROR( "Bad time report format `%s`, expected `json`", optarg );
+                    return 1;
+                }
+                TimeReportEnable( format );
+                break;
+            }
+            case OPTION_TRACE:
+                trace_filename = optarg ? optarg : TRACE_DEFAULT_FILENAME;
+                break;
+            case OPTION_TRACE_DEPTH: {
+                char* end = NULL;
+                long depth = strtol( optarg, &end, 10 );
+                if ( !end || *end != '\0' || depth < 0 ) {
+                    PRINT_ERROR( "Bad trace depth `%s`", optarg );
+                    return 1;
+                }
+                trace_depth = (size_t)depth;
+                break;
+            }
+            case OPTION_MEM_REPORT:
+                if ( !MemReportParseFormat( optarg, &mem_format ) ) {
+                    PRINT_ERROR( "Bad memory report format `%s`, expected `json`", optarg );
+                    return 1;
+                }
+                break;
+            case OPTION_MEM_BUDGET:
+                if ( !MemReportParseBudget( optarg, &mem_budget ) ) {
+                    PRINT_ERROR( "Bad memory budget `%s`, expected mebibytes", optarg );
+                    return 1;
+                }
+                break;
+            case OPTION_LOG:
+                log_spec = optarg;
+                break;
+            case 'h':
+                PrintUsage();
+                return 0;
+            case '?':
+            default:
+                PrintUsage();
+                return 1;
+        }
+    }
+
+    if ( argc - optind < 2 ) {
         PrintUsage();
         return 1;
     }
 
-    const char* input_file = argv[1];
-    const char* output_file = argv[2];
+    if ( !LogConfigure( log_spec ) )
+        return 1;
+    if ( trace_filename )
+        TraceEnable( trace_filename, trace_depth );
+    MemReportEnable( mem_format, mem_budget );
+
+    const char* input_file = argv[optind];
+    const char* output_file = argv[optind + 1];
 
-    PRINT( "Backend: %s -> %s", input_file, output_file );
+    LOG_INFO( LOG_CODEGEN, "Backend: %s -> %s", input_file, output_file );
+
+    // Имя входного файла попадает в заголовок ассемблера, поэтому входит в ключ
+    BuildCache_t cache = {};
+    char key[BUILD_CACHE_KEY_LENGTH + 1] = "";
+    bool cached = !IsStdStream( input_file ) && !IsStdStream( output_file ) &&
+                  BuildCacheOpen( &cache ) && BuildCacheKey( &cache, "back", input_file, input_file, key );
+
+    if ( cached && BuildCacheFetch( &cache, key, output_file ) ) {
+        BuildCacheClose( &cache );
+        TimeReportPrint( stderr );
+        TraceWrite();
+        return MemReportPrint( stderr ) ? 0 : 1;
+    }
 
     // Создаём генератор кода
     CodeGen_t* codegen = CodeGenCtor( input_file, output_file );
     if ( !codegen ) {
         PRINT_ERROR( "Failed to create code generator" );
+        BuildCacheClose( &cache );
         return 1;
     }
 
-    // Загружаем AST из файла с подробным сообщением об ошибке
+    codegen->incremental = incremental;
+
+    // Загружаем AST по одной функции и сразу генерируем для неё код
+    GenerateCodeBegin( codegen );
+
     char error_buffer[256] = {};
-    codegen->tree = TreeLoadFromFile( input_file, error_buffer, sizeof(error_buffer) );
-    if ( !codegen->tree ) {
+    if ( !TreeLoadStreaming( input_file, GenerateFunction, codegen, error_buffer, sizeof(error_buffer) ) ) {
         if ( error_buffer[0] != '\0' ) {
             PRINT_ERROR( "Failed to load AST from file '%s': %s", input_file, error_buffer );
         } else {
             PRINT_ERROR( "Failed to load AST from file: %s", input_file );
         }
         CodeGenDtor( &codegen );
+        BuildCacheClose( &cache );
+        TimeReportPrint( stderr );
+        TraceWrite();
+        MemReportPrint( stderr );
         return 1;
     }
 
-    PRINT( "AST loaded successfully" );
-
-    // Генерируем ассемблерный код
-    GenerateCode( codegen );
+    GenerateCodeEnd( codegen );
 
-    PRINT( "Code generation successful" );
+    LOG_INFO( LOG_CODEGEN, "Code generation successful" );
 
     CodeGenDtor( &codegen );
-    return 0;
+
+    // Файл сохраняется в кэш только после закрытия, когда записан целиком
+    if ( cached )
+        BuildCacheStore( &cache, key, output_file );
+    BuildCacheClose( &cache );
+
+    TimeReportPrint( stderr );
+    TraceWrite();
+    return MemReportPrint( stderr ) ? 0 : 1;
 }
@@ -0,0 +1,133 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "DebugUtils.h"
+#include "driver/Protocol.h"
+
+// Thin client of `lang --server`: forwards its command line and working directory,
+// prints what the server captured and exits with the status of the compile.
+// `lang-client [--socket PATH] [lang options...]`, `lang-client --stop` stops the server
+
+const size_t RELAY_CHUNK_SIZE = 1 << 16;
+const size_t MAX_HEADER_LENGTH = 64;
+
+static bool RequestAppend( char *request, size_t *size, const char *field ) {
+    size_t length = strlen( field ) + 1;
+    if ( *size + length > MAX_REQUEST_SIZE ) {
+        PRINT_ERROR( "The command line is too long" );
+        return false;
+    }
+
+    memcpy( request + *size, field, length );
+    *size += length;
+    return true;
+}
+
+static int Connect( const char *socket_path ) {
+    struct sockaddr_un address = {};
+    size_t address_length = 0;
+    if ( !SocketAddress( socket_path, &address, &address_length ) )
+        return -1;
+
+    int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( fd < 0 )
+        return -1;
+
+    if ( connect( fd, (struct sockaddr *)&address, (socklen_t)address_length ) ) {
+        PRINT_ERROR( "No server on `%s`, start one with `lang --server`", socket_path );
+        close( fd );
+        return -1;
+    }
+
+    return fd;
+}
+
+static bool ReadHeader( int server, int *status, size_t *output_size, size_t *errors_size ) {
+    char header[MAX_HEADER_LENGTH] = "";
+
+    for ( size_t length = 0; length + 1 < MAX_HEADER_LENGTH; length++ ) {
+        if ( recv( server, header + length, 1, 0 ) != 1 )
+            return false;
+        if ( header[length] == '\n' )
+            return sscanf( header, "%d %zu %zu", status, output_size, errors_size ) == 3;
+    }
+
+    return false;
+}
+
+static bool Relay( int server, FILE *stream, size_t size, char *chunk ) {
+    while ( size > 0 ) {
+        ssize_t received = recv( server, chunk, size < RELAY_CHUNK_SIZE ? size : RELAY_CHUNK_SIZE, 0 );
+        if ( received <= 0 )
+            return false;
+
+        fwrite( chunk, sizeof( *chunk ), (size_t)received, stream );
+        size -= (size_t)received;
+    }
+
+    return true;
+}
+
+// "<status> <stdout length> <stderr length>\n" followed by both outputs
+static int RelayResponse( int server ) {
+    int status = 1;
+    size_t output_size = 0, errors_size = 0;
+    char *chunk = (char *)calloc( RELAY_CHUNK_SIZE, sizeof( *chunk ) );
+
+    if ( !chunk || !ReadHeader( server, &status, &output_size, &errors_size ) ||
+         !Relay( server, stdout, output_size, chunk ) || !Relay( server, stderr, errors_size, chunk ) ) {
+        PRINT_ERROR( "The server closed the connection without an answer" );
+        status = 1;
+    }
+
+    free( chunk );
+    return status;
+}
+
+int main( int argc, char **argv ) {
+    char socket_path[SOCKET_PATH_LENGTH] = "";
+    DefaultSocketPath( socket_path, sizeof( socket_path ) );
+
+    int first_argument = 1;
+    if ( argc > 2 && !strcmp( argv[1], "--socket" ) ) {
+        snprintf( socket_path, sizeof( socket_path ), "%s", argv[2] );
+        first_argument = 3;
+    }
+
+    char cwd[PATH_MAX] = "";
+    if ( !getcwd( cwd, sizeof( cwd ) ) ) {
+        PRINT_ERROR( "Failed to get the working directory" );
+        return 1;
+    }
+
+    char *request = (char *)calloc( MAX_REQUEST_SIZE, sizeof( *request ) );
+    if ( !request )
+        return 1;
+
+    size_t size = 0;
+    bool built = RequestAppend( request, &size, cwd ) && RequestAppend( request, &size, "lang" );
+    for ( int i = first_argument; i < argc && built; i++ )
+        built = RequestAppend( request, &size, argv[i] );
+
+    int server = built ? Connect( socket_path ) : -1;
+    if ( server < 0 ) {
+        free( request );
+        return 1;
+    }
+
+    int status = 1;
+    if ( SendAll( server, request, size ) && !shutdown( server, SHUT_WR ) )
+        status = RelayResponse( server );
+    else
+        PRINT_ERROR( "Failed to send the request" );
+
+    close( server );
+    free( request );
+
+    return status;
+}
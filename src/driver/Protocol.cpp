@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "DebugUtils.h"
+#include "driver/Protocol.h"
+
+const size_t RECEIVE_CHUNK_SIZE = 1 << 16;
+
+void DefaultSocketPath( char *buffer, size_t size ) {
+    my_assert( buffer, "Null pointer on `buffer`" );
+
+    const char *path = getenv( "LANG_SERVER_SOCKET" );
+    if ( path && *path )
+        snprintf( buffer, size, "%s", path );
+    else
+        snprintf( buffer, size, "/tmp/lang-%u.sock", getuid() );
+}
+
+bool SocketAddress( const char *path, void *address, size_t *address_length ) {
+    my_assert( path, "Null pointer on `path`" );
+
+    struct sockaddr_un *unix_address = (struct sockaddr_un *)address;
+    if ( strlen( path ) >= sizeof( unix_address->sun_path ) ) {
+        PRINT_ERROR( "Socket path `%s` is too long", path );
+        return false;
+    }
+
+    memset( unix_address, 0, sizeof( *unix_address ) );
+    unix_address->sun_family = AF_UNIX;
+    strcpy( unix_address->sun_path, path );
+    *address_length = sizeof( *unix_address );
+
+    return true;
+}
+
+bool SendAll( int fd, const char *data, size_t size ) {
+    while ( size > 0 ) {
+        // A client that went away must not kill the server with SIGPIPE
+        ssize_t sent = send( fd, data, size, MSG_NOSIGNAL );
+        if ( sent <= 0 )
+            return false;
+
+        data += sent;
+        size -= (size_t)sent;
+    }
+
+    return true;
+}
+
+char *ReceiveAll( int fd, size_t limit, size_t *size ) {
+    my_assert( size, "Null pointer on `size`" );
+
+    size_t capacity = RECEIVE_CHUNK_SIZE + 1;
+    char *data = (char *)calloc( capacity, sizeof( *data ) );
+    if ( !data )
+        return NULL;
+
+    *size = 0;
+    for ( ;; ) {
+        if ( *size + 1 == capacity ) {
+            if ( capacity > limit ) {
+                PRINT_ERROR( "Message is longer than %zu bytes", limit );
+                free( data );
+                return NULL;
+            }
+
+            char *new_data = (char *)realloc( data, capacity * 2 );
+            if ( !new_data ) {
+                free( data );
+                return NULL;
+            }
+            data = new_data;
+            capacity *= 2;
+        }
+
+        ssize_t received = recv( fd, data + *size, capacity - *size - 1, 0 );
+        if ( received < 0 ) {
+            free( data );
+            return NULL;
+        }
+        if ( received == 0 )
+            break;
+
+        *size += (size_t)received;
+    }
+
+    data[*size] = '\0';
+    return data;
+}
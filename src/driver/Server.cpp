@@ -0,0 +1,306 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "DebugUtils.h"
+#include "driver/Driver.h"
+#include "driver/Protocol.h"
+
+// Compile server: one process serves requests one after another, so a request pays
+// neither for exec and dynamic linking nor for parsing functions it has seen before.
+// The warm state is the AstCache_t of parsed function subtrees; the parser and the
+// code generator are still built per request, they are cheap next to parsing.
+// A request runs in the client's working directory with stdout and stderr captured
+// into temporary files, which are sent back as the response. Requests are served one at
+// a time, so a client that stops talking is cut off after SERVER_CLIENT_TIMEOUT_SECONDS
+
+const size_t SERVER_BACKLOG = 16;
+// Functions not compiled during this many requests are dropped from the cache
+const size_t SERVER_SWEEP_INTERVAL = 64;
+const size_t SEND_CHUNK_SIZE = 1 << 16;
+// Longest wait for a single read or write of a client, requests behind it wait as long
+const time_t SERVER_CLIENT_TIMEOUT_SECONDS = 10;
+
+struct Capture_t {
+    FILE *output;
+    FILE *errors;
+
+    int saved_output;
+    int saved_errors;
+};
+
+// A socket file that refuses connections was left by a server that died and is removed;
+// one that accepts them belongs to a live server, which keeps it
+static bool ClaimSocketPath( const char *socket_path, const struct sockaddr_un *address, size_t address_length ) {
+    int probe = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( probe < 0 ) {
+        PRINT_ERROR( "Failed to create a socket" );
+        return false;
+    }
+
+    bool alive = !connect( probe, (const struct sockaddr *)address, (socklen_t)address_length );
+    bool stale = !alive && errno == ECONNREFUSED;
+    close( probe );
+
+    if ( alive ) {
+        PRINT_ERROR( "A server is already listening on `%s`", socket_path );
+        return false;
+    }
+
+    if ( stale )
+        unlink( socket_path );
+
+    return true;
+}
+
+static int ServerListen( const char *socket_path ) {
+    struct sockaddr_un address = {};
+    size_t address_length = 0;
+    if ( !SocketAddress( socket_path, &address, &address_length ) ||
+         !ClaimSocketPath( socket_path, &address, address_length ) )
+        return -1;
+
+    int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( fd < 0 ) {
+        PRINT_ERROR( "Failed to create a socket" );
+        return -1;
+    }
+
+    if ( bind( fd, (struct sockaddr *)&address, (socklen_t)address_length ) || listen( fd, SERVER_BACKLOG ) ) {
+        PRINT_ERROR( "Failed to listen on `%s`", socket_path );
+        close( fd );
+        return -1;
+    }
+
+    return fd;
+}
+
+static bool SetClientTimeout( int client ) {
+    struct timeval timeout = {};
+    timeout.tv_sec = SERVER_CLIENT_TIMEOUT_SECONDS;
+
+    return !setsockopt( client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) ) &&
+           !setsockopt( client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof( timeout ) );
+}
+
+static bool CaptureBegin( Capture_t *capture ) {
+    LogFlush();
+    fflush( stdout );
+    fflush( stderr );
+
+    capture->output = tmpfile();
+    capture->errors = tmpfile();
+    capture->saved_output = dup( STDOUT_FILENO );
+    capture->saved_errors = dup( STDERR_FILENO );
+
+    if ( !capture->output || !capture->errors || capture->saved_output < 0 || capture->saved_errors < 0 ||
+         dup2( fileno( capture->output ), STDOUT_FILENO ) < 0 || dup2( fileno( capture->errors ), STDERR_FILENO ) < 0 ) {
+        PRINT_ERROR( "Failed to capture the output" );
+        return false;
+    }
+
+    return true;
+}
+
+static size_t CaptureSize( FILE *file ) {
+    if ( !file || fseek( file, 0, SEEK_END ) )
+        return 0;
+
+    long size = ftell( file );
+    rewind( file );
+
+    return size > 0 ? (size_t)size : 0;
+}
+
+// Captured output may be far larger than memory (debug builds log every token),
+// so it goes to the client in chunks
+static bool SendCaptured( int client, FILE *file, size_t size ) {
+    char *chunk = (char *)calloc( SEND_CHUNK_SIZE, sizeof( *chunk ) );
+    bool sent = chunk != NULL;
+
+    while ( sent && size > 0 ) {
+        size_t read = fread( chunk, sizeof( *chunk ), size < SEND_CHUNK_SIZE ? size : SEND_CHUNK_SIZE, file );
+        sent = read > 0 && SendAll( client, chunk, read );
+        size -= read;
+    }
+
+    free( chunk );
+    return sent;
+}
+
+static void CaptureEnd( Capture_t *capture ) {
+    LogFlush();
+    fflush( stdout );
+    fflush( stderr );
+
+    if ( capture->saved_output >= 0 ) {
+        dup2( capture->saved_output, STDOUT_FILENO );
+        close( capture->saved_output );
+    }
+    if ( capture->saved_errors >= 0 ) {
+        dup2( capture->saved_errors, STDERR_FILENO );
+        close( capture->saved_errors );
+    }
+}
+
+static void CaptureDtor( Capture_t *capture ) {
+    if ( capture->output )
+        fclose( capture->output );
+    if ( capture->errors )
+        fclose( capture->errors );
+
+    *capture = {};
+}
+
+static bool SendHeader( int client, int status, size_t output_size, size_t errors_size ) {
+    char header[64] = "";
+    int header_length = snprintf( header, sizeof( header ), "%d %zu %zu\n", status, output_size, errors_size );
+
+    return SendAll( client, header, (size_t)header_length );
+}
+
+static void SendError( int client, const char *message ) {
+    size_t length = strlen( message );
+    if ( SendHeader( client, 1, 0, length ) )
+        SendAll( client, message, length );
+}
+
+// Splits the '\0'-terminated fields of a request into the working directory and argv,
+// the returned argv points into the request
+static char **ParseRequest( char *request, size_t size, const char **cwd, int *argc ) {
+    if ( size == 0 || request[size - 1] != '\0' )
+        return NULL;
+
+    size_t fields = 0;
+    for ( size_t i = 0; i < size; i++ )
+        fields += request[i] == '\0';
+    if ( fields < 2 )
+        return NULL;
+
+    char **argv = (char **)calloc( fields, sizeof( *argv ) );
+    if ( !argv )
+        return NULL;
+
+    *cwd = request;
+    *argc = 0;
+    for ( char *field = request + strlen( request ) + 1; field < request + size; field += strlen( field ) + 1 )
+        argv[( *argc )++] = field;
+
+    return argv;
+}
+
+static int Compile( int argc, char **argv, AstCache_t *cache, int client ) {
+    Capture_t capture = {};
+    int status = 1;
+
+    if ( CaptureBegin( &capture ) )
+        status = DriverRun( argc, argv, cache );
+    CaptureEnd( &capture );
+
+    size_t output_size = CaptureSize( capture.output );
+    size_t errors_size = CaptureSize( capture.errors );
+
+    // A client that went away only loses its answer
+    if ( SendHeader( client, status, output_size, errors_size ) && SendCaptured( client, capture.output, output_size ) )
+        SendCaptured( client, capture.errors, errors_size );
+
+    CaptureDtor( &capture );
+    return status;
+}
+
+// Returns false when the client asked the server to stop
+static bool ServeClient( int client, AstCache_t *cache, int server_cwd ) {
+    size_t size = 0;
+    char *request = ReceiveAll( client, MAX_REQUEST_SIZE, &size );
+    // SO_RCVTIMEO expired; EWOULDBLOCK is the same code on Linux
+    bool timed_out = !request && errno == EAGAIN;
+
+    const char *cwd = NULL;
+    int argc = 0;
+    char **argv = request ? ParseRequest( request, size, &cwd, &argc ) : NULL;
+    bool keep_serving = true;
+
+    if ( timed_out ) {
+        SendError( client, "The request was not sent in time\n" );
+    } else if ( !argv ) {
+        SendError( client, "Malformed request\n" );
+    } else if ( argc == 2 && !strcmp( argv[1], SERVER_STOP_ARGUMENT ) ) {
+        SendHeader( client, 0, 0, 0 );
+        keep_serving = false;
+    } else if ( chdir( cwd ) ) {
+        SendError( client, "The server cannot enter the working directory\n" );
+    } else {
+        Compile( argc, argv, cache, client );
+        if ( fchdir( server_cwd ) )
+            PRINT_ERROR( "Failed to return to the server directory" );
+    }
+
+    free( argv );
+    free( request );
+    return keep_serving;
+}
+
+int ServerRun( const char *socket_path ) {
+    my_assert( socket_path, "Null pointer on `socket_path`" );
+
+    int server_cwd = open( ".", O_RDONLY | O_DIRECTORY );
+    if ( server_cwd < 0 ) {
+        PRINT_ERROR( "Failed to open the working directory" );
+        return 1;
+    }
+
+    // `-i -` of a client must not wait on the terminal of the server
+    int null_input = open( "/dev/null", O_RDONLY );
+    if ( null_input >= 0 ) {
+        dup2( null_input, STDIN_FILENO );
+        close( null_input );
+    }
+
+    int server = ServerListen( socket_path );
+    if ( server < 0 ) {
+        close( server_cwd );
+        return 1;
+    }
+    fprintf( stderr, "Listening on %s\n", socket_path );
+
+    AstCache_t cache = {};
+    size_t requests = 0;
+
+    for ( bool serving = true; serving; ) {
+        int client = accept( server, NULL, NULL );
+        if ( client < 0 )
+            continue;
+
+        if ( !SetClientTimeout( client ) ) {
+            PRINT_ERROR( "Failed to set the client timeout" );
+            close( client );
+            continue;
+        }
+
+        serving = ServeClient( client, &cache, server_cwd );
+        close( client );
+
+        if ( ++requests % SERVER_SWEEP_INTERVAL == 0 )
+            AstCacheSweep( &cache );
+
+        // Memory freed by the request goes back to the system, so `--mem-budget` of the next
+        // one starts from the RSS of the cache rather than from the biggest request so far
+        malloc_trim( 0 );
+    }
+
+    fprintf( stderr, "Served %zu requests, %zu functions cached\n", requests, cache.table.count );
+
+    AstCacheDtor( &cache );
+    close( server );
+    close( server_cwd );
+    unlink( socket_path );
+
+    return 0;
+}
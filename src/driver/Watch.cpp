@@ -0,0 +1,317 @@
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "DebugUtils.h"
+#include "MemReport.h"
+#include "ThreadPool.h"
+#include "TimeReport.h"
+#include "UtilsRW.h"
+#include "driver/Driver.h"
+
+// Watch mode: every source of a directory is compiled once, then inotify reports the
+// files that were written and only those are compiled again. Each file keeps its warm
+// state in memory between rebuilds: the code of every function keyed by its source text,
+// and the AST cache with the token counts. A function whose text did not change is not
+// lexed, parsed or even copied as a tree - its cached code goes straight to the output
+// with labels renumbered, so a rebuild costs the edited functions plus one pass over the text.
+// Only the directory itself is watched, not its subdirectories
+
+const size_t WATCH_DEFAULT_CAPACITY = 64;
+// Editors save a file in several steps, events this close together make one rebuild
+const int WATCH_SETTLE_MILLISECONDS = 20;
+const size_t WATCH_EVENTS_BUFFER_SIZE = 1 << 16;
+const uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM;
+
+struct WatchFile_t {
+    char *name; // inside the watched directory
+    char *input_filename;
+    char *output_filename;
+
+    AstCache_t ast_cache;   // token counts and subtrees of the functions, by source text
+    FuncCache_t func_cache; // code of the functions, by source text
+
+    bool dirty; // changed since the last rebuild
+    bool compiled;
+    double milliseconds;
+};
+
+struct Watch_t {
+    WatchFile_t *files;
+    size_t count;
+    size_t capacity;
+
+    const char *directory;
+    const char *output_directory;
+};
+
+static volatile sig_atomic_t watch_stopped = 0;
+
+static void WatchStop( int /* signal */ ) {
+    watch_stopped = 1;
+}
+
+static bool IsSourceName( const char *name ) {
+    size_t length = strlen( name );
+    size_t extension_length = sizeof( SOURCE_EXTENSION ) - 1;
+
+    return length > extension_length && !strcmp( name + length - extension_length, SOURCE_EXTENSION );
+}
+
+static WatchFile_t *WatchFind( Watch_t *watch, const char *name ) {
+    for ( size_t i = 0; i < watch->count; i++ )
+        if ( !strcmp( watch->files[i].name, name ) )
+            return &watch->files[i];
+
+    return NULL;
+}
+
+static void WatchFileDtor( WatchFile_t *file ) {
+    free( file->name );
+    free( file->input_filename );
+    free( file->output_filename );
+
+    AstCacheDtor( &file->ast_cache );
+    FuncCacheDtor( &file->func_cache );
+
+    *file = {};
+}
+
+static WatchFile_t *WatchAdd( Watch_t *watch, const char *name ) {
+    if ( watch->count == watch->capacity ) {
+        size_t new_capacity = watch->capacity ? watch->capacity * 2 : WATCH_DEFAULT_CAPACITY;
+        WatchFile_t *new_files = (WatchFile_t *)realloc( watch->files, new_capacity * sizeof( *new_files ) );
+        if ( !new_files )
+            return NULL;
+
+        watch->files = new_files;
+        watch->capacity = new_capacity;
+    }
+
+    WatchFile_t file = {};
+    size_t length = strlen( watch->directory ) + 1 + strlen( name ) + 1;
+    file.name = strdup( name );
+    file.input_filename = (char *)calloc( length, sizeof( *file.input_filename ) );
+    if ( file.input_filename ) {
+        snprintf( file.input_filename, length, "%s/%s", watch->directory, name );
+        file.output_filename = BatchOutputName( watch->output_directory, file.input_filename );
+    }
+
+    if ( !file.name || !file.output_filename ) {
+        WatchFileDtor( &file );
+        return NULL;
+    }
+
+    watch->files[watch->count] = file;
+    return &watch->files[watch->count++];
+}
+
+static void WatchRemove( Watch_t *watch, const char *name ) {
+    WatchFile_t *file = WatchFind( watch, name );
+    if ( !file )
+        return;
+
+    printf( "removed %s\n", file->input_filename );
+    fflush( stdout );
+    WatchFileDtor( file );
+    *file = watch->files[--watch->count];
+}
+
+static void WatchDtor( Watch_t *watch ) {
+    for ( size_t i = 0; i < watch->count; i++ )
+        WatchFileDtor( &watch->files[i] );
+
+    free( watch->files );
+    *watch = {};
+}
+
+static bool WatchMarkChanged( Watch_t *watch, const char *name ) {
+    WatchFile_t *file = WatchFind( watch, name );
+    if ( !file )
+        file = WatchAdd( watch, name );
+    if ( !file ) {
+        PRINT_ERROR( "Failed to watch `%s`", name );
+        return false;
+    }
+
+    file->dirty = true;
+    return true;
+}
+
+// Adds the sources of the directory and marks every file changed: used at start and
+// when the kernel dropped events, after which nothing is known about what changed
+static bool WatchScan( Watch_t *watch ) {
+    DIR *directory = opendir( watch->directory );
+    if ( !directory ) {
+        PRINT_ERROR( "Fail to open directory `%s`", watch->directory );
+        return false;
+    }
+
+    bool scanned = true;
+    for ( struct dirent *entry = readdir( directory ); entry && scanned; entry = readdir( directory ) )
+        if ( entry->d_type != DT_DIR && IsSourceName( entry->d_name ) )
+            scanned = WatchMarkChanged( watch, entry->d_name );
+
+    closedir( directory );
+
+    for ( size_t i = 0; i < watch->count; i++ )
+        watch->files[i].dirty = true;
+
+    return scanned;
+}
+
+// A failed rebuild leaves the last good assembly in place: CodeGenDtor publishes only a
+// finished program
+static void RebuildJob( size_t file_index, void *context ) {
+    Watch_t *watch = (Watch_t *)context;
+    WatchFile_t *file = &watch->files[file_index];
+    if ( !file->dirty )
+        return;
+
+    TRACE_ZONE_DETAIL( "RebuildFile", file->name );
+    double start = NowMilliseconds();
+
+    FunctionsResult_t result =
+        CompileFunctions( file->input_filename, file->output_filename, &file->ast_cache, &file->func_cache );
+
+    // Code keyed by source text needs the split, anything else is compiled cold
+    file->compiled = result == FUNCTIONS_DONE ||
+                     ( result == FUNCTIONS_NOT_SPLIT &&
+                       CompileFile( file->input_filename, file->output_filename, NULL, 1, false, NULL, NULL ) );
+    file->milliseconds = NowMilliseconds() - start;
+}
+
+static void Rebuild( Watch_t *watch, size_t threads ) {
+    double start = NowMilliseconds();
+    ParallelFor( watch->count, threads, RebuildJob, watch );
+    double total = NowMilliseconds() - start;
+
+    size_t rebuilt = 0, failed = 0;
+    for ( size_t i = 0; i < watch->count; i++ ) {
+        WatchFile_t *file = &watch->files[i];
+        if ( !file->dirty )
+            continue;
+
+        printf( "%-4s %9.3f ms  %s -> %s\n", file->compiled ? "ok" : "FAIL", file->milliseconds,
+                file->input_filename, file->output_filename );
+        rebuilt++;
+        failed += !file->compiled;
+        file->dirty = false;
+    }
+    printf( "rebuilt %zu of %zu files, %zu failed in %.3f ms\n", rebuilt, watch->count, failed, total );
+
+    // The output is usually read by a person or a pipe while the watch goes on
+    fflush( stdout );
+    // Each rebuild gets its own report, the wall time includes the wait for changes
+    TimeReportPrint( stderr );
+    TraceWrite();
+    // The peak RSS belongs to the whole watch, over the budget the watch goes on and says so
+    MemReportPrint( stderr );
+}
+
+// Returns false when the inotify descriptor is unusable
+static bool ReadEvents( int inotify_fd, Watch_t *watch, char *buffer ) {
+    for ( ;; ) {
+        ssize_t length = read( inotify_fd, buffer, WATCH_EVENTS_BUFFER_SIZE );
+        if ( length < 0 )
+            return errno == EAGAIN || errno == EINTR;
+        if ( length == 0 )
+            return false;
+
+        for ( char *position = buffer; position < buffer + length; ) {
+            const struct inotify_event *event = (const struct inotify_event *)position;
+            position += sizeof( *event ) + event->len;
+
+            if ( event->mask & IN_Q_OVERFLOW ) {
+                WatchScan( watch );
+                continue;
+            }
+            if ( !event->len || ( event->mask & IN_ISDIR ) || !IsSourceName( event->name ) )
+                continue;
+
+            if ( event->mask & ( IN_DELETE | IN_MOVED_FROM ) )
+                WatchRemove( watch, event->name );
+            else
+                WatchMarkChanged( watch, event->name );
+        }
+    }
+}
+
+static bool HasChanges( const Watch_t *watch ) {
+    for ( size_t i = 0; i < watch->count; i++ )
+        if ( watch->files[i].dirty )
+            return true;
+
+    return false;
+}
+
+int WatchRun( const char *directory, const char *output_directory, size_t threads ) {
+    my_assert( directory, "Null pointer on `directory`" );
+    my_assert( output_directory, "Null pointer on `output_directory`" );
+
+    // poll returns on these signals, the loop then ends and frees the warm state
+    struct sigaction stop = {};
+    stop.sa_handler = WatchStop;
+    sigaction( SIGINT, &stop, NULL );
+    sigaction( SIGTERM, &stop, NULL );
+
+    int inotify_fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    if ( inotify_fd < 0 || inotify_add_watch( inotify_fd, directory, WATCH_EVENTS ) < 0 ) {
+        PRINT_ERROR( "Failed to watch directory `%s`", directory );
+        if ( inotify_fd >= 0 )
+            close( inotify_fd );
+        return 1;
+    }
+
+    Watch_t watch = {};
+    watch.directory = directory;
+    watch.output_directory = output_directory;
+
+    char *buffer = (char *)calloc( WATCH_EVENTS_BUFFER_SIZE, sizeof( *buffer ) );
+    // Watching starts before the scan, so a file written during the first build is not missed
+    if ( !buffer || MakeDirectory( output_directory ) || !WatchScan( &watch ) ) {
+        PRINT_ERROR( "Failed to prepare the watch" );
+        free( buffer );
+        WatchDtor( &watch );
+        close( inotify_fd );
+        return 1;
+    }
+
+    Rebuild( &watch, threads );
+    fprintf( stderr, "Watching %s, Ctrl-C to stop\n", directory );
+
+    int status = 0;
+    while ( !watch_stopped ) {
+        struct pollfd poll_fd = { inotify_fd, POLLIN, 0 };
+        int ready = poll( &poll_fd, 1, -1 );
+        if ( ready < 0 && errno == EINTR )
+            continue;
+
+        bool watching = ready > 0 && ReadEvents( inotify_fd, &watch, buffer );
+        while ( watching && !watch_stopped && poll( &poll_fd, 1, WATCH_SETTLE_MILLISECONDS ) > 0 )
+            watching = ReadEvents( inotify_fd, &watch, buffer );
+
+        if ( !watching ) {
+            PRINT_ERROR( "Lost the watch on `%s`", directory );
+            status = 1;
+            break;
+        }
+
+        if ( HasChanges( &watch ) && !watch_stopped )
+            Rebuild( &watch, threads );
+    }
+
+    fprintf( stderr, "Stopped watching %s\n", directory );
+
+    free( buffer );
+    WatchDtor( &watch );
+    close( inotify_fd );
+
+    return status;
+}
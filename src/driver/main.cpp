@@ -0,0 +1,638 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "BuildCache.h"
+#include "DebugUtils.h"
+#include "GraphDump.h"
+#include "MemReport.h"
+#include "ThreadPool.h"
+#include "TimeReport.h"
+#include "Tree.h"
+#include "UtilsRW.h"
+#include "backend/CodeGen.h"
+#include "driver/Driver.h"
+#include "driver/Protocol.h"
+#include "frontend/Parser.h"
+
+// Frontend and backend in one process: the AST goes from Parse to GenerateCode in
+// memory, the text form is written only on request.
+// With several inputs every file is a job of ParallelFor. A job owns its Parser_t and
+// CodeGen_t and never touches getopt, so jobs share nothing but the read-only options.
+// `--server` keeps the process and its parsed-function cache alive between compiles,
+// see Server.cpp. `--watch` keeps the same warm state per file of a directory, see Watch.cpp
+
+struct DriverOptions_t {
+    const char *input_filename;
+    const char *output_filename;
+    const char *ast_filename; // --save-ast, NULL if not requested
+    size_t threads;
+
+    bool incremental; // -c, per-function code cache next to every output
+    bool no_cache;
+    bool cache_stats;
+    TimeReportFormat_t time_report;
+    const char *trace_filename; // --trace, NULL if not requested
+    size_t trace_depth;
+    MemReportFormat_t mem_report;
+    uint64_t mem_budget; // bytes, 0 - no budget
+    const char *log_spec; // --log, NULL - LANG_LOG or the default levels
+    GraphDumpMode_t dump_mode;
+    size_t dump_limit;
+
+    // Batch mode
+    const char *output_directory;
+    const char *manifest_filename;
+    char **inputs;
+    size_t inputs_count;
+
+    // Server mode
+    bool server;
+    const char *socket_path;
+
+    const char *watch_directory; // --watch, NULL if not requested
+};
+
+enum DriverLongOption {
+    OPTION_SAVE_AST = 256,
+    OPTION_OUT_DIR,
+    OPTION_MANIFEST,
+    OPTION_SERVER,
+    OPTION_SOCKET,
+    OPTION_NO_CACHE,
+    OPTION_CACHE_STATS,
+    OPTION_WATCH,
+    OPTION_TIME_REPORT,
+    OPTION_TRACE,
+    OPTION_TRACE_DEPTH,
+    OPTION_MEM_REPORT,
+    OPTION_MEM_BUDGET,
+    OPTION_LOG,
+    OPTION_DUMP,
+    OPTION_DUMP_LIMIT
+};
+
+const size_t BATCH_DEFAULT_CAPACITY = 64;
+
+struct BatchJob_t {
+    const char *input_filename;
+    char *output_filename;
+
+    bool duplicate; // another input has the same output name
+    bool compiled;
+    double milliseconds;
+};
+
+struct Batch_t {
+    BatchJob_t *jobs;
+    size_t count;
+    size_t capacity;
+
+    char *manifest; // paths of the manifest point into it
+
+    const BuildCache_t *build_cache; // NULL when disabled
+    bool incremental;
+};
+
+static void HelpPrint( const char *program_name, const DriverOptions_t *defaults ) {
+    printf( "Usage: %s [-c] [-i input_file] [-o output_file] [-j threads] [--save-ast FILE]\n", program_name );
+    printf( "       %s [-c] [-j threads] [--out-dir DIR] [--manifest FILE] [input_file...]\n", program_name );
+    printf( "       %s --server [--socket PATH]\n", program_name );
+    printf( "       %s --watch DIR [-j threads] [--out-dir DIR]\n", program_name );
+    printf( "  -i FILE          input source file, `-` for stdin (default: %s)\n", defaults->input_filename );
+    printf( "  -o FILE          output assembly file, `-` for stdout (default: %s)\n", defaults->output_filename );
+    printf( "  -c               reuse the code of unchanged functions, cached in <output>.cache\n" );
+    printf( "  -j N             lex and parse on N threads, in batch mode compile N files at once\n" );
+    printf( "                   (default: one per CPU)\n" );
+    printf( "  --save-ast FILE  also write the AST in the lang-front format, single file only\n" );
+    printf( "  --out-dir DIR    batch mode: write NAME.asm for every NAME.lang to DIR (default: %s)\n",
+            defaults->output_directory );
+    printf( "  --manifest FILE  batch mode: compile the files listed in FILE, one per line, `-` for stdin\n" );
+    printf( "  --no-cache       do not look up or store outputs in the build cache\n" );
+    printf( "  --cache-stats    print build cache statistics and exit\n" );
+    printf( "  --server         serve compile requests from lang-client, keeping parsed functions cached\n" );
+    printf( "  --socket PATH    server socket (default: $LANG_SERVER_SOCKET or /tmp/lang-<uid>.sock)\n" );
+    printf( "  --watch DIR      compile every %s file of DIR, then recompile the changed ones until Ctrl-C\n",
+            SOURCE_EXTENSION );
+    printf( "  --time-report[=json]\n" );
+    printf( "                   print time and throughput of every phase to stderr, as a table or JSON,\n" );
+    printf( "                   in watch mode after every rebuild\n" );
+    printf( "  --trace[=FILE]   write a Chrome trace of the compiler zones (default: %s),\n", TRACE_DEFAULT_FILENAME );
+    printf( "                   in watch mode of the last rebuild\n" );
+    printf( "  --trace-depth N  levels of grammar functions in the trace (default: %zu)\n", TRACE_DEFAULT_DEPTH );
+    printf( "  --mem-report[=json]\n" );
+    printf( "                   print allocations and peak RSS of every phase to stderr, as a table or JSON\n" );
+    printf( "  --mem-budget MIB fail when the compile raises the RSS by more than MIB mebibytes\n" );
+    printf( "  --log SPEC       log levels, e.g. `info` or `warn,lexer=trace` (default: $LANG_LOG)\n" );
+    printf( "  --dump MODE      graph dumps of debug builds to %s/: off, dot, async or batch\n",
+            GRAPH_DUMP_DIRECTORY );
+    printf( "                   (default: async)\n" );
+    printf( "  --dump-limit N   nodes drawn per dump, the rest is collapsed, 0 - all (default: %zu)\n",
+            defaults->dump_limit );
+    printf( "  -h               show this help\n" );
+}
+
+static bool ParseDriverArgs( DriverOptions_t *options, int argc, char **argv ) {
+    const DriverOptions_t defaults = *options;
+
+    static const struct option long_options[] = {
+        { "save-ast", required_argument, NULL, OPTION_SAVE_AST },
+        { "out-dir",  required_argument, NULL, OPTION_OUT_DIR },
+        { "manifest", required_argument, NULL, OPTION_MANIFEST },
+        { "server",   no_argument,       NULL, OPTION_SERVER },
+        { "socket",   required_argument, NULL, OPTION_SOCKET },
+        { "no-cache",    no_argument,    NULL, OPTION_NO_CACHE },
+        { "cache-stats", no_argument,    NULL, OPTION_CACHE_STATS },
+        { "watch",    required_argument, NULL, OPTION_WATCH },
+        { "time-report", optional_argument, NULL, OPTION_TIME_REPORT },
+        { "trace",       optional_argument, NULL, OPTION_TRACE },
+        { "trace-depth", required_argument, NULL, OPTION_TRACE_DEPTH },
+        { "mem-report",  optional_argument, NULL, OPTION_MEM_REPORT },
+        { "mem-budget",  required_argument, NULL, OPTION_MEM_BUDGET },
+        { "log",         required_argument, NULL, OPTION_LOG },
+        { "dump",        required_argument, NULL, OPTION_DUMP },
+        { "dump-limit",  required_argument, NULL, OPTION_DUMP_LIMIT },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL,       0,                 NULL, 0 }
+    };
+
+    optind = 0;
+
+    int opt;
+    while ( ( opt = getopt_long( argc, argv, "i:o:j:ch", long_options, NULL ) ) != -1 ) {
+        switch ( opt ) {
+            case 'i':
+                options->input_filename = optarg;
+                break;
+            case 'o':
+                options->output_filename = optarg;
+                break;
+            case 'c':
+                options->incremental = true;
+                break;
+            case 'j': {
+                char *end = NULL;
+                long threads = strtol( optarg, &end, 10 );
+                if ( !end || *end != '\0' || threads < 1 ) {
+                    PRINT_ERROR( "Bad thread count `%s`", optarg );
+                    return false;
+                }
+                options->threads = (size_t)threads;
+                break;
+            }
+            case OPTION_SAVE_AST:
+                options->ast_filename = optarg;
+                break;
+            case OPTION_OUT_DIR:
+                options->output_directory = optarg;
+                break;
+            case OPTION_MANIFEST:
+                options->manifest_filename = optarg;
+                break;
+            case OPTION_SERVER:
+                options->server = true;
+                break;
+            case OPTION_SOCKET:
+                options->socket_path = optarg;
+                break;
+            case OPTION_NO_CACHE:
+                options->no_cache = true;
+                break;
+            case OPTION_CACHE_STATS:
+                options->cache_stats = true;
+                break;
+            case OPTION_WATCH:
+                options->watch_directory = optarg;
+                break;
+            case OPTION_TIME_REPORT:
+                if ( !TimeReportParseFormat( optarg, &options->time_report ) ) {
+                    PRINT_ERROR( "Bad time report format `%s`, expected `json`", optarg );
+                    return false;
+                }
+                break;
+            case OPTION_TRACE:
+                options->trace_filename = optarg ? optarg : TRACE_DEFAULT_FILENAME;
+                break;
+            case OPTION_TRACE_DEPTH: {
+                char *end = NULL;
+                long depth = strtol( optarg, &end, 10 );
+                if ( !end || *end != '\0' || depth < 0 ) {
+                    PRINT_ERROR( "Bad trace depth `%s`", optarg );
+                    return false;
+                }
+                options->trace_depth = (size_t)depth;
+                break;
+            }
+            case OPTION_MEM_REPORT:
+                if ( !MemReportParseFormat( optarg, &options->mem_report ) ) {
+                    PRINT_ERROR( "Bad memory report format `%s`, expected `json`", optarg );
+                    return false;
+                }
+                break;
+            case OPTION_MEM_BUDGET:
+                if ( !MemReportParseBudget( optarg, &options->mem_budget ) ) {
+                    PRINT_ERROR( "Bad memory budget `%s`, expected mebibytes", optarg );
+                    return false;
+                }
+                break;
+            case OPTION_LOG:
+                options->log_spec = optarg;
+                break;
+            case OPTION_DUMP:
+                if ( !GraphDumpParseMode( optarg, &options->dump_mode ) ) {
+                    PRINT_ERROR( "Bad dump mode `%s`, expected `off`, `dot`, `async` or `batch`", optarg );
+                    return false;
+                }
+                break;
+            case OPTION_DUMP_LIMIT: {
+                char *end = NULL;
+                long limit = strtol( optarg, &end, 10 );
+                if ( !end || *end != '\0' || limit < 0 ) {
+                    PRINT_ERROR( "Bad dump node limit `%s`", optarg );
+                    return false;
+                }
+                options->dump_limit = (size_t)limit;
+                break;
+            }
+            case 'h':
+                HelpPrint( argv[0], &defaults );
+                return false;
+            case '?':
+            default:
+                return false;
+        }
+    }
+
+    options->inputs = argv + optind;
+    options->inputs_count = (size_t)( argc - optind );
+
+    if ( options->ast_filename && ( options->inputs_count || options->manifest_filename ) ) {
+        PRINT_ERROR( "--save-ast takes a single input file" );
+        return false;
+    }
+
+    return true;
+}
+
+static Tree_t *Frontend( const char *input_filename, const char *ast_filename, size_t threads, AstCache_t *cache ) {
+    Parser_t *parser = ParserCtorWithFiles( input_filename, ast_filename );
+    if ( !parser )
+        return NULL;
+
+    parser->threads = threads;
+    if ( cache ) {
+        // The parser borrows the cache for one compile and hands it back filled
+        parser->ast_cache = *cache;
+        ParseCached( parser );
+        *cache = parser->ast_cache;
+        parser->ast_cache = {};
+    } else {
+        Parse( parser );
+    }
+
+    if ( ast_filename && parser->tree && parser->tree->root )
+        TreeSaveToFile( parser->tree, ast_filename );
+
+    Tree_t *tree = ParserReleaseTree( parser );
+    ParserDtor( &parser );
+
+    if ( tree && !tree->root )
+        TreeDtor( &tree, NULL );
+
+    return tree;
+}
+
+bool CompileFile( const char *input_filename, const char *output_filename, const char *ast_filename, size_t threads,
+                  bool incremental, AstCache_t *cache, const BuildCache_t *build_cache ) {
+    // --save-ast needs the tree itself, -c refreshes <output>.cache as it generates;
+    // the source name goes into the assembly header
+    char key[BUILD_CACHE_KEY_LENGTH + 1] = "";
+    bool cached = build_cache && !ast_filename && !incremental && !IsStdStream( input_filename ) &&
+                  !IsStdStream( output_filename ) &&
+                  BuildCacheKey( build_cache, "lang", input_filename, input_filename, key );
+
+    if ( cached && BuildCacheFetch( build_cache, key, output_filename ) )
+        return true;
+
+    Tree_t *tree = Frontend( input_filename, ast_filename, threads, cache );
+    if ( !tree )
+        return false;
+
+    CodeGen_t *codegen = CodeGenCtor( input_filename, output_filename );
+    if ( !codegen ) {
+        PRINT_ERROR( "Failed to create code generator" );
+        TreeDtor( &tree, NULL );
+        return false;
+    }
+
+    codegen->tree = tree;
+    codegen->incremental = incremental;
+    GenerateCode( codegen );
+
+    CodeGenDtor( &codegen );
+
+    if ( cached )
+        BuildCacheStore( build_cache, key, output_filename );
+
+    return true;
+}
+
+static bool KnownFunction( const CacheKey_t *key, void *context ) {
+    return HasFunctionCode( (CodeGen_t *)context, key );
+}
+
+static bool EmitFunction( const CacheKey_t *key, Node_t *function, void *context ) {
+    return GenerateFunctionByKey( (CodeGen_t *)context, key, function );
+}
+
+FunctionsResult_t CompileFunctions( const char *input_filename, const char *output_filename, AstCache_t *cache,
+                                    FuncCache_t *func_cache ) {
+    my_assert( cache, "Null pointer on `cache`" );
+    my_assert( func_cache, "Null pointer on `func_cache`" );
+
+    Parser_t *parser = ParserCtorWithFiles( input_filename, NULL );
+    CodeGen_t *codegen = parser ? CodeGenCtor( input_filename, output_filename ) : NULL;
+    if ( !codegen ) {
+        ParserDtor( &parser );
+        return FUNCTIONS_FAILED;
+    }
+
+    // Both caches are borrowed for the compile, as in Frontend
+    parser->ast_cache = *cache;
+    codegen->func_cache = *func_cache;
+    codegen->incremental = true;
+    codegen->func_cache_in_memory = true;
+
+    GenerateCodeBegin( codegen );
+    FunctionsResult_t result = ParseFunctions( parser, KnownFunction, EmitFunction, codegen );
+    // Functions of the previous version of the file are not needed any more
+    if ( result == FUNCTIONS_DONE ) {
+        GenerateCodeEnd( codegen );
+        AstCacheSweep( &parser->ast_cache );
+    }
+
+    *cache = parser->ast_cache;
+    *func_cache = codegen->func_cache;
+    parser->ast_cache = {};
+    codegen->func_cache = {};
+
+    ParserDtor( &parser );
+    CodeGenDtor( &codegen );
+
+    return result;
+}
+
+double NowMilliseconds() {
+    struct timespec now = {};
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return (double)now.tv_sec * 1e3 + (double)now.tv_nsec / 1e6;
+}
+
+char *BatchOutputName( const char *output_directory, const char *input_filename ) {
+    const char *name = strrchr( input_filename, '/' );
+    name = name ? name + 1 : input_filename;
+
+    size_t name_length = strlen( name );
+    size_t extension_length = sizeof( SOURCE_EXTENSION ) - 1;
+    if ( name_length > extension_length && !strcmp( name + name_length - extension_length, SOURCE_EXTENSION ) )
+        name_length -= extension_length;
+
+    size_t length = strlen( output_directory ) + 1 + name_length + sizeof( OUTPUT_EXTENSION );
+    char *output_filename = (char *)calloc( length, sizeof( *output_filename ) );
+    if ( output_filename )
+        snprintf( output_filename, length, "%s/%.*s%s", output_directory, (int)name_length, name, OUTPUT_EXTENSION );
+
+    return output_filename;
+}
+
+static bool BatchAdd( Batch_t *batch, const char *output_directory, const char *input_filename ) {
+    if ( batch->count == batch->capacity ) {
+        size_t new_capacity = batch->capacity ? batch->capacity * 2 : BATCH_DEFAULT_CAPACITY;
+        BatchJob_t *new_jobs = (BatchJob_t *)realloc( batch->jobs, new_capacity * sizeof( *new_jobs ) );
+        if ( !new_jobs )
+            return false;
+
+        batch->jobs = new_jobs;
+        batch->capacity = new_capacity;
+    }
+
+    BatchJob_t job = {};
+    job.input_filename = input_filename;
+    job.output_filename = BatchOutputName( output_directory, input_filename );
+    if ( !job.output_filename )
+        return false;
+
+    batch->jobs[batch->count++] = job;
+    return true;
+}
+
+static int CompareOutputNames( const void *first, const void *second ) {
+    const BatchJob_t *first_job = *(const BatchJob_t *const *)first;
+    const BatchJob_t *second_job = *(const BatchJob_t *const *)second;
+
+    return strcmp( first_job->output_filename, second_job->output_filename );
+}
+
+// Inputs with one basename, like `a/p.lang` and `b/p.lang`, would write the same `.asm`
+// at the same time, so all of them fail instead
+static bool BatchMarkDuplicates( Batch_t *batch ) {
+    if ( batch->count < 2 )
+        return true;
+
+    BatchJob_t **sorted = (BatchJob_t **)calloc( batch->count, sizeof( *sorted ) );
+    if ( !sorted )
+        return false;
+
+    for ( size_t i = 0; i < batch->count; i++ )
+        sorted[i] = &batch->jobs[i];
+    qsort( sorted, batch->count, sizeof( *sorted ), CompareOutputNames );
+
+    for ( size_t i = 1; i < batch->count; i++ ) {
+        if ( strcmp( sorted[i - 1]->output_filename, sorted[i]->output_filename ) )
+            continue;
+
+        PRINT_ERROR( "Inputs `%s` and `%s` both compile to `%s`", sorted[i - 1]->input_filename,
+                     sorted[i]->input_filename, sorted[i]->output_filename );
+        sorted[i - 1]->duplicate = true;
+        sorted[i]->duplicate = true;
+    }
+
+    free( sorted );
+    return true;
+}
+
+// One path per line, empty lines and lines starting with `#` are skipped
+static bool BatchAddManifest( Batch_t *batch, const char *output_directory, const char *manifest_filename ) {
+    batch->manifest = ReadToBuffer( manifest_filename );
+    if ( !batch->manifest ) {
+        PRINT_ERROR( "Fail to read manifest `%s`", manifest_filename );
+        return false;
+    }
+
+    for ( char *line = batch->manifest; *line; ) {
+        char *end = strchr( line, '\n' );
+        char *next = end ? end + 1 : line + strlen( line );
+        if ( end )
+            *end = '\0';
+        if ( end && end > line && end[-1] == '\r' )
+            end[-1] = '\0';
+
+        if ( *line && *line != '#' && !BatchAdd( batch, output_directory, line ) )
+            return false;
+
+        line = next;
+    }
+
+    return true;
+}
+
+static void BatchDtor( Batch_t *batch ) {
+    for ( size_t i = 0; i < batch->count; i++ )
+        free( batch->jobs[i].output_filename );
+
+    free( batch->jobs );
+    free( batch->manifest );
+    *batch = {};
+}
+
+static void CompileJob( size_t job_index, void *context ) {
+    Batch_t *batch = (Batch_t *)context;
+    BatchJob_t *job = &batch->jobs[job_index];
+    if ( job->duplicate )
+        return;
+
+    const char *name = strrchr( job->input_filename, '/' );
+    TRACE_ZONE_DETAIL( "CompileFile", name ? name + 1 : job->input_filename );
+
+    double start = NowMilliseconds();
+    // Files are the unit of parallelism, nested pools would only oversubscribe the CPUs
+    job->compiled = CompileFile( job->input_filename, job->output_filename, NULL, 1, batch->incremental, NULL,
+                                 batch->build_cache );
+    job->milliseconds = NowMilliseconds() - start;
+}
+
+static int CompileBatch( const DriverOptions_t *options, const BuildCache_t *build_cache ) {
+    Batch_t batch = {};
+    batch.build_cache = build_cache;
+    batch.incremental = options->incremental;
+
+    bool prepared = true;
+    for ( size_t i = 0; i < options->inputs_count && prepared; i++ )
+        prepared = BatchAdd( &batch, options->output_directory, options->inputs[i] );
+    if ( prepared && options->manifest_filename )
+        prepared = BatchAddManifest( &batch, options->output_directory, options->manifest_filename );
+    prepared = prepared && BatchMarkDuplicates( &batch );
+
+    if ( !prepared || MakeDirectory( options->output_directory ) ) {
+        PRINT_ERROR( "Failed to prepare the batch" );
+        BatchDtor( &batch );
+        return 1;
+    }
+
+    double start = NowMilliseconds();
+    ParallelFor( batch.count, options->threads, CompileJob, &batch );
+    double total = NowMilliseconds() - start;
+
+    size_t failed = 0;
+    for ( size_t i = 0; i < batch.count; i++ ) {
+        const BatchJob_t *job = &batch.jobs[i];
+        printf( "%-4s %9.3f ms  %s -> %s\n", job->compiled ? "ok" : "FAIL", job->milliseconds, job->input_filename,
+                job->output_filename );
+        failed += !job->compiled;
+    }
+    printf( "%zu files: %zu compiled, %zu failed in %.3f ms\n", batch.count, batch.count - failed, failed, total );
+
+    BatchDtor( &batch );
+    return failed ? 1 : 0;
+}
+
+int DriverRun( int argc, char **argv, AstCache_t *cache ) {
+    DriverOptions_t options = {};
+    options.input_filename = "source.lang";
+    options.output_filename = "asm.txt";
+    options.output_directory = ".";
+    options.trace_depth = TRACE_DEFAULT_DEPTH;
+    options.dump_mode = GRAPH_DUMP_ASYNC;
+    options.dump_limit = GRAPH_DUMP_DEFAULT_NODE_LIMIT;
+
+    if ( !ParseDriverArgs( &options, argc, argv ) )
+        return 1;
+
+    // Set on every run: a server must not keep the report of an earlier request
+    if ( !LogConfigure( options.log_spec ) )
+        return 1;
+    TimeReportEnable( options.time_report );
+    if ( options.trace_filename )
+        TraceEnable( options.trace_filename, options.trace_depth );
+    else
+        TraceDisable();
+    MemReportEnable( options.mem_report, options.mem_budget );
+    GraphDumpConfigure( options.dump_mode, options.dump_limit );
+
+    if ( options.server ) {
+        if ( cache ) {
+            PRINT_ERROR( "Already talking to a server" );
+            return 1;
+        }
+
+        char socket_path[SOCKET_PATH_LENGTH] = "";
+        if ( options.socket_path )
+            snprintf( socket_path, sizeof( socket_path ), "%s", options.socket_path );
+        else
+            DefaultSocketPath( socket_path, sizeof( socket_path ) );
+
+        return ServerRun( socket_path );
+    }
+
+    if ( options.watch_directory ) {
+        if ( cache || options.inputs_count || options.manifest_filename ) {
+            PRINT_ERROR( "--watch takes no input files and does not run on a server" );
+            return 1;
+        }
+
+        return WatchRun( options.watch_directory, options.output_directory, options.threads );
+    }
+
+    BuildCache_t build_cache = {};
+    bool build_cache_opened = !options.no_cache && BuildCacheOpen( &build_cache );
+
+    if ( options.cache_stats ) {
+        if ( build_cache_opened )
+            BuildCachePrintStats( &build_cache, stdout );
+        else
+            printf( "Build cache is disabled\n" );
+
+        BuildCacheClose( &build_cache );
+        return 0;
+    }
+
+    const BuildCache_t *used_cache = build_cache_opened ? &build_cache : NULL;
+    int status = 0;
+
+    if ( options.inputs_count || options.manifest_filename )
+        status = CompileBatch( &options, used_cache );
+    else if ( !CompileFile( options.input_filename, options.output_filename, options.ast_filename, options.threads,
+                            options.incremental, cache, used_cache ) )
+        status = 1;
+
+    BuildCacheClose( &build_cache );
+    TimeReportPrint( stderr );
+    TraceWrite();
+    if ( !MemReportPrint( stderr ) )
+        status = 1;
+    if ( status || options.inputs_count || options.manifest_filename )
+        return status;
+
+    // The client is not the process that wrote the file, tell it where to look
+    if ( cache && !IsStdStream( options.output_filename ) )
+        fprintf( stderr, "%s -> %s\n", options.input_filename, options.output_filename );
+
+    return 0;
+}
+
+int main( int argc, char **argv ) {
+    return DriverRun( argc, argv, NULL );
+}
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "DebugUtils.h"
+#include "frontend/AstCache.h"
+
+// Bump when the text AST format or INIT_OPERATIONS spelling changes
+static const char AST_CACHE_HEADER[] = "lang-ast-cache 2\n";
+
+static AstCacheEntry_t *AsAstEntry( CacheEntry_t *entry ) {
+    return (AstCacheEntry_t *)entry;
+}
+
+static void EntryDelete( CacheEntry_t *base ) {
+    AstCacheEntry_t *entry = AsAstEntry( base );
+
+    free( entry->text );
+    NodeDelete( entry->subtree, NULL, NULL );
+    free( entry );
+}
+
+void AstCacheDtor( AstCache_t *cache ) {
+    my_assert( cache, "Null pointer on `cache`" );
+
+    CacheTableDtor( &( cache->table ), EntryDelete );
+}
+
+AstCacheEntry_t *AstCacheFind( AstCache_t *cache, const CacheKey_t *key ) {
+    my_assert( cache, "Null pointer on `cache`" );
+
+    return AsAstEntry( CacheTableFind( &( cache->table ), key ) );
+}
+
+AstCacheEntry_t *AstCacheInsert( AstCache_t *cache, const CacheKey_t *key, size_t tokens_count, char *text,
+                                 size_t text_length ) {
+    my_assert( cache, "Null pointer on `cache`" );
+    my_assert( key, "Null pointer on `key`" );
+
+    AstCacheEntry_t *entry = (AstCacheEntry_t *)calloc( 1, sizeof( *entry ) );
+    if ( !entry )
+        return NULL;
+
+    entry->base.key = *key;
+    entry->tokens_count = tokens_count;
+    entry->text = text;
+    entry->text_length = text_length;
+
+    if ( !CacheTableInsert( &( cache->table ), &( entry->base ), EntryDelete ) ) {
+        free( entry );
+        return NULL;
+    }
+
+    return entry;
+}
+
+void AstCacheSweep( AstCache_t *cache ) {
+    my_assert( cache, "Null pointer on `cache`" );
+
+    CacheTableSweep( &( cache->table ), EntryDelete );
+}
+
+// ===== On-disk format =====
+// AST_CACHE_HEADER, then for every entry a line
+//   <hash hex> <sha-256 hex> <source_length> <tokens_count> <text_length>
+// followed by text_length bytes of serialized AST and '\n'
+
+static bool ParseCacheFile( AstCache_t *cache, const char *data, size_t size ) {
+    size_t header_length = sizeof( AST_CACHE_HEADER ) - 1;
+    if ( size < header_length || memcmp( data, AST_CACHE_HEADER, header_length ) )
+        return false;
+
+    const char *pos = data + header_length;
+    const char *end = data + size;
+
+    while ( pos < end ) {
+        CacheKey_t key = {};
+        unsigned long long tokens_count = 0, text_length = 0;
+        if ( !CacheKeyRead( &pos, end, &key ) || !CacheReadNumber( &pos, end, 10, &tokens_count ) ||
+             !CacheReadNumber( &pos, end, 10, &text_length ) )
+            return false;
+
+        if ( pos >= end || *pos != '\n' || (size_t)( end - pos - 1 ) < text_length + 1 )
+            return false;
+        pos++;
+
+        char *text = (char *)calloc( text_length + 1, sizeof( *text ) );
+        if ( !text )
+            return false;
+        memcpy( text, pos, text_length );
+        pos += text_length + 1;
+
+        AstCacheEntry_t *entry = AstCacheInsert( cache, &key, tokens_count, text, text_length );
+        if ( !entry ) {
+            free( text );
+            return false;
+        }
+        entry->base.used = false;
+    }
+
+    return true;
+}
+
+bool AstCacheLoad( AstCache_t *cache, const char *path ) {
+    my_assert( cache, "Null pointer on `cache`" );
+    my_assert( path, "Null pointer on `path`" );
+
+    FILE *file = fopen( path, "rb" );
+    if ( !file ) {
+        LOG_DEBUG( LOG_CACHE, "No AST cache at `%s`", path );
+        return false;
+    }
+
+    fseek( file, 0, SEEK_END );
+    long size = ftell( file );
+    fseek( file, 0, SEEK_SET );
+
+    char *data = size > 0 ? (char *)calloc( (size_t)size + 1, sizeof( *data ) ) : NULL;
+    bool loaded = data && fread( data, 1, (size_t)size, file ) == (size_t)size &&
+                  ParseCacheFile( cache, data, (size_t)size );
+
+    free( data );
+    fclose( file );
+
+    if ( !loaded ) {
+        LOG_WARN( LOG_CACHE, "AST cache `%s` is damaged, starting empty", path );
+        AstCacheDtor( cache );
+    }
+
+    return loaded;
+}
+
+// Written to `<path>.tmp` and renamed, so a crash never leaves a torn cache
+bool AstCacheSave( const AstCache_t *cache, const char *path ) {
+    my_assert( cache, "Null pointer on `cache`" );
+    my_assert( path, "Null pointer on `path`" );
+
+    size_t tmp_length = strlen( path ) + sizeof( ".tmp" );
+    char *tmp_path = (char *)calloc( tmp_length, sizeof( *tmp_path ) );
+    if ( !tmp_path )
+        return false;
+    snprintf( tmp_path, tmp_length, "%s.tmp", path );
+
+    FILE *file = fopen( tmp_path, "wb" );
+    if ( !file ) {
+        PRINT_ERROR( "Fail to open file `%s`", tmp_path );
+        free( tmp_path );
+        return false;
+    }
+
+    fputs( AST_CACHE_HEADER, file );
+    for ( size_t i = 0; i < cache->table.capacity; i++ ) {
+        const AstCacheEntry_t *entry = (const AstCacheEntry_t *)cache->table.slots[i];
+        if ( !entry || !entry->text )
+            continue;
+
+        CacheKeyWrite( file, &( entry->base.key ) );
+        fprintf( file, " %zu %zu\n", entry->tokens_count, entry->text_length );
+        fwrite( entry->text, 1, entry->text_length, file );
+        fputc( '\n', file );
+    }
+
+    bool saved = !ferror( file );
+    saved = !fclose( file ) && saved;
+    saved = saved && !rename( tmp_path, path );
+    if ( !saved ) {
+        PRINT_ERROR( "Fail to write AST cache `%s`", path );
+        remove( tmp_path );
+    }
+
+    free( tmp_path );
+    return saved;
+}
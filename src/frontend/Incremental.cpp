@@ -0,0 +1,669 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "DebugUtils.h"
+#include "MemReport.h"
+#include "TimeReport.h"
+#include "Tree.h"
+#include "UtilsRW.h"
+#include "frontend/AstCache.h"
+#include "frontend/Parser.h"
+
+// ===== Incremental parsing =====
+// The source is cut into top-level functions by matching braces in the raw text (the
+// language has only `//` comments and no string literals, so braces are never quoted).
+// Every piece is keyed by its text (see CacheKey_t): a cached piece reuses its serialized
+// subtree without lexing or parsing, a new one is lexed and parsed by a private parser
+// and its subtree is serialized into the cache. Output is byte-identical to a full parse.
+// Token indices of syntax errors are shifted by the tokens of the preceding pieces, so
+// they match the full pass too. Anything the split cannot handle falls back to Parse.
+// The same split drives the streaming mode at the end of the file.
+
+const size_t PIECES_DEFAULT_CAPACITY = 64;
+
+static const char AST_CACHE_SUFFIX[] = ".cache";
+
+struct SourcePiece_t {
+    char *begin;
+    size_t length;
+};
+
+struct SourcePieces_t {
+    SourcePiece_t *pieces;
+    size_t count;
+    size_t capacity;
+};
+
+static char *SkipSpacesAndComments( char *pos ) {
+    while ( *pos ) {
+        if ( *pos == '/' && pos[1] == '/' ) {
+            while ( *pos && *pos != '\n' )
+                pos++;
+        } else if ( *pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r' || *pos == '\v' || *pos == '\f' ) {
+            pos++;
+        } else {
+            break;
+        }
+    }
+
+    return pos;
+}
+
+static bool PiecesPush( SourcePieces_t *pieces, char *begin, size_t length ) {
+    if ( pieces->count == pieces->capacity ) {
+        size_t new_capacity = pieces->capacity ? pieces->capacity * 2 : PIECES_DEFAULT_CAPACITY;
+        SourcePiece_t *new_pieces = (SourcePiece_t *)realloc( pieces->pieces, new_capacity * sizeof( *new_pieces ) );
+        if ( !new_pieces )
+            return false;
+
+        pieces->pieces = new_pieces;
+        pieces->capacity = new_capacity;
+    }
+
+    pieces->pieces[pieces->count++] = { begin, length };
+    return true;
+}
+
+enum PieceScan_t {
+    SCAN_PIECE_END,
+    SCAN_TEXT_END,
+    SCAN_UNBALANCED
+};
+
+// Moves `*pos` right after the `}` that closes brace depth 0, or to the terminating '\0'.
+// A piece takes everything since the previous one, leading comments included
+static PieceScan_t ScanPiece( char **pos, size_t *depth ) {
+    while ( *( *pos = SkipSpacesAndComments( *pos ) ) ) {
+        char symbol = *( ( *pos )++ );
+
+        if ( symbol == '{' ) {
+            ( *depth )++;
+        } else if ( symbol == '}' ) {
+            if ( !*depth )
+                return SCAN_UNBALANCED;
+            if ( !--( *depth ) )
+                return SCAN_PIECE_END;
+        }
+    }
+
+    return SCAN_TEXT_END;
+}
+
+// Fails on unbalanced braces or tokens after the last function
+static bool SplitSource( char *buffer, SourcePieces_t *pieces ) {
+    char *begin = buffer;
+    char *pos = buffer;
+    size_t depth = 0;
+
+    PieceScan_t scan = SCAN_PIECE_END;
+    while ( ( scan = ScanPiece( &pos, &depth ) ) == SCAN_PIECE_END ) {
+        if ( !PiecesPush( pieces, begin, (size_t)( pos - begin ) ) )
+            return false;
+        begin = pos;
+    }
+
+    return scan == SCAN_TEXT_END && depth == 0 && pieces->count > 0 && !*SkipSpacesAndComments( begin );
+}
+
+enum PieceResult_t {
+    PIECE_PARSED,
+    PIECE_SYNTAX_ERROR,
+    PIECE_LEXICAL_ERROR,
+    PIECE_NOT_A_FUNCTION,
+    PIECE_NO_MEMORY
+};
+
+static char *SerializeNode( const Node_t *node, size_t *length ) {
+    char *text = NULL;
+    FILE *stream = open_memstream( &text, length );
+    if ( !stream )
+        return NULL;
+
+    NodeSaveToStream( node, stream );
+
+    if ( fclose( stream ) ) {
+        free( text );
+        return NULL;
+    }
+
+    return text;
+}
+
+// Lexes and parses one piece with the private parser `sub`, on success `sub->tree` holds
+// the program block. The piece is cut out of the buffer with '\0' for the time of lexing
+static PieceResult_t LexAndParsePiece( Parser_t *parser, Parser_t *sub, char *begin, size_t length,
+                                       size_t token_offset, size_t *tokens_count ) {
+    sub->threads = 1;
+
+    char *end = begin + length;
+    char saved = *end;
+    *end = '\0';
+    Node_t **tokens = LexicalAnalyzeBuffer( sub, begin );
+    *end = saved;
+
+    if ( !tokens )
+        return PIECE_LEXICAL_ERROR;
+
+    *tokens_count = sub->tokens.size;
+    Node_t *program = SyntaxAnalyzeSilent( sub );
+    if ( !program ) {
+        ErrorListAppend( &( parser->errors ), &( sub->errors ), token_offset );
+        return PIECE_SYNTAX_ERROR;
+    }
+
+    sub->tree = TreeCtor();
+    sub->tree->root = program;
+
+    return PIECE_PARSED;
+}
+
+static PieceResult_t ParsePiece( Parser_t *parser, SourcePiece_t *piece, const CacheKey_t *key, size_t token_offset,
+                                 AstCacheEntry_t **entry, size_t *tokens_count ) {
+    Parser_t sub = {};
+    PieceResult_t result = LexAndParsePiece( parser, &sub, piece->begin, piece->length, token_offset, tokens_count );
+    if ( result != PIECE_PARSED ) {
+        ParserReset( &sub );
+        return result;
+    }
+
+    Node_t *program = sub.tree->root;
+    if ( program->value.data.block.count != 1 ) {
+        result = PIECE_NOT_A_FUNCTION;
+    } else {
+        size_t text_length = 0;
+        char *text = SerializeNode( program->value.data.block.items[0], &text_length );
+
+        *entry = text ? AstCacheInsert( &( parser->ast_cache ), key, *tokens_count, text, text_length )
+                      : NULL;
+        if ( !*entry ) {
+            free( text );
+            result = PIECE_NO_MEMORY;
+        }
+    }
+
+    ParserReset( &sub );
+    return result;
+}
+
+// Pieces with syntax errors are not cached, the rest are, so the next run after a fix
+// reparses only the broken functions
+static PieceResult_t ParsePieces( Parser_t *parser, SourcePieces_t *pieces, AstCacheEntry_t **entries ) {
+    size_t token_offset = 0;
+    size_t hits = 0;
+    PieceResult_t result = PIECE_PARSED;
+
+    for ( size_t i = 0; i < pieces->count; i++ ) {
+        SourcePiece_t *piece = &pieces->pieces[i];
+        CacheKey_t key = CacheKeyOf( piece->begin, piece->length );
+
+        entries[i] = AstCacheFind( &( parser->ast_cache ), &key );
+        if ( entries[i] && !entries[i]->text )
+            entries[i]->text = SerializeNode( entries[i]->subtree, &( entries[i]->text_length ) );
+        if ( entries[i] && !entries[i]->text )
+            return PIECE_NO_MEMORY;
+
+        if ( entries[i] ) {
+            hits++;
+            token_offset += entries[i]->tokens_count;
+            continue;
+        }
+
+        size_t tokens_count = 0;
+        PieceResult_t piece_result = ParsePiece( parser, piece, &key, token_offset, &entries[i], &tokens_count );
+        token_offset += tokens_count;
+
+        if ( piece_result == PIECE_SYNTAX_ERROR ) {
+            result = PIECE_SYNTAX_ERROR;
+        } else if ( piece_result != PIECE_PARSED ) {
+            return piece_result;
+        }
+    }
+
+    LOG_INFO( LOG_PARSER, "AST cache: %zu hits, %zu misses", hits, pieces->count - hits );
+    return result;
+}
+
+static char *CachePath( const char *output_filename ) {
+    size_t length = strlen( output_filename ) + sizeof( AST_CACHE_SUFFIX );
+    char *path = (char *)calloc( length, sizeof( *path ) );
+    if ( path )
+        snprintf( path, length, "%s%s", output_filename, AST_CACHE_SUFFIX );
+
+    return path;
+}
+
+static void WriteProgram( const char *filename, AstCacheEntry_t **entries, size_t count ) {
+    FILE *file_stream = OpenFile( filename, "w" );
+    if ( !file_stream ) {
+        PRINT_ERROR( "Fail to open file `%s`", filename );
+        return;
+    }
+
+    TimeScope_t scope = TimePhaseBegin();
+    uint64_t bytes = 0;
+
+    // Same bytes as TreeSaveToFile writes for the program block
+    fputs( "[ ", file_stream );
+    for ( size_t i = 0; i < count; i++ )
+        bytes += fwrite( entries[i]->text, 1, entries[i]->text_length, file_stream );
+    fputs( "] ", file_stream );
+
+    TimePhaseEnd( &scope, PHASE_AST_SAVE, { bytes + 4, 0, 0 } );
+
+    CloseFile( file_stream );
+}
+
+void ParseIncremental( Parser_t *parser ) {
+    my_assert( parser, "Null pointer on `parser`" );
+
+    // There is nothing to put the disk cache next to when writing to stdout
+    char *cache_path = IsStdStream( parser->output_filename ) ? NULL : CachePath( parser->output_filename );
+    if ( cache_path && !parser->ast_cache.table.count )
+        AstCacheLoad( &( parser->ast_cache ), cache_path );
+
+    char *buffer = ReadToBuffer( parser->input_filename );
+    if ( !buffer ) {
+        PRINT_ERROR( "Fail to read source from file `%s`", parser->input_filename );
+        free( cache_path );
+        return;
+    }
+
+    SourcePieces_t pieces = {};
+    AstCacheEntry_t **entries = NULL;
+    PieceResult_t result = PIECE_NOT_A_FUNCTION;
+
+    if ( SplitSource( buffer, &pieces ) &&
+         ( entries = (AstCacheEntry_t **)calloc( pieces.count, sizeof( *entries ) ) ) )
+        result = ParsePieces( parser, &pieces, entries );
+
+    switch ( result ) {
+        case PIECE_PARSED:
+            WriteProgram( parser->output_filename, entries, pieces.count );
+            break;
+        case PIECE_SYNTAX_ERROR:
+            // Same as a failed full pass: the tree is written as `nil`
+            ReportSyntaxErrors( parser );
+            parser->tree = TreeCtor();
+            TreeSaveToFile( parser->tree, parser->output_filename );
+            break;
+        case PIECE_LEXICAL_ERROR:
+            PRINT_ERROR( "Lexical analysis failed" );
+            break;
+        case PIECE_NOT_A_FUNCTION:
+        case PIECE_NO_MEMORY:
+        default:
+            LOG_INFO( LOG_PARSER, "Source does not split into functions, parsing it whole" );
+            free( parser->errors.errors );
+            parser->errors = {};
+            Parse( parser );
+            if ( parser->tree )
+                TreeSaveToFile( parser->tree, parser->output_filename );
+            break;
+    }
+
+    free( entries );
+    free( pieces.pieces );
+    free( buffer );
+
+    // Only functions of this version are kept, so the cache does not grow with edits
+    AstCacheSweep( &( parser->ast_cache ) );
+    if ( cache_path && result != PIECE_LEXICAL_ERROR )
+        AstCacheSave( &( parser->ast_cache ), cache_path );
+    free( cache_path );
+}
+
+// ===== Incremental parsing into a tree =====
+// Same split and cache for compiles that keep the AST in memory: every function of the
+// program is a copy of the cached subtree, so the caller may change and free the tree.
+// Entries loaded from the disk cache get their subtree from the text on first use.
+
+static Node_t *CachedSubtree( Parser_t *parser, SourcePiece_t *piece, const CacheKey_t *key, size_t token_offset,
+                              size_t *tokens_count, PieceResult_t *result ) {
+    AstCacheEntry_t *entry = AstCacheFind( &( parser->ast_cache ), key );
+    if ( entry ) {
+        if ( !entry->subtree )
+            entry->subtree = NodeLoadFromString( entry->text, NULL, 0 );
+
+        *tokens_count = entry->tokens_count;
+        *result = entry->subtree ? PIECE_PARSED : PIECE_NOT_A_FUNCTION;
+        return entry->subtree ? NodeCopy( entry->subtree ) : NULL;
+    }
+
+    Parser_t sub = {};
+    *result = LexAndParsePiece( parser, &sub, piece->begin, piece->length, token_offset, tokens_count );
+
+    Node_t *function = NULL;
+    if ( *result == PIECE_PARSED && sub.tree->root->value.data.block.count != 1 ) {
+        *result = PIECE_NOT_A_FUNCTION;
+    } else if ( *result == PIECE_PARSED ) {
+        entry = AstCacheInsert( &( parser->ast_cache ), key, *tokens_count, NULL, 0 );
+        if ( entry ) {
+            entry->subtree = NodeCopy( sub.tree->root->value.data.block.items[0] );
+            function = NodeCopy( entry->subtree );
+        } else {
+            *result = PIECE_NO_MEMORY;
+        }
+    }
+
+    ParserReset( &sub );
+    return function;
+}
+
+void ParseCached( Parser_t *parser ) {
+    my_assert( parser, "Null pointer on `parser`" );
+
+    char *buffer = ReadToBuffer( parser->input_filename );
+    if ( !buffer ) {
+        PRINT_ERROR( "Fail to read source from file `%s`", parser->input_filename );
+        return;
+    }
+
+    SourcePieces_t pieces = {};
+    PieceResult_t result = PIECE_NOT_A_FUNCTION;
+    Node_t *program = NULL;
+
+    if ( SplitSource( buffer, &pieces ) ) {
+        program = BlockCreate( NULL );
+        result = PIECE_PARSED;
+
+        size_t token_offset = 0;
+        for ( size_t i = 0; i < pieces.count; i++ ) {
+            SourcePiece_t *piece = &pieces.pieces[i];
+            CacheKey_t key = CacheKeyOf( piece->begin, piece->length );
+
+            size_t tokens_count = 0;
+            PieceResult_t piece_result = PIECE_PARSED;
+            Node_t *function = CachedSubtree( parser, piece, &key, token_offset, &tokens_count, &piece_result );
+            token_offset += tokens_count;
+
+            if ( function )
+                BlockAppend( program, function );
+
+            if ( piece_result == PIECE_SYNTAX_ERROR ) {
+                result = PIECE_SYNTAX_ERROR;
+            } else if ( piece_result != PIECE_PARSED ) {
+                result = piece_result;
+                break;
+            }
+        }
+    }
+
+    free( pieces.pieces );
+    free( buffer );
+
+    if ( result != PIECE_PARSED )
+        NodeDelete( program, NULL, NULL );
+
+    switch ( result ) {
+        case PIECE_PARSED:
+            parser->tree = TreeCtor();
+            parser->tree->root = program;
+            break;
+        case PIECE_SYNTAX_ERROR:
+            ReportSyntaxErrors( parser );
+            parser->tree = TreeCtor();
+            break;
+        case PIECE_LEXICAL_ERROR:
+            PRINT_ERROR( "Lexical analysis failed" );
+            break;
+        case PIECE_NOT_A_FUNCTION:
+        case PIECE_NO_MEMORY:
+        default:
+            LOG_INFO( LOG_PARSER, "Source does not split into functions, parsing it whole" );
+            free( parser->errors.errors );
+            parser->errors = {};
+            Parse( parser );
+            break;
+    }
+}
+
+// ===== Parsing for a consumer with its own cache =====
+// Same split and AST cache, but a function whose text the consumer already knows is not
+// even copied out of the cache: only its token count is taken, so error positions of the
+// later functions stay those of a full pass.
+
+FunctionsResult_t ParseFunctions( Parser_t *parser, FunctionKnown_t known, FunctionSink_t sink, void *context ) {
+    my_assert( parser, "Null pointer on `parser`" );
+    my_assert( known, "Null pointer on `known`" );
+    my_assert( sink, "Null pointer on `sink`" );
+
+    char *buffer = ReadToBuffer( parser->input_filename );
+    if ( !buffer ) {
+        PRINT_ERROR( "Fail to read source from file `%s`", parser->input_filename );
+        return FUNCTIONS_FAILED;
+    }
+
+    SourcePieces_t pieces = {};
+    PieceResult_t result = SplitSource( buffer, &pieces ) ? PIECE_PARSED : PIECE_NOT_A_FUNCTION;
+
+    size_t token_offset = 0;
+    for ( size_t i = 0; i < pieces.count && ( result == PIECE_PARSED || result == PIECE_SYNTAX_ERROR ); i++ ) {
+        SourcePiece_t *piece = &pieces.pieces[i];
+        CacheKey_t key = CacheKeyOf( piece->begin, piece->length );
+
+        // After an error only the token counts matter
+        AstCacheEntry_t *entry = AstCacheFind( &( parser->ast_cache ), &key );
+        bool reused = entry && ( result != PIECE_PARSED || known( &key, context ) );
+
+        size_t tokens_count = 0;
+        PieceResult_t piece_result = PIECE_PARSED;
+        Node_t *function = NULL;
+        if ( reused )
+            tokens_count = entry->tokens_count;
+        else
+            function = CachedSubtree( parser, piece, &key, token_offset, &tokens_count, &piece_result );
+        token_offset += tokens_count;
+
+        if ( piece_result != PIECE_PARSED ) {
+            result = piece_result;
+        } else if ( result != PIECE_PARSED ) {
+            NodeDelete( function, NULL, NULL );
+        } else if ( !sink( &key, function, context ) ) {
+            result = PIECE_NO_MEMORY;
+        }
+    }
+
+    free( pieces.pieces );
+    free( buffer );
+
+    switch ( result ) {
+        case PIECE_PARSED:
+            return FUNCTIONS_DONE;
+        case PIECE_SYNTAX_ERROR:
+            ReportSyntaxErrors( parser );
+            return FUNCTIONS_FAILED;
+        case PIECE_LEXICAL_ERROR:
+            PRINT_ERROR( "Lexical analysis failed" );
+            return FUNCTIONS_FAILED;
+        case PIECE_NOT_A_FUNCTION:
+        case PIECE_NO_MEMORY:
+        default:
+            free( parser->errors.errors );
+            parser->errors = {};
+            return FUNCTIONS_NOT_SPLIT;
+    }
+}
+
+// ===== Streaming parsing =====
+// The source is read in blocks and every function is lexed, parsed, written and freed as
+// soon as its closing `}` arrives, so memory holds one function instead of the program.
+// Reading stdin and writing stdout this way lets lang-front and lang-back run as a pipeline.
+// Only complete lines are scanned: a `//` comment never spans a scan boundary. After an
+// unmatched `}` the rest of the input is parsed as one piece, which reports the errors.
+
+const size_t STREAM_READ_SIZE = 1 << 16;
+
+struct SourceStream_t {
+    FILE *file;
+    char *buffer;
+    size_t size;
+    size_t capacity;
+    bool eof;
+};
+
+struct StreamState_t {
+    FILE *output;
+    size_t token_offset;
+    size_t functions_count;
+    bool syntax_error;
+    bool lexical_error;
+};
+
+static bool StreamFill( SourceStream_t *stream ) {
+    if ( stream->capacity < stream->size + STREAM_READ_SIZE + 1 ) {
+        size_t new_capacity = stream->capacity ? stream->capacity : STREAM_READ_SIZE + 1;
+        while ( new_capacity < stream->size + STREAM_READ_SIZE + 1 )
+            new_capacity *= 2;
+
+        char *new_buffer = (char *)realloc( stream->buffer, new_capacity );
+        if ( !new_buffer )
+            return false;
+        MemCount( MEM_IO_BUFFERS, new_capacity );
+
+        stream->buffer = new_buffer;
+        stream->capacity = new_capacity;
+    }
+
+    size_t read = fread( stream->buffer + stream->size, 1, STREAM_READ_SIZE, stream->file );
+    stream->size += read;
+    stream->buffer[stream->size] = '\0';
+    stream->eof = read < STREAM_READ_SIZE;
+
+    return !ferror( stream->file );
+}
+
+static void StreamPiece( Parser_t *parser, StreamState_t *state, char *begin, size_t length ) {
+    Parser_t sub = {};
+    size_t tokens_count = 0;
+
+    switch ( LexAndParsePiece( parser, &sub, begin, length, state->token_offset, &tokens_count ) ) {
+        case PIECE_PARSED: {
+            // After the first error the output is `nil` anyway, pieces are parsed only for errors
+            const NodeBlock *functions = &( sub.tree->root->value.data.block );
+            for ( size_t i = 0; i < functions->count && !state->syntax_error; i++ )
+                NodeSaveToStream( functions->items[i], state->output );
+            state->functions_count += functions->count;
+            break;
+        }
+        case PIECE_SYNTAX_ERROR:
+            state->syntax_error = true;
+            break;
+        case PIECE_LEXICAL_ERROR:
+        case PIECE_NOT_A_FUNCTION:
+        case PIECE_NO_MEMORY:
+        default:
+            state->lexical_error = true;
+            break;
+    }
+
+    state->token_offset += tokens_count;
+    ParserReset( &sub );
+}
+
+// Scans the complete lines of the buffer and streams every finished piece. Returns the
+// offset of the first byte not yet streamed
+static size_t StreamScan( Parser_t *parser, StreamState_t *state, SourceStream_t *stream, size_t begin,
+                          size_t *scan, size_t *depth, bool *unbalanced ) {
+    size_t lines_end = stream->size;
+    if ( !stream->eof ) {
+        const char *newline = (const char *)memrchr( stream->buffer + *scan, '\n', stream->size - *scan );
+        lines_end = newline ? (size_t)( newline - stream->buffer ) + 1 : *scan;
+    }
+
+    char saved = stream->buffer[lines_end];
+    stream->buffer[lines_end] = '\0';
+
+    char *pos = stream->buffer + *scan;
+    PieceScan_t result = SCAN_PIECE_END;
+    while ( !state->lexical_error && ( result = ScanPiece( &pos, depth ) ) == SCAN_PIECE_END ) {
+        size_t end = (size_t)( pos - stream->buffer );
+        StreamPiece( parser, state, stream->buffer + begin, end - begin );
+        begin = end;
+    }
+
+    stream->buffer[lines_end] = saved;
+    *scan = (size_t)( pos - stream->buffer );
+    *unbalanced = result == SCAN_UNBALANCED;
+
+    return begin;
+}
+
+static bool StreamSource( Parser_t *parser, StreamState_t *state, SourceStream_t *stream ) {
+    size_t begin = 0;
+    size_t scan = 0;
+    size_t depth = 0;
+    bool unbalanced = false;
+
+    while ( !state->lexical_error ) {
+        if ( !StreamFill( stream ) ) {
+            PRINT_ERROR( "Fail to read source from file `%s`", parser->input_filename );
+            return false;
+        }
+
+        if ( !unbalanced )
+            begin = StreamScan( parser, state, stream, begin, &scan, &depth, &unbalanced );
+
+        if ( stream->eof )
+            break;
+
+        // Streamed text is not needed any more
+        memmove( stream->buffer, stream->buffer + begin, stream->size - begin );
+        stream->size -= begin;
+        scan -= begin;
+        begin = 0;
+    }
+
+    // The tail goes through the parser if it has tokens or is all there is: it reports
+    // an unfinished function, stray tokens or an empty program like a full pass
+    char *tail = stream->buffer + begin;
+    if ( !state->lexical_error && ( *SkipSpacesAndComments( tail ) || !state->token_offset ) )
+        StreamPiece( parser, state, tail, stream->size - begin );
+
+    return true;
+}
+
+void ParseStreaming( Parser_t *parser ) {
+    my_assert( parser, "Null pointer on `parser`" );
+
+    SourceStream_t stream = {};
+    stream.file = OpenFile( parser->input_filename, "r" );
+    if ( !stream.file ) {
+        PRINT_ERROR( "Fail to read source from file `%s`", parser->input_filename );
+        return;
+    }
+
+    StreamState_t state = {};
+    state.output = OpenFile( parser->output_filename, "w" );
+    if ( !state.output ) {
+        PRINT_ERROR( "Fail to open file `%s`", parser->output_filename );
+        CloseFile( stream.file );
+        return;
+    }
+
+    fputs( "[ ", state.output );
+    bool streamed = StreamSource( parser, &state, &stream );
+
+    CloseFile( stream.file );
+    free( stream.buffer );
+
+    if ( streamed && !state.syntax_error && !state.lexical_error )
+        fputs( "] ", state.output );
+    CloseFile( state.output );
+
+    LOG_INFO( LOG_PARSER, "Streamed %zu functions, %zu tokens", state.functions_count, state.token_offset );
+
+    // Written functions cannot be taken back from stdout: the unclosed `[` fails the reader
+    bool rewritable = !IsStdStream( parser->output_filename );
+    if ( state.lexical_error ) {
+        PRINT_ERROR( "Lexical analysis failed" );
+        if ( rewritable )
+            remove( parser->output_filename );
+    } else if ( state.syntax_error ) {
+        // Same as a failed full pass: the tree is written as `nil`
+        ReportSyntaxErrors( parser );
+        parser->tree = TreeCtor();
+        if ( rewritable )
+            TreeSaveToFile( parser->tree, parser->output_filename );
+    }
+}
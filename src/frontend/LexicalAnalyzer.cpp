@@ -4,6 +4,9 @@
 #include <string.h>
 
 #include "DebugUtils.h"
+#include "MemReport.h"
+#include "ThreadPool.h"
+#include "TimeReport.h"
 #include "UtilsRW.h"
 #include "frontend/Parser.h"
 
@@ -35,11 +38,14 @@ static Node_t *TokenNumber( const char **cur_pos ) {
     TreeData_t value = {};
     value.type = NODE_NUMBER;
 
-    int read_bytes = 0;
-    sscanf( *cur_pos, "%d%n", &( value.data.number ), &read_bytes );
-    ( *cur_pos ) += read_bytes;
+    // Not sscanf: glibc runs strlen over the rest of the buffer on every call
+    char *end = NULL;
+    value.data.number = (int)strtol( *cur_pos, &end, 10 );
+    if ( end == *cur_pos )
+        return NULL;
+    *cur_pos = end;
 
-    PRINT( "Number: %d", value.data.number );
+    LOG_TRACE( LOG_LEXER, "Number: %d", value.data.number );
 
     return NodeCreate( value, NULL );
 }
@@ -59,27 +65,28 @@ static Node_t *TokenVariable( const char **cur_pos ) {
     buffer[i] = '\0';
 
     value.data.variable = strdup( buffer );
+    MemCount( MEM_STRINGS, (size_t)i + 1 );
 
-    PRINT( "Variable: `%s`", value.data.variable );
+    LOG_TRACE( LOG_LEXER, "Variable: `%s`", value.data.variable );
 
     return NodeCreate( value, NULL );
 }
 
 static bool MatchOperation( const char *str, OperationType *out_op, size_t *out_len ) {
-    bool found = false;
-
-#define CHECK_OP( token_str, op_enum, is_custom, nargs, ... )                                                     \
-    if ( !found && strncmp( str, token_str, strlen( token_str ) ) == 0 ) {                                   \
-        *out_op = op_enum;                                                                                   \
-        *out_len = strlen( token_str );                                                                      \
-        found = true;                                                                                        \
-        PRINT( "Operation: `%s`", token_str );                                                                 \
-    }
+    size_t length = 0;
+    OperationType op = MatchOperationPrefix( str, &length );
+    if ( op == OP_NOPE )
+        return false;
+
+    // Keywords are not matched inside identifiers: `iffy` is a variable, not `if` + `fy`
+    if ( isalpha( (unsigned char)str[0] ) && ( isalnum( (unsigned char)str[length] ) || str[length] == '_' ) )
+        return false;
 
-    INIT_OPERATIONS( CHECK_OP );
-#undef CHECK_OP
+    *out_op = op;
+    *out_len = length;
+    LOG_TRACE( LOG_LEXER, "Operation: `%s`", GetOperationInfo( op )->token );
 
-    return found;
+    return true;
 }
 
 static Node_t *ReadToken( const char **pos ) {
@@ -92,7 +99,7 @@ static Node_t *ReadToken( const char **pos ) {
     if ( !**pos )
         return NULL;
 
-    PRINT( "Cur. position: \n'`%s`", *pos );
+    LOG_TRACE( LOG_LEXER, "At: `%.20s`", *pos );
 
     const char *start = *pos;
 
@@ -108,54 +115,152 @@ static Node_t *ReadToken( const char **pos ) {
         return TokenVariable( pos );
     }
 
-    PRINT_ERROR( "Lexical error: unexpected character '%c' at: \"%.20s\"\n", **pos, start );
-    ( *pos )++;
+    // Unexpected character: `*pos` stays on it, the caller reports the error
     return NULL;
 }
 
+// ===== Parallel lexing =====
+// The language has only `//` line comments and no string literals, and no token spans
+// a newline, so the buffer is cut into chunks right after a '\n' and the chunks are
+// lexed independently into their own token arrays, then concatenated in order.
+// Cut points are moved forward to the next newline, so a chunk always starts at the
+// beginning of a line and never inside a comment. The '\n' at a cut is replaced with
+// '\0': ReadToken stops at the end of its chunk and treats it like a line end.
+
+const size_t LEX_MIN_CHUNK_SIZE    = 1 << 20;
+const size_t LEX_CHUNKS_PER_THREAD = 4;
+
+struct LexChunk_t {
+    const char *begin;
+    TokenArray_t tokens;
+
+    const char *error_pos; // first unexpected character, NULL if none
+    bool out_of_memory;
+};
+
+static size_t SplitIntoChunks( char *buffer, size_t size, size_t threads, LexChunk_t *chunks, size_t max_chunks ) {
+    size_t wanted = size / LEX_MIN_CHUNK_SIZE;
+    if ( wanted > threads * LEX_CHUNKS_PER_THREAD )
+        wanted = threads * LEX_CHUNKS_PER_THREAD;
+    if ( wanted > max_chunks )
+        wanted = max_chunks;
+
+    size_t count = 0;
+    chunks[count++].begin = buffer;
+
+    size_t step = wanted > 1 ? size / wanted : size;
+    size_t cut = 0;
+    for ( size_t i = 1; i < wanted; i++ ) {
+        if ( cut < i * step )
+            cut = i * step;
+
+        char *newline = (char *)memchr( buffer + cut, '\n', size - cut );
+        if ( !newline )
+            break;
+
+        *newline = '\0';
+        cut = (size_t)( newline - buffer ) + 1;
+        chunks[count++].begin = buffer + cut;
+    }
+
+    return count;
+}
+
+static void LexChunk( size_t chunk_index, void *context ) {
+    LexChunk_t *chunk = &( (LexChunk_t *)context )[chunk_index];
+    TRACE_FUNCTION();
+
+    const char *pos = chunk->begin;
+    while ( *pos ) {
+        Node_t *token = ReadToken( &pos );
+        if ( !token ) {
+            // NULL is either the end of the chunk after spaces/comments or an error
+            if ( *pos )
+                chunk->error_pos = pos;
+            return;
+        }
+
+        if ( !TokenArrayPushBack( &chunk->tokens, token ) ) {
+            NodeDelete( token, NULL, NULL );
+            chunk->out_of_memory = true;
+            return;
+        }
+    }
+}
+
 Node_t **LexicalAnalyze( Parser_t *parser ) {
     my_assert( parser, "Null pointer on `parser`" );
 
-    PRINT( "Start lexical analization" );
+    TRACE_FUNCTION();
 
-    TokenArray_t tokens = TokenArrayCreate();
+    LOG_INFO( LOG_LEXER, "Start lexical analization" );
 
     char *buffer = ReadToBuffer( parser->input_filename );
     if ( !buffer ) {
         PRINT_ERROR( "Fail to read source from file `%s`", parser->input_filename );
         return NULL;
     }
-    PRINT( "Succesful reading to buffer" );
+    LOG_INFO( LOG_LEXER, "Succesful reading to buffer" );
 
-    const char *pos = buffer;
-    while ( *pos ) {
-        Node_t *token = ReadToken( &pos );
-        if ( !token ) {
-            // If ReadToken returns NULL, it could be EOF (after skipping spaces) or an error
-            // Check if we're at EOF (no more non-whitespace characters)
-            SkipSpaces( &pos );
-            SkipComments( &pos );
-            if ( !*pos ) {
-                // End of input reached normally
-                break;
-            }
-            // Otherwise it's a real error
-            TokenArrayDestroy( &tokens );
-            return NULL;
+    Node_t **tokens = LexicalAnalyzeBuffer( parser, buffer );
+    free( buffer );
+
+    return tokens;
+}
+
+Node_t **LexicalAnalyzeBuffer( Parser_t *parser, char *buffer ) {
+    my_assert( parser, "Null pointer on `parser`" );
+    my_assert( buffer, "Null pointer on `buffer`" );
+
+    TRACE_FUNCTION();
+
+    size_t threads = parser->threads ? parser->threads : DefaultThreadsCount();
+    size_t max_chunks = threads * LEX_CHUNKS_PER_THREAD;
+
+    LexChunk_t *chunks = (LexChunk_t *)calloc( max_chunks, sizeof( *chunks ) );
+    if ( !chunks ) {
+        PRINT_ERROR( "Memory allocation error" );
+        return NULL;
+    }
+
+    TimeScope_t scope = TimePhaseBegin();
+    size_t buffer_length = strlen( buffer );
+    size_t chunks_count = SplitIntoChunks( buffer, buffer_length, threads, chunks, max_chunks );
+    LOG_INFO( LOG_LEXER, "Lexing in %zu chunks", chunks_count );
+
+    ParallelFor( chunks_count, threads, LexChunk, chunks );
+
+    // Errors are reported for the first failing chunk only, as a serial pass would
+    TokenArray_t tokens = TokenArrayCreate();
+    bool failed = false;
+    for ( size_t i = 0; i < chunks_count; i++ ) {
+        if ( !failed && chunks[i].error_pos ) {
+            PRINT_ERROR( "Lexical error: unexpected character '%c' at: \"%.20s\"\n", *chunks[i].error_pos,
+                         chunks[i].error_pos );
+            failed = true;
+        } else if ( !failed && chunks[i].out_of_memory ) {
+            PRINT_ERROR( "Memory allocation error" );
+            failed = true;
         }
 
-        if ( !TokenArrayPushBack( &tokens, token ) ) {
-            NodeDelete( token, NULL, NULL );
-            TokenArrayDestroy( &tokens );
-            return NULL;
+        if ( failed || !TokenArrayAppend( &tokens, &chunks[i].tokens ) ) {
+            failed = true;
+            TokenArrayDestroy( &chunks[i].tokens );
         }
     }
 
-    parser->tokens = tokens;
+    free( chunks );
 
-    free( buffer );
+    TimePhaseEnd( &scope, PHASE_LEX, { buffer_length, failed ? 0 : tokens.size, 0 } );
+
+    if ( failed ) {
+        TokenArrayDestroy( &tokens );
+        return NULL;
+    }
+
+    parser->tokens = tokens;
 
-    PRINT( "Finish lexixal analization" );
+    LOG_INFO( LOG_LEXER, "Finish lexixal analization" );
 
     return tokens.data;
 }
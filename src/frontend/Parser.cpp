@@ -1,4 +1,4 @@
-#include <assert.h>
+#include <getopt.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,14 +6,40 @@
 #include <unistd.h>
 
 #include "DebugUtils.h"
+#include "GraphDump.h"
+#include "MemReport.h"
+#include "TimeReport.h"
 #include "Tree.h"
-#include "UtilsRW.h"
 #include "frontend/Parser.h"
 
 static void HelpPrint( const char *program_name, const char *default_input, const char *default_output ) {
-    printf( "Usage: %s [-i input_file] [-o output_file]\n", program_name );
-    printf( "  -i FILE   input source file (default: %s)\n", default_input );
-    printf( "  -o FILE   output tree file (default: %s)\n", default_output );
+    printf( "Usage: %s [-i input_file] [-o output_file] [-j threads] [-c | -s] [--time-report[=json]]\n"
+            "          [--trace[=FILE]] [--trace-depth N] [--mem-report[=json]] [--mem-budget MIB] [--log SPEC]\n"
+            "          [--dump MODE] [--dump-limit N]\n",
+            program_name );
+    printf( "  -i FILE   input source file, `-` for stdin (default: %s)\n", default_input );
+    printf( "  -o FILE   output tree file, `-` for stdout (default: %s)\n", default_output );
+    printf( "  -j N      lex and parse on N threads (default: one per CPU)\n" );
+    printf( "  -c        incremental: reparse only functions changed since the last run\n" );
+    printf( "  -s        streaming: write every function as soon as it is parsed, on one thread\n" );
+    printf( "  --time-report[=json]\n" );
+    printf( "            print time and throughput of every phase to stderr, as a table or JSON\n" );
+    printf( "  --trace[=FILE]\n" );
+    printf( "            write a Chrome trace of the compiler zones (default: %s)\n", TRACE_DEFAULT_FILENAME );
+    printf( "  --trace-depth N\n" );
+    printf( "            levels of grammar functions in the trace (default: %zu)\n", TRACE_DEFAULT_DEPTH );
+    printf( "  --mem-report[=json]\n" );
+    printf( "            print allocations and peak RSS of every phase to stderr, as a table or JSON\n" );
+    printf( "  --mem-budget MIB\n" );
+    printf( "            fail when the compile raises the RSS by more than MIB mebibytes\n" );
+    printf( "  --log SPEC\n" );
+    printf( "            log levels, e.g. `info` or `warn,lexer=trace` (default: $LANG_LOG)\n" );
+    printf( "  --dump MODE\n" );
+    printf( "            graph dumps of debug builds to %s/: off, dot, async or batch (default: async)\n",
+            GRAPH_DUMP_DIRECTORY );
+    printf( "  --dump-limit N\n" );
+    printf( "            nodes drawn per dump, the rest is collapsed, 0 - all (default: %zu)\n",
+            GRAPH_DUMP_DEFAULT_NODE_LIMIT );
     printf( "  -h        show this help\n" );
 }
 
@@ -24,10 +50,33 @@ static bool ParseArgs( Parser_t *parser, int argc, char **argv ) {
     parser->input_filename = strdup( default_input );
     parser->output_filename = strdup( default_output );
 
+    enum { OPTION_TIME_REPORT = 256, OPTION_TRACE, OPTION_TRACE_DEPTH, OPTION_MEM_REPORT, OPTION_MEM_BUDGET, OPTION_LOG,
+           OPTION_DUMP, OPTION_DUMP_LIMIT };
+    static const struct option long_options[] = {
+        { "time-report", optional_argument, NULL, OPTION_TIME_REPORT },
+        { "trace",       optional_argument, NULL, OPTION_TRACE },
+        { "trace-depth", required_argument, NULL, OPTION_TRACE_DEPTH },
+        { "mem-report",  optional_argument, NULL, OPTION_MEM_REPORT },
+        { "mem-budget",  required_argument, NULL, OPTION_MEM_BUDGET },
+        { "log",         required_argument, NULL, OPTION_LOG },
+        { "dump",        required_argument, NULL, OPTION_DUMP },
+        { "dump-limit",  required_argument, NULL, OPTION_DUMP_LIMIT },
+        { NULL, 0, NULL, 0 }
+    };
+
+    // The depth may come after --trace, the budget after --mem-report
+    size_t trace_depth = TRACE_DEFAULT_DEPTH;
+    const char *trace_filename = NULL;
+    MemReportFormat_t mem_format = MEM_REPORT_OFF;
+    uint64_t mem_budget = 0;
+    const char *log_spec = NULL;
+    GraphDumpMode_t dump_mode = GRAPH_DUMP_ASYNC;
+    size_t dump_limit = GRAPH_DUMP_DEFAULT_NODE_LIMIT;
+
     optind = 0;
 
     int opt;
-    while ( ( opt = getopt( argc, argv, "i:o:h" ) ) != -1 ) {
+    while ( ( opt = getopt_long( argc, argv, "i:o:j:csh", long_options, NULL ) ) != -1 ) {
         switch ( opt ) {
             case 'i': {
                 free( parser->input_filename );
@@ -39,6 +88,75 @@ static bool ParseArgs( Parser_t *parser, int argc, char **argv ) {
                 parser->output_filename = optarg ? strdup( optarg ) : NULL;
                 break;
             }
+            case 'j': {
+                char *end = NULL;
+                long threads = strtol( optarg, &end, 10 );
+                if ( !end || *end != '\0' || threads < 1 ) {
+                    PRINT_ERROR( "Bad thread count `%s`", optarg );
+                    return false;
+                }
+                parser->threads = (size_t)threads;
+                break;
+            }
+            case 'c':
+                parser->incremental = true;
+                break;
+            case 's':
+                parser->streaming = true;
+                break;
+            case OPTION_TIME_REPORT: {
+                TimeReportFormat_t format = TIME_REPORT_OFF;
+                if ( !TimeReportParseFormat( optarg, &format ) ) {
+                    PRINT_ERROR( "Bad time report format `%s`, expected `json`", optarg );
+                    return false;
+                }
+                TimeReportEnable( format );
+                break;
+            }
+            case OPTION_TRACE:
+                trace_filename = optarg ? optarg : TRACE_DEFAULT_FILENAME;
+                break;
+            case OPTION_TRACE_DEPTH: {
+                char *end = NULL;
+                long depth = strtol( optarg, &end, 10 );
+                if ( !end || *end != '\0' || depth < 0 ) {
+                    PRINT_ERROR( "Bad trace depth `%s`", optarg );
+                    return false;
+                }
+                trace_depth = (size_t)depth;
+                break;
+            }
+            case OPTION_MEM_REPORT:
+                if ( !MemReportParseFormat( optarg, &mem_format ) ) {
+                    PRINT_ERROR( "Bad memory report format `%s`, expected `json`", optarg );
+                    return false;
+                }
+                break;
+            case OPTION_MEM_BUDGET:
+                if ( !MemReportParseBudget( optarg, &mem_budget ) ) {
+                    PRINT_ERROR( "Bad memory budget `%s`, expected mebibytes", optarg );
+                    return false;
+                }
+                break;
+            case OPTION_LOG:
+                log_spec = optarg;
+                break;
+            case OPTION_DUMP:
+                if ( !GraphDumpParseMode( optarg, &dump_mode ) ) {
+                    PRINT_ERROR( "Bad dump mode `%s`, expected `off`, `dot`, `async` or `batch`", optarg );
+                    return false;
+                }
+                break;
+            case OPTION_DUMP_LIMIT: {
+                char *end = NULL;
+                long limit = strtol( optarg, &end, 10 );
+                if ( !end || *end != '\0' || limit < 0 ) {
+                    PRINT_ERROR( "Bad dump node limit `%s`", optarg );
+                    return false;
+                }
+                dump_limit = (size_t)limit;
+                break;
+            }
             case 'h':
                 HelpPrint( argv[0], default_input, default_output );
                 return false;
@@ -48,31 +166,15 @@ static bool ParseArgs( Parser_t *parser, int argc, char **argv ) {
         }
     }
 
-    return true;
-}
-
-#ifdef _DEBUG
-static void DumpCtor( Log_t *logging ) {
-    my_assert( logging, "Null pointer on `logging`" );
-    logging->log_path = strdup( "dump_front" );
-
-    char buffer[MAX_LEN_PATH] = {};
-
-    snprintf( buffer, MAX_LEN_PATH, "%s/images", logging->log_path );
-    logging->img_log_path = strdup( buffer );
-
-    int mkdir_result = MakeDirectory( logging->log_path );
-    assert( !mkdir_result && "Error creating directory for dump" );
-    mkdir_result = MakeDirectory( logging->img_log_path );
-    assert( !mkdir_result && "Error creating directory for dump images" );
+    if ( !LogConfigure( log_spec ) )
+        return false;
+    if ( trace_filename )
+        TraceEnable( trace_filename, trace_depth );
+    MemReportEnable( mem_format, mem_budget );
+    GraphDumpConfigure( dump_mode, dump_limit );
 
-    snprintf( buffer, MAX_LEN_PATH, "%s/index.html", logging->log_path );
-    logging->log_file = fopen( buffer, "w" );
-    assert( logging->log_file && "Error opening file" );
-
-    logging->image_number = 0;
+    return true;
 }
-#endif
 
 Parser_t *ParserCtor( int argc, char **argv ) {
     my_assert( argv && *argv, "Null pointer on `argv`" );
@@ -84,38 +186,69 @@ Parser_t *ParserCtor( int argc, char **argv ) {
     }
 
     if ( !ParseArgs( parser, argc, argv ) ) {
+        free( parser->input_filename );
+        free( parser->output_filename );
         free( parser );
         return NULL;
     }
-    PRINT( "Input file  = `%s`", parser->input_filename );
-    PRINT( "Output file = `%s`", parser->output_filename );
+    LOG_DEBUG( LOG_PARSER, "Input file  = `%s`", parser->input_filename );
+    LOG_DEBUG( LOG_PARSER, "Output file = `%s`", parser->output_filename );
 
-    ON_DEBUG( DumpCtor( &( parser->logging ) ) );
+    return parser;
+}
+
+Parser_t *ParserCtorWithFiles( const char *input_filename, const char *output_filename ) {
+    my_assert( input_filename, "Null pointer on `input_filename`" );
+
+    Parser_t *parser = (Parser_t *)calloc( 1, sizeof( *parser ) );
+    if ( !parser ) {
+        PRINT_ERROR( "Memory allocation error" );
+        return NULL;
+    }
+
+    parser->input_filename = strdup( input_filename );
+    parser->output_filename = output_filename ? strdup( output_filename ) : NULL;
+    LOG_DEBUG( LOG_PARSER, "Input file  = `%s`", parser->input_filename );
 
     return parser;
 }
 
-#ifdef _DEBUG
-static void DumpDtor( Log_t *logging ) {
-    my_assert( logging, "Null pointer on `logging" );
+Tree_t *ParserReleaseTree( Parser_t *parser ) {
+    my_assert( parser, "Null pointer on `parser`" );
 
-    int fclose_result = fclose( logging->log_file );
-    if ( fclose_result ) {
-        PRINT_ERROR( "Fail to close file with logs \n" );
+    // Tokens linked into the AST go with the tree, the rest (braces, `;`, ...) stay with the array
+    Tree_t *tree = parser->tree;
+    if ( tree && tree->root ) {
+        TokenArray_t *tokens = &( parser->tokens );
+        for ( size_t i = 0; i < tokens->size; i++ ) {
+            if ( tokens->data[i] && ( tokens->data[i]->parent || tokens->data[i] == tree->root ) )
+                tokens->data[i] = NULL;
+        }
     }
 
-    free( logging->log_path );
-    free( logging->img_log_path );
+    parser->tree = NULL;
+    return tree;
+}
+
+void ParserReset( Parser_t *parser ) {
+    my_assert( parser, "Null pointer on `parser`" );
+
+    Tree_t *tree = ParserReleaseTree( parser );
+    TreeDtor( &tree, NULL );
+
+    TokenArrayDestroy( &( parser->tokens ) );
+    TokenArrayDestroy( &( parser->own_nodes ) );
+
+    free( parser->errors.errors );
+    parser->errors = {};
 }
-#endif
 
 void ParserDtor( Parser_t **parser ) {
     my_assert( parser && *parser, "Null pointer on `parse`" );
 
-    ON_DEBUG( DumpDtor( &( ( *parser )->logging ) ); )
-    TokenArrayDestroy( &( ( *parser )->tokens ) );
+    ParserReset( *parser );
+    AstCacheDtor( &( ( *parser )->ast_cache ) );
 
-    free( ( *parser )->tree );
     free( ( *parser )->input_filename );
     free( ( *parser )->output_filename );
 
@@ -136,45 +269,21 @@ void Parse( Parser_t *parser ) {
     parser->tree = TreeCtor();
     parser->tree->root = root;
 
-    PRINT( "root = %p", parser->tree->root );
-    ParserDump( parser, "After pasring my code" );
+    LOG_DEBUG( LOG_PARSER, "root = %p", parser->tree->root );
+    ON_DEBUG( ParserDump( parser, "After pasring my code" ) );
 }
 
 #ifdef _DEBUG
-#define PRINT_HTML( fmt, ... ) fprintf( parser->logging.log_file, fmt, ##__VA_ARGS__ );
-
-static void PrintCustomMessage( Parser_t *parser, const char *format_string, va_list args ) {
-    my_assert( parser, "Null pointer on `parser`" );
-    my_assert( format_string, "Null pointer on `format_string`" );
-
-    PRINT_HTML( "<pre>" );
-    vfprintf( parser->logging.log_file, format_string, args );
-    PRINT_HTML( "</pre>\n" );
-}
-
+// Snapshots of all parsers of the process share one index.html, see GraphDump.h
 void ParserDump( Parser_t *parser, const char *format_string, ... ) {
     my_assert( parser, "Null pointer for `parser`" );
+    my_assert( format_string, "Null pointer on `format_string`" );
 
-    PRINT_HTML( "<h3>DUMP</h3>\n" );
-
-    if ( format_string ) {
-        va_list args;
-        va_start( args, format_string );
-        PrintCustomMessage( parser, format_string, args );
-        va_end( args );
-    }
-
-    if ( parser->tree ) {
-        NodeGraphicDump( parser->tree->root, "%s/image%lu.dot", parser->logging.img_log_path,
-                         parser->logging.image_number );
-        PRINT_HTML( "<img src=\"images/image%lu.dot.svg\" style=\"width:auto; height:400;\">\n",
-                    parser->logging.image_number++ );
-    }
-
-    fflush( parser->logging.log_file );
+    va_list args;
+    va_start( args, format_string );
+    GraphDumpTree( parser->tree ? parser->tree->root : NULL, format_string, args );
+    va_end( args );
 
-    PRINT( "Succesful Dump" );
+    LOG_DEBUG( LOG_PARSER, "Succesful Dump" );
 }
-
-#undef PRINT_HTML
 #endif
@@ -2,6 +2,9 @@
 #include <string.h>
 
 #include "DebugUtils.h"
+#include "MemReport.h"
+#include "ThreadPool.h"
+#include "TimeReport.h"
 #include "Tree.h"
 #include "UtilsRW.h"
 #include "frontend/Parser.h"
@@ -13,24 +16,23 @@
 // Function    ::= "main" "(" ")" Block
 //              | "func" Variable "(" ParamList? ")" Block
 // ParamList   ::= Variable { "," Variable }
-// OPSeq       ::= OP { OP }                // OP+
+// OPSeq       ::= OP { [ ";" ] OP }        // OP+
 // OP          ::= Block
 //              | Assignment ";"
 //              | Expression ";"
 //              | IfStmt
 //              | WhileStmt
 //              | ReturnStmt ";"
-// Block       ::= "{" OPSeq? "}" [ ";" ]
+// Block       ::= "{" OPSeq "}" [ ";" ]     // в AST - узел NODE_BLOCK со списком операторов
 // Assignment  ::= Variable ( ":=" | "=" ) Expression
 // ReturnStmt  ::= "return" Expression
 // IfStmt      ::= "if" "(" Expression ")" OP [ "else" OP ] [ ";" ]
 // WhileStmt   ::= "while" "(" Expression ")" OP [ ";" ]
-// Expression  ::= Term { ("+" | "-") Term }*
-// Term        ::= Pow { ("*" | "/") Pow }*
-// Pow         ::= Unary { "^" Unary }
-// Unary       ::= "sqrt" "(" Expression ")"
-//              | Primary
-// Primary     ::= Number
+// Expression  ::= Operand { InfixOp Operand }  // Pratt: приоритет и ассоциативность -
+//                                               // столбцы lbp/rbp в INIT_OPERATIONS
+// InfixOp     ::= "+" | "-" | "*" | "/" | "^"   // ^ правоассоциативен
+// Operand     ::= Number
+//              | "sqrt" "(" Expression ")"
 //              | "input" "(" ")"
 //              | "print" "(" Expression ")"
 //              | "call" Variable "(" ArgList? ")"
@@ -47,6 +49,18 @@ static bool MatchToken( Parser_t *parser, size_t index, OperationType op ) {
     return tok->value.type == NODE_OPERATION && (OperationType)tok->value.data.operation == op;
 }
 
+// Блоки и заголовки функций создаёт сам парсер, а не берёт из массива токенов.
+// Они регистрируются здесь: при успехе ими владеет дерево, после синтаксических ошибок
+// они освобождаются вместе со списком, а токенами по-прежнему владеет массив токенов
+static Node_t *OwnNode( Parser_t *parser, Node_t *node ) {
+    if ( node && !TokenArrayPushBack( &parser->own_nodes, node ) ) {
+        PRINT_ERROR( "Memory allocation error" );
+        abort();
+    }
+
+    return node;
+}
+
 static bool MatchVariable( Parser_t *parser, size_t index ) {
     if ( AtEnd( parser, index ) )
         return false;
@@ -54,6 +68,105 @@ static bool MatchVariable( Parser_t *parser, size_t index ) {
     return tok->value.type == NODE_VARIABLE;
 }
 
+static void DescribeToken( Parser_t *parser, size_t index, char *buffer, size_t size ) {
+    if ( AtEnd( parser, index ) ) {
+        snprintf( buffer, size, "end of input" );
+        return;
+    }
+
+    Node_t *tok = parser->tokens.data[index];
+    if ( tok->value.type == NODE_OPERATION )
+        snprintf( buffer, size, "%s", GetOperationInfo( (OperationType)tok->value.data.operation )->token );
+    else if ( tok->value.type == NODE_NUMBER )
+        snprintf( buffer, size, "%d", tok->value.data.number );
+    else if ( tok->value.type == NODE_VARIABLE )
+        snprintf( buffer, size, "%s", tok->value.data.variable ? tok->value.data.variable : "(null)" );
+    else
+        snprintf( buffer, size, "?" );
+}
+
+static void ErrorListPush( ErrorList_t *list, const SyntaxError_t *error ) {
+    if ( list->count >= MAX_SYNTAX_ERRORS ) {
+        list->dropped++;
+        return;
+    }
+
+    if ( list->count >= list->capacity ) {
+        size_t new_capacity = list->capacity ? list->capacity * 2 : 4;
+        if ( new_capacity > MAX_SYNTAX_ERRORS )
+            new_capacity = MAX_SYNTAX_ERRORS;
+
+        SyntaxError_t *new_errors = (SyntaxError_t *)realloc( list->errors, new_capacity * sizeof( *new_errors ) );
+        if ( !new_errors ) {
+            list->dropped++;
+            return;
+        }
+
+        list->errors = new_errors;
+        list->capacity = new_capacity;
+    }
+
+    list->errors[list->count++] = *error;
+}
+
+// Ограничение на размер `dst` по-прежнему действует
+void ErrorListAppend( ErrorList_t *dst, ErrorList_t *src, size_t token_offset ) {
+    for ( size_t i = 0; i < src->count; i++ ) {
+        src->errors[i].token_index += token_offset;
+        ErrorListPush( dst, &src->errors[i] );
+    }
+    dst->dropped += src->dropped;
+
+    free( src->errors );
+    *src = {};
+}
+
+static void RecordSyntaxError( Parser_t *parser, size_t index, const char *expected ) {
+    SyntaxError_t error = {};
+    error.token_index = index;
+    error.expected = expected;
+    DescribeToken( parser, index, error.found, sizeof( error.found ) );
+
+    ErrorListPush( &parser->errors, &error );
+}
+
+// ===== Восстановление после ошибок (panic mode) =====
+// Ошибка в операторе раскручивает разбор до ближайшего GetOPSeq, который пропускает
+// токены до `;` (съедается), до `}` или `func`/`main` (остаются) и продолжает со
+// следующего оператора. Вложенные `{ }` пропускаются целиком, закрытый блок тоже
+// считается концом оператора. Ошибка в заголовке функции или за её пределами
+// пропускает всё до следующего `func`/`main`.
+
+static void SynchronizeStatement( Parser_t *parser, size_t *index ) {
+    size_t depth = 0;
+
+    while ( !AtEnd( parser, *index ) ) {
+        if ( depth == 0 && ( MatchToken( parser, *index, OP_FUNC ) || MatchToken( parser, *index, OP_MAIN ) ) )
+            return;
+
+        if ( MatchToken( parser, *index, OP_OPEN_BRACE ) ) {
+            depth++;
+        } else if ( MatchToken( parser, *index, OP_CLOSE_BRACE ) ) {
+            if ( depth == 0 )
+                return;
+            if ( --depth == 0 ) {
+                ( *index )++;
+                return;
+            }
+        } else if ( depth == 0 && MatchToken( parser, *index, OP_SEMICOLON ) ) {
+            ( *index )++;
+            return;
+        }
+
+        ( *index )++;
+    }
+}
+
+static void SynchronizeFunction( Parser_t *parser, size_t *index ) {
+    while ( !AtEnd( parser, *index ) && !MatchToken( parser, *index, OP_FUNC ) && !MatchToken( parser, *index, OP_MAIN ) )
+        ( *index )++;
+}
+
 static Node_t *GetGrammar( Parser_t *parser, size_t *index, bool *error );
 static Node_t *GetProgram( Parser_t *parser, size_t *index, bool *error );
 static Node_t *GetFunction( Parser_t *parser, size_t *index, bool *error );
@@ -65,58 +178,72 @@ static Node_t *GetReturnStmt( Parser_t *parser, size_t *index, bool *error );
 static Node_t *GetIfStmt( Parser_t *parser, size_t *index, bool *error );
 static Node_t *GetWhileStmt( Parser_t *parser, size_t *index, bool *error );
 static Node_t *GetExpression( Parser_t *parser, size_t *index, bool *error );
-static Node_t *GetTerm( Parser_t *parser, size_t *index, bool *error );
-static Node_t *GetPow( Parser_t *parser, size_t *index, bool *error );
-static Node_t *GetUnary( Parser_t *parser, size_t *index, bool *error );
-static Node_t *GetPrimary( Parser_t *parser, size_t *index, bool *error );
 static Node_t *GetBlock( Parser_t *parser, size_t *index, bool *error );
-static Node_t *GetArgList( Parser_t *parser, size_t *index, bool *error );
 
 Node_t *SyntaxAnalyze( Parser_t *parser ) {
     my_assert( parser, "Null pointer on `parser`" );
 
-    PRINT( "Start syntax analysis" );
+    Node_t *node = SyntaxAnalyzeSilent( parser );
+    if ( !node )
+        ReportSyntaxErrors( parser );
 
+    return node;
+}
+
+Node_t *SyntaxAnalyzeSilent( Parser_t *parser ) {
+    my_assert( parser, "Null pointer on `parser`" );
+
+    LOG_INFO( LOG_PARSER, "Start syntax analysis" );
+
+    TimeScope_t scope = TimePhaseBegin();
     bool error = false;
     size_t index = 0;
     Node_t *node = GetGrammar( parser, &index, &error );
 
-    if ( error ) {
-        PRINT_ERROR( "SyntaxAnalyze failed near token %zu/%zu", index, parser->tokens.size );
-        if ( !AtEnd( parser, index ) ) {
-            Node_t *tok = parser->tokens.data[index];
-            if ( tok->value.type == NODE_OPERATION )
-                PRINT_ERROR( "Current token: OP %d", tok->value.data.operation );
-            else if ( tok->value.type == NODE_NUMBER )
-                PRINT_ERROR( "Current token: NUMBER %d", tok->value.data.number );
-            else if ( tok->value.type == NODE_VARIABLE )
-                PRINT_ERROR( "Current token: VAR %s", tok->value.data.variable ? tok->value.data.variable : "(null)" );
-            else
-                PRINT_ERROR( "Current token: UNKNOWN" );
-        }
+    // Узлы считаются только для отчёта: без него лишний обход дерева не нужен
+    size_t nodes_count = 0;
+    if ( scope.start && node )
+        NodeHash( node, 0, &nodes_count, NULL );
+    TimePhaseEnd( &scope, PHASE_PARSE, { 0, index, nodes_count } );
 
-        PRINT_ERROR( "The expression was not considered correct." );
+    if ( error || parser->errors.count || parser->errors.dropped ) {
+        // Частично собранное дерево не нужно: токены освободит массив токенов, остальное - own_nodes
+        TokenArrayDestroy( &parser->own_nodes );
         TreeDtor( &( parser->tree ), NULL );
         return NULL;
     }
 
-    if ( !AtEnd( parser, index ) ) {
-        PRINT_ERROR( "Unexpected tokens at end of input" );
-        return NULL;
-    }
+    // Узлы парсера теперь принадлежат дереву
+    free( parser->own_nodes.data );
+    parser->own_nodes = TokenArrayCreate();
 
-    PRINT( "The program was considered correct." );
+    LOG_INFO( LOG_PARSER, "The program was considered correct." );
     return node;
 }
 
+void ReportSyntaxErrors( const Parser_t *parser ) {
+    my_assert( parser, "Null pointer on `parser`" );
+
+    const ErrorList_t *errors = &parser->errors;
+    for ( size_t i = 0; i < errors->count; i++ )
+        PRINT_ERROR( "Syntax error at token %zu: %s, found `%s`", errors->errors[i].token_index,
+                     errors->errors[i].expected, errors->errors[i].found );
+    if ( errors->dropped )
+        PRINT_ERROR( "... and %zu more syntax errors", errors->dropped );
+
+    PRINT_ERROR( "The expression was not considered correct: %zu syntax error(s).", errors->count + errors->dropped );
+}
+
 #define SyntaxError( msg )                                                                                     \
     do {                                                                                                       \
-        PRINT_ERROR( "Syntax error: %s at token %zu", msg, *index );                                           \
+        RecordSyntaxError( parser, *index, msg );                                                              \
         *error = true;                                                                                         \
         return NULL;                                                                                           \
     } while ( 0 )
 
 static Node_t *GetGrammar( Parser_t *parser, size_t *index, bool *error ) {
+    TRACE_NESTED_ZONE( __func__ );
+
     my_assert( parser, "Null pointer on `parser`" );
     my_assert( index, "Null pointer on `index`" );
     my_assert( error, "Null pointer on `error`" );
@@ -124,44 +251,185 @@ static Node_t *GetGrammar( Parser_t *parser, size_t *index, bool *error ) {
     return GetProgram( parser, index, error );
 }
 
+// ===== Параллельный разбор функций верхнего уровня =====
+// Функции верхнего уровня независимы: предварительный проход по токенам находит их
+// границы по парным скобкам, каждая разбирается отдельным заданием ParallelFor,
+// а GetProgram склеивает результаты в исходном порядке. Если разбиение не чистое
+// (лишние токены между функциями, непарные скобки), разбор идёт последовательно.
+// Задание пишет ошибки и созданные узлы в свою копию Parser_t, после join они
+// переносятся в parser по порядку функций - вывод не зависит от числа потоков.
+
+const size_t PARALLEL_MIN_FUNCTIONS         = 64;
+const size_t FUNCTION_JOBS_DEFAULT_CAPACITY = 64;
+
+struct FunctionJob_t {
+    size_t begin;
+    size_t end;
+
+    Node_t *function;
+    ErrorList_t errors;
+    TokenArray_t own_nodes;
+};
+
+struct FunctionJobs_t {
+    Parser_t *parser;
+    FunctionJob_t *jobs;
+    size_t count;
+    size_t capacity;
+};
+
+static bool FunctionJobsPush( FunctionJobs_t *jobs, size_t begin, size_t end ) {
+    if ( jobs->count >= jobs->capacity ) {
+        size_t new_capacity = jobs->capacity ? jobs->capacity * 2 : FUNCTION_JOBS_DEFAULT_CAPACITY;
+        FunctionJob_t *new_jobs = (FunctionJob_t *)realloc( jobs->jobs, new_capacity * sizeof( *new_jobs ) );
+        if ( !new_jobs )
+            return false;
+
+        jobs->jobs = new_jobs;
+        jobs->capacity = new_capacity;
+    }
+
+    FunctionJob_t *job = &jobs->jobs[jobs->count++];
+    memset( job, 0, sizeof( *job ) );
+    job->begin = begin;
+    job->end = end;
+
+    return true;
+}
+
+// Каждая функция - `func`/`main`, затем токены до закрытия первой `{` на глубине 0.
+// Других `func`/`main` внутри быть не должно: тогда восстановление после ошибки
+// (SynchronizeFunction) останавливается ровно на границе задания
+static bool SplitFunctions( Parser_t *parser, size_t index, FunctionJobs_t *jobs ) {
+    while ( !AtEnd( parser, index ) ) {
+        if ( !MatchToken( parser, index, OP_FUNC ) && !MatchToken( parser, index, OP_MAIN ) )
+            return false;
+
+        size_t begin = index;
+        size_t depth = 0;
+
+        for ( index++; !AtEnd( parser, index ); index++ ) {
+            if ( MatchToken( parser, index, OP_OPEN_BRACE ) ) {
+                depth++;
+            } else if ( MatchToken( parser, index, OP_CLOSE_BRACE ) ) {
+                if ( depth == 0 )
+                    return false;
+                if ( --depth == 0 )
+                    break;
+            } else if ( MatchToken( parser, index, OP_FUNC ) || MatchToken( parser, index, OP_MAIN ) ) {
+                return false;
+            }
+        }
+
+        if ( AtEnd( parser, index ) )
+            return false;
+
+        index++;
+        if ( !FunctionJobsPush( jobs, begin, index ) )
+            return false;
+    }
+
+    return true;
+}
+
+static void ParseFunctionJob( size_t job_index, void *context ) {
+    FunctionJobs_t *jobs = (FunctionJobs_t *)context;
+    FunctionJob_t *job = &jobs->jobs[job_index];
+
+    // Токены общие, списки ошибок и узлов - свои
+    Parser_t view = *jobs->parser;
+    view.own_nodes = TokenArrayCreate();
+    view.errors = {};
+
+    bool error = false;
+    size_t index = job->begin;
+    job->function = GetFunction( &view, &index, &error );
+
+    // Так же, как последовательный GetProgram: лишние токены до следующей функции - ошибка
+    if ( !error && index != job->end )
+        RecordSyntaxError( &view, index, "Expected 'func' or 'main'" );
+
+    job->errors = view.errors;
+    job->own_nodes = view.own_nodes;
+}
+
+static Node_t *GetProgramParallel( Parser_t *parser, size_t *index, FunctionJobs_t *jobs ) {
+    TRACE_NESTED_ZONE( __func__ );
+
+    ParallelFor( jobs->count, parser->threads, ParseFunctionJob, jobs );
+
+    Node_t *program = OwnNode( parser, BlockCreate( NULL ) );
+    for ( size_t i = 0; i < jobs->count; i++ ) {
+        FunctionJob_t *job = &jobs->jobs[i];
+
+        if ( job->function )
+            BlockAppend( program, job->function );
+
+        ErrorListAppend( &parser->errors, &job->errors, 0 );
+        if ( !TokenArrayAppend( &parser->own_nodes, &job->own_nodes ) ) {
+            PRINT_ERROR( "Memory allocation error" );
+            abort();
+        }
+    }
+
+    *index = jobs->jobs[jobs->count - 1].end;
+    return program;
+}
+
 static Node_t *GetProgram( Parser_t *parser, size_t *index, bool *error ) {
+    TRACE_NESTED_ZONE( __func__ );
+
     my_assert( parser, "Null pointer on `parser`" );
     my_assert( index, "Null pointer on `index`" );
     my_assert( error, "Null pointer on `error`" );
 
-    Node_t *head = GetFunction( parser, index, error );
-    if ( *error || !head )
-        return head;
+    size_t threads = parser->threads ? parser->threads : DefaultThreadsCount();
+    if ( threads > 1 ) {
+        FunctionJobs_t jobs = { parser, NULL, 0, 0 };
+        Node_t *program = NULL;
+        bool parallel = SplitFunctions( parser, *index, &jobs ) && jobs.count >= PARALLEL_MIN_FUNCTIONS;
+
+        if ( parallel ) {
+            LOG_INFO( LOG_PARSER, "Parsing %zu functions on %zu threads", jobs.count, threads );
+            program = GetProgramParallel( parser, index, &jobs );
+        }
+
+        free( jobs.jobs );
+        if ( parallel )
+            return program;
+    }
+
+    // Все функции программы - один блок
+    Node_t *program = OwnNode( parser, BlockCreate( NULL ) );
 
     while ( !AtEnd( parser, *index ) ) {
-        if ( MatchToken( parser, *index, OP_FUNC ) || MatchToken( parser, *index, OP_MAIN ) ) {
-            Node_t *next = GetFunction( parser, index, error );
-            if ( *error )
-                return NULL;
-
-            // Соединяем функции через ;
-            TreeData_t semicolon_data;
-            semicolon_data.type = NODE_OPERATION;
-            semicolon_data.data.operation = OP_SEMICOLON;
-            Node_t *semicolon = NodeCreate( semicolon_data, NULL );
-
-            semicolon->left = head;
-            semicolon->right = next;
-            if ( head )
-                head->parent = semicolon;
-            if ( next )
-                next->parent = semicolon;
-
-            head = semicolon;
-        } else {
-            break;
+        if ( !MatchToken( parser, *index, OP_FUNC ) && !MatchToken( parser, *index, OP_MAIN ) ) {
+            RecordSyntaxError( parser, *index, "Expected 'func' or 'main'" );
+            SynchronizeFunction( parser, index );
+            continue;
         }
+
+        bool function_error = false;
+        Node_t *function = GetFunction( parser, index, &function_error );
+        if ( function_error ) {
+            SynchronizeFunction( parser, index );
+            continue;
+        }
+
+        BlockAppend( program, function );
     }
 
-    return head;
+    if ( program->value.data.block.count == 0 && parser->errors.count == 0 ) {
+        RecordSyntaxError( parser, *index, "Expected 'func' or 'main'" );
+        *error = true;
+    }
+
+    return program;
 }
 
 static Node_t *GetFunction( Parser_t *parser, size_t *index, bool *error ) {
+    TRACE_NESTED_ZONE( __func__ );
+
     my_assert( parser, "Null pointer on `parser`" );
     my_assert( index, "Null pointer on `index`" );
     my_assert( error, "Null pointer on `error`" );
@@ -177,7 +445,8 @@ static Node_t *GetFunction( Parser_t *parser, size_t *index, bool *error ) {
         TreeData_t name_data;
         name_data.type = NODE_VARIABLE;
         name_data.data.variable = strdup("main");
-        func_name = NodeCreate( name_data, NULL );
+        MemCount( MEM_STRINGS, sizeof( "main" ) );
+        func_name = OwnNode( parser, NodeCreate( name_data, NULL ) );
     } else if ( MatchToken( parser, *index, OP_FUNC ) ) {
         func_token = parser->tokens.data[*index];
         (*index)++;
@@ -214,7 +483,7 @@ static Node_t *GetFunction( Parser_t *parser, size_t *index, bool *error ) {
     TreeData_t comma_data;
     comma_data.type = NODE_OPERATION;
     comma_data.data.operation = OP_COMMA;
-    Node_t *comma_node = NodeCreate( comma_data, NULL );
+    Node_t *comma_node = OwnNode( parser, NodeCreate( comma_data, NULL ) );
 
     comma_node->left = func_name;
     comma_node->right = params;
@@ -235,6 +504,8 @@ static Node_t *GetFunction( Parser_t *parser, size_t *index, bool *error ) {
 }
 
 static Node_t *GetParamList( Parser_t *parser, size_t *index, bool *error ) {
+    TRACE_NESTED_ZONE( __func__ );
+
     my_assert( parser, "Null pointer on `parser`" );
     my_assert( index, "Null pointer on `index`" );
     my_assert( error, "Null pointer on `error`" );
@@ -288,70 +559,56 @@ static bool IsStatementStart( Parser_t *parser, size_t index ) {
     if ( tok->value.type == NODE_OPERATION ) {
         OperationType op = (OperationType)tok->value.data.operation;
         return op == OP_OPEN_BRACE || op == OP_IF || op == OP_WHILE || 
-               op == OP_OPEN_PARENT || op == OP_RETURN || op == OP_IN || op == OP_OUT;
+               op == OP_OPEN_PARENT || op == OP_RETURN || op == OP_IN || op == OP_OUT ||
+               op == OP_CALL || op == OP_SQRT;
     }
 
     return false;
 }
 
 static Node_t *GetOPSeq( Parser_t *parser, size_t *index, bool *error, OperationType stop_op ) {
+    TRACE_NESTED_ZONE( __func__ );
+
     my_assert( parser, "Null pointer on `parser`" );
     my_assert( index, "Null pointer on `index`" );
     my_assert( error, "Null pointer on `error`" );
 
-    Node_t *head = GetOP( parser, index, error );
-    if ( *error || !head )
-        return head;
+    Node_t *block = OwnNode( parser, BlockCreate( NULL ) );
 
     while ( !AtEnd( parser, *index ) && !( stop_op != OP_NOPE && MatchToken( parser, *index, stop_op ) ) ) {
+        // ';' только разделяет операторы и в дерево не попадает
         if ( MatchToken( parser, *index, OP_SEMICOLON ) ) {
-            Node_t *semicolon = ConsumeOp( parser, index, error, OP_SEMICOLON, "Expected ';'" );
-            if ( *error )
-                return NULL;
-
-            bool is_first_wrap = ( head->value.type != NODE_OPERATION || (OperationType)head->value.data.operation != OP_SEMICOLON );
-            
-            if ( is_first_wrap ) {
-                semicolon->left = head;
-                semicolon->right = NULL;
-                if ( head ) head->parent = semicolon;
-                head = semicolon;
-            } else {
-                semicolon->left = head;
-                if ( head ) head->parent = semicolon;
-                head = semicolon;
-
-                if ( IsStatementStart( parser, *index ) ) {
-                    Node_t *next = GetOP( parser, index, error );
-                    semicolon->right = next;
-                    if ( next ) next->parent = semicolon;
-                } else {
-                    semicolon->right = NULL;
-                }
-            }
-        } else if ( IsStatementStart( parser, *index ) ) {
-            Node_t *next = GetOP( parser, index, error );
-            if ( *error ) return NULL;
-
-            if ( head->value.type == NODE_OPERATION && (OperationType)head->value.data.operation == OP_SEMICOLON ) {
-                if ( head->right == NULL ) {
-                    head->right = next;
-                    if ( next ) next->parent = head;
-                } else {
-                    head = next; 
-                }
-            } else {
-                head = next;
-            }
-        } else {
-            break;
+            ( *index )++;
+            continue;
         }
+
+        // `}` и `func`/`main` закрывают последовательность, остальное - мусор до конца оператора
+        if ( !IsStatementStart( parser, *index ) ) {
+            if ( MatchToken( parser, *index, OP_CLOSE_BRACE ) || MatchToken( parser, *index, OP_FUNC ) ||
+                 MatchToken( parser, *index, OP_MAIN ) )
+                break;
+
+            RecordSyntaxError( parser, *index, "Expected statement" );
+            SynchronizeStatement( parser, index );
+            continue;
+        }
+
+        bool stmt_error = false;
+        Node_t *stmt = GetOP( parser, index, &stmt_error );
+        if ( stmt_error ) {
+            SynchronizeStatement( parser, index );
+            continue;
+        }
+
+        BlockAppend( block, stmt );
     }
 
-    return head;
+    return block;
 }
 
 static Node_t *GetOP( Parser_t *parser, size_t *index, bool *error ) {
+    TRACE_NESTED_ZONE( __func__ );
+
     my_assert( parser, "Null pointer on `parser`" );
     my_assert( index, "Null pointer on `index`" );
     my_assert( error, "Null pointer on `error`" );
@@ -388,6 +645,8 @@ static Node_t *GetOP( Parser_t *parser, size_t *index, bool *error ) {
 }
 
 static Node_t *GetAssignment( Parser_t *parser, size_t *index, bool *error ) {
+    TRACE_NESTED_ZONE( __func__ );
+
     my_assert( parser, "Null pointer on `parser`" );
     my_assert( index, "Null pointer on `index`" );
     my_assert( error, "Null pointer on `error`" );
@@ -420,6 +679,8 @@ static Node_t *GetAssignment( Parser_t *parser, size_t *index, bool *error ) {
 }
 
 static Node_t *GetReturnStmt( Parser_t *parser, size_t *index, bool *error ) {
+    TRACE_NESTED_ZONE( __func__ );
+
     my_assert( parser, "Null pointer on `parser`" );
     my_assert( index, "Null pointer on `index`" );
     my_assert( error, "Null pointer on `error`" );
@@ -441,6 +702,8 @@ static Node_t *GetReturnStmt( Parser_t *parser, size_t *index, bool *error ) {
 }
 
 static Node_t *GetWhileStmt( Parser_t *parser, size_t *index, bool *error ) {
+    TRACE_NESTED_ZONE( __func__ );
+
     my_assert( parser, "Null pointer on `parser`" );
     my_assert( index, "Null pointer on `index`" );
     my_assert( error, "Null pointer on `error`" );
@@ -478,6 +741,8 @@ static Node_t *GetWhileStmt( Parser_t *parser, size_t *index, bool *error ) {
 }
 
 static Node_t *GetIfStmt( Parser_t *parser, size_t *index, bool *error ) {
+    TRACE_NESTED_ZONE( __func__ );
+
     my_assert( parser, "Null pointer on `parser`" );
     my_assert( index, "Null pointer on `index`" );
     my_assert( error, "Null pointer on `error`" );
@@ -544,6 +809,8 @@ static Node_t *GetIfStmt( Parser_t *parser, size_t *index, bool *error ) {
 }
 
 static Node_t *GetBlock( Parser_t *parser, size_t *index, bool *error ) {
+    TRACE_NESTED_ZONE( __func__ );
+
     my_assert( parser, "Null pointer on `parser`" );
     my_assert( index, "Null pointer on `index`" );
     my_assert( error, "Null pointer on `error`" );
@@ -552,305 +819,281 @@ static Node_t *GetBlock( Parser_t *parser, size_t *index, bool *error ) {
     if ( *error )
         return NULL;
 
-    Node_t *body = NULL;
-    if ( !MatchToken( parser, *index, OP_CLOSE_BRACE ) ) {
-        body = GetOPSeq( parser, index, error, OP_CLOSE_BRACE );
-        if ( *error )
-            return NULL;
-    }
+    size_t errors_before = parser->errors.count + parser->errors.dropped;
+    Node_t *body = GetOPSeq( parser, index, error, OP_CLOSE_BRACE );
+    if ( *error )
+        return NULL;
 
     ConsumeOp( parser, index, error, OP_CLOSE_BRACE, "Expected '}'" );
     if ( *error )
         return NULL;
 
-    if ( !body )
+    // Блок, опустевший из-за выброшенных при восстановлении операторов, - не новая ошибка
+    if ( body->value.data.block.count == 0 && parser->errors.count + parser->errors.dropped == errors_before )
         SyntaxError( "Empty block is not allowed" );
 
     return body;
 }
 
-static Node_t *GetExpression( Parser_t *parser, size_t *index, bool *error ) {
-    my_assert( parser, "Null pointer on `parser`" );
-    my_assert( index, "Null pointer on `index`" );
-    my_assert( error, "Null pointer on `error`" );
-
-    Node_t *node = GetTerm( parser, index, error );
-    if ( *error )
-        return NULL;
-
-    while ( !AtEnd( parser, *index ) ) {
-        if ( MatchToken( parser, *index, OP_ADD ) || MatchToken( parser, *index, OP_SUB ) ) {
-            Node_t *op_node = parser->tokens.data[*index];
-            ( *index )++;
-
-            Node_t *right = GetTerm( parser, index, error );
-            if ( *error )
-                return NULL;
-
-            op_node->left = node;
-            op_node->right = right;
-
-            if ( node )
-                node->parent = op_node;
-            if ( right )
-                right->parent = op_node;
-
-            node = op_node;
+// ===== Выражения: парсер Пратта =====
+// Сила связывания инфиксных операторов берётся из столбцов lbp/rbp INIT_OPERATIONS,
+// поэтому новый оператор - это одна строка таблицы. Вложенность (скобки, sqrt(...),
+// print(...), аргументы call и ожидающие правого операнда операторы) хранится в явном
+// стеке фреймов, а не на стеке вызовов, так что глубокие скобки его не переполняют.
+
+const size_t EXPR_STACK_INLINE_CAPACITY = 32;
+
+enum ExprFrameType {
+    FRAME_INFIX, // op_node ждёт правый операнд, left - уже разобранный левый
+    FRAME_PAREN,
+    FRAME_SQRT,
+    FRAME_PRINT,
+    FRAME_CALL   // left - уже собранные аргументы, comma - запятая перед текущим
+};
+
+struct ExprFrame_t {
+    ExprFrameType type;
+    Node_t *op_node;
+    Node_t *left;
+    Node_t *comma;
+    int min_bp; // min_bp, действовавший до открытия фрейма
+};
+
+// Обычные выражения помещаются во встроенный буфер, на куче - только глубокая вложенность
+struct ExprStack_t {
+    ExprFrame_t inline_frames[EXPR_STACK_INLINE_CAPACITY];
+    ExprFrame_t *frames;
+    size_t size;
+    size_t capacity;
+};
+
+static bool ExprStackPush( ExprStack_t *stack, ExprFrame_t frame ) {
+    if ( stack->size >= stack->capacity ) {
+        size_t new_capacity = stack->capacity * 2;
+        ExprFrame_t *new_frames = NULL;
+
+        if ( stack->frames == stack->inline_frames ) {
+            new_frames = (ExprFrame_t *)calloc( new_capacity, sizeof( *new_frames ) );
+            if ( new_frames )
+                memcpy( new_frames, stack->frames, stack->size * sizeof( *new_frames ) );
         } else {
-            break;
+            new_frames = (ExprFrame_t *)realloc( stack->frames, new_capacity * sizeof( *new_frames ) );
         }
-    }
-
-    return node;
-}
-
-static Node_t *GetTerm( Parser_t *parser, size_t *index, bool *error ) {
-    my_assert( parser, "Null pointer on `parser`" );
-    my_assert( index, "Null pointer on `index`" );
-    my_assert( error, "Null pointer on `error`" );
-
-    Node_t *node = GetPow( parser, index, error );
-    if ( *error )
-        return NULL;
-
-    while ( !AtEnd( parser, *index ) ) {
-        if ( MatchToken( parser, *index, OP_MUL ) || MatchToken( parser, *index, OP_DIV ) ) {
-            Node_t *op_node = parser->tokens.data[*index];
-            ( *index )++;
-
-            Node_t *right = GetPow( parser, index, error );
-            if ( *error )
-                return NULL;
-
-            op_node->left = node;
-            op_node->right = right;
 
-            if ( node )
-                node->parent = op_node;
-            if ( right )
-                right->parent = op_node;
+        if ( !new_frames )
+            return false;
 
-            node = op_node;
-        } else {
-            break;
-        }
+        stack->frames = new_frames;
+        stack->capacity = new_capacity;
     }
 
-    return node;
+    stack->frames[stack->size++] = frame;
+    return true;
 }
 
-static Node_t *GetPow( Parser_t *parser, size_t *index, bool *error ) {
-    my_assert( parser, "Null pointer on `parser`" );
-    my_assert( index, "Null pointer on `index`" );
-    my_assert( error, "Null pointer on `error`" );
-
-    Node_t *node = GetUnary( parser, index, error );
-    if ( *error )
+// Инфиксный оператор на позиции `index`, NULL если там что-то другое
+static const OperationInfo_t *MatchInfix( Parser_t *parser, size_t index ) {
+    if ( AtEnd( parser, index ) )
         return NULL;
 
-    while ( MatchToken( parser, *index, OP_POW ) ) {
-        Node_t *op_node = parser->tokens.data[*index];
-        ( *index )++;
-
-        Node_t *right = GetUnary( parser, index, error );
-        if ( *error )
-            return NULL;
-
-        op_node->left = node;
-        op_node->right = right;
-
-        if ( node )
-            node->parent = op_node;
-        if ( right )
-            right->parent = op_node;
-
-        node = op_node;
-    }
+    Node_t *tok = parser->tokens.data[index];
+    if ( tok->value.type != NODE_OPERATION )
+        return NULL;
 
-    return node;
+    const OperationInfo_t *info = GetOperationInfo( (OperationType)tok->value.data.operation );
+    return ( info && info->lbp > 0 ) ? info : NULL;
 }
 
-static Node_t *GetUnary( Parser_t *parser, size_t *index, bool *error ) {
-    my_assert( parser, "Null pointer on `parser`" );
-    my_assert( index, "Null pointer on `index`" );
-    my_assert( error, "Null pointer on `error`" );
-
-    // sqrt(expr)
-    if ( MatchToken( parser, *index, OP_SQRT ) ) {
-        Node_t *sqrt_token = parser->tokens.data[*index];
-        (*index)++;
-
-        if ( !MatchToken( parser, *index, OP_OPEN_PARENT ) )
-            SyntaxError( "Expected '(' after 'sqrt'" );
-        (*index)++;
-
-        Node_t *expr = GetExpression( parser, index, error );
-        if ( *error )
-            return NULL;
-
-        if ( !MatchToken( parser, *index, OP_CLOSE_PARENT ) )
-            SyntaxError( "Expected ')' after sqrt expression" );
-        (*index)++;
-
-        sqrt_token->left = expr;
-        sqrt_token->right = NULL;
-        if ( expr )
-            expr->parent = sqrt_token;
+static void LinkChildren( Node_t *node, Node_t *left, Node_t *right ) {
+    node->left = left;
+    node->right = right;
+    if ( left )
+        left->parent = node;
+    if ( right )
+        right->parent = node;
+}
 
-        return sqrt_token;
-    }
+static Node_t *ParseExpression( Parser_t *parser, size_t *index, bool *error, ExprStack_t *stack ) {
+    int min_bp = 0;
+    Node_t *lhs = NULL;
 
-    return GetPrimary( parser, index, error );
-}
+    while ( true ) {
+        // nud: операнд или открывающая конструкция
+        if ( AtEnd( parser, *index ) )
+            SyntaxError( "Unexpected end of input" );
 
-static Node_t *GetArgList( Parser_t *parser, size_t *index, bool *error ) {
-    my_assert( parser, "Null pointer on `parser`" );
-    my_assert( index, "Null pointer on `index`" );
-    my_assert( error, "Null pointer on `error`" );
+        Node_t *tok = parser->tokens.data[*index];
+        ExprFrame_t frame = { FRAME_PAREN, tok, NULL, NULL, min_bp };
+        bool opened = false;
 
-    Node_t *head = GetExpression( parser, index, error );
-    if ( *error )
-        return NULL;
+        if ( tok->value.type == NODE_NUMBER || tok->value.type == NODE_VARIABLE ) {
+            ( *index )++;
+            lhs = tok;
+        } else if ( tok->value.type == NODE_OPERATION ) {
+            switch ( tok->value.data.operation ) {
+                case OP_OPEN_PARENT:
+                    ( *index )++;
+                    frame.op_node = NULL;
+                    opened = true;
+                    break;
+                case OP_SQRT:
+                    ( *index )++;
+                    ConsumeOp( parser, index, error, OP_OPEN_PARENT, "Expected '(' after 'sqrt'" );
+                    if ( *error )
+                        return NULL;
+                    frame.type = FRAME_SQRT;
+                    opened = true;
+                    break;
+                case OP_OUT:
+                    ( *index )++;
+                    ConsumeOp( parser, index, error, OP_OPEN_PARENT, "Expected '(' after 'print'" );
+                    if ( *error )
+                        return NULL;
+                    frame.type = FRAME_PRINT;
+                    opened = true;
+                    break;
+                case OP_IN:
+                    ( *index )++;
+                    ConsumeOp( parser, index, error, OP_OPEN_PARENT, "Expected '(' after 'input'" );
+                    if ( *error )
+                        return NULL;
+                    ConsumeOp( parser, index, error, OP_CLOSE_PARENT, "Expected ')' after 'input'" );
+                    if ( *error )
+                        return NULL;
+                    LinkChildren( tok, NULL, NULL );
+                    lhs = tok;
+                    break;
+                case OP_CALL: {
+                    ( *index )++;
+                    if ( !MatchVariable( parser, *index ) )
+                        SyntaxError( "Expected function name after 'call'" );
+
+                    Node_t *func_name = parser->tokens.data[*index];
+                    ( *index )++;
+
+                    ConsumeOp( parser, index, error, OP_OPEN_PARENT, "Expected '(' after function name" );
+                    if ( *error )
+                        return NULL;
+
+                    LinkChildren( tok, func_name, NULL );
+                    if ( MatchToken( parser, *index, OP_CLOSE_PARENT ) ) {
+                        ( *index )++;
+                        lhs = tok;
+                    } else {
+                        frame.type = FRAME_CALL;
+                        opened = true;
+                    }
+                    break;
+                }
+                default:
+                    SyntaxError( "Expected number, variable, or '('" );
+            }
+        } else {
+            SyntaxError( "Expected number, variable, or '('" );
+        }
 
-    while ( MatchToken( parser, *index, OP_COMMA ) ) {
-        Node_t *comma_token = parser->tokens.data[*index];
-        (*index)++;
+        if ( opened ) {
+            if ( !ExprStackPush( stack, frame ) )
+                SyntaxError( "Out of memory for expression stack" );
+            min_bp = 0;
+            continue;
+        }
 
-        Node_t *next_arg = GetExpression( parser, index, error );
-        if ( *error )
-            return NULL;
+        // led: цепляем инфиксные операторы, пока их lbp не меньше min_bp,
+        // иначе сворачиваем верхний фрейм; выходим, когда нужен следующий операнд
+        bool need_operand = false;
+        while ( !need_operand ) {
+            const OperationInfo_t *info = MatchInfix( parser, *index );
+            if ( info && info->lbp >= min_bp ) {
+                ExprFrame_t infix = { FRAME_INFIX, parser->tokens.data[*index], lhs, NULL, min_bp };
+                if ( !ExprStackPush( stack, infix ) )
+                    SyntaxError( "Out of memory for expression stack" );
+                ( *index )++;
+                min_bp = info->rbp;
+                need_operand = true;
+                break;
+            }
 
-        comma_token->left = head;
-        comma_token->right = next_arg;
-        if ( head )
-            head->parent = comma_token;
-        if ( next_arg )
-            next_arg->parent = comma_token;
+            if ( stack->size == 0 )
+                return lhs;
+
+            ExprFrame_t *top = &stack->frames[stack->size - 1];
+            switch ( top->type ) {
+                case FRAME_INFIX:
+                    LinkChildren( top->op_node, top->left, lhs );
+                    lhs = top->op_node;
+                    break;
+                case FRAME_PAREN:
+                    ConsumeOp( parser, index, error, OP_CLOSE_PARENT, "Expected ')'" );
+                    if ( *error )
+                        return NULL;
+                    break;
+                case FRAME_SQRT:
+                    ConsumeOp( parser, index, error, OP_CLOSE_PARENT, "Expected ')' after sqrt expression" );
+                    if ( *error )
+                        return NULL;
+                    LinkChildren( top->op_node, lhs, NULL );
+                    lhs = top->op_node;
+                    break;
+                case FRAME_PRINT:
+                    ConsumeOp( parser, index, error, OP_CLOSE_PARENT, "Expected ')' after print expression" );
+                    if ( *error )
+                        return NULL;
+                    LinkChildren( top->op_node, lhs, NULL );
+                    lhs = top->op_node;
+                    break;
+                case FRAME_CALL: {
+                    // Аргументы - левое дерево запятых: (, (, a b) c)
+                    Node_t *args = lhs;
+                    if ( top->comma ) {
+                        LinkChildren( top->comma, top->left, lhs );
+                        args = top->comma;
+                    }
+
+                    if ( MatchToken( parser, *index, OP_COMMA ) ) {
+                        top->left = args;
+                        top->comma = parser->tokens.data[*index];
+                        ( *index )++;
+                        min_bp = 0;
+                        need_operand = true;
+                        break;
+                    }
+
+                    ConsumeOp( parser, index, error, OP_CLOSE_PARENT, "Expected ')' after arguments" );
+                    if ( *error )
+                        return NULL;
+                    top->op_node->right = args;
+                    args->parent = top->op_node;
+                    lhs = top->op_node;
+                    break;
+                }
+                default:
+                    SyntaxError( "Broken expression stack" );
+            }
 
-        head = comma_token;
+            if ( !need_operand ) {
+                min_bp = top->min_bp;
+                stack->size--;
+            }
+        }
     }
-
-    return head;
 }
 
-static Node_t *GetPrimary( Parser_t *parser, size_t *index, bool *error ) {
+static Node_t *GetExpression( Parser_t *parser, size_t *index, bool *error ) {
+    TRACE_NESTED_ZONE( __func__ );
+
     my_assert( parser, "Null pointer on `parser`" );
     my_assert( index, "Null pointer on `index`" );
     my_assert( error, "Null pointer on `error`" );
 
-    if ( AtEnd( parser, *index ) ) {
-        SyntaxError( "Unexpected end of input" );
-    }
-
-    Node_t *tok = parser->tokens.data[*index];
-
-    // Числа
-    if ( tok->value.type == NODE_NUMBER ) {
-        ( *index )++;
-        return tok;
-    }
-
-    // input()
-    if ( MatchToken( parser, *index, OP_IN ) ) {
-        Node_t *input_token = parser->tokens.data[*index];
-        (*index)++;
-
-        if ( !MatchToken( parser, *index, OP_OPEN_PARENT ) )
-            SyntaxError( "Expected '(' after 'input'" );
-        (*index)++;
-
-        if ( !MatchToken( parser, *index, OP_CLOSE_PARENT ) )
-            SyntaxError( "Expected ')' after 'input'" );
-        (*index)++;
-
-        input_token->left = NULL;
-        input_token->right = NULL;
-
-        return input_token;
-    }
-
-    // print(expr)
-    if ( MatchToken( parser, *index, OP_OUT ) ) {
-        Node_t *print_token = parser->tokens.data[*index];
-        (*index)++;
-
-        if ( !MatchToken( parser, *index, OP_OPEN_PARENT ) )
-            SyntaxError( "Expected '(' after 'print'" );
-        (*index)++;
-
-        Node_t *expr = GetExpression( parser, index, error );
-        if ( *error )
-            return NULL;
-
-        if ( !MatchToken( parser, *index, OP_CLOSE_PARENT ) )
-            SyntaxError( "Expected ')' after print expression" );
-        (*index)++;
-
-        print_token->left = expr;
-        print_token->right = NULL;
-        if ( expr )
-            expr->parent = print_token;
-
-        return print_token;
-    }
-
-    // call func(args)
-    if ( MatchToken( parser, *index, OP_CALL ) ) {
-        Node_t *call_token = parser->tokens.data[*index];
-        (*index)++;
-
-        if ( !MatchVariable( parser, *index ) )
-            SyntaxError( "Expected function name after 'call'" );
-
-        Node_t *func_name = parser->tokens.data[*index];
-        (*index)++;
-
-        if ( !MatchToken( parser, *index, OP_OPEN_PARENT ) )
-            SyntaxError( "Expected '(' after function name" );
-        (*index)++;
-
-        Node_t *args = NULL;
-        if ( !MatchToken( parser, *index, OP_CLOSE_PARENT ) ) {
-            args = GetArgList( parser, index, error );
-            if ( *error )
-                return NULL;
-        }
-
-        if ( !MatchToken( parser, *index, OP_CLOSE_PARENT ) )
-            SyntaxError( "Expected ')' after arguments" );
-        (*index)++;
+    ExprStack_t stack = {};
+    stack.frames = stack.inline_frames;
+    stack.capacity = EXPR_STACK_INLINE_CAPACITY;
 
-        call_token->left = func_name;
-        call_token->right = args;
-        if ( func_name )
-            func_name->parent = call_token;
-        if ( args )
-            args->parent = call_token;
-
-        return call_token;
-    }
+    Node_t *expr = ParseExpression( parser, index, error, &stack );
 
-    // Переменные
-    if ( tok->value.type == NODE_VARIABLE ) {
-        ( *index )++;
-        return tok;
-    }
-
-    // (expr)
-    if ( MatchToken( parser, *index, OP_OPEN_PARENT ) ) {
-        ( *index )++;
-
-        Node_t *expr = GetExpression( parser, index, error );
-        if ( *error )
-            return NULL;
-
-        ConsumeOp( parser, index, error, OP_CLOSE_PARENT, "Expected ')'" );
-        if ( *error )
-            return NULL;
-
-        return expr;
-    }
+    if ( stack.frames != stack.inline_frames )
+        free( stack.frames );
 
-    SyntaxError( "Expected number, variable, or '('" );
-    return NULL;
+    return expr;
 }
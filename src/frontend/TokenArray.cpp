@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "MemReport.h"
 #include "Tree.h"
 #include "frontend/TokenArray.h"
 
@@ -28,6 +29,8 @@ void TokenArrayDestroy( TokenArray_t *arr ) {
 
         if ( node->value.type == NODE_VARIABLE )
             free( node->value.data.variable );
+        else if ( node->value.type == NODE_BLOCK )
+            free( node->value.data.block.items );
 
         free( node );
     }
@@ -53,6 +56,7 @@ static bool TokenArrayReallocate( TokenArray_t *arr, size_t new_capacity ) {
 
     arr->data = new_data;
     arr->capacity = new_capacity;
+    MemCount( MEM_TOKENS, new_capacity * sizeof( Node_t * ) );
 
     return true;
 }
@@ -74,4 +78,28 @@ bool TokenArrayPushBack( TokenArray_t *arr, Node_t *token ) {
     return true;
 }
 
-size_t TokenArraySize( const TokenArray_t *arr ) { return arr ? arr->size : 0; }
\ No newline at end of file
+size_t TokenArraySize( const TokenArray_t *arr ) { return arr ? arr->size : 0; }
+// Moves all tokens of `src` to the end of `dst`; `src` is left empty
+bool TokenArrayAppend( TokenArray_t *dst, TokenArray_t *src ) {
+    if ( !dst || !src )
+        return false;
+
+    if ( dst->size + src->size > dst->capacity ) {
+        size_t new_capacity = dst->capacity * TOKEN_ARRAY_GROWTH_FACTOR;
+        if ( new_capacity < dst->size + src->size )
+            new_capacity = dst->size + src->size;
+
+        if ( !TokenArrayReallocate( dst, new_capacity ) ) {
+            return false;
+        }
+    }
+
+    if ( src->size )
+        memcpy( dst->data + dst->size, src->data, src->size * sizeof( *src->data ) );
+    dst->size += src->size;
+
+    free( src->data );
+    *src = TokenArrayCreate();
+
+    return true;
+}
@@ -1,12 +1,60 @@
+#include <stdio.h>
+
+#include "BuildCache.h"
+#include "MemReport.h"
+#include "TimeReport.h"
+#include "Trace.h"
 #include "Tree.h"
+#include "UtilsRW.h"
 #include "frontend/Parser.h"
 
+// On errors the output holds `nil` or is removed, only a written tree is worth caching
+static bool OutputHasTree( const char *output_filename ) {
+    FILE *output = fopen( output_filename, "r" );
+    if ( !output )
+        return false;
+
+    int first = fgetc( output );
+    fclose( output );
+
+    return first == '[' || first == '(';
+}
+
 int main( int argc, char **argv ) {
     Parser_t *parser = ParserCtor( argc, argv );
+    if ( !parser )
+        return 1;
+
+    // The AST depends on the source text only, no option changes it. With -c the parse also
+    // refreshes <output>.cache, which a fetched tree would leave behind, so it always runs
+    BuildCache_t cache = {};
+    char key[BUILD_CACHE_KEY_LENGTH + 1] = "";
+    bool cached = !parser->incremental && !IsStdStream( parser->input_filename ) && !IsStdStream( parser->output_filename ) &&
+                  BuildCacheOpen( &cache ) && BuildCacheKey( &cache, "front", "", parser->input_filename, key );
+
+    if ( cached && BuildCacheFetch( &cache, key, parser->output_filename ) ) {
+        BuildCacheClose( &cache );
+        ParserDtor( &parser );
+        TimeReportPrint( stderr );
+        TraceWrite();
+        return MemReportPrint( stderr ) ? 0 : 1;
+    }
+
+    if ( parser->incremental ) {
+        ParseIncremental( parser );
+    } else if ( parser->streaming ) {
+        ParseStreaming( parser );
+    } else {
+        Parse( parser );
+        TreeSaveToFile( parser->tree, parser->output_filename );
+    }
 
-    Parse( parser );
-    TreeSaveToFile( parser->tree, parser->output_filename );
+    if ( cached && OutputHasTree( parser->output_filename ) )
+        BuildCacheStore( &cache, key, parser->output_filename );
 
+    BuildCacheClose( &cache );
     ParserDtor( &parser );
-    return 0;
-}
\ No newline at end of file
+    TimeReportPrint( stderr );
+    TraceWrite();
+    return MemReportPrint( stderr ) ? 0 : 1;
+}
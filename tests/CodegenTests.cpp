@@ -0,0 +1,481 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "backend/CodeGen.h"
+#include "DebugUtils.h"
+#include "GraphDump.h"
+#include "Log.h"
+#include "Tree.h"
+#include "frontend/Parser.h"
+
+// Regression tests of the backend. Every test compiles a `.lang` source with the
+// frontend and the code generator, then runs the assembly on a small interpreter of the
+// target VM and compares what the program prints. Exit code is the number of failures.
+//
+// Usage: codegen-tests
+
+const size_t VM_STACK_SIZE    = 1 << 16;
+const size_t VM_MEMORY_SIZE   = 1 << 16;
+const size_t VM_MAX_STEPS     = 1 << 26;
+const size_t VM_MAX_OUTPUT    = 64;
+const size_t VM_OPERAND_SIZE  = 64;
+const size_t VM_REGISTERS     = 4;
+
+const double CHAIN_MAX_SECONDS = 5.0;
+
+struct VmLine_t {
+    char instruction[8];
+    char operand[VM_OPERAND_SIZE];
+};
+
+struct Vm_t {
+    VmLine_t *lines;
+    size_t count;
+
+    long long *stack;
+    size_t stack_size;
+    size_t *calls;
+    size_t calls_size;
+
+    long long registers[VM_REGISTERS];
+    long long *memory;
+
+    long long output[VM_MAX_OUTPUT];
+    size_t output_count;
+};
+
+static char work_directory[] = "/tmp/codegen-tests-XXXXXX";
+
+static double Seconds( const struct timespec *start, const struct timespec *end ) {
+    return (double)( end->tv_sec - start->tv_sec ) + (double)( end->tv_nsec - start->tv_nsec ) * 1e-9;
+}
+
+// One instruction or label per line, comments after `;` dropped
+static bool VmLoad( Vm_t *vm, const char *filename ) {
+    FILE *file = fopen( filename, "r" );
+    if ( !file ) {
+        PRINT_ERROR( "Fail to open file `%s`", filename );
+        return false;
+    }
+
+    size_t capacity = 0;
+    char *line = NULL;
+    size_t line_capacity = 0;
+
+    while ( getline( &line, &line_capacity, file ) > 0 ) {
+        char *comment = strchr( line, ';' );
+        if ( comment )
+            *comment = '\0';
+
+        VmLine_t parsed = {};
+        if ( sscanf( line, "%7s %63s", parsed.instruction, parsed.operand ) < 1 )
+            continue;
+
+        if ( vm->count == capacity ) {
+            capacity = capacity ? capacity * 2 : 256;
+            VmLine_t *lines = (VmLine_t *)realloc( vm->lines, capacity * sizeof( *lines ) );
+            if ( !lines ) {
+                PRINT_ERROR( "Memory allocation error" );
+                break;
+            }
+            vm->lines = lines;
+        }
+
+        vm->lines[vm->count++] = parsed;
+    }
+
+    free( line );
+    fclose( file );
+    return true;
+}
+
+static bool VmFindLabel( const Vm_t *vm, const char *label, size_t *position ) {
+    for ( size_t i = 0; i < vm->count; i++ ) {
+        if ( vm->lines[i].instruction[0] == ':' && !strcmp( vm->lines[i].instruction + 1, label + 1 ) ) {
+            *position = i;
+            return true;
+        }
+    }
+
+    PRINT_ERROR( "No label `%s`", label );
+    return false;
+}
+
+// `RAX`, `[3]` or a number; NULL `constant` means a store, where numbers are not allowed
+static long long *VmOperand( Vm_t *vm, const char *operand, long long *constant ) {
+    static const char *const REGISTER_NAMES[VM_REGISTERS] = { "RAX", "RBX", "RCX", "RDX" };
+    for ( size_t i = 0; i < VM_REGISTERS; i++ ) {
+        if ( !strcmp( operand, REGISTER_NAMES[i] ) )
+            return &vm->registers[i];
+    }
+
+    if ( operand[0] == '[' ) {
+        size_t address = strtoull( operand + 1, NULL, 10 );
+        return address < VM_MEMORY_SIZE ? &vm->memory[address] : NULL;
+    }
+
+    if ( !constant )
+        return NULL;
+
+    *constant = strtoll( operand, NULL, 10 );
+    return constant;
+}
+
+static bool VmPop( Vm_t *vm, long long *value ) {
+    if ( !vm->stack_size ) {
+        PRINT_ERROR( "VM stack underflow" );
+        return false;
+    }
+
+    *value = vm->stack[--vm->stack_size];
+    return true;
+}
+
+static bool VmPush( Vm_t *vm, long long value ) {
+    if ( vm->stack_size == VM_STACK_SIZE ) {
+        PRINT_ERROR( "VM stack overflow" );
+        return false;
+    }
+
+    vm->stack[vm->stack_size++] = value;
+    return true;
+}
+
+static bool VmArithmetic( Vm_t *vm, const char *instruction ) {
+    long long right = 0, left = 0;
+    if ( !VmPop( vm, &right ) || !VmPop( vm, &left ) )
+        return false;
+
+    long long result = 0;
+    if ( !strcmp( instruction, "ADD" ) ) {
+        result = left + right;
+    } else if ( !strcmp( instruction, "SUB" ) ) {
+        result = left - right;
+    } else if ( !strcmp( instruction, "MUL" ) ) {
+        result = left * right;
+    } else if ( !strcmp( instruction, "DIV" ) ) {
+        if ( !right ) {
+            PRINT_ERROR( "VM division by zero" );
+            return false;
+        }
+        result = left / right;
+    } else {
+        result = 1;
+        for ( long long i = 0; i < right; i++ )
+            result *= left;
+    }
+
+    return VmPush( vm, result );
+}
+
+// Runs from `:main` until HLT or the RET of main
+static bool VmRun( Vm_t *vm ) {
+    size_t ip = 0;
+    if ( !VmFindLabel( vm, ":main", &ip ) )
+        return false;
+
+    for ( size_t steps = 0; steps < VM_MAX_STEPS; steps++ ) {
+        if ( ++ip >= vm->count )
+            return true;
+
+        const VmLine_t *line = &vm->lines[ip];
+        const char *instruction = line->instruction;
+
+        if ( instruction[0] == ':' )
+            continue;
+
+        if ( !strcmp( instruction, "PUSH" ) ) {
+            long long constant = 0;
+            long long *source = VmOperand( vm, line->operand, &constant );
+            if ( !source || !VmPush( vm, *source ) )
+                return false;
+        } else if ( !strcmp( instruction, "POP" ) ) {
+            long long *target = VmOperand( vm, line->operand, NULL );
+            if ( !target || !VmPop( vm, target ) )
+                return false;
+        } else if ( !strcmp( instruction, "ADD" ) || !strcmp( instruction, "SUB" ) || !strcmp( instruction, "MUL" ) ||
+                    !strcmp( instruction, "DIV" ) || !strcmp( instruction, "POW" ) ) {
+            if ( !VmArithmetic( vm, instruction ) )
+                return false;
+        } else if ( !strcmp( instruction, "SQRT" ) ) {
+            long long value = 0;
+            if ( !VmPop( vm, &value ) || !VmPush( vm, (long long)sqrt( (double)value ) ) )
+                return false;
+        } else if ( !strcmp( instruction, "OUT" ) ) {
+            long long value = 0;
+            if ( !VmPop( vm, &value ) )
+                return false;
+            if ( vm->output_count < VM_MAX_OUTPUT )
+                vm->output[vm->output_count++] = value;
+        } else if ( !strcmp( instruction, "JMP" ) || !strcmp( instruction, "JBE" ) ) {
+            bool jump = true;
+            if ( instruction[1] == 'B' ) {
+                long long right = 0, left = 0;
+                if ( !VmPop( vm, &right ) || !VmPop( vm, &left ) )
+                    return false;
+                jump = left <= right;
+            }
+            if ( jump && !VmFindLabel( vm, line->operand, &ip ) )
+                return false;
+        } else if ( !strcmp( instruction, "CALL" ) ) {
+            if ( vm->calls_size == VM_STACK_SIZE ) {
+                PRINT_ERROR( "VM call stack overflow" );
+                return false;
+            }
+            vm->calls[vm->calls_size++] = ip;
+            if ( !VmFindLabel( vm, line->operand, &ip ) )
+                return false;
+        } else if ( !strcmp( instruction, "RET" ) ) {
+            if ( !vm->calls_size )
+                return true;
+            ip = vm->calls[--vm->calls_size];
+        } else if ( !strcmp( instruction, "HLT" ) ) {
+            return true;
+        } else {
+            PRINT_ERROR( "Unknown VM instruction `%s`", instruction );
+            return false;
+        }
+    }
+
+    PRINT_ERROR( "VM step limit exceeded" );
+    return false;
+}
+
+// Compiles `source` and runs it; `output` gets the printed values. `seconds` is the time
+// of code generation alone
+static bool CompileAndRun( const char *name, const char *source, long long *output, size_t *output_count,
+                           double *seconds ) {
+    char source_path[MAX_LEN_PATH] = {};
+    char asm_path[MAX_LEN_PATH] = {};
+    snprintf( source_path, sizeof( source_path ), "%s/%s.lang", work_directory, name );
+    snprintf( asm_path, sizeof( asm_path ), "%s/%s.asm", work_directory, name );
+
+    FILE *file = fopen( source_path, "w" );
+    if ( !file ) {
+        PRINT_ERROR( "Fail to open file `%s`", source_path );
+        return false;
+    }
+    fputs( source, file );
+    fclose( file );
+
+    Parser_t *parser = ParserCtorWithFiles( source_path, NULL );
+    if ( !parser )
+        return false;
+    Parse( parser );
+    Tree_t *tree = ParserReleaseTree( parser );
+    ParserDtor( &parser );
+
+    if ( !tree || !tree->root ) {
+        TreeDtor( &tree, NULL );
+        return false;
+    }
+
+    CodeGen_t *codegen = CodeGenCtor( source_path, asm_path );
+    if ( !codegen ) {
+        TreeDtor( &tree, NULL );
+        return false;
+    }
+    codegen->tree = tree;
+
+    struct timespec start = {}, end = {};
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    GenerateCode( codegen );
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    CodeGenDtor( &codegen );
+
+    if ( seconds )
+        *seconds = Seconds( &start, &end );
+
+    Vm_t vm = {};
+    vm.stack = (long long *)calloc( VM_STACK_SIZE, sizeof( *vm.stack ) );
+    vm.calls = (size_t *)calloc( VM_STACK_SIZE, sizeof( *vm.calls ) );
+    vm.memory = (long long *)calloc( VM_MEMORY_SIZE, sizeof( *vm.memory ) );
+
+    bool ran = vm.stack && vm.calls && vm.memory && VmLoad( &vm, asm_path ) && VmRun( &vm );
+    if ( ran ) {
+        memcpy( output, vm.output, vm.output_count * sizeof( *output ) );
+        *output_count = vm.output_count;
+    }
+
+    free( vm.lines );
+    free( vm.stack );
+    free( vm.calls );
+    free( vm.memory );
+
+    unlink( source_path );
+    unlink( asm_path );
+    return ran;
+}
+
+static bool ExpectOutput( const char *name, const long long *output, size_t output_count, const long long *expected,
+                          size_t expected_count ) {
+    if ( output_count != expected_count ) {
+        PRINT_ERROR( "%s: printed %zu values, expected %zu", name, output_count, expected_count );
+        return false;
+    }
+
+    for ( size_t i = 0; i < expected_count; i++ ) {
+        if ( output[i] != expected[i] ) {
+            PRINT_ERROR( "%s: value %zu is %lld, expected %lld", name, i, output[i], expected[i] );
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Appends `count` copies of `term` joined by `separator`, then `tail`
+static char *RepeatSource( const char *head, const char *term, const char *separator, size_t count,
+                           const char *tail ) {
+    size_t length = strlen( head ) + count * ( strlen( term ) + strlen( separator ) ) + strlen( tail ) + 1;
+    char *source = (char *)calloc( length, sizeof( *source ) );
+    if ( !source )
+        return NULL;
+
+    char *end = stpcpy( source, head );
+    for ( size_t i = 0; i < count; i++ ) {
+        if ( i )
+            end = stpcpy( end, separator );
+        end = stpcpy( end, term );
+    }
+    stpcpy( end, tail );
+
+    return source;
+}
+
+// Sethi-Ullman numbers of a long left-leaning chain: emission used to walk the whole
+// subtree again at every operator, 3000 terms took minutes
+static bool TestLongChain() {
+    const size_t TERMS = 3000;
+
+    char *source = RepeatSource( "main() {\n    x := 1;\n    print(", "x", " + ", TERMS, ");\n}\n" );
+    if ( !source )
+        return false;
+
+    long long output[VM_MAX_OUTPUT] = {};
+    size_t output_count = 0;
+    double seconds = 0;
+    bool ran = CompileAndRun( "long_chain", source, output, &output_count, &seconds );
+    free( source );
+
+    const long long expected[] = { (long long)TERMS };
+    if ( !ran || !ExpectOutput( "long chain", output, output_count, expected, 1 ) )
+        return false;
+
+    if ( seconds > CHAIN_MAX_SECONDS ) {
+        PRINT_ERROR( "long chain: code generation took %.3f s", seconds );
+        return false;
+    }
+
+    return true;
+}
+
+// Right-nested sums are swapped to the deeper operand first; the value must not change
+static bool TestReorderedOperands() {
+    const size_t DEPTH = 40;
+
+    char *source = RepeatSource( "main() {\n    x := 2;\n    print(1 - ", "(x + x * ", "", DEPTH, "1" );
+    if ( !source )
+        return false;
+
+    size_t length = strlen( source );
+    char *closed = (char *)realloc( source, length + DEPTH + sizeof( ");\n}\n" ) );
+    if ( !closed ) {
+        free( source );
+        return false;
+    }
+    memset( closed + length, ')', DEPTH );
+    strcpy( closed + length + DEPTH, ");\n}\n" );
+
+    long long output[VM_MAX_OUTPUT] = {};
+    size_t output_count = 0;
+    bool ran = CompileAndRun( "reordered", closed, output, &output_count, NULL );
+    free( closed );
+
+    // v = x + x * v from the innermost 1 outwards
+    long long value = 1;
+    for ( size_t i = 0; i < DEPTH; i++ )
+        value = 2 + 2 * value;
+
+    const long long expected[] = { 1 - value };
+    return ran && ExpectOutput( "reordered operands", output, output_count, expected, 1 );
+}
+
+// Three registers go to variables, the rest live in fixed memory cells of the function:
+// a recursive call must not overwrite the cells of its caller
+static bool TestRecursiveLocals() {
+    const char *source = "func f(n) {\n"
+                         "    a := n + 1;\n"
+                         "    b := n + 2;\n"
+                         "    c := n + 3;\n"
+                         "    d := n + 4;\n"
+                         "    e := n * 5;\n"
+                         "    r := 0;\n"
+                         "    if (n) {\n"
+                         "        r = call f(n - 1);\n"
+                         "    }\n"
+                         "    print(a);\n"
+                         "    print(b);\n"
+                         "    print(c);\n"
+                         "    print(d);\n"
+                         "    print(e);\n"
+                         "    return r + n;\n"
+                         "}\n"
+                         "main() {\n"
+                         "    print(call f(4));\n"
+                         "}\n";
+
+    long long output[VM_MAX_OUTPUT] = {};
+    size_t output_count = 0;
+    if ( !CompileAndRun( "recursive_locals", source, output, &output_count, NULL ) )
+        return false;
+
+    // `if (n)` is taken for n > 1, so f(1) is the innermost call and prints first
+    long long expected[VM_MAX_OUTPUT] = {};
+    size_t expected_count = 0;
+    long long sum = 0;
+    for ( long long n = 1; n <= 4; n++ ) {
+        const long long values[] = { n + 1, n + 2, n + 3, n + 4, n * 5 };
+        for ( size_t i = 0; i < sizeof( values ) / sizeof( *values ); i++ )
+            expected[expected_count++] = values[i];
+        sum += n;
+    }
+    expected[expected_count++] = sum;
+
+    return ExpectOutput( "recursive locals", output, output_count, expected, expected_count );
+}
+
+struct Test_t {
+    const char *name;
+    bool ( *run )();
+};
+
+int main() {
+    LogConfigure( "warn" );
+    GraphDumpConfigure( GRAPH_DUMP_OFF, 0 );
+
+    if ( !mkdtemp( work_directory ) ) {
+        PRINT_ERROR( "Fail to create a directory in /tmp" );
+        return 1;
+    }
+
+    static const Test_t TESTS[] = {
+        { "long operator chain",  TestLongChain },
+        { "reordered operands",   TestReorderedOperands },
+        { "recursive locals",     TestRecursiveLocals },
+    };
+
+    int failed = 0;
+    for ( size_t i = 0; i < sizeof( TESTS ) / sizeof( *TESTS ); i++ ) {
+        bool passed = TESTS[i].run();
+        printf( "[%s] %s\n", passed ? " ok " : "FAIL", TESTS[i].name );
+        failed += !passed;
+    }
+
+    rmdir( work_directory );
+    return failed;
+}
@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "DebugUtils.h"
+#include "GraphDump.h"
+#include "Log.h"
+#include "Tree.h"
+#include "frontend/Parser.h"
+
+// Regression tests of the frontend. Parser tests write a `.lang` source, parse it and
+// compare the text AST with the expected one. Lexer tests lex one buffer on different
+// numbers of threads, so it is cut into different chunks, and compare the tokens.
+// Exit code is the number of failures.
+//
+// Usage: frontend-tests
+
+// Above 4 MiB the lexer cuts 4 chunks on one thread and 5 on LEX_TEST_THREADS
+const size_t LEX_TEST_SIZE    = 5 << 20;
+const size_t LEX_TEST_THREADS = 8;
+// Lines of ~40 KB: a cut point lands in the middle of a line and is moved to its end
+const size_t LEX_TEST_LINE_TERMS = 4096;
+
+static char work_directory[] = "/tmp/frontend-tests-XXXXXX";
+
+// Parses `source` and returns its tree in the text AST format, NULL on errors
+static char *ParseToText( const char *name, const char *source ) {
+    char source_path[MAX_LEN_PATH] = {};
+    snprintf( source_path, sizeof( source_path ), "%s/%s.lang", work_directory, name );
+
+    FILE *file = fopen( source_path, "w" );
+    if ( !file ) {
+        PRINT_ERROR( "Fail to open file `%s`", source_path );
+        return NULL;
+    }
+    fputs( source, file );
+    fclose( file );
+
+    Parser_t *parser = ParserCtorWithFiles( source_path, NULL );
+    if ( !parser ) {
+        unlink( source_path );
+        return NULL;
+    }
+    Parse( parser );
+
+    char *text = NULL;
+    size_t text_length = 0;
+    if ( parser->tree && parser->tree->root ) {
+        FILE *stream = open_memstream( &text, &text_length );
+        if ( stream ) {
+            NodeSaveToStream( parser->tree->root, stream );
+            fclose( stream );
+        }
+    }
+
+    ParserDtor( &parser );
+    unlink( source_path );
+    return text;
+}
+
+// Parses `print( <expression> )` in main and compares the printed tree with `expected`
+static bool ExpectExpression( const char *name, const char *expression, const char *expected ) {
+    char source[256] = "";
+    snprintf( source, sizeof( source ), "main() {\n    print(%s);\n}\n", expression );
+
+    char wanted[512] = "";
+    snprintf( wanted, sizeof( wanted ), "[ ( main ( , ( \"main\" nil nil ) nil ) [ ( print %s nil ) ] ) ] ",
+              expected );
+
+    char *text = ParseToText( name, source );
+    if ( !text ) {
+        PRINT_ERROR( "%s: `%s` did not parse", name, expression );
+        return false;
+    }
+
+    bool equal = !strcmp( text, wanted );
+    if ( !equal )
+        PRINT_ERROR( "%s: `%s` parsed as\n%s\nexpected\n%s", name, expression, text, wanted );
+
+    free( text );
+    return equal;
+}
+
+// `^` binds to the right: 2 ^ 3 ^ 2 is 2 ^ 9, not 8 ^ 2
+static bool TestPowerAssociativity() {
+    return ExpectExpression( "power", "2 ^ 3 ^ 2",
+                             "( ^ ( 2 nil nil ) ( ^ ( 3 nil nil ) ( 2 nil nil ) ) )" );
+}
+
+// `-` and `/` bind to the left: a - b - c is ( a - b ) - c
+static bool TestLeftAssociativity() {
+    return ExpectExpression( "subtraction", "a - b - c",
+                             "( - ( - ( \"a\" nil nil ) ( \"b\" nil nil ) ) ( \"c\" nil nil ) )" ) &&
+           ExpectExpression( "division", "a / b / c",
+                             "( / ( / ( \"a\" nil nil ) ( \"b\" nil nil ) ) ( \"c\" nil nil ) )" );
+}
+
+// `^` above `*` and `/`, those above `+` and `-`; parentheses override both
+static bool TestPrecedence() {
+    return ExpectExpression( "precedence", "1 + 2 * 3 ^ 2 - 4 / 2",
+                             "( - ( + ( 1 nil nil ) ( * ( 2 nil nil ) ( ^ ( 3 nil nil ) ( 2 nil nil ) ) ) ) "
+                             "( / ( 4 nil nil ) ( 2 nil nil ) ) )" ) &&
+           ExpectExpression( "parentheses", "( 1 + 2 ) * ( 3 - a ) ^ 2",
+                             "( * ( + ( 1 nil nil ) ( 2 nil nil ) ) "
+                             "( ^ ( - ( 3 nil nil ) ( \"a\" nil nil ) ) ( 2 nil nil ) ) )" );
+}
+
+// `main() { x := 0;` and then statements `x = x + 1234567 + ... + 1234567;` up to `size`
+// bytes, one per line or all on one line, and `}` without a newline after it
+static char *MakeLexSource( size_t size, bool newlines, size_t *tokens_count ) {
+    const char HEAD[] = "main() {\n    x := 0;\n";
+    const char STATEMENT[] = "    x = x";
+    const char TERM[] = " + 1234567";
+
+    size_t line_length = sizeof( STATEMENT ) - 1 + LEX_TEST_LINE_TERMS * ( sizeof( TERM ) - 1 ) + 2;
+    char *source = (char *)calloc( size + line_length + sizeof( HEAD ) + 1, sizeof( *source ) );
+    if ( !source )
+        return NULL;
+
+    char *end = stpcpy( source, HEAD );
+    if ( !newlines )
+        end[-1] = ' ';
+    *tokens_count = 8; // main ( ) { x := 0 ;
+
+    while ( (size_t)( end - source ) < size ) {
+        end = stpcpy( end, STATEMENT );
+        for ( size_t i = 0; i < LEX_TEST_LINE_TERMS; i++ )
+            end = stpcpy( end, TERM );
+        end = stpcpy( end, newlines ? ";\n" : "; " );
+
+        // x = x, `+ number` per term, ;
+        *tokens_count += 3 + 2 * LEX_TEST_LINE_TERMS + 1;
+    }
+
+    stpcpy( end, "}" );
+    *tokens_count += 1;
+
+    return source;
+}
+
+static bool TokensEqual( const Node_t *first, const Node_t *second ) {
+    if ( first->value.type != second->value.type )
+        return false;
+
+    switch ( first->value.type ) {
+        case NODE_NUMBER:
+            return first->value.data.number == second->value.data.number;
+        case NODE_OPERATION:
+            return first->value.data.operation == second->value.data.operation;
+        case NODE_VARIABLE:
+            return !strcmp( first->value.data.variable, second->value.data.variable );
+        default:
+            return true;
+    }
+}
+
+// Lexes a copy of `source` on `threads` threads, the tokens stay in the returned parser
+static Parser_t *LexWithThreads( const char *source, size_t threads ) {
+    Parser_t *parser = ParserCtorWithFiles( "lexer-test", NULL );
+    if ( !parser )
+        return NULL;
+    parser->threads = threads;
+
+    char *buffer = strdup( source );
+    bool lexed = buffer && LexicalAnalyzeBuffer( parser, buffer );
+    free( buffer );
+
+    if ( !lexed )
+        ParserDtor( &parser );
+    return parser;
+}
+
+// One thread and LEX_TEST_THREADS threads must give the same `expected_count` tokens
+static bool ExpectSameTokens( const char *name, const char *source, size_t expected_count ) {
+    Parser_t *serial = LexWithThreads( source, 1 );
+    Parser_t *parallel = LexWithThreads( source, LEX_TEST_THREADS );
+
+    bool equal = serial && parallel;
+    if ( !equal )
+        PRINT_ERROR( "%s: the source did not lex", name );
+
+    if ( equal && ( serial->tokens.size != expected_count || parallel->tokens.size != expected_count ) ) {
+        PRINT_ERROR( "%s: %zu tokens on 1 thread, %zu on %zu, expected %zu", name, serial->tokens.size,
+                     parallel->tokens.size, LEX_TEST_THREADS, expected_count );
+        equal = false;
+    }
+
+    for ( size_t i = 0; equal && i < expected_count; i++ ) {
+        if ( !TokensEqual( serial->tokens.data[i], parallel->tokens.data[i] ) ) {
+            PRINT_ERROR( "%s: token %zu differs between 1 and %zu threads", name, i, LEX_TEST_THREADS );
+            equal = false;
+        }
+    }
+
+    if ( serial )
+        ParserDtor( &serial );
+    if ( parallel )
+        ParserDtor( &parallel );
+    return equal;
+}
+
+// Cut points fall inside long lines and are moved to the next '\n', so no token is split
+static bool TestChunkBoundaries() {
+    size_t tokens_count = 0;
+    char *source = MakeLexSource( LEX_TEST_SIZE, true, &tokens_count );
+    if ( !source )
+        return false;
+
+    bool equal = ExpectSameTokens( "chunk boundaries", source, tokens_count );
+    free( source );
+    return equal;
+}
+
+// Without any '\n' there is nowhere to cut, the whole file is one chunk
+static bool TestNoNewline() {
+    size_t tokens_count = 0;
+    char *source = MakeLexSource( LEX_TEST_SIZE, false, &tokens_count );
+    if ( !source )
+        return false;
+
+    bool equal = ExpectSameTokens( "no newline", source, tokens_count );
+    free( source );
+    return equal;
+}
+
+struct Test_t {
+    const char *name;
+    bool ( *run )();
+};
+
+int main() {
+    LogConfigure( "warn" );
+    GraphDumpConfigure( GRAPH_DUMP_OFF, 0 );
+
+    if ( !mkdtemp( work_directory ) ) {
+        PRINT_ERROR( "Fail to create a directory in /tmp" );
+        return 1;
+    }
+
+    static const Test_t TESTS[] = {
+        { "right-associative power",     TestPowerAssociativity },
+        { "left-associative operators",  TestLeftAssociativity },
+        { "operator precedence",         TestPrecedence },
+        { "lexer chunk boundaries",      TestChunkBoundaries },
+        { "lexer input without newline", TestNoNewline },
+    };
+
+    int failed = 0;
+    for ( size_t i = 0; i < sizeof( TESTS ) / sizeof( *TESTS ); i++ ) {
+        bool passed = TESTS[i].run();
+        printf( "[%s] %s\n", passed ? " ok " : "FAIL", TESTS[i].name );
+        failed += !passed;
+    }
+
+    rmdir( work_directory );
+    return failed;
+}